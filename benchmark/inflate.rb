@@ -0,0 +1,40 @@
+# Measure how fast objects are read and inflated from the object
+# database, which is what every lookup of a tree or blob pays for.
+#
+#   ruby -Ilib benchmark/inflate.rb [REPO_PATH] [COMMITS] [ROUNDS]
+#
+# Compare builds made with different --with-zlib-backend options; the
+# backend in use is reported by Rugged.capabilities.
+require 'benchmark'
+require 'rugged'
+
+path    = ARGV[0] || File.expand_path('../..', __FILE__)
+commits = (ARGV[1] || 200).to_i
+rounds  = (ARGV[2] || 3).to_i
+
+repo = Rugged::Repository.new(path)
+
+# every read has to inflate the object again
+Rugged::Settings['enable_caching'] = false
+
+oids = {}
+repo.walk(repo.head.target).first(commits).each do |commit|
+  oids[commit.oid] = true
+  oids[commit.tree.oid] = true
+  commit.tree.walk(:preorder) { |_, entry| oids[entry[:oid]] = true unless entry[:type] == :commit }
+end
+
+zlib = Rugged.capabilities.include?(:zlib_ng) ? "zlib-ng" : "zlib"
+puts "#{oids.size} objects from #{commits} commits of #{path} (#{zlib})"
+
+rounds.times do |round|
+  bytes = 0
+  time = Benchmark.realtime do
+    oids.each_key { |oid| bytes += repo.read(oid).len }
+  end
+
+  puts "round %d: %.1f MB inflated in %.3fs, %.1f MB/s, %.0f objects/s" %
+    [round + 1, bytes / 1048576.0, time, bytes / 1048576.0 / time, oids.size / time]
+end
+
+Rugged::Settings['enable_caching'] = true
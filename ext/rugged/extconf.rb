@@ -12,6 +12,39 @@ end
 
 MAKE_PROGRAM = find_executable('gmake') || find_executable('make')
 
+# The zlib libgit2 inflates objects with: the copy bundled with libgit2,
+# the system zlib, or zlib-ng built with ZLIB_COMPAT, which is API
+# compatible and much faster. Pick with --with-zlib-backend=NAME or
+# RUGGED_ZLIB_BACKEND.
+ZLIB_BACKEND = (with_config('zlib-backend') || ENV['RUGGED_ZLIB_BACKEND'] || 'bundled').to_s
+
+unless %w(bundled system zlib-ng).include?(ZLIB_BACKEND)
+  STDERR.puts "ERROR: Unknown zlib backend `#{ZLIB_BACKEND}`; expected bundled, system or zlib-ng"
+  STDERR.puts "       (libdeflate has no streaming zlib API, which libgit2 requires)" if ZLIB_BACKEND == 'libdeflate'
+  exit(1)
+end
+
+def check_external_zlib
+  unless have_header 'zlib.h' and have_library 'z', 'inflate'
+    STDERR.puts "ERROR: zlib is required to build Rugged"
+    exit(1)
+  end
+
+  if ZLIB_BACKEND == 'zlib-ng' and !have_func('zlibng_version', 'zlib.h')
+    STDERR.puts "ERROR: the zlib found is not zlib-ng built with ZLIB_COMPAT"
+    exit(1)
+  end
+end
+
+# Build flags for Makefile.embed that leave the bundled zlib out
+def embed_without_bundled_zlib
+  makefile = File.read('Makefile.embed')
+  sources = makefile[/^SOURCES\s*=(.*)$/, 1].gsub(%r{\$\(wildcard deps/zlib/\*\.c\)}, '')
+  cflags = makefile[/^CFLAGS\s*=(.*)$/, 1].gsub('-Ideps/zlib', '') + " #{$CPPFLAGS}"
+
+  "'SOURCES=#{sources.strip}' 'CFLAGS=#{cflags.strip}'"
+end
+
 if MAKE_PROGRAM.nil?
   STDERR.puts "ERROR: GNU make is required to build Rugged"
   exit(1)
@@ -24,19 +57,29 @@ if p = ENV['LIBGIT2_PATH']
     STDERR.puts "ERROR: Invalid `LIBGIT2_PATH` environment"
     exit(1)
   end
+
+  check_external_zlib
 else
   CWD = File.expand_path(File.dirname(__FILE__))
   LIBGIT2_DIR = File.join(CWD, '..', '..', 'vendor', 'libgit2')
   LIBGIT2_LIB_PATH = "#{CWD}/libgit2_embed.a"
 
+  check_external_zlib unless ZLIB_BACKEND == 'bundled'
+
   if !File.exists?(LIBGIT2_LIB_PATH)
     Dir.chdir(LIBGIT2_DIR) do
-      sys("#{MAKE_PROGRAM} -f Makefile.embed")
+      if ZLIB_BACKEND == 'bundled'
+        sys("#{MAKE_PROGRAM} -f Makefile.embed")
+      else
+        sys("#{MAKE_PROGRAM} -f Makefile.embed #{embed_without_bundled_zlib}")
+      end
       FileUtils.cp 'libgit2.a', LIBGIT2_LIB_PATH
     end
   end
 
+  # libgit2_embed bundles zlib; reuse its headers for binary patches
   $INCFLAGS[0,0] = " -I#{LIBGIT2_DIR}/include "
+  $INCFLAGS[0,0] << " -I#{LIBGIT2_DIR}/deps/zlib " if ZLIB_BACKEND == 'bundled'
   $LDFLAGS << " -L#{CWD} "
 
   unless have_library 'git2_embed' and have_header 'git2.h'
@@ -45,4 +88,12 @@ else
   end
 end
 
+# Repository#diff_stats_for diffs commits on several threads without the GVL
+have_header 'pthread.h'
+have_func 'rb_thread_call_without_gvl', 'ruby/thread.h'
+have_func 'rb_thread_blocking_region'
+
+# Repository#batch_fsync flushes only the repository's filesystem
+have_func 'syncfs', 'unistd.h'
+
 create_makefile("rugged/rugged")
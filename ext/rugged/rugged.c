@@ -24,6 +24,8 @@
 
 #include "rugged.h"
 
+#include <zlib.h>
+
 const char *RUGGED_ERROR_NAMES[] = {
 	"NoMemError", /* GITERR_NOMEMORY, */
 	"OSError", /* GITERR_OS, */
@@ -82,7 +84,9 @@ static VALUE rb_git_libgit2_version(VALUE self)
  *	This is implemented in libgit2 with simple bitwise ops; we offer Rubyland an array
  *	of symbols representing the capabilities.
  *
- *	The possible capabilities are "threads" and "https".
+ *	The possible capabilities are "threads" and "https", plus "zlib_ng"
+ *	when objects are inflated with zlib-ng instead of the stock zlib
+ *	(see the --with-zlib-backend build option).
  *
  *	Rugged.capabilities
  *		#=> [:threads, :https]
@@ -99,6 +103,10 @@ static VALUE rb_git_capabilities(VALUE self)
 	if (caps & GIT_CAP_HTTPS)
 		rb_ary_push(ret_arr, CSTR2SYM("https"));
 
+	/* zlib-ng in compat mode tags the zlib version it implements */
+	if (strstr(zlibVersion(), "zlib-ng") != NULL)
+		rb_ary_push(ret_arr, CSTR2SYM("zlib_ng"));
+
 	return ret_arr;
 }
 
@@ -297,7 +305,7 @@ void rugged_exception_raise(int errorcode)
 
 static VALUE rb_git_cache_usage(VALUE self)
 {
-	int64_t used, max;
+	ssize_t used, max;
 	git_libgit2_opts(GIT_OPT_GET_CACHED_MEMORY, &used, &max);
 	return rb_ary_new3(2, LL2NUM(used), LL2NUM(max));
 }
@@ -348,6 +356,7 @@ void Init_rugged()
 	Init_rugged_tree();
 	Init_rugged_tag();
 	Init_rugged_blob();
+	Init_rugged_signature();
 
 	Init_rugged_index();
 	Init_rugged_repo();
@@ -363,6 +372,20 @@ void Init_rugged()
 	Init_rugged_diff_delta();
 	Init_rugged_diff_hunk();
 	Init_rugged_diff_line();
+	Init_rugged_fast_export();
+	Init_rugged_merge();
+	Init_rugged_apply();
+	Init_rugged_word_diff();
+	Init_rugged_diff_cache();
+	Init_rugged_diff_stats();
+	Init_rugged_pathspec();
+	Init_rugged_tree_aggregator();
+	Init_rugged_checkout();
+	Init_rugged_fork();
+	Init_rugged_shared_cache();
+	Init_rugged_write_policy();
+	Init_rugged_object_ids();
+	Init_rugged_fsck();
 
 	/* Constants */
 	rb_define_const(rb_mRugged, "SORT_NONE", INT2FIX(0));
@@ -37,6 +37,7 @@
 #endif
 
 #include <assert.h>
+#include <stdint.h>
 #include <git2.h>
 #include <git2/odb_backend.h>
 
@@ -64,12 +65,27 @@ void Init_rugged_diff_patch();
 void Init_rugged_diff_delta();
 void Init_rugged_diff_hunk();
 void Init_rugged_diff_line();
+void Init_rugged_fast_export();
+void Init_rugged_signature();
+void Init_rugged_merge();
+void Init_rugged_apply();
+void Init_rugged_word_diff();
+void Init_rugged_diff_cache();
+void Init_rugged_diff_stats();
+void Init_rugged_pathspec();
+void Init_rugged_tree_aggregator();
+void Init_rugged_checkout();
+void Init_rugged_fork();
+void Init_rugged_shared_cache();
+void Init_rugged_write_policy();
+void Init_rugged_object_ids();
+void Init_rugged_fsck();
 
 VALUE rb_git_object_init(git_otype type, int argc, VALUE *argv, VALUE self);
 
 VALUE rugged_raw_read(git_repository *repo, const git_oid *oid);
 
-VALUE rugged_signature_new(const git_signature *sig, const char *encoding_name);
+VALUE rugged_signature_new(const git_signature *sig, const char *encoding_name, VALUE rb_repo);
 
 VALUE rugged_index_new(VALUE klass, VALUE owner, git_index *index);
 VALUE rugged_config_new(VALUE klass, VALUE owner, git_config *cfg);
@@ -83,10 +99,81 @@ VALUE rugged_diff_line_new(VALUE owner, const char line_origin, const char *cont
 
 void rugged_parse_diff_options(git_diff_options *opts, VALUE rb_options);
 
+int rugged_tree_entry_cmp(const git_tree_entry *a, const git_tree_entry *b);
+VALUE rugged_tree_byte_stats(VALUE rb_repo, const git_oid *tree_id,
+	const char *attribute, int count_files);
+
+void rugged_pathspec_strarray(git_strarray *out, VALUE rb_pathspec);
+int rugged_pathspec_commit_touches(int *touches, VALUE rb_pathspec, git_commit *commit);
+VALUE rugged_pathspec_coerce(VALUE rb_paths);
+int rugged_pathspec_match_path(VALUE rb_pathspec, const char *path);
+int rugged_pathspec_match_dir(VALUE rb_pathspec, const char *dir, size_t dir_len);
+
+int rugged_shared_cache_attach(VALUE rb_repo, git_odb *odb);
+int rugged_write_policy_attach(VALUE rb_repo, git_odb *odb);
+void rugged_ref_fsync(VALUE rb_repo, const char *refname);
+VALUE rugged_object_ids(VALUE rb_repo, git_otype type);
+VALUE rugged_object_dirs(VALUE rb_repo);
+
+char **rugged_repo_alternates(VALUE rb_repo);
+void rugged_repo_alternates_free(char **alternates);
+int rugged_repo_open_worker(git_repository **out, const char *path, char **alternates);
+
+/* libgit2 can only be used from several threads when built with GIT_THREADS */
+static inline int rugged_threads_supported(void)
+{
+	return git_libgit2_capabilities() & GIT_CAP_THREADS;
+}
+
+/* worker threads need pthreads, and a way to release the GVL */
+#if defined(HAVE_PTHREAD_H) && \
+	(defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL) || defined(HAVE_RB_THREAD_BLOCKING_REGION))
+#	define RUGGED_THREADS
+#endif
+
+#define RUGGED_POOL_MAX_THREADS 32
+
+/* returned by a job given up because of an interrupt, to run it again */
+#define RUGGED_POOL_RETRY 1
+
+typedef struct rugged_pool rugged_pool;
+typedef int (*rugged_pool_job_cb)(rugged_pool *pool, size_t worker, size_t job, void *payload);
+typedef void (*rugged_pool_report_cb)(size_t done, void *payload);
+
+size_t rugged_pool_threads(size_t max);
+int rugged_pool_run(size_t threads, size_t job_count,
+	rugged_pool_job_cb job_cb, rugged_pool_report_cb report_cb, void *payload);
+int rugged_pool_interrupted(const rugged_pool *pool);
+
+static inline uint32_t rugged_be32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* a pack index (version 1 or 2), parsed just enough to read its entries */
+typedef struct {
+	const unsigned char *data;
+	size_t size;
+	int version;
+	uint32_t count;
+	const unsigned char *fanout, *names, *crcs, *offsets, *large_offsets;
+} rugged_pack_index;
+
+void *rugged_map_file(const char *path, size_t *size);
+int rugged_pack_index_parse(rugged_pack_index *idx);
+const unsigned char *rugged_pack_index_name(const rugged_pack_index *idx, uint32_t pos);
+int rugged_pack_index_offset(uint64_t *out, const rugged_pack_index *idx, uint32_t pos);
+
+/* results of rugged_pathspec_match_dir */
+#define PATHSPEC_DIR_NONE 0
+#define PATHSPEC_DIR_SOME 1
+#define PATHSPEC_DIR_ALL  2
+
 VALUE rugged_otype_new(git_otype t);
 git_otype rugged_otype_get(VALUE rb_type);
 
 git_signature *rugged_signature_get(VALUE rb_person);
+const git_signature *rugged_signature_unwrap(VALUE rb_sig);
 git_object *rugged_object_get(git_repository *repo, VALUE object_value, git_otype type);
 int rugged_oid_get(git_oid *oid, git_repository *repo, VALUE p);
 
@@ -0,0 +1,1534 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "rugged.h"
+#include <zlib.h>
+
+extern VALUE rb_mRugged;
+extern VALUE rb_cRuggedDiff;
+extern VALUE rb_cRuggedTree;
+
+VALUE rb_cRuggedDiffParsed;
+
+/*
+ * Rugged Diff::Parsed
+ *
+ * A patch in unified diff format (as produced by `git diff` or
+ * `git format-patch`), parsed in memory. Hunks are kept as pointers into
+ * a frozen copy of the original text, which is marked by the object.
+ */
+
+typedef struct {
+	int old_start, old_lines, new_start, new_lines;
+	const char *lines;
+	size_t lines_len;
+} rugged_patch_hunk;
+
+typedef enum {
+	RUGGED_BINARY_NONE = 0,
+	RUGGED_BINARY_LITERAL,
+	RUGGED_BINARY_DELTA,
+} rugged_binary_t;
+
+typedef struct {
+	rugged_binary_t type;
+	size_t inflated_len;
+	const char *data;
+	size_t data_len;
+} rugged_patch_binary;
+
+typedef struct {
+	char *old_path, *new_path;
+	unsigned int old_mode, new_mode;
+	git_delta_t status;
+	int is_binary;
+	rugged_patch_binary binary;
+
+	rugged_patch_hunk *hunks;
+	size_t hunk_count, hunk_alloc;
+} rugged_patch_file;
+
+typedef struct {
+	VALUE rb_text;
+	rugged_patch_file *files;
+	size_t count, alloc;
+} rugged_parsed_diff;
+
+typedef struct {
+	const char *ptr, *end;
+	const char *line;
+	size_t len;
+	int lineno;
+} rugged_patch_parser;
+
+#define PARSER_LINE_IS(p, str) \
+	((p)->len >= strlen(str) && !memcmp((p)->line, (str), strlen(str)))
+
+static int patch_error(rugged_patch_parser *parser, const char *message)
+{
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "Corrupt patch at line %d: %s", parser->lineno, message);
+	giterr_set_str(GITERR_INVALID, buf);
+
+	return -1;
+}
+
+static int parser_next(rugged_patch_parser *parser)
+{
+	const char *eol;
+
+	if (parser->ptr >= parser->end)
+		return 0;
+
+	parser->line = parser->ptr;
+	eol = memchr(parser->ptr, '\n', parser->end - parser->ptr);
+	parser->ptr = eol ? eol + 1 : parser->end;
+	parser->len = parser->ptr - parser->line;
+	parser->lineno++;
+
+	return 1;
+}
+
+static int parser_peek(rugged_patch_parser *parser, const char *prefix)
+{
+	size_t len = strlen(prefix);
+
+	return (size_t)(parser->end - parser->ptr) >= len &&
+		!memcmp(parser->ptr, prefix, len);
+}
+
+/* Length of the current line, without its newline */
+static size_t parser_line_len(rugged_patch_parser *parser)
+{
+	size_t len = parser->len;
+
+	if (len > 0 && parser->line[len - 1] == '\n')
+		len--;
+
+	return len;
+}
+
+static int parse_number(const char **ptr, const char *end, int *out)
+{
+	const char *p = *ptr;
+	int n = 0;
+
+	if (p >= end || *p < '0' || *p > '9')
+		return -1;
+
+	while (p < end && *p >= '0' && *p <= '9')
+		n = n * 10 + (*p++ - '0');
+
+	*ptr = p;
+	*out = n;
+	return 0;
+}
+
+static unsigned int parse_mode(const char *str, const char *end)
+{
+	unsigned int mode = 0;
+
+	while (str < end && *str >= '0' && *str <= '7')
+		mode = (mode << 3) + (*str++ - '0');
+
+	return mode;
+}
+
+/*
+ * Parse a path as it appears in a patch header: either plain text,
+ * ending at a tab or at the end of the line, or a C-style quoted string.
+ * "/dev/null" yields a NULL path. `strip` removes the first component
+ * ("a/", "b/"), like `git apply -p1`.
+ */
+static int parse_path(char **out, const char **ptr, const char *end, int strip)
+{
+	const char *p = *ptr;
+	char *path, *w;
+
+	path = w = xmalloc(end - p + 1);
+
+	if (p < end && *p == '"') {
+		for (p++; p < end && *p != '"'; p++) {
+			if (*p != '\\') {
+				*w++ = *p;
+				continue;
+			}
+
+			if (++p == end)
+				break;
+
+			switch (*p) {
+			case 'a': *w++ = '\a'; break;
+			case 'b': *w++ = '\b'; break;
+			case 'f': *w++ = '\f'; break;
+			case 'n': *w++ = '\n'; break;
+			case 'r': *w++ = '\r'; break;
+			case 't': *w++ = '\t'; break;
+			case 'v': *w++ = '\v'; break;
+			case '0': case '1': case '2': case '3':
+				if (end - p < 3) {
+					xfree(path);
+					return -1;
+				}
+				*w++ = (char)(((p[0] - '0') << 6) | ((p[1] - '0') << 3) | (p[2] - '0'));
+				p += 2;
+				break;
+			default:
+				*w++ = *p;
+			}
+		}
+
+		if (p == end) {
+			xfree(path);
+			return -1;
+		}
+
+		p++;
+	} else {
+		while (p < end && *p != '\t')
+			*w++ = *p++;
+	}
+
+	*w = '\0';
+	*ptr = p;
+
+	if (!strcmp(path, "/dev/null")) {
+		xfree(path);
+		*out = NULL;
+		return 0;
+	}
+
+	if (strip && (w = strchr(path, '/')) != NULL)
+		memmove(path, w + 1, strlen(w + 1) + 1);
+
+	*out = path;
+	return 0;
+}
+
+static rugged_patch_file *parsed_diff_add_file(rugged_parsed_diff *diff)
+{
+	rugged_patch_file *file;
+
+	if (diff->count == diff->alloc) {
+		diff->alloc = diff->alloc ? diff->alloc * 2 : 8;
+		diff->files = xrealloc(diff->files, diff->alloc * sizeof(rugged_patch_file));
+	}
+
+	file = &diff->files[diff->count++];
+	memset(file, 0x0, sizeof(rugged_patch_file));
+	file->status = GIT_DELTA_MODIFIED;
+
+	return file;
+}
+
+/*
+ * "diff --git a/foo b/foo": when the names are unquoted and contain
+ * spaces there's no way to tell where one ends, so we assume both are
+ * the same, as git does. Renames carry their names in the extended
+ * headers anyway.
+ */
+static int parse_git_header(rugged_patch_file *file, rugged_patch_parser *parser)
+{
+	const char *p = parser->line + strlen("diff --git "), *end = parser->line + parser_line_len(parser);
+	size_t len = end - p;
+
+	if (*p == '"') {
+		if (parse_path(&file->old_path, &p, end, 1) < 0)
+			return patch_error(parser, "invalid path in git header");
+
+		while (p < end && *p == ' ')
+			p++;
+
+		if (parse_path(&file->new_path, &p, end, 1) < 0)
+			return patch_error(parser, "invalid path in git header");
+
+		return 0;
+	}
+
+	if (len % 2 == 1 && p[len / 2] == ' ') {
+		const char *b = p + len / 2 + 1;
+
+		if (parse_path(&file->old_path, &p, p + len / 2, 1) < 0 ||
+			parse_path(&file->new_path, &b, end, 1) < 0)
+			return patch_error(parser, "invalid path in git header");
+
+		return 0;
+	}
+
+	return 0;
+}
+
+static int parse_header_path(char **out, rugged_patch_parser *parser, size_t prefix_len, int strip)
+{
+	const char *p = parser->line + prefix_len;
+	char *path;
+
+	if (parse_path(&path, &p, parser->line + parser_line_len(parser), strip) < 0)
+		return patch_error(parser, "invalid path");
+
+	xfree(*out);
+	*out = path;
+	return 0;
+}
+
+static int parse_extended_header(rugged_patch_file *file, rugged_patch_parser *parser)
+{
+	const char *end = parser->line + parser_line_len(parser);
+
+	if (PARSER_LINE_IS(parser, "old mode "))
+		file->old_mode = parse_mode(parser->line + strlen("old mode "), end);
+	else if (PARSER_LINE_IS(parser, "new mode "))
+		file->new_mode = parse_mode(parser->line + strlen("new mode "), end);
+	else if (PARSER_LINE_IS(parser, "deleted file mode ")) {
+		file->old_mode = parse_mode(parser->line + strlen("deleted file mode "), end);
+		file->status = GIT_DELTA_DELETED;
+	} else if (PARSER_LINE_IS(parser, "new file mode ")) {
+		file->new_mode = parse_mode(parser->line + strlen("new file mode "), end);
+		file->status = GIT_DELTA_ADDED;
+	} else if (PARSER_LINE_IS(parser, "rename from ")) {
+		file->status = GIT_DELTA_RENAMED;
+		return parse_header_path(&file->old_path, parser, strlen("rename from "), 0);
+	} else if (PARSER_LINE_IS(parser, "rename to ")) {
+		file->status = GIT_DELTA_RENAMED;
+		return parse_header_path(&file->new_path, parser, strlen("rename to "), 0);
+	} else if (PARSER_LINE_IS(parser, "copy from ")) {
+		file->status = GIT_DELTA_COPIED;
+		return parse_header_path(&file->old_path, parser, strlen("copy from "), 0);
+	} else if (PARSER_LINE_IS(parser, "copy to ")) {
+		file->status = GIT_DELTA_COPIED;
+		return parse_header_path(&file->new_path, parser, strlen("copy to "), 0);
+	} else if (PARSER_LINE_IS(parser, "index ")) {
+		const char *mode = memchr(parser->line, ' ', end - parser->line);
+
+		/* "index abc..def 100644" */
+		if (mode && (mode = memchr(mode + 1, ' ', end - mode - 1)) != NULL)
+			file->old_mode = file->new_mode = parse_mode(mode + 1, end);
+	} else if (PARSER_LINE_IS(parser, "Binary files ")) {
+		file->is_binary = 1;
+	}
+
+	return 0;
+}
+
+static int parse_hunk(rugged_patch_file *file, rugged_patch_parser *parser)
+{
+	const char *p = parser->line + strlen("@@ -"), *end = parser->line + parser->len;
+	rugged_patch_hunk *hunk;
+	int old_left, new_left;
+
+	if (file->hunk_count == file->hunk_alloc) {
+		file->hunk_alloc = file->hunk_alloc ? file->hunk_alloc * 2 : 4;
+		file->hunks = xrealloc(file->hunks, file->hunk_alloc * sizeof(rugged_patch_hunk));
+	}
+
+	hunk = &file->hunks[file->hunk_count++];
+	hunk->old_lines = hunk->new_lines = 1;
+
+	if (parse_number(&p, end, &hunk->old_start) < 0 ||
+		(p < end && *p == ',' && (++p, parse_number(&p, end, &hunk->old_lines) < 0)) ||
+		end - p < 2 || memcmp(p, " +", 2) ||
+		(p += 2, parse_number(&p, end, &hunk->new_start) < 0) ||
+		(p < end && *p == ',' && (++p, parse_number(&p, end, &hunk->new_lines) < 0)) ||
+		end - p < 3 || memcmp(p, " @@", 3))
+		return patch_error(parser, "invalid hunk header");
+
+	old_left = hunk->old_lines;
+	new_left = hunk->new_lines;
+	hunk->lines = parser->ptr;
+
+	while ((old_left > 0 || new_left > 0) && parser_next(parser)) {
+		switch (parser->line[0]) {
+		case ' ':
+		case '\n':
+			old_left--;
+			new_left--;
+			break;
+		case '-':
+			old_left--;
+			break;
+		case '+':
+			new_left--;
+			break;
+		case '\\':
+			break;
+		default:
+			return patch_error(parser, "unexpected line in hunk");
+		}
+
+		if (old_left < 0 || new_left < 0)
+			return patch_error(parser, "hunk is longer than its header says");
+	}
+
+	if (old_left > 0 || new_left > 0)
+		return patch_error(parser, "truncated hunk");
+
+	if (parser_peek(parser, "\\"))
+		parser_next(parser);
+
+	hunk->lines_len = parser->ptr - hunk->lines;
+	return 0;
+}
+
+static int parse_binary_hunk(rugged_patch_binary *binary, rugged_patch_parser *parser)
+{
+	const char *p;
+	int len;
+
+	if (!parser_next(parser))
+		return patch_error(parser, "truncated binary patch");
+
+	if (PARSER_LINE_IS(parser, "literal ")) {
+		binary->type = RUGGED_BINARY_LITERAL;
+		p = parser->line + strlen("literal ");
+	} else if (PARSER_LINE_IS(parser, "delta ")) {
+		binary->type = RUGGED_BINARY_DELTA;
+		p = parser->line + strlen("delta ");
+	} else {
+		return patch_error(parser, "unknown binary patch type");
+	}
+
+	if (parse_number(&p, parser->line + parser->len, &len) < 0)
+		return patch_error(parser, "invalid binary patch size");
+
+	binary->inflated_len = (size_t)len;
+	binary->data = parser->ptr;
+
+	while (parser_next(parser)) {
+		if (parser_line_len(parser) == 0) {
+			binary->data_len = parser->line - binary->data;
+			return 0;
+		}
+	}
+
+	/* The patch ended right after the last data line */
+	binary->data_len = parser->end - binary->data;
+	return 0;
+}
+
+static int parse_binary(rugged_patch_file *file, rugged_patch_parser *parser)
+{
+	rugged_patch_binary reverse;
+
+	file->is_binary = 1;
+
+	if (parse_binary_hunk(&file->binary, parser) < 0)
+		return -1;
+
+	/* The reverse hunk is optional, and never needed to apply forward */
+	if (parser_peek(parser, "literal ") || parser_peek(parser, "delta "))
+		return parse_binary_hunk(&reverse, parser);
+
+	return 0;
+}
+
+static int parse_patch(rugged_parsed_diff *diff, const char *text, size_t len)
+{
+	rugged_patch_parser parser;
+	rugged_patch_file *file = NULL;
+	int in_header = 0, seen_paths = 0;
+
+	memset(&parser, 0x0, sizeof(parser));
+	parser.ptr = text;
+	parser.end = text + len;
+
+	while (parser_next(&parser)) {
+		if (PARSER_LINE_IS(&parser, "diff --git ")) {
+			file = parsed_diff_add_file(diff);
+			in_header = 1;
+			seen_paths = 0;
+
+			if (parse_git_header(file, &parser) < 0)
+				return -1;
+
+		} else if (PARSER_LINE_IS(&parser, "--- ") && parser_peek(&parser, "+++ ")) {
+			if (!file || !in_header || seen_paths) {
+				file = parsed_diff_add_file(diff);
+				in_header = 1;
+			}
+
+			seen_paths = 1;
+
+			if (parse_header_path(&file->old_path, &parser, strlen("--- "), 1) < 0)
+				return -1;
+
+			parser_next(&parser);
+
+			if (parse_header_path(&file->new_path, &parser, strlen("+++ "), 1) < 0)
+				return -1;
+
+			if (file->old_path == NULL)
+				file->status = GIT_DELTA_ADDED;
+			else if (file->new_path == NULL)
+				file->status = GIT_DELTA_DELETED;
+
+		} else if (file && PARSER_LINE_IS(&parser, "@@ -")) {
+			in_header = 0;
+
+			if (parse_hunk(file, &parser) < 0)
+				return -1;
+
+		} else if (file && in_header && PARSER_LINE_IS(&parser, "GIT binary patch")) {
+			in_header = 0;
+
+			if (parse_binary(file, &parser) < 0)
+				return -1;
+
+		} else if (file && in_header) {
+			if (parse_extended_header(file, &parser) < 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void rb_git_parsed_diff__mark(rugged_parsed_diff *diff)
+{
+	rb_gc_mark(diff->rb_text);
+}
+
+static void rb_git_parsed_diff__free(rugged_parsed_diff *diff)
+{
+	size_t i;
+
+	for (i = 0; i < diff->count; ++i) {
+		xfree(diff->files[i].old_path);
+		xfree(diff->files[i].new_path);
+		xfree(diff->files[i].hunks);
+	}
+
+	xfree(diff->files);
+	xfree(diff);
+}
+
+static rugged_parsed_diff *rugged_parsed_diff_get(VALUE rb_diff)
+{
+	rugged_parsed_diff *diff;
+
+	if (!rb_obj_is_kind_of(rb_diff, rb_cRuggedDiffParsed))
+		rb_raise(rb_eTypeError, "Expecting a Rugged::Diff::Parsed instance");
+
+	Data_Get_Struct(rb_diff, rugged_parsed_diff, diff);
+	return diff;
+}
+
+/*
+ *	call-seq:
+ *		Diff.parse(patch) -> parsed_diff
+ *
+ *	Parse the text of a +patch+ in unified diff format, as generated by
+ *	<tt>git diff</tt> or <tt>git format-patch</tt>, and return it as a
+ *	<tt>Rugged::Diff::Parsed</tt> that can be applied to a tree with
+ *	+Tree#apply+.
+ *
+ *	Git extended headers (modes, renames, copies) and binary patches are
+ *	understood; plain unified diffs are parsed as if by <tt>patch -p1</tt>.
+ *	Any text around the diffs (e.g. an email's headers and commit message)
+ *	is ignored.
+ *
+ *	Raises <tt>Rugged::InvalidError</tt> if the patch is corrupt.
+ *
+ *		diff = Rugged::Diff.parse(File.read("fix.patch"))
+ *		diff.paths #=> ["README", "lib/foo.rb"]
+ */
+static VALUE rb_git_diff_parse(VALUE self, VALUE rb_text)
+{
+	rugged_parsed_diff *diff;
+	VALUE rb_diff;
+
+	Check_Type(rb_text, T_STRING);
+
+	diff = xmalloc(sizeof(rugged_parsed_diff));
+	memset(diff, 0x0, sizeof(rugged_parsed_diff));
+
+	diff->rb_text = rb_str_new_frozen(rb_text);
+	rb_diff = Data_Wrap_Struct(rb_cRuggedDiffParsed,
+		rb_git_parsed_diff__mark, rb_git_parsed_diff__free, diff);
+
+	rugged_exception_check(parse_patch(diff,
+		RSTRING_PTR(diff->rb_text), RSTRING_LEN(diff->rb_text)));
+
+	return rb_diff;
+}
+
+static VALUE rb_git_delta_status_sym(git_delta_t status)
+{
+	switch (status) {
+	case GIT_DELTA_ADDED:
+		return CSTR2SYM("added");
+	case GIT_DELTA_DELETED:
+		return CSTR2SYM("deleted");
+	case GIT_DELTA_RENAMED:
+		return CSTR2SYM("renamed");
+	case GIT_DELTA_COPIED:
+		return CSTR2SYM("copied");
+	default:
+		return CSTR2SYM("modified");
+	}
+}
+
+/*
+ *	call-seq:
+ *		parsed_diff.each_file { |file| block }
+ *		parsed_diff.each_file -> Enumerator
+ *
+ *	Iterate through the files changed by the patch. Each +file+ is
+ *	a +Hash+ with the following keys:
+ *
+ *	- +:old_path+, +:new_path+: the paths before and after the change;
+ *	  +nil+ for the missing side of an addition or deletion
+ *	- +:old_mode+, +:new_mode+: the modes, or +nil+ if the patch doesn't
+ *	  say
+ *	- +:status+: one of +:added+, +:deleted+, +:modified+, +:renamed+
+ *	  or +:copied+
+ *	- +:binary+: whether the change is a binary patch
+ *	- +:hunks+: the number of hunks in the change
+ */
+static VALUE rb_git_parsed_diff_each_file(VALUE self)
+{
+	rugged_parsed_diff *diff;
+	size_t i;
+
+	if (!rb_block_given_p())
+		return rb_funcall(self, rb_intern("to_enum"), 1, CSTR2SYM("each_file"));
+
+	Data_Get_Struct(self, rugged_parsed_diff, diff);
+
+	for (i = 0; i < diff->count; ++i) {
+		rugged_patch_file *file = &diff->files[i];
+		VALUE rb_file = rb_hash_new();
+
+		rb_hash_aset(rb_file, CSTR2SYM("old_path"),
+			file->old_path ? rugged_str_new2(file->old_path, NULL) : Qnil);
+		rb_hash_aset(rb_file, CSTR2SYM("new_path"),
+			file->new_path ? rugged_str_new2(file->new_path, NULL) : Qnil);
+		rb_hash_aset(rb_file, CSTR2SYM("old_mode"),
+			file->old_mode ? INT2FIX(file->old_mode) : Qnil);
+		rb_hash_aset(rb_file, CSTR2SYM("new_mode"),
+			file->new_mode ? INT2FIX(file->new_mode) : Qnil);
+		rb_hash_aset(rb_file, CSTR2SYM("status"), rb_git_delta_status_sym(file->status));
+		rb_hash_aset(rb_file, CSTR2SYM("binary"), file->is_binary ? Qtrue : Qfalse);
+		rb_hash_aset(rb_file, CSTR2SYM("hunks"), INT2FIX(file->hunk_count));
+
+		rb_yield(rb_file);
+	}
+
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		parsed_diff.size -> count
+ *
+ *	Return the number of files changed by the patch.
+ */
+static VALUE rb_git_parsed_diff_size(VALUE self)
+{
+	rugged_parsed_diff *diff;
+	Data_Get_Struct(self, rugged_parsed_diff, diff);
+
+	return INT2FIX(diff->count);
+}
+
+/*
+ * Applying patches
+ */
+
+typedef struct {
+	char *ptr;
+	size_t size, alloc;
+} apply_buf;
+
+typedef struct {
+	const char *ptr;
+	size_t len;
+} apply_line;
+
+typedef struct {
+	apply_line *lines;
+	size_t count, alloc;
+} apply_lines;
+
+typedef struct {
+	char *path;
+	git_oid oid;
+	git_filemode_t mode;
+	int remove;
+} apply_change;
+
+typedef struct {
+	git_repository *repo;
+	git_tree *tree;
+	int max_fuzz;
+
+	apply_change *changes;
+	size_t change_count, change_alloc;
+
+	VALUE rb_hunks;
+} rugged_apply;
+
+static void apply_buf_put(apply_buf *buf, const char *data, size_t len)
+{
+	if (buf->size + len > buf->alloc) {
+		buf->alloc = (buf->size + len) * 3 / 2 + 64;
+		buf->ptr = xrealloc(buf->ptr, buf->alloc);
+	}
+
+	memcpy(buf->ptr + buf->size, data, len);
+	buf->size += len;
+}
+
+static void apply_lines_push(apply_lines *lines, const char *ptr, size_t len)
+{
+	if (lines->count == lines->alloc) {
+		lines->alloc = lines->alloc ? lines->alloc * 2 : 32;
+		lines->lines = xrealloc(lines->lines, lines->alloc * sizeof(apply_line));
+	}
+
+	lines->lines[lines->count].ptr = ptr;
+	lines->lines[lines->count].len = len;
+	lines->count++;
+}
+
+static void apply_lines_split(apply_lines *lines, const char *data, size_t size)
+{
+	size_t i, start = 0;
+
+	for (i = 0; i < size; ++i) {
+		if (data[i] == '\n' || i + 1 == size) {
+			apply_lines_push(lines, data + start, i + 1 - start);
+			start = i + 1;
+		}
+	}
+}
+
+static int apply_lines_match(
+	const apply_lines *image, size_t pos, const apply_line *lines, size_t count)
+{
+	size_t i;
+
+	if (pos + count > image->count)
+		return 0;
+
+	for (i = 0; i < count; ++i) {
+		const apply_line *a = &image->lines[pos + i], *b = &lines[i];
+
+		if (a->len != b->len || memcmp(a->ptr, b->ptr, a->len))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Look for `lines` in `image`, starting at `expected` and moving further
+ * away from it in both directions, but never before `min_pos` (the part
+ * of the image already consumed by previous hunks).
+ */
+static int apply_find_hunk(
+	const apply_lines *image,
+	size_t min_pos,
+	size_t expected,
+	const apply_line *lines,
+	size_t count,
+	size_t *out)
+{
+	size_t distance;
+
+	/* Insertions without context can only go where the header says */
+	if (count == 0) {
+		*out = expected < image->count ? expected : image->count;
+		return 1;
+	}
+
+	for (distance = 0; ; ++distance) {
+		int forward = (expected + distance + count <= image->count);
+		int backward = (distance > 0 && expected >= min_pos + distance);
+
+		if (forward && apply_lines_match(image, expected + distance, lines, count)) {
+			*out = expected + distance;
+			return 1;
+		}
+
+		if (backward && apply_lines_match(image, expected - distance, lines, count)) {
+			*out = expected - distance;
+			return 1;
+		}
+
+		/* Out of range on both sides from now on */
+		if (!forward && expected <= min_pos + distance)
+			return 0;
+	}
+}
+
+static int apply_error(const char *path, const char *message)
+{
+	char buf[256];
+
+	snprintf(buf, sizeof(buf), "Failed to apply patch to '%s': %s", path, message);
+	giterr_set_str(GITERR_INVALID, buf);
+
+	return -1;
+}
+
+/*
+ * Apply the hunks of a text patch to `data`. Each hunk is looked for at
+ * the position given in its header (adjusted by the offset of the previous
+ * hunk), then further and further away from it. If it can't be found and
+ * fuzz is allowed, the search is retried ignoring up to `max_fuzz` lines of
+ * leading and trailing context.
+ */
+static int apply_hunks(
+	rugged_apply *apply,
+	apply_buf *out,
+	const rugged_patch_file *file,
+	const char *path,
+	const char *data, size_t size)
+{
+	apply_lines image = {0}, pre = {0}, post = {0};
+	size_t pos = 0, h;
+	long last_offset = 0;
+	int error = 0;
+
+	apply_lines_split(&image, data, size);
+
+	for (h = 0; h < file->hunk_count && !error; ++h) {
+		const rugged_patch_hunk *hunk = &file->hunks[h];
+		rugged_patch_parser parser;
+		size_t leading = 0, trailing = 0, base, expected, found = 0;
+		int fuzz, matched = 0, last = 0, context_only = 1;
+		char message[64];
+		VALUE rb_hunk;
+
+		pre.count = post.count = 0;
+
+		memset(&parser, 0x0, sizeof(parser));
+		parser.ptr = hunk->lines;
+		parser.end = hunk->lines + hunk->lines_len;
+
+		while (parser_next(&parser)) {
+			const char *content = parser.line + 1;
+			size_t content_len = parser.len - 1;
+
+			if (parser.line[0] == '\n') {
+				content = parser.line;
+				content_len = 1;
+			}
+
+			switch (parser.line[0]) {
+			case ' ':
+			case '\n':
+				apply_lines_push(&pre, content, content_len);
+				apply_lines_push(&post, content, content_len);
+
+				if (context_only)
+					leading++;
+				trailing++;
+				last = ' ';
+				break;
+
+			case '-':
+				apply_lines_push(&pre, content, content_len);
+				context_only = 0;
+				trailing = 0;
+				last = '-';
+				break;
+
+			case '+':
+				apply_lines_push(&post, content, content_len);
+				context_only = 0;
+				trailing = 0;
+				last = '+';
+				break;
+
+			case '\\':
+				/* "\ No newline at end of file" applies to the line before */
+				if ((last == ' ' || last == '-') && pre.count > 0)
+					pre.lines[pre.count - 1].len--;
+				if ((last == ' ' || last == '+') && post.count > 0)
+					post.lines[post.count - 1].len--;
+				break;
+			}
+		}
+
+		if (context_only)
+			trailing = 0;
+
+		if (hunk->old_lines == 0)
+			base = (size_t)hunk->old_start;
+		else
+			base = (size_t)(hunk->old_start > 0 ? hunk->old_start - 1 : 0);
+
+		expected = base;
+
+		if ((long)base + last_offset >= (long)pos)
+			expected = (size_t)((long)base + last_offset);
+
+		if (expected < pos)
+			expected = pos;
+
+		for (fuzz = 0; fuzz <= apply->max_fuzz && !matched; ++fuzz) {
+			size_t lead = (size_t)fuzz < leading ? (size_t)fuzz : leading;
+			size_t trail = (size_t)fuzz < trailing ? (size_t)fuzz : trailing;
+			size_t count, i;
+
+			if (fuzz > 0 && lead == 0 && trail == 0)
+				break;
+
+			count = pre.count - lead - trail;
+
+			/* Don't let fuzz throw away every line of the preimage */
+			if (count == 0 && pre.count > 0)
+				break;
+
+			if (!apply_find_hunk(&image, pos, expected + lead, pre.lines + lead, count, &found))
+				continue;
+
+			for (i = pos; i < found; ++i)
+				apply_buf_put(out, image.lines[i].ptr, image.lines[i].len);
+
+			for (i = lead; i < post.count - trail; ++i)
+				apply_buf_put(out, post.lines[i].ptr, post.lines[i].len);
+
+			pos = found + count;
+			last_offset = (long)found - (long)(base + lead);
+			matched = 1;
+
+			rb_hunk = rb_hash_new();
+			rb_hash_aset(rb_hunk, CSTR2SYM("path"), rugged_str_new2(path, NULL));
+			rb_hash_aset(rb_hunk, CSTR2SYM("hunk"), INT2FIX(h));
+			rb_hash_aset(rb_hunk, CSTR2SYM("offset"), LONG2NUM(last_offset));
+			rb_hash_aset(rb_hunk, CSTR2SYM("fuzz"), INT2FIX(fuzz));
+			rb_ary_push(apply->rb_hunks, rb_hunk);
+		}
+
+		if (!matched) {
+			snprintf(message, sizeof(message), "hunk #%d does not apply", (int)h + 1);
+			error = apply_error(path, message);
+		}
+	}
+
+	if (!error) {
+		for (; pos < image.count; ++pos)
+			apply_buf_put(out, image.lines[pos].ptr, image.lines[pos].len);
+	}
+
+	xfree(image.lines);
+	xfree(pre.lines);
+	xfree(post.lines);
+
+	return error;
+}
+
+static const char base85_alphabet[] =
+	"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+	"abcdefghijklmnopqrstuvwxyz!#$%&()*+-;<=>?@^_`{|}~";
+
+static int base85_value(char c)
+{
+	const char *p = c ? strchr(base85_alphabet, c) : NULL;
+	return p ? (int)(p - base85_alphabet) : -1;
+}
+
+/* Decode the base85 lines of a binary hunk into its deflated data */
+static int apply_decode_base85(apply_buf *out, const rugged_patch_binary *binary)
+{
+	rugged_patch_parser parser;
+
+	memset(&parser, 0x0, sizeof(parser));
+	parser.ptr = binary->data;
+	parser.end = binary->data + binary->data_len;
+
+	while (parser_next(&parser)) {
+		size_t len, line_len = parser_line_len(&parser);
+		const char *p = parser.line + 1;
+		char c = parser.line[0];
+
+		if (c >= 'A' && c <= 'Z')
+			len = c - 'A' + 1;
+		else if (c >= 'a' && c <= 'z')
+			len = c - 'a' + 27;
+		else
+			return -1;
+
+		if (line_len != 1 + ((len + 3) / 4) * 5)
+			return -1;
+
+		while (len > 0) {
+			unsigned int acc = 0;
+			unsigned char bytes[4];
+			size_t i, n = len < 4 ? len : 4;
+
+			for (i = 0; i < 5; ++i) {
+				int v = base85_value(p[i]);
+
+				if (v < 0)
+					return -1;
+
+				acc = acc * 85 + v;
+			}
+
+			bytes[0] = (acc >> 24) & 0xff;
+			bytes[1] = (acc >> 16) & 0xff;
+			bytes[2] = (acc >> 8) & 0xff;
+			bytes[3] = acc & 0xff;
+
+			apply_buf_put(out, (const char *)bytes, n);
+
+			p += 5;
+			len -= n;
+		}
+	}
+
+	return 0;
+}
+
+static int apply_inflate(apply_buf *out, const char *data, size_t len, size_t inflated_len)
+{
+	z_stream zs;
+	int zerr;
+
+	memset(&zs, 0x0, sizeof(zs));
+
+	if (inflateInit(&zs) != Z_OK)
+		return -1;
+
+	out->alloc = inflated_len + 1;
+	out->ptr = xrealloc(out->ptr, out->alloc);
+	out->size = 0;
+
+	zs.next_in = (Bytef *)data;
+	zs.avail_in = (uInt)len;
+	zs.next_out = (Bytef *)out->ptr;
+	zs.avail_out = (uInt)out->alloc;
+
+	zerr = inflate(&zs, Z_FINISH);
+	out->size = zs.total_out;
+	inflateEnd(&zs);
+
+	return (zerr == Z_STREAM_END && out->size == inflated_len) ? 0 : -1;
+}
+
+static int delta_varint(const unsigned char **p, const unsigned char *end, size_t *out)
+{
+	size_t value = 0;
+	int shift = 0;
+	unsigned char c;
+
+	do {
+		if (*p >= end)
+			return -1;
+
+		c = *(*p)++;
+		value |= (size_t)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+
+	*out = value;
+	return 0;
+}
+
+/* Apply a git (packfile-style) delta to `base` */
+static int apply_delta(apply_buf *out, const char *base, size_t base_len, const apply_buf *delta)
+{
+	const unsigned char *p = (const unsigned char *)delta->ptr, *end = p + delta->size;
+	size_t src_len, dst_len;
+
+	if (delta_varint(&p, end, &src_len) < 0 ||
+		delta_varint(&p, end, &dst_len) < 0 ||
+		src_len != base_len)
+		return -1;
+
+	while (p < end) {
+		unsigned char op = *p++;
+
+		if (op & 0x80) {
+			size_t offset = 0, len = 0;
+			int i;
+
+			for (i = 0; i < 4; ++i) {
+				if (op & (1 << i)) {
+					if (p >= end)
+						return -1;
+					offset |= (size_t)(*p++) << (8 * i);
+				}
+			}
+
+			for (i = 0; i < 3; ++i) {
+				if (op & (0x10 << i)) {
+					if (p >= end)
+						return -1;
+					len |= (size_t)(*p++) << (8 * i);
+				}
+			}
+
+			if (len == 0)
+				len = 0x10000;
+
+			if (offset + len > base_len)
+				return -1;
+
+			apply_buf_put(out, base + offset, len);
+		} else if (op) {
+			if ((size_t)(end - p) < op)
+				return -1;
+
+			apply_buf_put(out, (const char *)p, op);
+			p += op;
+		} else {
+			return -1;
+		}
+	}
+
+	return out->size == dst_len ? 0 : -1;
+}
+
+static int apply_binary(
+	apply_buf *out,
+	const rugged_patch_file *file,
+	const char *path,
+	const char *data, size_t size)
+{
+	apply_buf deflated = {0}, inflated = {0};
+	int error = 0;
+
+	if (file->binary.type == RUGGED_BINARY_NONE)
+		return apply_error(path, "patch has no binary data");
+
+	if (apply_decode_base85(&deflated, &file->binary) < 0 ||
+		apply_inflate(&inflated, deflated.ptr, deflated.size, file->binary.inflated_len) < 0) {
+		error = apply_error(path, "corrupt binary patch");
+	} else if (file->binary.type == RUGGED_BINARY_LITERAL) {
+		apply_buf_put(out, inflated.ptr, inflated.size);
+	} else if (apply_delta(out, data, size, &inflated) < 0) {
+		error = apply_error(path, "binary delta does not apply");
+	}
+
+	xfree(deflated.ptr);
+	xfree(inflated.ptr);
+
+	return error;
+}
+
+static apply_change *apply_find_change(rugged_apply *apply, const char *path)
+{
+	size_t i;
+
+	for (i = 0; i < apply->change_count; ++i) {
+		if (!strcmp(apply->changes[i].path, path))
+			return &apply->changes[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Record the new state of `path`. There is a single change per path, so
+ * a later patch to the same file replaces the result of an earlier one.
+ */
+static void apply_add_change(
+	rugged_apply *apply, const char *path, const git_oid *oid, git_filemode_t mode, int remove)
+{
+	apply_change *change = apply_find_change(apply, path);
+
+	if (change == NULL) {
+		if (apply->change_count == apply->change_alloc) {
+			apply->change_alloc = apply->change_alloc ? apply->change_alloc * 2 : 16;
+			apply->changes = xrealloc(apply->changes, apply->change_alloc * sizeof(apply_change));
+		}
+
+		change = &apply->changes[apply->change_count++];
+		change->path = xmalloc(strlen(path) + 1);
+		strcpy(change->path, path);
+	}
+
+	change->mode = mode;
+	change->remove = remove;
+
+	if (oid)
+		git_oid_cpy(&change->oid, oid);
+}
+
+static int apply_file(rugged_apply *apply, const rugged_patch_file *file)
+{
+	const char *source = NULL, *target = NULL;
+	git_tree_entry *entry = NULL, *existing = NULL;
+	git_filemode_t mode = GIT_FILEMODE_BLOB;
+	git_blob *blob = NULL;
+	apply_buf out = {0};
+	const char *data = NULL;
+	size_t size = 0;
+	git_oid oid;
+	int error = 0;
+
+	switch (file->status) {
+	case GIT_DELTA_ADDED:
+		target = file->new_path;
+		break;
+	case GIT_DELTA_DELETED:
+		source = file->old_path;
+		break;
+	case GIT_DELTA_RENAMED:
+	case GIT_DELTA_COPIED:
+		source = file->old_path;
+		target = file->new_path;
+		break;
+	default:
+		/* For plain diffs, the old name is the one that must exist */
+		source = target = file->old_path ? file->old_path : file->new_path;
+		break;
+	}
+
+	if ((file->status != GIT_DELTA_ADDED && source == NULL) ||
+		(file->status != GIT_DELTA_DELETED && target == NULL))
+		return apply_error("(unknown)", "patch has no file names");
+
+	if (source) {
+		const apply_change *pending = apply_find_change(apply, source);
+		const git_oid *source_id;
+
+		/* A file already patched earlier in the diff: patch its result */
+		if (pending) {
+			if (pending->remove)
+				return apply_error(source, "file does not exist in tree");
+
+			mode = pending->mode;
+			source_id = &pending->oid;
+		} else {
+			if (git_tree_entry_bypath(&entry, apply->tree, source) < 0) {
+				giterr_clear();
+				return apply_error(source, "file does not exist in tree");
+			}
+
+			mode = git_tree_entry_filemode(entry);
+			source_id = git_tree_entry_id(entry);
+		}
+
+		if ((error = git_blob_lookup(&blob, apply->repo, source_id)) < 0)
+			goto cleanup;
+
+		data = git_blob_rawcontent(blob);
+		size = (size_t)git_blob_rawsize(blob);
+	}
+
+	if (target && target != source) {
+		const apply_change *pending = apply_find_change(apply, target);
+		int exists;
+
+		if (pending) {
+			exists = !pending->remove;
+		} else {
+			exists = (git_tree_entry_bypath(&existing, apply->tree, target) == 0);
+			giterr_clear();
+		}
+
+		if (exists) {
+			error = apply_error(target, "file already exists in tree");
+			goto cleanup;
+		}
+	}
+
+	if (file->new_mode)
+		mode = (git_filemode_t)file->new_mode;
+
+	if (file->is_binary)
+		error = apply_binary(&out, file, target ? target : source, data, size);
+	else if (file->hunk_count > 0)
+		error = apply_hunks(apply, &out, file, target ? target : source, data, size);
+	else if (data)
+		apply_buf_put(&out, data, size);
+
+	if (error < 0)
+		goto cleanup;
+
+	if (target == NULL) {
+		if (out.size > 0)
+			error = apply_error(source, "removal patch leaves file contents");
+		else
+			apply_add_change(apply, source, NULL, 0, 1);
+
+		goto cleanup;
+	}
+
+	if (blob && out.size == size && (size == 0 || !memcmp(out.ptr, data, size)))
+		git_oid_cpy(&oid, git_blob_id(blob));
+	else if ((error = git_blob_create_frombuffer(&oid, apply->repo, out.ptr ? out.ptr : "", out.size)) < 0)
+		goto cleanup;
+
+	if (file->status == GIT_DELTA_RENAMED)
+		apply_add_change(apply, source, NULL, 0, 1);
+
+	apply_add_change(apply, target, &oid, mode, 0);
+
+cleanup:
+	git_tree_entry_free(entry);
+	git_tree_entry_free(existing);
+	git_blob_free(blob);
+	xfree(out.ptr);
+
+	return error;
+}
+
+static int apply_change_cmp(const void *a, const void *b)
+{
+	const apply_change *ca = a, *cb = b;
+	int cmp = strcmp(ca->path, cb->path);
+
+	/* A removal and an addition of the same path: remove first */
+	return cmp ? cmp : cb->remove - ca->remove;
+}
+
+/*
+ * Build the tree resulting from applying `changes` (sorted by path) to
+ * `base`. Only the subtrees containing changed paths are rebuilt; every
+ * other entry is carried over by OID from the original tree.
+ */
+static int apply_update_tree(
+	git_oid *out,
+	int *is_empty,
+	git_repository *repo,
+	const git_tree *base,
+	const apply_change *changes,
+	size_t count,
+	size_t prefix_len)
+{
+	git_treebuilder *builder;
+	size_t i = 0, j;
+	int error, removed = 0;
+
+	if ((error = git_treebuilder_create(&builder, base)) < 0)
+		return error;
+
+	while (i < count && !error) {
+		const char *name = changes[i].path + prefix_len;
+		const char *slash = strchr(name, '/');
+		const git_tree_entry *entry;
+		git_tree *subtree = NULL;
+		git_oid subtree_oid;
+		int subtree_empty;
+		char *dirname;
+
+		if (slash == NULL) {
+			if (changes[i].remove) {
+				if (git_treebuilder_get(builder, name) != NULL)
+					error = git_treebuilder_remove(builder, name);
+				removed = 1;
+			} else {
+				error = git_treebuilder_insert(NULL, builder,
+					name, &changes[i].oid, changes[i].mode);
+			}
+
+			i++;
+			continue;
+		}
+
+		dirname = xmalloc(slash - name + 1);
+		memcpy(dirname, name, slash - name);
+		dirname[slash - name] = '\0';
+
+		for (j = i + 1; j < count; ++j) {
+			const char *other = changes[j].path + prefix_len;
+
+			if (strncmp(other, dirname, slash - name) || other[slash - name] != '/')
+				break;
+		}
+
+		entry = git_treebuilder_get(builder, dirname);
+
+		if (entry && git_tree_entry_type(entry) == GIT_OBJ_TREE)
+			error = git_tree_lookup(&subtree, repo, git_tree_entry_id(entry));
+
+		if (!error)
+			error = apply_update_tree(&subtree_oid, &subtree_empty,
+				repo, subtree, changes + i, j - i, prefix_len + (slash - name) + 1);
+
+		if (!error) {
+			if (!subtree_empty)
+				error = git_treebuilder_insert(NULL, builder, dirname, &subtree_oid, GIT_FILEMODE_TREE);
+			else if (entry != NULL) {
+				error = git_treebuilder_remove(builder, dirname);
+				removed = 1;
+			}
+		}
+
+		git_tree_free(subtree);
+		xfree(dirname);
+		i = j;
+	}
+
+	if (!error)
+		error = git_treebuilder_write(out, repo, builder);
+
+	git_treebuilder_free(builder);
+
+	*is_empty = 0;
+
+	/* Only a subtree that lost entries can have become empty */
+	if (!error && removed) {
+		git_tree *tree;
+
+		if ((error = git_tree_lookup(&tree, repo, out)) == 0) {
+			*is_empty = (git_tree_entrycount(tree) == 0);
+			git_tree_free(tree);
+		}
+	}
+
+	return error;
+}
+
+static VALUE rugged_apply_run(VALUE _payload)
+{
+	VALUE *args = (VALUE *)_payload;
+	rugged_apply *apply = (rugged_apply *)args[0];
+	rugged_parsed_diff *diff = (rugged_parsed_diff *)args[1];
+	git_oid tree_oid;
+	int error = 0, is_empty;
+	size_t i;
+	VALUE rb_result;
+
+	for (i = 0; i < diff->count && !error; ++i)
+		error = apply_file(apply, &diff->files[i]);
+
+	if (!error) {
+		qsort(apply->changes, apply->change_count, sizeof(apply_change), apply_change_cmp);
+		error = apply_update_tree(&tree_oid, &is_empty,
+			apply->repo, apply->tree, apply->changes, apply->change_count, 0);
+	}
+
+	rugged_exception_check(error);
+
+	rb_result = rb_hash_new();
+	rb_hash_aset(rb_result, CSTR2SYM("tree"), rugged_create_oid(&tree_oid));
+	rb_hash_aset(rb_result, CSTR2SYM("hunks"), apply->rb_hunks);
+
+	return rb_result;
+}
+
+static VALUE rugged_apply_cleanup(VALUE _apply)
+{
+	rugged_apply *apply = (rugged_apply *)_apply;
+	size_t i;
+
+	for (i = 0; i < apply->change_count; ++i)
+		xfree(apply->changes[i].path);
+
+	xfree(apply->changes);
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		tree.apply(diff, options = {}) -> result
+ *
+ *	Apply a patch to this tree entirely in memory, writing the new blobs
+ *	and trees to the repository. +diff+ is either a
+ *	<tt>Rugged::Diff::Parsed</tt> or the text of a patch, which will be
+ *	parsed with +Diff.parse+.
+ *
+ *	Only the subtrees that contain changed files are rebuilt; all other
+ *	entries are reused by OID.
+ *
+ *	A file patched more than once in +diff+ gets each patch applied to the
+ *	result of the previous one.
+ *
+ *	Returns a +Hash+ with the following keys:
+ *
+ *	:tree ::
+ *	  The OID of the resulting tree.
+ *
+ *	:hunks ::
+ *	  An +Array+ with a +Hash+ for each hunk applied, with the +:path+ of
+ *	  the file, the index of the +:hunk+ in the file, and the +:offset+ (in
+ *	  lines) and +:fuzz+ with which it was applied.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:fuzz ::
+ *	  The maximum number of leading and trailing context lines which
+ *	  can be ignored when a hunk doesn't match. Defaults to 0.
+ *
+ *	Raises <tt>Rugged::InvalidError</tt> if the patch does not apply.
+ *
+ *		result = tree.apply(Rugged::Diff.parse(patch))
+ *		result[:tree] #=> "4b3a2d2e8f3ac1a5b9b6f1ad13e2a1b5dfb12a3c"
+ *		result[:hunks] #=> [{:path => "README", :hunk => 0, :offset => 2, :fuzz => 0}]
+ */
+static VALUE rb_git_tree_apply(int argc, VALUE *argv, VALUE self)
+{
+	VALUE rb_diff, rb_options, rb_fuzz, rb_result, args[2];
+	rugged_parsed_diff *diff;
+	rugged_apply apply;
+	git_tree *tree;
+
+	rb_scan_args(argc, argv, "11", &rb_diff, &rb_options);
+
+	if (TYPE(rb_diff) == T_STRING)
+		rb_diff = rb_git_diff_parse(rb_cRuggedDiff, rb_diff);
+
+	diff = rugged_parsed_diff_get(rb_diff);
+
+	Data_Get_Struct(self, git_tree, tree);
+
+	memset(&apply, 0x0, sizeof(apply));
+	apply.repo = git_object_owner((git_object *)tree);
+	apply.tree = tree;
+	apply.rb_hunks = rb_ary_new();
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+
+		rb_fuzz = rb_hash_aref(rb_options, CSTR2SYM("fuzz"));
+		if (!NIL_P(rb_fuzz)) {
+			Check_Type(rb_fuzz, T_FIXNUM);
+			apply.max_fuzz = FIX2INT(rb_fuzz);
+
+			if (apply.max_fuzz < 0)
+				rb_raise(rb_eArgError, ":fuzz must not be negative");
+		}
+	}
+
+	args[0] = (VALUE)&apply;
+	args[1] = (VALUE)diff;
+
+	rb_result = rb_ensure(rugged_apply_run, (VALUE)args, rugged_apply_cleanup, (VALUE)&apply);
+
+	/* `diff` belongs to rb_diff, which may have been parsed just above */
+	RB_GC_GUARD(rb_diff);
+
+	return rb_result;
+}
+
+void Init_rugged_apply()
+{
+	rb_define_singleton_method(rb_cRuggedDiff, "parse", rb_git_diff_parse, 1);
+
+	rb_cRuggedDiffParsed = rb_define_class_under(rb_cRuggedDiff, "Parsed", rb_cObject);
+	rb_undef_alloc_func(rb_cRuggedDiffParsed);
+	rb_define_method(rb_cRuggedDiffParsed, "each_file", rb_git_parsed_diff_each_file, 0);
+	rb_define_method(rb_cRuggedDiffParsed, "size", rb_git_parsed_diff_size, 0);
+
+	rb_define_method(rb_cRuggedTree, "apply", rb_git_tree_apply, -1);
+}
@@ -97,6 +97,7 @@ static VALUE rb_git_branch_create(int argc, VALUE *argv, VALUE self)
 	git_commit_free(target);
 
 	rugged_exception_check(error);
+	rugged_ref_fsync(rb_repo, git_reference_name(branch));
 
 	return rugged_branch_new(rb_repo, branch);
 }
@@ -162,6 +163,8 @@ static VALUE rb_git_branch_delete(VALUE self)
 		git_branch_delete(branch)
 	);
 
+	rugged_ref_fsync(rugged_owner(self), git_reference_name(branch));
+
 	return Qnil;
 }
 
@@ -284,6 +287,8 @@ static VALUE rb_git_branch_move(int argc, VALUE *argv, VALUE self)
 
 	error = git_branch_move(&new_branch, old_branch, StringValueCStr(rb_new_branch_name), force);
 	rugged_exception_check(error);
+	rugged_ref_fsync(rugged_owner(self), git_reference_name(old_branch));
+	rugged_ref_fsync(rugged_owner(self), git_reference_name(new_branch));
 
 	return rugged_branch_new(rugged_owner(self), new_branch);
 }
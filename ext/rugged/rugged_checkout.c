@@ -0,0 +1,712 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "rugged.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef O_BINARY
+#	define O_BINARY 0
+#endif
+
+extern VALUE rb_cRuggedRepo;
+
+#define RUGGED_CHECKOUT_MAX_THREADS 32
+
+typedef struct {
+	char *path;
+	git_oid oid;
+	unsigned int mode;
+	int skip_worktree;
+	struct stat st;
+} rugged_checkout_file;
+
+typedef struct {
+	git_repository *repo;
+	const char *repo_path;
+	char **alternates;
+	const char *workdir;
+	size_t workdir_len;
+
+	char *path;
+	size_t path_len, path_alloc;
+
+	rugged_checkout_file *files;
+	size_t file_count, file_alloc;
+
+	char **dirs;
+	size_t dir_count, dir_alloc;
+
+	/* lengths of the enclosing directories not created yet */
+	size_t *dir_stack;
+	size_t dir_depth, dir_emitted, dir_stack_alloc;
+
+	VALUE rb_paths;
+	VALUE rb_sparse;
+
+	/* indexes in `files` of the files to write */
+	size_t *writes;
+	size_t write_count;
+	size_t thread_count;
+	int cancelled;
+
+	int error;
+	int error_class;
+	char error_message[256];
+
+	VALUE rb_progress;
+
+	/* one handle per worker, opened on its first file */
+	git_repository *repos[RUGGED_POOL_MAX_THREADS];
+	git_odb *odbs[RUGGED_POOL_MAX_THREADS];
+} rugged_checkout;
+
+/*
+ * Record an OS error as the last libgit2 error of the current thread.
+ */
+static int checkout_os_error(const char *fmt, const char *path)
+{
+	char message[512];
+
+	snprintf(message, sizeof(message), fmt, path, strerror(errno));
+	giterr_set_str(GITERR_OS, message);
+
+	return -1;
+}
+
+static void checkout_set_git_error(rugged_checkout *work, int error)
+{
+	const git_error *last = giterr_last();
+
+	if (work->error < 0)
+		return;
+
+	work->error = error;
+	work->error_class = last ? last->klass : GITERR_INVALID;
+	snprintf(work->error_message, sizeof(work->error_message), "%s",
+		last ? last->message : "Failed to check out tree");
+	work->cancelled = 1;
+}
+
+static void checkout_push_path(rugged_checkout *work, const char *name)
+{
+	size_t name_len = strlen(name);
+	size_t needed = work->path_len + name_len + 2;
+
+	if (needed > work->path_alloc) {
+		work->path_alloc = needed * 2;
+		work->path = xrealloc(work->path, work->path_alloc);
+	}
+
+	if (work->path_len)
+		work->path[work->path_len++] = '/';
+
+	memcpy(work->path + work->path_len, name, name_len + 1);
+	work->path_len += name_len;
+}
+
+static char *checkout_strdup(const char *str, size_t len)
+{
+	char *copy = xmalloc(len + 1);
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+	return copy;
+}
+
+/*
+ * Queue the directories enclosing the current path for creation, the
+ * first time something is actually written below them, so filtered
+ * checkouts never leave empty directories behind.
+ */
+static void checkout_emit_dirs(rugged_checkout *work)
+{
+	for (; work->dir_emitted < work->dir_depth; work->dir_emitted++) {
+		if (work->dir_count == work->dir_alloc) {
+			work->dir_alloc = work->dir_alloc ? work->dir_alloc * 2 : 64;
+			work->dirs = xrealloc(work->dirs, work->dir_alloc * sizeof(char *));
+		}
+
+		work->dirs[work->dir_count++] =
+			checkout_strdup(work->path, work->dir_stack[work->dir_emitted]);
+	}
+}
+
+/* how a subtree relates to the :paths or :sparse_patterns pathspec */
+enum {
+	CHECKOUT_MATCH_SOME = 0,
+	CHECKOUT_MATCH_ALL,
+	CHECKOUT_MATCH_NONE,
+};
+
+static int checkout_match_dir(VALUE rb_pathspec, int parent, const char *dir, size_t dir_len)
+{
+	if (NIL_P(rb_pathspec) || parent != CHECKOUT_MATCH_SOME)
+		return NIL_P(rb_pathspec) ? CHECKOUT_MATCH_ALL : parent;
+
+	switch (rugged_pathspec_match_dir(rb_pathspec, dir, dir_len)) {
+	case PATHSPEC_DIR_ALL:
+		return CHECKOUT_MATCH_ALL;
+	case PATHSPEC_DIR_NONE:
+		return CHECKOUT_MATCH_NONE;
+	default:
+		return CHECKOUT_MATCH_SOME;
+	}
+}
+
+static int checkout_match_path(VALUE rb_pathspec, int parent, const char *path)
+{
+	if (parent != CHECKOUT_MATCH_SOME)
+		return parent == CHECKOUT_MATCH_ALL;
+
+	return rugged_pathspec_match_path(rb_pathspec, path);
+}
+
+/*
+ * Reject the tree entry names git itself refuses to check out, so a
+ * crafted tree can't write outside of the working directory or into the
+ * repository: ".", "..", ".git" in any case, and anything with a slash.
+ */
+static int checkout_valid_name(const char *name)
+{
+	if (!name[0] || strchr(name, '/'))
+		return 0;
+
+#ifdef _WIN32
+	if (strchr(name, '\\'))
+		return 0;
+#endif
+
+	if (name[0] != '.')
+		return 1;
+
+	if (!name[1] || (name[1] == '.' && !name[2]))
+		return 0;
+
+	return !((name[1] == 'g' || name[1] == 'G') &&
+		(name[2] == 'i' || name[2] == 'I') &&
+		(name[3] == 't' || name[3] == 'T') && !name[4]);
+}
+
+/*
+ * Flatten the tree into the list of directories to create (parents
+ * first) and the list of files to write. Subtrees outside of :paths are
+ * never read; subtrees outside of :sparse_patterns are only read to
+ * list their entries in the index.
+ */
+static int checkout_collect(rugged_checkout *work, git_tree *tree, int paths, int sparse)
+{
+	size_t i, count = git_tree_entrycount(tree);
+	int error = 0;
+
+	for (i = 0; i < count && !error; ++i) {
+		const git_tree_entry *entry = git_tree_entry_byindex(tree, i);
+		size_t path_len = work->path_len;
+
+		checkout_push_path(work, git_tree_entry_name(entry));
+
+		if (!checkout_valid_name(git_tree_entry_name(entry))) {
+			char message[512];
+
+			snprintf(message, sizeof(message), "Refusing to check out invalid path '%s'", work->path);
+			giterr_set_str(GITERR_INVALID, message);
+			error = -1;
+		} else if (git_tree_entry_type(entry) == GIT_OBJ_TREE) {
+			int sub_paths = checkout_match_dir(work->rb_paths, paths, work->path, work->path_len);
+			int sub_sparse = checkout_match_dir(work->rb_sparse, sparse, work->path, work->path_len);
+			git_tree *subtree;
+
+			if (sub_paths != CHECKOUT_MATCH_NONE &&
+				(error = git_tree_lookup(&subtree, work->repo, git_tree_entry_id(entry))) == 0) {
+				if (work->dir_depth == work->dir_stack_alloc) {
+					work->dir_stack_alloc = work->dir_stack_alloc ? work->dir_stack_alloc * 2 : 16;
+					work->dir_stack = xrealloc(work->dir_stack, work->dir_stack_alloc * sizeof(size_t));
+				}
+				work->dir_stack[work->dir_depth++] = work->path_len;
+
+				error = checkout_collect(work, subtree, sub_paths, sub_sparse);
+				git_tree_free(subtree);
+
+				work->dir_depth--;
+				if (work->dir_emitted > work->dir_depth)
+					work->dir_emitted = work->dir_depth;
+			}
+		} else if (checkout_match_path(work->rb_paths, paths, work->path)) {
+			rugged_checkout_file *file;
+
+			if (work->file_count == work->file_alloc) {
+				work->file_alloc = work->file_alloc ? work->file_alloc * 2 : 256;
+				work->files = xrealloc(work->files, work->file_alloc * sizeof(rugged_checkout_file));
+			}
+
+			file = &work->files[work->file_count++];
+			memset(file, 0x0, sizeof(rugged_checkout_file));
+			file->path = checkout_strdup(work->path, work->path_len);
+			file->mode = git_tree_entry_filemode(entry);
+			file->skip_worktree = !checkout_match_path(work->rb_sparse, sparse, work->path);
+			git_oid_cpy(&file->oid, git_tree_entry_id(entry));
+
+			if (!file->skip_worktree) {
+				checkout_emit_dirs(work);
+				work->write_count++;
+			}
+		}
+
+		work->path_len = path_len;
+		work->path[path_len] = '\0';
+	}
+
+	return error;
+}
+
+static char *checkout_full_path(rugged_checkout *work, const char *path)
+{
+	size_t len = strlen(path);
+	char *full = xmalloc(work->workdir_len + len + 1);
+
+	memcpy(full, work->workdir, work->workdir_len);
+	memcpy(full + work->workdir_len, path, len + 1);
+
+	return full;
+}
+
+/*
+ * All the directories are created up front, in one pass and parents
+ * first, so writing a file never has to check for or create any of its
+ * leading directories. Submodules are checked out as empty directories.
+ */
+static void checkout_mkdirs(rugged_checkout *work)
+{
+	size_t i;
+
+	for (i = 0; i < work->dir_count + work->file_count && !work->cancelled; ++i) {
+		const char *path;
+		char *full;
+		struct stat st;
+
+		if (i < work->dir_count) {
+			path = work->dirs[i];
+		} else if (work->files[i - work->dir_count].mode == GIT_FILEMODE_COMMIT &&
+			!work->files[i - work->dir_count].skip_worktree) {
+			path = work->files[i - work->dir_count].path;
+		} else {
+			continue;
+		}
+
+		full = checkout_full_path(work, path);
+
+		if (mkdir(full, 0777) < 0) {
+			if (errno != EEXIST || lstat(full, &st) < 0)
+				checkout_set_git_error(work,
+					checkout_os_error("Failed to create directory '%s': %s", path));
+			else if (!S_ISDIR(st.st_mode) && (unlink(full) < 0 || mkdir(full, 0777) < 0))
+				checkout_set_git_error(work,
+					checkout_os_error("Failed to replace '%s' with a directory: %s", path));
+		}
+
+		xfree(full);
+	}
+}
+
+/*
+ * Write one blob to the working directory. This may run without the GVL,
+ * so it must not touch the Ruby API (including xmalloc).
+ */
+static int checkout_write_file(rugged_checkout *work, git_odb *odb, rugged_checkout_file *file)
+{
+	git_odb_object *blob;
+	const char *data;
+	size_t len, path_len = strlen(file->path);
+	char *full;
+	int error = 0;
+
+	if (file->mode == GIT_FILEMODE_COMMIT)
+		return 0;
+
+	if ((error = git_odb_read(&blob, odb, &file->oid)) < 0)
+		return error;
+
+	data = git_odb_object_data(blob);
+	len = git_odb_object_size(blob);
+
+	full = malloc(work->workdir_len + path_len + 1);
+	if (!full) {
+		git_odb_object_free(blob);
+		giterr_set_oom();
+		return -1;
+	}
+
+	memcpy(full, work->workdir, work->workdir_len);
+	memcpy(full + work->workdir_len, file->path, path_len + 1);
+
+	/* never write through a symlink or into a read-only file */
+	if (unlink(full) < 0 && errno != ENOENT) {
+		error = checkout_os_error("Failed to remove '%s': %s", file->path);
+	} else if (file->mode == GIT_FILEMODE_LINK) {
+		char *target = malloc(len + 1);
+
+		if (!target) {
+			giterr_set_oom();
+			error = -1;
+		} else {
+			memcpy(target, data, len);
+			target[len] = '\0';
+
+			if (symlink(target, full) < 0 || lstat(full, &file->st) < 0) {
+				error = checkout_os_error("Failed to create symlink '%s': %s", file->path);
+			}
+
+			free(target);
+		}
+	} else {
+		int fd = open(full, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+			file->mode == GIT_FILEMODE_BLOB_EXECUTABLE ? 0777 : 0666);
+
+		if (fd < 0) {
+			error = checkout_os_error("Failed to open '%s' for writing: %s", file->path);
+		} else {
+			while (len > 0) {
+				ssize_t written = write(fd, data, len);
+
+				if (written < 0 && errno == EINTR)
+					continue;
+
+				if (written <= 0) {
+					error = checkout_os_error("Failed to write '%s': %s", file->path);
+					break;
+				}
+
+				data += written;
+				len -= written;
+			}
+
+			/* the stat data goes to the index without another syscall per file */
+			if (!error && fstat(fd, &file->st) < 0) {
+				error = checkout_os_error("Failed to stat '%s': %s", file->path);
+			}
+
+			if (close(fd) < 0 && !error) {
+				error = checkout_os_error("Failed to close '%s': %s", file->path);
+			}
+		}
+	}
+
+	free(full);
+	git_odb_object_free(blob);
+
+	return error;
+}
+
+static void checkout_report(size_t completed, void *payload)
+{
+	rugged_checkout *work = payload;
+
+	rb_funcall(work->rb_progress, rb_intern("call"), 2,
+		SIZET2NUM(completed), SIZET2NUM(work->write_count));
+}
+
+/*
+ * Every worker opens its own handle on the repository, since libgit2
+ * objects can't be shared between threads.
+ */
+static int checkout_run_job(rugged_pool *pool, size_t worker, size_t i, void *payload)
+{
+	rugged_checkout *work = payload;
+	int error;
+
+	if (!work->odbs[worker]) {
+		if (!work->repos[worker] &&
+			(error = rugged_repo_open_worker(&work->repos[worker], work->repo_path, work->alternates)) < 0)
+			return error;
+
+		if ((error = git_repository_odb(&work->odbs[worker], work->repos[worker])) < 0)
+			return error;
+	}
+
+	return checkout_write_file(work, work->odbs[worker], &work->files[work->writes[i]]);
+}
+
+static int checkout_file_cmp(const void *a, const void *b)
+{
+	return strcmp(((const rugged_checkout_file *)a)->path, ((const rugged_checkout_file *)b)->path);
+}
+
+/*
+ * Rebuild the index from the checked out files in one pass, reusing the
+ * stat data captured when each file was written, and write it once.
+ */
+static int checkout_update_index(rugged_checkout *work)
+{
+	git_index *index;
+	size_t i;
+	int error;
+
+	if ((error = git_repository_index(&index, work->repo)) < 0)
+		return error;
+
+	/* in index order, so every entry is appended at the end */
+	qsort(work->files, work->file_count, sizeof(rugged_checkout_file), checkout_file_cmp);
+
+	git_index_clear(index);
+
+	for (i = 0; i < work->file_count && !error; ++i) {
+		rugged_checkout_file *file = &work->files[i];
+		git_index_entry entry;
+
+		memset(&entry, 0x0, sizeof(entry));
+
+		if (file->mode != GIT_FILEMODE_COMMIT && !file->skip_worktree) {
+			entry.ctime.seconds = (git_time_t)file->st.st_ctime;
+			entry.mtime.seconds = (git_time_t)file->st.st_mtime;
+			entry.dev = (unsigned int)file->st.st_dev;
+			entry.ino = (unsigned int)file->st.st_ino;
+			entry.uid = (unsigned int)file->st.st_uid;
+			entry.gid = (unsigned int)file->st.st_gid;
+			entry.file_size = (git_off_t)file->st.st_size;
+		}
+
+		if (file->skip_worktree) {
+			entry.flags = GIT_IDXENTRY_EXTENDED;
+			entry.flags_extended = GIT_IDXENTRY_SKIP_WORKTREE;
+		}
+
+		entry.mode = file->mode;
+		entry.path = file->path;
+		git_oid_cpy(&entry.oid, &file->oid);
+
+		error = git_index_add(index, &entry);
+	}
+
+	if (!error)
+		error = git_index_write(index);
+
+	git_index_free(index);
+
+	return error;
+}
+
+static VALUE checkout_body(VALUE payload)
+{
+	rugged_checkout *work = (rugged_checkout *)payload;
+	size_t i, count = 0;
+	int error;
+
+	checkout_mkdirs(work);
+
+	if (work->cancelled)
+		return Qnil;
+
+	work->writes = xmalloc((work->write_count + 1) * sizeof(size_t));
+
+	for (i = 0; i < work->file_count; ++i) {
+		if (!work->files[i].skip_worktree)
+			work->writes[count++] = i;
+	}
+
+	/* blobs are read through libgit2, which may not be thread-safe */
+	error = rugged_pool_run(rugged_threads_supported() ? work->thread_count : 0,
+		work->write_count, checkout_run_job,
+		NIL_P(work->rb_progress) ? NULL : checkout_report, work);
+
+	if (error < 0) {
+		checkout_set_git_error(work, error);
+		return Qnil;
+	}
+
+	if ((error = checkout_update_index(work)) < 0)
+		checkout_set_git_error(work, error);
+
+	return Qnil;
+}
+
+static VALUE checkout_cleanup(VALUE payload)
+{
+	rugged_checkout *work = (rugged_checkout *)payload;
+	size_t i;
+
+	for (i = 0; i < RUGGED_POOL_MAX_THREADS; ++i) {
+		git_odb_free(work->odbs[i]);
+		git_repository_free(work->repos[i]);
+	}
+
+	for (i = 0; i < work->file_count; ++i)
+		xfree(work->files[i].path);
+
+	for (i = 0; i < work->dir_count; ++i)
+		xfree(work->dirs[i]);
+
+	xfree(work->files);
+	xfree(work->writes);
+	xfree(work->dirs);
+	xfree(work->dir_stack);
+	xfree(work->path);
+	rugged_repo_alternates_free(work->alternates);
+
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		repo.checkout_tree(tree, options = {}) -> nil
+ *		repo.checkout_tree(tree, options = {}) { |completed, total| block } -> nil
+ *
+ *	Write every file of +tree+ (a Rugged::Tree, a Rugged::Commit or a
+ *	revision String) into the working directory, overwriting the files
+ *	already there, and replace the index with the contents of the tree.
+ *	Files that are not part of +tree+ are left alone, and +HEAD+ is not
+ *	updated.
+ *
+ *	Directories are all created up front, and the files are then written
+ *	by a pool of native threads, each reading blobs straight from the
+ *	object database, without holding the GVL. The stat data of every
+ *	file is recorded as it is written, and the index is written once at
+ *	the end. Blobs are written as they are stored: no filters (such as
+ *	CRLF conversion) are applied.
+ *
+ *	Raises <tt>Rugged::InvalidError</tt>, before writing anything, if
+ *	the tree has an entry git would refuse to check out, such as +..+ or
+ *	<tt>.git</tt>.
+ *
+ *	If a block is given, it is called from the calling thread with the
+ *	number of files written so far and the total number of files, as the
+ *	checkout progresses.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:threads ::
+ *	  The number of threads writing files. Defaults to the number of
+ *	  online CPUs, at most 32. When libgit2 was built without thread
+ *	  support, the files are written serially in the calling thread,
+ *	  holding the GVL.
+ *
+ *	:paths ::
+ *	  A Rugged::Pathspec (or the patterns to build one from) selecting
+ *	  the files to check out. Subtrees it can't match are skipped without
+ *	  being read, and the index only contains the checked out files.
+ *
+ *	:sparse_patterns ::
+ *	  A Rugged::Pathspec (or the patterns to build one from) selecting
+ *	  the files written to the working directory. Every other file of the
+ *	  tree is still added to the index, with the skip-worktree bit set,
+ *	  but its blob is never read.
+ *
+ *		repo.checkout_tree(repo.head.target) do |completed, total|
+ *		  print "\r#{completed}/#{total}"
+ *		end
+ */
+static VALUE rb_git_repo_checkout_tree(int argc, VALUE *argv, VALUE self)
+{
+	rugged_checkout work;
+	git_object *object, *tree;
+	git_oid oid;
+	VALUE rb_tree, rb_options, rb_threads = Qnil;
+	int error;
+
+	memset(&work, 0x0, sizeof(work));
+
+	rb_scan_args(argc, argv, "11&", &rb_tree, &rb_options, &work.rb_progress);
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+		rb_threads = rb_hash_aref(rb_options, CSTR2SYM("threads"));
+		work.rb_paths = rb_hash_aref(rb_options, CSTR2SYM("paths"));
+		work.rb_sparse = rb_hash_aref(rb_options, CSTR2SYM("sparse_patterns"));
+	}
+
+	if (!NIL_P(work.rb_paths))
+		work.rb_paths = rugged_pathspec_coerce(work.rb_paths);
+
+	if (!NIL_P(work.rb_sparse))
+		work.rb_sparse = rugged_pathspec_coerce(work.rb_sparse);
+
+	Data_Get_Struct(self, git_repository, work.repo);
+
+	work.workdir = git_repository_workdir(work.repo);
+	if (!work.workdir) {
+		giterr_set_str(GITERR_REPOSITORY, "Cannot check out a tree in a bare repository");
+		rugged_exception_check(-1);
+	}
+
+	work.workdir_len = strlen(work.workdir);
+	work.repo_path = git_repository_path(work.repo);
+
+	if (NIL_P(rb_threads)) {
+		work.thread_count = rugged_pool_threads(RUGGED_CHECKOUT_MAX_THREADS);
+	} else {
+		long threads = NUM2LONG(rb_threads);
+
+		if (threads < 1)
+			rb_raise(rb_eArgError, "The number of threads must be positive");
+
+		work.thread_count = (size_t)threads;
+	}
+
+	if (work.thread_count > RUGGED_CHECKOUT_MAX_THREADS)
+		work.thread_count = RUGGED_CHECKOUT_MAX_THREADS;
+
+	error = rugged_oid_get(&oid, work.repo, rb_tree);
+	rugged_exception_check(error);
+
+	error = git_object_lookup(&object, work.repo, &oid, GIT_OBJ_ANY);
+	rugged_exception_check(error);
+
+	error = git_object_peel(&tree, object, GIT_OBJ_TREE);
+	git_object_free(object);
+	rugged_exception_check(error);
+
+	work.path_alloc = 256;
+	work.path = xmalloc(work.path_alloc);
+	work.path[0] = '\0';
+
+	error = checkout_collect(&work, (git_tree *)tree,
+		NIL_P(work.rb_paths) ? CHECKOUT_MATCH_ALL : CHECKOUT_MATCH_SOME,
+		NIL_P(work.rb_sparse) ? CHECKOUT_MATCH_ALL : CHECKOUT_MATCH_SOME);
+	git_object_free(tree);
+
+	if (error < 0)
+		checkout_set_git_error(&work, error);
+	else {
+		work.alternates = rugged_repo_alternates(self);
+		rb_ensure(checkout_body, (VALUE)&work, checkout_cleanup, (VALUE)&work);
+	}
+
+	if (error < 0)
+		checkout_cleanup((VALUE)&work);
+
+	if (work.error < 0) {
+		giterr_set_str(work.error_class, work.error_message);
+		rugged_exception_check(work.error);
+	}
+
+	return Qnil;
+}
+
+void Init_rugged_checkout()
+{
+	rb_define_method(rb_cRuggedRepo, "checkout_tree", rb_git_repo_checkout_tree, -1);
+}
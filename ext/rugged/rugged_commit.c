@@ -23,6 +23,7 @@
  */
 
 #include "rugged.h"
+#include <git2/sys/commit.h>
 
 extern VALUE rb_mRugged;
 extern VALUE rb_cRuggedObject;
@@ -86,7 +87,8 @@ static VALUE rb_git_commit_committer_GET(VALUE self)
 
 	return rugged_signature_new(
 		git_commit_committer(commit),
-		git_commit_message_encoding(commit));
+		git_commit_message_encoding(commit),
+		rugged_owner(self));
 }
 
 /*
@@ -111,7 +113,8 @@ static VALUE rb_git_commit_author_GET(VALUE self)
 
 	return rugged_signature_new(
 		git_commit_author(commit),
-		git_commit_message_encoding(commit));
+		git_commit_message_encoding(commit),
+		rugged_owner(self));
 }
 
 /*
@@ -285,7 +288,7 @@ static VALUE rb_git_commit_create(VALUE self, VALUE rb_repo, VALUE rb_data)
 	git_signature *author, *committer;
 	git_oid commit_oid;
 	git_repository *repo;
-	const char *update_ref = NULL;
+	const char *update_ref = NULL, *message;
 
 	Check_Type(rb_data, T_HASH);
 
@@ -299,8 +302,10 @@ static VALUE rb_git_commit_create(VALUE self, VALUE rb_repo, VALUE rb_data)
 		update_ref = StringValueCStr(rb_ref);
 	}
 
+	/* converted before the signatures are allocated, since this raises on NUL bytes */
 	rb_message = rb_hash_aref(rb_data, CSTR2SYM("message"));
 	Check_Type(rb_message, T_STRING);
+	message = StringValueCStr(rb_message);
 
 	committer = rugged_signature_get(
 		rb_hash_aref(rb_data, CSTR2SYM("committer"))
@@ -360,7 +365,7 @@ static VALUE rb_git_commit_create(VALUE self, VALUE rb_repo, VALUE rb_data)
 		author,
 		committer,
 		NULL,
-		StringValueCStr(rb_message),
+		message,
 		tree,
 		parent_count,
 		parents);
@@ -379,6 +384,153 @@ cleanup:
 
 	rugged_exception_check(error);
 
+	if (update_ref)
+		rugged_ref_fsync(rb_repo, update_ref);
+
+	return rugged_create_oid(&commit_oid);
+}
+
+static const git_signature *commit_signature_get(VALUE rb_sig, git_signature **free_ptr)
+{
+	if (rb_obj_is_kind_of(rb_sig, rb_cRuggedSignature)) {
+		*free_ptr = NULL;
+		return rugged_signature_unwrap(rb_sig);
+	}
+
+	*free_ptr = rugged_signature_get(rb_sig);
+	return *free_ptr;
+}
+
+typedef struct {
+	VALUE rb_sig;
+	const git_signature *sig;
+	git_signature *free_ptr;
+} commit_signature_args;
+
+static VALUE commit_signature_get_protected(VALUE payload)
+{
+	commit_signature_args *args = (commit_signature_args *)payload;
+	args->sig = commit_signature_get(args->rb_sig, &args->free_ptr);
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		Commit.create_raw(repository, data = {}) -> oid
+ *
+ *	Write a new +Commit+ object to +repository+ straight from the OIDs
+ *	of its tree and parents. This is a lower-level version of +Commit.create+
+ *	meant for writing many commits in a row: none of the referenced objects
+ *	are looked up, so it's up to the caller to make sure they exist.
+ *
+ *	The +data+ is passed as a +Hash+:
+ *
+ *	- +:message+: a string with the full text for the commit's message
+ *	- +:committer+: a <tt>Rugged::Signature</tt> for the committer
+ *	- +:author+: a <tt>Rugged::Signature</tt> for the author
+ *	- +:parent_oids+: an +Array+ with zero or more parent OIDs, as hex +String+s
+ *	- +:tree_oid+: the OID of the tree for this commit, as a hex +String+
+ *	- +:update_ref+ (optional): a +String+ with the name of a reference in the
+ *	repository which should be updated to point to this commit (e.g. "HEAD")
+ *
+ *	Signatures may also be given as a +Hash+, like in +Commit.create+, but
+ *	<tt>Rugged::Signature</tt> objects can be reused across calls without
+ *	being parsed again.
+ *
+ *		author = Rugged::Signature.new("Vicent Mart\303\255", "tanoku@gmail.com")
+ *
+ *		Rugged::Commit.create_raw(r,
+ *			:author => author,
+ *			:message => "Hello world\n\n",
+ *			:committer => author,
+ *			:parent_oids => ["2cb831a8aea28b2c1b9c63385585b864e4d3bad1"],
+ *			:tree_oid => "f148106ca58764adc93ad4e2d6b1d168422b9796") #=> "5c4f1ab4ac1b8e1dd4d7a6e3ec7ab1cb7d4dcb2e"
+ */
+static VALUE rb_git_commit_create_raw(VALUE self, VALUE rb_repo, VALUE rb_data)
+{
+	VALUE rb_message, rb_tree, rb_parents, rb_ref;
+	int parent_count, i, error;
+	const git_oid **parents;
+	git_oid *parent_oids, tree_oid, commit_oid;
+	const git_signature *author, *committer;
+	git_signature *author_free, *committer_free;
+	commit_signature_args author_args;
+	int state = 0;
+	git_repository *repo;
+	const char *update_ref = NULL, *message;
+
+	Check_Type(rb_data, T_HASH);
+
+	if (!rb_obj_is_kind_of(rb_repo, rb_cRuggedRepo))
+		rb_raise(rb_eTypeError, "Expecting a Rugged::Repository instance");
+	Data_Get_Struct(rb_repo, git_repository, repo);
+
+	rb_ref = rb_hash_aref(rb_data, CSTR2SYM("update_ref"));
+	if (!NIL_P(rb_ref)) {
+		Check_Type(rb_ref, T_STRING);
+		update_ref = StringValueCStr(rb_ref);
+	}
+
+	/* converted before the signatures are allocated, since this raises on NUL bytes */
+	rb_message = rb_hash_aref(rb_data, CSTR2SYM("message"));
+	Check_Type(rb_message, T_STRING);
+	message = StringValueCStr(rb_message);
+
+	rb_tree = rb_hash_aref(rb_data, CSTR2SYM("tree_oid"));
+	Check_Type(rb_tree, T_STRING);
+	rugged_exception_check(git_oid_fromstr(&tree_oid, StringValueCStr(rb_tree)));
+
+	rb_parents = rb_hash_aref(rb_data, CSTR2SYM("parent_oids"));
+	Check_Type(rb_parents, T_ARRAY);
+
+	parent_count = (int)RARRAY_LEN(rb_parents);
+	parents = alloca(parent_count * sizeof(void *));
+	parent_oids = alloca(parent_count * sizeof(git_oid));
+
+	for (i = 0; i < parent_count; ++i) {
+		VALUE p = rb_ary_entry(rb_parents, i);
+
+		Check_Type(p, T_STRING);
+		rugged_exception_check(git_oid_fromstr(&parent_oids[i], StringValueCStr(p)));
+		parents[i] = &parent_oids[i];
+	}
+
+	committer = commit_signature_get(
+		rb_hash_aref(rb_data, CSTR2SYM("committer")), &committer_free);
+
+	/* don't leak the committer if the author can't be parsed */
+	author_args.rb_sig = rb_hash_aref(rb_data, CSTR2SYM("author"));
+	author_args.free_ptr = NULL;
+	rb_protect(commit_signature_get_protected, (VALUE)&author_args, &state);
+
+	if (state) {
+		git_signature_free(committer_free);
+		rb_jump_tag(state);
+	}
+
+	author = author_args.sig;
+	author_free = author_args.free_ptr;
+
+	error = git_commit_create_from_oids(
+		&commit_oid,
+		repo,
+		update_ref,
+		author,
+		committer,
+		NULL,
+		message,
+		&tree_oid,
+		parent_count,
+		parents);
+
+	git_signature_free(author_free);
+	git_signature_free(committer_free);
+
+	rugged_exception_check(error);
+
+	if (update_ref)
+		rugged_ref_fsync(rb_repo, update_ref);
+
 	return rugged_create_oid(&commit_oid);
 }
 
@@ -387,6 +539,7 @@ void Init_rugged_commit()
 	rb_cRuggedCommit = rb_define_class_under(rb_mRugged, "Commit", rb_cRuggedObject);
 
 	rb_define_singleton_method(rb_cRuggedCommit, "create", rb_git_commit_create, 2);
+	rb_define_singleton_method(rb_cRuggedCommit, "create_raw", rb_git_commit_create_raw, 2);
 
 	rb_define_method(rb_cRuggedCommit, "message", rb_git_commit_message_GET, 0);
 	rb_define_method(rb_cRuggedCommit, "epoch_time", rb_git_commit_epoch_time_GET, 0);
@@ -25,6 +25,7 @@
 #include "rugged.h"
 
 extern VALUE rb_mRugged;
+extern VALUE rb_cRuggedPathspec;
 VALUE rb_cRuggedDiff;
 
 static void rb_git_diff__free(git_diff_list *diff)
@@ -139,7 +140,9 @@ void rugged_parse_diff_options(git_diff_options *opts, VALUE rb_options)
 		}
 
 		rb_value = rb_hash_aref(rb_options, CSTR2SYM("paths"));
-		if (!NIL_P(rb_value)) {
+		if (rb_obj_is_kind_of(rb_value, rb_cRuggedPathspec)) {
+			rugged_pathspec_strarray(&opts->pathspec, rb_value);
+		} else if (!NIL_P(rb_value)) {
 			int i;
 			Check_Type(rb_value, T_ARRAY);
 
@@ -0,0 +1,462 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "rugged.h"
+
+extern VALUE rb_cRuggedRepo;
+
+typedef struct {
+	const unsigned char *ptr;
+	size_t len;
+} rugged_diff_cache_key;
+
+typedef struct rugged_diff_cache_entry {
+	rugged_diff_cache_key key;
+	struct rugged_diff_cache_entry *prev, *next;
+	VALUE rb_patch;
+	size_t bytes;
+} rugged_diff_cache_entry;
+
+typedef struct {
+	st_table *entries;
+	/* most recently used first */
+	rugged_diff_cache_entry *head, *tail;
+	size_t bytes, max_bytes;
+	size_t hits, misses, evictions;
+} rugged_diff_cache;
+
+static int diff_cache_key_cmp(st_data_t a, st_data_t b)
+{
+	const rugged_diff_cache_key *ka = (const rugged_diff_cache_key *)a;
+	const rugged_diff_cache_key *kb = (const rugged_diff_cache_key *)b;
+
+	if (ka->len != kb->len)
+		return 1;
+
+	return memcmp(ka->ptr, kb->ptr, ka->len);
+}
+
+static st_index_t diff_cache_key_hash(st_data_t a)
+{
+	const rugged_diff_cache_key *key = (const rugged_diff_cache_key *)a;
+	st_index_t h = 5381;
+	size_t i;
+
+	for (i = 0; i < key->len; ++i)
+		h = (h << 5) + h + key->ptr[i];
+
+	return h;
+}
+
+static const struct st_hash_type diff_cache_hash_type = {
+	diff_cache_key_cmp,
+	diff_cache_key_hash,
+};
+
+static void rb_git_diff_cache__mark(rugged_diff_cache *cache)
+{
+	rugged_diff_cache_entry *entry;
+
+	for (entry = cache->head; entry; entry = entry->next)
+		rb_gc_mark(entry->rb_patch);
+}
+
+static void diff_cache_unlink(rugged_diff_cache *cache, rugged_diff_cache_entry *entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		cache->head = entry->next;
+
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+
+	entry->prev = entry->next = NULL;
+}
+
+static void diff_cache_link(rugged_diff_cache *cache, rugged_diff_cache_entry *entry)
+{
+	entry->prev = NULL;
+	entry->next = cache->head;
+
+	if (cache->head)
+		cache->head->prev = entry;
+	else
+		cache->tail = entry;
+
+	cache->head = entry;
+}
+
+static void diff_cache_remove(rugged_diff_cache *cache, rugged_diff_cache_entry *entry)
+{
+	st_data_t key = (st_data_t)&entry->key;
+
+	st_delete(cache->entries, &key, NULL);
+	diff_cache_unlink(cache, entry);
+
+	cache->bytes -= entry->bytes;
+	xfree(entry);
+}
+
+static void diff_cache_shrink(rugged_diff_cache *cache, size_t max_bytes)
+{
+	while (cache->tail && cache->bytes > max_bytes) {
+		diff_cache_remove(cache, cache->tail);
+		cache->evictions++;
+	}
+}
+
+static void rb_git_diff_cache__free(rugged_diff_cache *cache)
+{
+	diff_cache_shrink(cache, 0);
+	st_free_table(cache->entries);
+	xfree(cache);
+}
+
+/*
+ * Like the signature intern table, the cache lives in a hidden instance
+ * variable of the repository and goes away together with it.
+ */
+static rugged_diff_cache *rugged_diff_cache_get(VALUE rb_repo)
+{
+	static ID id_cache = 0;
+	rugged_diff_cache *cache;
+	VALUE rb_cache;
+
+	if (!id_cache)
+		id_cache = rb_intern("diff_cache");
+
+	rb_cache = rb_attr_get(rb_repo, id_cache);
+
+	if (NIL_P(rb_cache)) {
+		cache = xcalloc(1, sizeof(rugged_diff_cache));
+		cache->entries = st_init_table(&diff_cache_hash_type);
+
+		rb_cache = Data_Wrap_Struct(rb_cObject,
+			rb_git_diff_cache__mark, rb_git_diff_cache__free, cache);
+		rb_ivar_set(rb_repo, id_cache, rb_cache);
+	} else {
+		Data_Get_Struct(rb_cache, rugged_diff_cache, cache);
+	}
+
+	return cache;
+}
+
+static int diff_cache_path_cmp(const void *a, const void *b)
+{
+	return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/*
+ * Serialize everything the patch text depends on: both tree OIDs, the
+ * parsed diff options, and the output format. Two requests with the
+ * same key always produce the same patch. The pathspec is a set, so
+ * its patterns are added sorted and without duplicates, and the same
+ * paths given in another order hit the same entry.
+ */
+static VALUE diff_cache_key_build(git_tree *old_tree, git_tree *new_tree,
+	const git_diff_options *opts, int compact)
+{
+	VALUE rb_key = rb_str_buf_new(64);
+	git_oid zero = {{0}};
+	unsigned int scalars[4];
+	size_t i;
+
+	rb_str_cat(rb_key, (const char *)(old_tree ? git_tree_id(old_tree) : &zero)->id, GIT_OID_RAWSZ);
+	rb_str_cat(rb_key, (const char *)(new_tree ? git_tree_id(new_tree) : &zero)->id, GIT_OID_RAWSZ);
+
+	scalars[0] = (unsigned int)opts->flags;
+	scalars[1] = (unsigned int)opts->context_lines;
+	scalars[2] = (unsigned int)opts->interhunk_lines;
+	scalars[3] = (unsigned int)compact;
+
+	rb_str_cat(rb_key, (const char *)scalars, sizeof(scalars));
+	rb_str_cat(rb_key, (const char *)&opts->max_size, sizeof(opts->max_size));
+
+	if (opts->pathspec.count > 0) {
+		const char **paths = xmalloc(opts->pathspec.count * sizeof(char *));
+
+		memcpy(paths, opts->pathspec.strings, opts->pathspec.count * sizeof(char *));
+		qsort(paths, opts->pathspec.count, sizeof(char *), diff_cache_path_cmp);
+
+		for (i = 0; i < opts->pathspec.count; ++i) {
+			if (i > 0 && !strcmp(paths[i], paths[i - 1]))
+				continue;
+
+			rb_str_cat(rb_key, paths[i], strlen(paths[i]) + 1);
+		}
+
+		xfree(paths);
+	}
+
+	return rb_key;
+}
+
+static int diff_cache_print_cb(
+	const git_diff_delta *delta,
+	const git_diff_range *range,
+	char line_origin,
+	const char *content,
+	size_t content_len,
+	void *payload)
+{
+	rb_str_cat((VALUE)payload, content, content_len);
+	return GIT_OK;
+}
+
+static void diff_cache_store(rugged_diff_cache *cache, VALUE rb_key, VALUE rb_patch)
+{
+	rugged_diff_cache_entry *entry;
+	size_t key_len = RSTRING_LEN(rb_key);
+	size_t bytes = sizeof(rugged_diff_cache_entry) + key_len + RSTRING_LEN(rb_patch);
+
+	if (bytes > cache->max_bytes)
+		return;
+
+	diff_cache_shrink(cache, cache->max_bytes - bytes);
+
+	entry = xmalloc(sizeof(rugged_diff_cache_entry) + key_len);
+	memcpy(entry + 1, RSTRING_PTR(rb_key), key_len);
+	entry->key.ptr = (const unsigned char *)(entry + 1);
+	entry->key.len = key_len;
+	entry->rb_patch = rb_patch;
+	entry->bytes = bytes;
+
+	diff_cache_link(cache, entry);
+	st_insert(cache->entries, (st_data_t)&entry->key, (st_data_t)entry);
+	cache->bytes += bytes;
+}
+
+static git_tree *diff_cache_tree_get(git_repository *repo, VALUE rb_value)
+{
+	git_object *object;
+	git_tree *tree = NULL;
+	int error;
+
+	if (NIL_P(rb_value))
+		return NULL;
+
+	object = rugged_object_get(repo, rb_value, GIT_OBJ_ANY);
+	error = git_object_peel((git_object **)&tree, object, GIT_OBJ_TREE);
+	git_object_free(object);
+	rugged_exception_check(error);
+
+	return tree;
+}
+
+typedef struct {
+	VALUE self, rb_old, rb_new, rb_options;
+	git_repository *repo;
+	git_diff_options opts;
+	git_tree *old_tree, *new_tree;
+	git_diff_list *diff;
+} diff_patch_args;
+
+static VALUE diff_patch_run(VALUE payload)
+{
+	diff_patch_args *args = (diff_patch_args *)payload;
+	rugged_diff_cache *cache;
+	VALUE rb_key = Qnil, rb_patch;
+	int error, compact = 0;
+
+	if (!NIL_P(args->rb_options)) {
+		Check_Type(args->rb_options, T_HASH);
+		compact = RTEST(rb_hash_aref(args->rb_options, CSTR2SYM("compact")));
+	}
+
+	rugged_parse_diff_options(&args->opts, args->rb_options);
+
+	args->old_tree = diff_cache_tree_get(args->repo, args->rb_old);
+	args->new_tree = diff_cache_tree_get(args->repo, args->rb_new);
+
+	cache = rugged_diff_cache_get(args->self);
+
+	if (cache->max_bytes > 0) {
+		rugged_diff_cache_key lookup;
+		st_data_t value;
+
+		rb_key = diff_cache_key_build(args->old_tree, args->new_tree, &args->opts, compact);
+		lookup.ptr = (const unsigned char *)RSTRING_PTR(rb_key);
+		lookup.len = RSTRING_LEN(rb_key);
+
+		if (st_lookup(cache->entries, (st_data_t)&lookup, &value)) {
+			rugged_diff_cache_entry *entry = (rugged_diff_cache_entry *)value;
+
+			diff_cache_unlink(cache, entry);
+			diff_cache_link(cache, entry);
+			cache->hits++;
+
+			return entry->rb_patch;
+		}
+
+		cache->misses++;
+	}
+
+	rb_patch = rugged_str_new(NULL, 0, NULL);
+
+	error = git_diff_tree_to_tree(&args->diff, args->repo,
+		args->old_tree, args->new_tree, &args->opts);
+
+	if (!error) {
+		if (compact)
+			error = git_diff_print_compact(args->diff, diff_cache_print_cb, (void *)rb_patch);
+		else
+			error = git_diff_print_patch(args->diff, diff_cache_print_cb, (void *)rb_patch);
+	}
+
+	rugged_exception_check(error);
+
+	OBJ_FREEZE(rb_patch);
+
+	if (!NIL_P(rb_key))
+		diff_cache_store(cache, rb_key, rb_patch);
+
+	return rb_patch;
+}
+
+static VALUE diff_patch_cleanup(VALUE payload)
+{
+	diff_patch_args *args = (diff_patch_args *)payload;
+
+	git_diff_list_free(args->diff);
+	git_tree_free(args->old_tree);
+	git_tree_free(args->new_tree);
+	xfree(args->opts.pathspec.strings);
+
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		repo.diff_patch(old, new, options = {}) -> patch
+ *
+ *	Return the patch text of the diff between the +old+ and +new+ trees,
+ *	which may be given as Rugged::Tree or Rugged::Commit instances, as
+ *	revision strings, or as +nil+ for the empty tree.
+ *
+ *	All of the options supported by Rugged::Tree#diff are accepted, as
+ *	well as +:compact+ to return the name-status form of the patch.
+ *
+ *	When the diff cache has been enabled with #diff_cache_size=, the
+ *	returned (frozen) String is shared between all calls with the same
+ *	trees and options, and the diff is only computed once.
+ */
+static VALUE rb_git_repo_diff_patch(int argc, VALUE *argv, VALUE self)
+{
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	diff_patch_args args;
+
+	memset(&args, 0x0, sizeof(args));
+	args.opts = opts;
+	args.self = self;
+
+	rb_scan_args(argc, argv, "21", &args.rb_old, &args.rb_new, &args.rb_options);
+	Data_Get_Struct(self, git_repository, args.repo);
+
+	/* the trees and options are released however the lookups end */
+	return rb_ensure(diff_patch_run, (VALUE)&args, diff_patch_cleanup, (VALUE)&args);
+}
+
+/*
+ *	call-seq:
+ *		repo.diff_cache_size = bytes
+ *
+ *	Enable the diff cache used by #diff_patch, bounded to roughly +bytes+
+ *	bytes of patch data. When the limit is reached, the least recently
+ *	used patches are evicted first. Setting the size to +0+ (the default)
+ *	disables the cache and drops everything in it.
+ */
+static VALUE rb_git_repo_set_diff_cache_size(VALUE self, VALUE rb_size)
+{
+	rugged_diff_cache *cache = rugged_diff_cache_get(self);
+	long size = NUM2LONG(rb_size);
+
+	if (size < 0)
+		rb_raise(rb_eArgError, "The diff cache size cannot be negative");
+
+	cache->max_bytes = (size_t)size;
+	diff_cache_shrink(cache, cache->max_bytes);
+
+	return rb_size;
+}
+
+/*
+ *	call-seq:
+ *		repo.diff_cache_size -> bytes
+ *
+ *	Return the maximum size of the diff cache, or +0+ if it is disabled.
+ */
+static VALUE rb_git_repo_get_diff_cache_size(VALUE self)
+{
+	return ULONG2NUM(rugged_diff_cache_get(self)->max_bytes);
+}
+
+/*
+ *	call-seq:
+ *		repo.diff_cache_stats -> hash
+ *
+ *	Return a Hash with the diff cache counters: +:hits+, +:misses+ and
+ *	+:evictions+ since the repository was opened, and the current number
+ *	of +:entries+ and +:bytes+ in the cache.
+ */
+static VALUE rb_git_repo_diff_cache_stats(VALUE self)
+{
+	rugged_diff_cache *cache = rugged_diff_cache_get(self);
+	VALUE rb_stats = rb_hash_new();
+
+	rb_hash_aset(rb_stats, CSTR2SYM("hits"), ULONG2NUM(cache->hits));
+	rb_hash_aset(rb_stats, CSTR2SYM("misses"), ULONG2NUM(cache->misses));
+	rb_hash_aset(rb_stats, CSTR2SYM("evictions"), ULONG2NUM(cache->evictions));
+	rb_hash_aset(rb_stats, CSTR2SYM("entries"), ULONG2NUM(cache->entries->num_entries));
+	rb_hash_aset(rb_stats, CSTR2SYM("bytes"), ULONG2NUM(cache->bytes));
+
+	return rb_stats;
+}
+
+/*
+ *	call-seq:
+ *		repo.clear_diff_cache -> nil
+ *
+ *	Drop all the patches in the diff cache, keeping it enabled.
+ */
+static VALUE rb_git_repo_clear_diff_cache(VALUE self)
+{
+	rugged_diff_cache *cache = rugged_diff_cache_get(self);
+
+	while (cache->tail)
+		diff_cache_remove(cache, cache->tail);
+
+	return Qnil;
+}
+
+void Init_rugged_diff_cache()
+{
+	rb_define_method(rb_cRuggedRepo, "diff_patch", rb_git_repo_diff_patch, -1);
+	rb_define_method(rb_cRuggedRepo, "diff_cache_size", rb_git_repo_get_diff_cache_size, 0);
+	rb_define_method(rb_cRuggedRepo, "diff_cache_size=", rb_git_repo_set_diff_cache_size, 1);
+	rb_define_method(rb_cRuggedRepo, "diff_cache_stats", rb_git_repo_diff_cache_stats, 0);
+	rb_define_method(rb_cRuggedRepo, "clear_diff_cache", rb_git_repo_clear_diff_cache, 0);
+}
@@ -0,0 +1,248 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "rugged.h"
+
+extern VALUE rb_cRuggedRepo;
+extern VALUE rb_cRuggedCommit;
+
+#define RUGGED_DIFF_STATS_MAX_THREADS 16
+
+typedef struct {
+	git_oid oid;
+	size_t files, additions, deletions;
+	int error;
+	int error_class;
+	char error_message[256];
+} rugged_diff_stats_job;
+
+typedef struct {
+	VALUE rb_repo;
+	VALUE rb_commits;
+	const char *repo_path;
+	char **alternates;
+	git_repository *repos[RUGGED_POOL_MAX_THREADS];
+	rugged_diff_stats_job *jobs;
+	size_t job_count;
+} rugged_diff_stats_work;
+
+static int diff_stats_file_cb(const git_diff_delta *delta, float progress, void *payload)
+{
+	((rugged_diff_stats_job *)payload)->files++;
+	return GIT_OK;
+}
+
+static int diff_stats_line_cb(
+	const git_diff_delta *delta,
+	const git_diff_range *range,
+	char line_origin,
+	const char *content,
+	size_t content_len,
+	void *payload)
+{
+	rugged_diff_stats_job *job = payload;
+
+	if (line_origin == GIT_DIFF_LINE_ADDITION)
+		job->additions++;
+	else if (line_origin == GIT_DIFF_LINE_DELETION)
+		job->deletions++;
+
+	return GIT_OK;
+}
+
+/*
+ * Diff a commit against its first parent (or the empty tree) and count
+ * the lines through the diff callbacks, without creating any patch.
+ * This may run without the GVL, so it must not touch the Ruby API.
+ */
+static void diff_stats_compute(git_repository *repo, rugged_diff_stats_job *job)
+{
+	git_commit *commit = NULL, *parent = NULL;
+	git_tree *tree = NULL, *parent_tree = NULL;
+	git_diff_list *diff = NULL;
+	int error;
+
+	if ((error = git_commit_lookup(&commit, repo, &job->oid)) < 0 ||
+		(error = git_commit_tree(&tree, commit)) < 0)
+		goto cleanup;
+
+	if (git_commit_parentcount(commit) > 0 &&
+		((error = git_commit_parent(&parent, commit, 0)) < 0 ||
+		(error = git_commit_tree(&parent_tree, parent)) < 0))
+		goto cleanup;
+
+	if ((error = git_diff_tree_to_tree(&diff, repo, parent_tree, tree, NULL)) < 0)
+		goto cleanup;
+
+	error = git_diff_foreach(diff, diff_stats_file_cb, NULL, diff_stats_line_cb, job);
+
+cleanup:
+	if (error < 0) {
+		const git_error *last = giterr_last();
+
+		job->error = error;
+		job->error_class = last ? last->klass : GITERR_INVALID;
+		snprintf(job->error_message, sizeof(job->error_message), "%s",
+			last ? last->message : "Failed to compute diff stats");
+	}
+
+	git_diff_list_free(diff);
+	git_tree_free(parent_tree);
+	git_tree_free(tree);
+	git_commit_free(parent);
+	git_commit_free(commit);
+}
+
+/*
+ * libgit2 objects can't be shared between threads, so every worker
+ * opens its own handle on the repository on its first job.
+ */
+static int diff_stats_run_job(rugged_pool *pool, size_t worker, size_t i, void *payload)
+{
+	rugged_diff_stats_work *work = payload;
+	rugged_diff_stats_job *job = &work->jobs[i];
+	int error;
+
+	if (!work->repos[worker] &&
+		(error = rugged_repo_open_worker(&work->repos[worker], work->repo_path, work->alternates)) < 0) {
+		job->error = error;
+		job->error_class = GITERR_OS;
+		snprintf(job->error_message, sizeof(job->error_message),
+			"Failed to open '%s' in a worker thread", work->repo_path);
+		return 0;
+	}
+
+	diff_stats_compute(work->repos[worker], job);
+	return 0;
+}
+
+static VALUE diff_stats_body(VALUE payload)
+{
+	rugged_diff_stats_work *work = (rugged_diff_stats_work *)payload;
+	git_repository *repo;
+	VALUE rb_result;
+	size_t i;
+
+	Data_Get_Struct(work->rb_repo, git_repository, repo);
+
+	work->job_count = RARRAY_LEN(work->rb_commits);
+	work->jobs = xcalloc(work->job_count + 1, sizeof(rugged_diff_stats_job));
+
+	for (i = 0; i < work->job_count; ++i) {
+		VALUE rb_commit = rb_ary_entry(work->rb_commits, i);
+
+		if (rb_obj_is_kind_of(rb_commit, rb_cRuggedCommit)) {
+			git_commit *commit;
+			Data_Get_Struct(rb_commit, git_commit, commit);
+			git_oid_cpy(&work->jobs[i].oid, git_commit_id(commit));
+			continue;
+		}
+
+		if (TYPE(rb_commit) != T_STRING)
+			rb_raise(rb_eTypeError, "Expecting a Rugged::Commit or a String OID");
+
+		rugged_exception_check(git_oid_fromstr(&work->jobs[i].oid, StringValueCStr(rb_commit)));
+	}
+
+	work->repo_path = git_repository_path(repo);
+	work->alternates = rugged_repo_alternates(work->rb_repo);
+
+	/* commits are diffed through libgit2, which may not be thread-safe */
+	rugged_pool_run(
+		rugged_threads_supported() ? rugged_pool_threads(RUGGED_DIFF_STATS_MAX_THREADS) : 0,
+		work->job_count, diff_stats_run_job, NULL, work);
+
+	for (i = 0; i < work->job_count; ++i) {
+		rugged_diff_stats_job *job = &work->jobs[i];
+
+		if (job->error < 0) {
+			giterr_set_str(job->error_class, job->error_message);
+			rugged_exception_check(job->error);
+		}
+	}
+
+	rb_result = rb_ary_new2(work->job_count);
+
+	for (i = 0; i < work->job_count; ++i) {
+		rugged_diff_stats_job *job = &work->jobs[i];
+
+		rb_ary_push(rb_result, rb_ary_new3(3,
+			ULONG2NUM(job->files),
+			ULONG2NUM(job->additions),
+			ULONG2NUM(job->deletions)));
+	}
+
+	return rb_result;
+}
+
+static VALUE diff_stats_cleanup(VALUE payload)
+{
+	rugged_diff_stats_work *work = (rugged_diff_stats_work *)payload;
+	size_t i;
+
+	for (i = 0; i < RUGGED_POOL_MAX_THREADS; ++i)
+		git_repository_free(work->repos[i]);
+
+	rugged_repo_alternates_free(work->alternates);
+	xfree(work->jobs);
+
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		repo.diff_stats_for(commits) -> array
+ *
+ *	Compute the size of the changes introduced by each commit in
+ *	+commits+ (an Array of Rugged::Commit instances or OID strings),
+ *	compared to its first parent, or to the empty tree for root commits.
+ *
+ *	Returns an Array with one <tt>[files, additions, deletions]</tt>
+ *	triple per commit, in the same order as +commits+. The lines are
+ *	counted while the diff is generated, without ever building
+ *	Rugged::Diff::Patch objects. When the platform supports it and
+ *	libgit2 was built with thread support (see Rugged.capabilities), the
+ *	commits are diffed in parallel on several threads, each using its
+ *	own handle on the repository, and without holding the GVL.
+ *
+ *		repo.diff_stats_for(walker.first(50))
+ *		#=> [[2, 10, 3], [1, 1, 1], ...]
+ */
+static VALUE rb_git_repo_diff_stats_for(VALUE self, VALUE rb_commits)
+{
+	rugged_diff_stats_work work;
+
+	Check_Type(rb_commits, T_ARRAY);
+
+	memset(&work, 0x0, sizeof(work));
+	work.rb_repo = self;
+	work.rb_commits = rb_commits;
+
+	return rb_ensure(diff_stats_body, (VALUE)&work, diff_stats_cleanup, (VALUE)&work);
+}
+
+void Init_rugged_diff_stats()
+{
+	rb_define_method(rb_cRuggedRepo, "diff_stats_for", rb_git_repo_diff_stats_for, 1);
+}
@@ -0,0 +1,597 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "rugged.h"
+
+extern VALUE rb_cRuggedRepo;
+
+/* Output is buffered and handed to `io.write` in chunks of at least this size */
+#define RUGGED_FAST_EXPORT_CHUNK (64 * 1024)
+
+typedef struct {
+	git_oid oid;
+	git_otype type;
+	int mark;
+} rugged_export_mark;
+
+typedef struct {
+	git_repository *repo;
+	git_revwalk *walk;
+	git_odb *odb;
+
+	VALUE rb_io;
+	VALUE rb_buffer;
+	VALUE rb_refs;
+	VALUE rb_marks;
+
+	st_table *marks;
+	int last_mark;
+
+	git_oid *tips;
+} rugged_fast_export;
+
+static int export_mark_cmp(st_data_t a, st_data_t b)
+{
+	return git_oid_cmp((const git_oid *)a, (const git_oid *)b);
+}
+
+static st_index_t export_mark_hash(st_data_t a)
+{
+	st_index_t h;
+	memcpy(&h, ((const git_oid *)a)->id, sizeof(h));
+	return h;
+}
+
+static const struct st_hash_type export_mark_hash_type = {
+	export_mark_cmp,
+	export_mark_hash,
+};
+
+static rugged_export_mark *export_mark_lookup(rugged_fast_export *ex, const git_oid *oid)
+{
+	st_data_t mark;
+
+	if (st_lookup(ex->marks, (st_data_t)oid, &mark))
+		return (rugged_export_mark *)mark;
+
+	return NULL;
+}
+
+static rugged_export_mark *export_mark_add(
+	rugged_fast_export *ex, const git_oid *oid, git_otype type, int mark_id)
+{
+	rugged_export_mark *mark = xmalloc(sizeof(rugged_export_mark));
+
+	git_oid_cpy(&mark->oid, oid);
+	mark->type = type;
+	mark->mark = mark_id;
+
+	st_insert(ex->marks, (st_data_t)&mark->oid, (st_data_t)mark);
+
+	if (mark_id > ex->last_mark)
+		ex->last_mark = mark_id;
+
+	return mark;
+}
+
+static rugged_export_mark *export_mark_new(
+	rugged_fast_export *ex, const git_oid *oid, git_otype type)
+{
+	rugged_export_mark *mark = export_mark_add(ex, oid, type, ex->last_mark + 1);
+	rb_hash_aset(ex->rb_marks, rugged_create_oid(oid), INT2FIX(mark->mark));
+	return mark;
+}
+
+static int export_mark_free_cb(st_data_t key, st_data_t value, st_data_t unused)
+{
+	xfree((rugged_export_mark *)value);
+	return ST_DELETE;
+}
+
+static int export_mark_import_cb(VALUE rb_oid, VALUE rb_mark, VALUE payload)
+{
+	rugged_fast_export *ex = (rugged_fast_export *)payload;
+	git_oid oid;
+	git_otype type;
+	size_t len;
+	int error;
+
+	Check_Type(rb_oid, T_STRING);
+	Check_Type(rb_mark, T_FIXNUM);
+
+	rugged_exception_check(git_oid_fromstr(&oid, StringValueCStr(rb_oid)));
+
+	/* New marks must never reuse a number, even one of a missing object */
+	if (FIX2INT(rb_mark) > ex->last_mark)
+		ex->last_mark = FIX2INT(rb_mark);
+
+	/*
+	 * Marks only carry object ids; we need to know which of them are
+	 * commits so they can be hidden from the walk. Reading the header
+	 * is enough for that.
+	 */
+	error = git_odb_read_header(&len, &type, ex->odb, &oid);
+	if (error == GIT_ENOTFOUND)
+		return ST_CONTINUE;
+
+	rugged_exception_check(error);
+
+	export_mark_add(ex, &oid, type, FIX2INT(rb_mark));
+	return ST_CONTINUE;
+}
+
+static void export_flush(rugged_fast_export *ex, int force)
+{
+	long len = RSTRING_LEN(ex->rb_buffer);
+
+	if (len == 0 || (!force && len < RUGGED_FAST_EXPORT_CHUNK))
+		return;
+
+	rb_io_write(ex->rb_io, ex->rb_buffer);
+
+	/* The IO may hold on to the string it was given; never reuse it */
+	ex->rb_buffer = rb_str_buf_new(RUGGED_FAST_EXPORT_CHUNK);
+}
+
+static void export_puts(rugged_fast_export *ex, const char *str)
+{
+	rb_str_cat(ex->rb_buffer, str, strlen(str));
+}
+
+static void export_printf(rugged_fast_export *ex, const char *fmt, ...)
+{
+	char buffer[128];
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintf(buffer, sizeof(buffer), fmt, args);
+	va_end(args);
+
+	if (len >= (int)sizeof(buffer))
+		len = (int)sizeof(buffer) - 1;
+
+	rb_str_cat(ex->rb_buffer, buffer, len);
+}
+
+static void export_data(rugged_fast_export *ex, const char *data, size_t len)
+{
+	export_printf(ex, "data %lu\n", (unsigned long)len);
+	rb_str_cat(ex->rb_buffer, data, len);
+	export_puts(ex, "\n");
+}
+
+static void export_oid(rugged_fast_export *ex, const git_oid *oid)
+{
+	char out[GIT_OID_HEXSZ];
+	git_oid_fmt(out, oid);
+	rb_str_cat(ex->rb_buffer, out, GIT_OID_HEXSZ);
+}
+
+/*
+ * Paths are written verbatim unless they would confuse the parser,
+ * in which case they are C-style quoted like `git fast-export` does.
+ */
+static void export_path(rugged_fast_export *ex, const char *path)
+{
+	const char *p;
+
+	if (path[0] != '"' && strpbrk(path, "\n\\\"") == NULL) {
+		export_puts(ex, path);
+		return;
+	}
+
+	export_puts(ex, "\"");
+	for (p = path; *p; ++p) {
+		switch (*p) {
+		case '\n': export_puts(ex, "\\n"); break;
+		case '"': export_puts(ex, "\\\""); break;
+		case '\\': export_puts(ex, "\\\\"); break;
+		default: rb_str_cat(ex->rb_buffer, p, 1); break;
+		}
+	}
+	export_puts(ex, "\"");
+}
+
+static void export_ident(rugged_fast_export *ex, const char *header, const git_signature *sig)
+{
+	int offset = sig->when.offset;
+	char sign = '+';
+
+	if (offset < 0) {
+		sign = '-';
+		offset = -offset;
+	}
+
+	export_puts(ex, header);
+	export_puts(ex, " ");
+	export_puts(ex, sig->name);
+	export_puts(ex, " <");
+	export_puts(ex, sig->email);
+	export_printf(ex, "> %ld %c%02d%02d\n",
+		(long)sig->when.time, sign, offset / 60, offset % 60);
+}
+
+static void export_commitish(rugged_fast_export *ex, const git_oid *oid)
+{
+	rugged_export_mark *mark = export_mark_lookup(ex, oid);
+
+	if (mark) {
+		export_printf(ex, ":%d", mark->mark);
+	} else {
+		export_oid(ex, oid);
+	}
+}
+
+static int export_blob(rugged_fast_export *ex, const git_oid *oid)
+{
+	git_blob *blob;
+	rugged_export_mark *mark;
+	int error;
+
+	if (export_mark_lookup(ex, oid) != NULL)
+		return 0;
+
+	error = git_blob_lookup(&blob, ex->repo, oid);
+	if (error < 0)
+		return error;
+
+	mark = export_mark_new(ex, oid, GIT_OBJ_BLOB);
+
+	export_printf(ex, "blob\nmark :%d\n", mark->mark);
+	export_data(ex, git_blob_rawcontent(blob), (size_t)git_blob_rawsize(blob));
+
+	git_blob_free(blob);
+	return 0;
+}
+
+static int export_file_changes(rugged_fast_export *ex, git_diff_list *diff)
+{
+	const git_diff_delta *delta;
+	size_t d, delta_count;
+	int error = 0;
+
+	delta_count = git_diff_num_deltas(diff);
+
+	/* All the blobs must be in the stream before the commit that uses them */
+	for (d = 0; d < delta_count; ++d) {
+		error = git_diff_get_patch(NULL, &delta, diff, d);
+		if (error < 0)
+			return error;
+
+		if (delta->status == GIT_DELTA_DELETED ||
+			delta->new_file.mode == GIT_FILEMODE_COMMIT)
+			continue;
+
+		error = export_blob(ex, &delta->new_file.oid);
+		if (error < 0)
+			return error;
+	}
+
+	return 0;
+}
+
+static int export_file_commands(rugged_fast_export *ex, git_diff_list *diff)
+{
+	const git_diff_delta *delta;
+	size_t d, delta_count;
+	int error;
+
+	delta_count = git_diff_num_deltas(diff);
+
+	/* Deletions go first, so type changes on the same path are replayed in order */
+	for (d = 0; d < delta_count; ++d) {
+		error = git_diff_get_patch(NULL, &delta, diff, d);
+		if (error < 0)
+			return error;
+
+		if (delta->status != GIT_DELTA_DELETED)
+			continue;
+
+		export_puts(ex, "D ");
+		export_path(ex, delta->old_file.path);
+		export_puts(ex, "\n");
+	}
+
+	for (d = 0; d < delta_count; ++d) {
+		error = git_diff_get_patch(NULL, &delta, diff, d);
+		if (error < 0)
+			return error;
+
+		if (delta->status == GIT_DELTA_DELETED)
+			continue;
+
+		export_printf(ex, "M %o ", delta->new_file.mode);
+		export_commitish(ex, &delta->new_file.oid);
+		export_puts(ex, " ");
+		export_path(ex, delta->new_file.path);
+		export_puts(ex, "\n");
+	}
+
+	return 0;
+}
+
+static int export_commit(rugged_fast_export *ex, git_commit *commit, const char *refname)
+{
+	git_tree *tree = NULL, *parent_tree = NULL;
+	git_commit *parent = NULL;
+	git_diff_list *diff = NULL;
+	rugged_export_mark *mark;
+	const char *message;
+	unsigned int p, parent_count;
+	int error;
+
+	parent_count = git_commit_parentcount(commit);
+
+	error = git_commit_tree(&tree, commit);
+	if (error < 0)
+		goto cleanup;
+
+	if (parent_count > 0) {
+		error = git_commit_parent(&parent, commit, 0);
+		if (error < 0)
+			goto cleanup;
+
+		error = git_commit_tree(&parent_tree, parent);
+		if (error < 0)
+			goto cleanup;
+	}
+
+	error = git_diff_tree_to_tree(&diff, ex->repo, parent_tree, tree, NULL);
+	if (error < 0)
+		goto cleanup;
+
+	error = export_file_changes(ex, diff);
+	if (error < 0)
+		goto cleanup;
+
+	/* Without a parent, fast-import would chain onto the branch's current tip */
+	if (parent_count == 0) {
+		export_puts(ex, "reset ");
+		export_puts(ex, refname);
+		export_puts(ex, "\n");
+	}
+
+	mark = export_mark_new(ex, git_commit_id(commit), GIT_OBJ_COMMIT);
+
+	export_puts(ex, "commit ");
+	export_puts(ex, refname);
+	export_printf(ex, "\nmark :%d\n", mark->mark);
+	export_ident(ex, "author", git_commit_author(commit));
+	export_ident(ex, "committer", git_commit_committer(commit));
+
+	message = git_commit_message(commit);
+	export_data(ex, message, strlen(message));
+
+	for (p = 0; p < parent_count; ++p) {
+		export_puts(ex, p == 0 ? "from " : "merge ");
+		export_commitish(ex, git_commit_parent_id(commit, p));
+		export_puts(ex, "\n");
+	}
+
+	error = export_file_commands(ex, diff);
+	export_puts(ex, "\n");
+
+cleanup:
+	git_diff_list_free(diff);
+	git_tree_free(parent_tree);
+	git_commit_free(parent);
+	git_tree_free(tree);
+	return error;
+}
+
+static int export_hide_cb(st_data_t key, st_data_t value, st_data_t payload)
+{
+	rugged_export_mark *mark = (rugged_export_mark *)value;
+	rugged_fast_export *ex = (rugged_fast_export *)payload;
+
+	if (mark->type == GIT_OBJ_COMMIT)
+		git_revwalk_hide(ex->walk, &mark->oid);
+
+	return ST_CONTINUE;
+}
+
+static VALUE rugged_fast_export_run(VALUE payload)
+{
+	rugged_fast_export *ex = (rugged_fast_export *)payload;
+	const char *first_ref = NULL;
+	git_oid *tips;
+	git_oid oid;
+	git_commit *commit;
+	long i, ref_count = RARRAY_LEN(ex->rb_refs);
+	int error;
+
+	/* freed by rugged_fast_export_cleanup */
+	tips = ex->tips = xmalloc((ref_count ? ref_count : 1) * sizeof(git_oid));
+
+	error = git_repository_odb(&ex->odb, ex->repo);
+	rugged_exception_check(error);
+
+	rb_hash_foreach(ex->rb_marks, export_mark_import_cb, (VALUE)ex);
+
+	error = git_revwalk_new(&ex->walk, ex->repo);
+	rugged_exception_check(error);
+
+	git_revwalk_sorting(ex->walk, GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+
+	for (i = 0; i < ref_count; ++i) {
+		VALUE rb_ref = rb_ary_entry(ex->rb_refs, i);
+		git_object *target;
+
+		error = git_revparse_single(&target, ex->repo,
+			StringValueCStr(rb_ref));
+		rugged_exception_check(error);
+
+		/* Annotated tags are exported as the commit they point to */
+		if (git_object_type(target) == GIT_OBJ_TAG) {
+			git_object *peeled;
+			error = git_tag_peel(&peeled, (git_tag *)target);
+			git_object_free(target);
+			rugged_exception_check(error);
+			target = peeled;
+		}
+
+		if (git_object_type(target) != GIT_OBJ_COMMIT) {
+			git_object_free(target);
+			rb_raise(rb_eTypeError, "Reference '%s' does not point to a commit",
+				StringValueCStr(rb_ref));
+		}
+
+		git_oid_cpy(&tips[i], git_object_id(target));
+		git_object_free(target);
+
+		error = git_revwalk_push(ex->walk, &tips[i]);
+		rugged_exception_check(error);
+	}
+
+	/* Everything that was exported in a previous run is left out of the walk */
+	st_foreach(ex->marks, export_hide_cb, (st_data_t)ex);
+
+	if (ref_count > 0) {
+		VALUE rb_first_ref = rb_ary_entry(ex->rb_refs, 0);
+		first_ref = StringValueCStr(rb_first_ref);
+	}
+
+	while ((error = git_revwalk_next(&oid, ex->walk)) == 0) {
+		error = git_commit_lookup(&commit, ex->repo, &oid);
+		rugged_exception_check(error);
+
+		error = export_commit(ex, commit, first_ref);
+		git_commit_free(commit);
+		rugged_exception_check(error);
+
+		export_flush(ex, 0);
+	}
+
+	if (error != GIT_ITEROVER)
+		rugged_exception_check(error);
+
+	/* Point every ref at its tip, since commits were labelled with the first one */
+	for (i = 0; i < ref_count; ++i) {
+		VALUE rb_ref = rb_ary_entry(ex->rb_refs, i);
+
+		export_puts(ex, "reset ");
+		export_puts(ex, StringValueCStr(rb_ref));
+		export_puts(ex, "\nfrom ");
+		export_commitish(ex, &tips[i]);
+		export_puts(ex, "\n\n");
+	}
+
+	export_flush(ex, 1);
+	return ex->rb_marks;
+}
+
+static VALUE rugged_fast_export_cleanup(VALUE payload)
+{
+	rugged_fast_export *ex = (rugged_fast_export *)payload;
+
+	git_revwalk_free(ex->walk);
+	git_odb_free(ex->odb);
+
+	st_foreach(ex->marks, export_mark_free_cb, 0);
+	st_free_table(ex->marks);
+	xfree(ex->tips);
+
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		repo.fast_export(io, refs, options = {}) -> marks
+ *
+ *	Write the history reachable from +refs+ to +io+ as a stream that
+ *	can be fed to <tt>git fast-import</tt>. +refs+ is a +String+ or an
+ *	+Array+ of fully qualified reference names (e.g. "refs/heads/master").
+ *
+ *	Commits are walked in topological order and their changes are computed
+ *	against their first parent; blobs are emitted right before the first
+ *	commit that needs them. The output is buffered and written to +io+ in
+ *	large chunks.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:marks ::
+ *	  A +Hash+ mapping object ids to fast-import mark numbers, as returned
+ *	  by a previous call. Objects in this +Hash+ are assumed to have been
+ *	  exported already: commits are left out of the walk, and both commits
+ *	  and blobs are referenced by their mark. New marks are added to the
+ *	  +Hash+ as objects are written.
+ *
+ *	Returns the +Hash+ of marks, which can be passed to a later call to
+ *	perform an incremental export.
+ *
+ *		marks = repo.fast_export($stdout, ["refs/heads/master"])
+ *		# ... some time later
+ *		repo.fast_export($stdout, ["refs/heads/master"], :marks => marks)
+ */
+static VALUE rb_git_repo_fast_export(int argc, VALUE *argv, VALUE self)
+{
+	VALUE rb_io, rb_refs, rb_options;
+	rugged_fast_export ex;
+	long i;
+
+	rb_scan_args(argc, argv, "21", &rb_io, &rb_refs, &rb_options);
+
+	if (!rb_respond_to(rb_io, rb_intern("write")))
+		rb_raise(rb_eArgError, "Expected io to respond to \"write\"");
+
+	if (TYPE(rb_refs) == T_STRING)
+		rb_refs = rb_ary_new3(1, rb_refs);
+
+	Check_Type(rb_refs, T_ARRAY);
+
+	/* `tips` is sized once; the caller's array may change while writing */
+	rb_refs = rb_ary_dup(rb_refs);
+	for (i = 0; i < RARRAY_LEN(rb_refs); ++i)
+		Check_Type(rb_ary_entry(rb_refs, i), T_STRING);
+
+	memset(&ex, 0x0, sizeof(ex));
+	Data_Get_Struct(self, git_repository, ex.repo);
+
+	ex.rb_io = rb_io;
+	ex.rb_refs = rb_refs;
+	ex.rb_marks = Qnil;
+	ex.rb_buffer = rb_str_buf_new(RUGGED_FAST_EXPORT_CHUNK);
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+		ex.rb_marks = rb_hash_aref(rb_options, CSTR2SYM("marks"));
+	}
+
+	if (NIL_P(ex.rb_marks))
+		ex.rb_marks = rb_hash_new();
+
+	Check_Type(ex.rb_marks, T_HASH);
+
+	ex.marks = st_init_table(&export_mark_hash_type);
+
+	return rb_ensure(
+		rugged_fast_export_run, (VALUE)&ex,
+		rugged_fast_export_cleanup, (VALUE)&ex);
+}
+
+void Init_rugged_fast_export()
+{
+	rb_define_method(rb_cRuggedRepo, "fast_export", rb_git_repo_fast_export, -1);
+}
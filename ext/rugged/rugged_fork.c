@@ -0,0 +1,212 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "rugged.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+extern VALUE rb_mRugged;
+extern VALUE rb_cRuggedRepo;
+
+static ID id_fork_repositories;
+
+/*
+ * Read ahead the pack indexes of a repository, so the pages the
+ * children will map are already in the page cache.
+ */
+static void fork_readahead_pack_indexes(const char *repo_path)
+{
+#ifdef POSIX_FADV_WILLNEED
+	size_t len = strlen(repo_path);
+	char *path = xmalloc(len + sizeof("objects/pack/") + 256);
+	struct dirent *entry;
+	DIR *dir;
+
+	memcpy(path, repo_path, len);
+	memcpy(path + len, "objects/pack/", sizeof("objects/pack/"));
+	len += sizeof("objects/pack/") - 1;
+
+	if ((dir = opendir(path)) != NULL) {
+		while ((entry = readdir(dir)) != NULL) {
+			size_t name_len = strlen(entry->d_name);
+			int fd;
+
+			if (name_len < 4 || name_len > 255 || strcmp(entry->d_name + name_len - 4, ".idx"))
+				continue;
+
+			memcpy(path + len, entry->d_name, name_len + 1);
+
+			if ((fd = open(path, O_RDONLY)) >= 0) {
+				posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+				close(fd);
+			}
+		}
+
+		closedir(dir);
+	}
+
+	xfree(path);
+#endif
+}
+
+/*
+ *	call-seq:
+ *		Rugged.prepare_for_fork(*repos) -> nil
+ *
+ *	Get the given Rugged::Repository instances ready to be shared by
+ *	forked children, e.g. from the master process of a preforking
+ *	server, right before forking the workers.
+ *
+ *	The object database of every repository is opened, which maps the
+ *	index of every one of its packfiles, and the index files are read
+ *	ahead. The mappings, together with the objects already in the
+ *	repository caches, are inherited by the children and stay shared
+ *	copy-on-write, since they are never written to.
+ *
+ *	Every child must call Rugged.after_fork before using any of the
+ *	repositories.
+ *
+ *	The repositories are referenced until the next call; the parent can
+ *	release them once it is done forking by calling this method without
+ *	arguments.
+ *
+ *	No other thread may be using Rugged while the process forks.
+ */
+static VALUE rb_git_prepare_for_fork(int argc, VALUE *argv, VALUE self)
+{
+	VALUE rb_repos = rb_ary_new();
+	git_oid zero_oid;
+	int i;
+
+	memset(&zero_oid, 0x0, sizeof(git_oid));
+
+	for (i = 0; i < argc; ++i) {
+		git_repository *repo;
+		git_odb *odb;
+		int error;
+
+		if (!rb_obj_is_kind_of(argv[i], rb_cRuggedRepo))
+			rb_raise(rb_eTypeError, "Expecting a Rugged::Repository instance");
+
+		Data_Get_Struct(argv[i], git_repository, repo);
+
+		error = git_repository_odb(&odb, repo);
+		rugged_exception_check(error);
+
+		/* a lookup that can't succeed loads the index of every pack */
+		git_odb_exists(odb, &zero_oid);
+		git_odb_free(odb);
+
+		fork_readahead_pack_indexes(git_repository_path(repo));
+
+		rb_ary_push(rb_repos, argv[i]);
+	}
+
+	rb_ivar_set(rb_mRugged, id_fork_repositories, argc ? rb_repos : Qnil);
+
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		Rugged.after_fork -> nil
+ *
+ *	Make the repositories given to Rugged.prepare_for_fork safe to use in
+ *	a forked child.
+ *
+ *	The object database of every repository is replaced with a fresh one,
+ *	so the child never shares packfile descriptors (and their offsets) or
+ *	memory windows with its parent or its siblings. Reopening it only maps
+ *	the pack indexes again, which are already in the page cache. The
+ *	parsed objects cached by the repository are kept, and stay shared with
+ *	the parent until they are freed. Any Rugged::SharedObjectCache added
+ *	to a repository is attached to its new object database as well, and
+ *	so are the +:alternates+ the repository was opened with.
+ *
+ *	The child stops referencing the repositories afterwards, so a second
+ *	call does nothing.
+ */
+static VALUE rb_git_after_fork(VALUE self)
+{
+	VALUE rb_repos = rb_attr_get(rb_mRugged, id_fork_repositories);
+	long i;
+
+	if (NIL_P(rb_repos))
+		return Qnil;
+
+	for (i = 0; i < RARRAY_LEN(rb_repos); ++i) {
+		git_repository *repo;
+		git_odb *odb;
+		const char *repo_path;
+		char *objects_path, **alternates, **alternate;
+		size_t len;
+		int error;
+
+		Data_Get_Struct(rb_ary_entry(rb_repos, i), git_repository, repo);
+
+		repo_path = git_repository_path(repo);
+		len = strlen(repo_path);
+
+		objects_path = xmalloc(len + sizeof("objects"));
+		memcpy(objects_path, repo_path, len);
+		memcpy(objects_path + len, "objects", sizeof("objects"));
+
+		error = git_odb_open(&odb, objects_path);
+		xfree(objects_path);
+		rugged_exception_check(error);
+
+		/* the same object database Repository.new built */
+		alternates = rugged_repo_alternates(rb_ary_entry(rb_repos, i));
+		for (alternate = alternates; !error && alternate && *alternate; ++alternate)
+			error = git_odb_add_disk_alternate(odb, *alternate);
+		rugged_repo_alternates_free(alternates);
+
+		if (!error)
+			error = rugged_shared_cache_attach(rb_ary_entry(rb_repos, i), odb);
+		if (!error)
+			error = rugged_write_policy_attach(rb_ary_entry(rb_repos, i), odb);
+		if (error < 0) {
+			git_odb_free(odb);
+			rugged_exception_check(error);
+		}
+
+		git_repository_set_odb(repo, odb);
+		git_odb_free(odb);
+	}
+
+	rb_ivar_set(rb_mRugged, id_fork_repositories, Qnil);
+
+	return Qnil;
+}
+
+void Init_rugged_fork()
+{
+	id_fork_repositories = rb_intern("fork_repositories");
+
+	rb_define_module_function(rb_mRugged, "prepare_for_fork", rb_git_prepare_for_fork, -1);
+	rb_define_module_function(rb_mRugged, "after_fork", rb_git_after_fork, 0);
+}
@@ -0,0 +1,941 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "rugged.h"
+
+#include <dirent.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+
+extern VALUE rb_cRuggedRepo;
+
+#define RUGGED_FSCK_MAX_THREADS 16
+
+/* objects hashed between two progress reports */
+#define RUGGED_FSCK_HASH_BATCH 4096
+
+/* objects walked between two progress reports */
+#define RUGGED_FSCK_WALK_BATCH 1024
+
+/* bytes hashed, or pack entries checked, between two checks for an interrupt */
+#define RUGGED_FSCK_INTERRUPT_BYTES (1 << 20)
+#define RUGGED_FSCK_INTERRUPT_ENTRIES 4096
+
+/*
+ * Packfile checksums are SHA-1 digests over the raw file, which
+ * libgit2 can't compute for us.
+ */
+typedef struct {
+	uint32_t h[5];
+	uint64_t len;
+	unsigned char buf[64];
+} fsck_sha1;
+
+#define SHA1_ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_block(uint32_t *h, const unsigned char *p)
+{
+	uint32_t w[80], a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], t;
+	int i;
+
+	for (i = 0; i < 16; ++i)
+		w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[i * 4 + 1] << 16) |
+			((uint32_t)p[i * 4 + 2] << 8) | p[i * 4 + 3];
+
+	for (i = 16; i < 80; ++i)
+		w[i] = SHA1_ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	for (i = 0; i < 80; ++i) {
+		if (i < 20)
+			t = ((b & c) | (~b & d)) + 0x5a827999;
+		else if (i < 40)
+			t = (b ^ c ^ d) + 0x6ed9eba1;
+		else if (i < 60)
+			t = ((b & c) | (b & d) | (c & d)) + 0x8f1bbcdc;
+		else
+			t = (b ^ c ^ d) + 0xca62c1d6;
+
+		t += SHA1_ROL(a, 5) + e + w[i];
+		e = d;
+		d = c;
+		c = SHA1_ROL(b, 30);
+		b = a;
+		a = t;
+	}
+
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+}
+
+static void sha1_init(fsck_sha1 *ctx)
+{
+	ctx->h[0] = 0x67452301;
+	ctx->h[1] = 0xefcdab89;
+	ctx->h[2] = 0x98badcfe;
+	ctx->h[3] = 0x10325476;
+	ctx->h[4] = 0xc3d2e1f0;
+	ctx->len = 0;
+}
+
+static void sha1_update(fsck_sha1 *ctx, const unsigned char *data, size_t len)
+{
+	size_t used = (size_t)(ctx->len & 63);
+
+	ctx->len += len;
+
+	if (used) {
+		size_t fill = 64 - used < len ? 64 - used : len;
+
+		memcpy(ctx->buf + used, data, fill);
+		data += fill;
+		len -= fill;
+
+		if (used + fill < 64)
+			return;
+
+		sha1_block(ctx->h, ctx->buf);
+	}
+
+	for (; len >= 64; data += 64, len -= 64)
+		sha1_block(ctx->h, data);
+
+	memcpy(ctx->buf, data, len);
+}
+
+static void sha1_final(fsck_sha1 *ctx, unsigned char *out)
+{
+	uint64_t bits = ctx->len * 8;
+	unsigned char pad[72];
+	size_t used = (size_t)(ctx->len & 63), pad_len = used < 56 ? 56 - used : 120 - used;
+	int i;
+
+	memset(pad, 0x0, sizeof(pad));
+	pad[0] = 0x80;
+
+	for (i = 0; i < 8; ++i)
+		pad[pad_len + i] = (unsigned char)(bits >> (56 - i * 8));
+
+	sha1_update(ctx, pad, pad_len + 8);
+
+	for (i = 0; i < 20; ++i)
+		out[i] = (unsigned char)(ctx->h[i / 4] >> (24 - (i % 4) * 8));
+}
+
+/*
+ * Set `ok` when the SHA-1 of `data` is `expected`. Returns
+ * RUGGED_POOL_RETRY when interrupted halfway, 0 otherwise.
+ */
+static int sha1_check(int *ok, rugged_pool *pool,
+	const unsigned char *data, size_t len, const unsigned char *expected)
+{
+	unsigned char digest[GIT_OID_RAWSZ];
+	fsck_sha1 ctx;
+
+	sha1_init(&ctx);
+
+	while (len > 0) {
+		size_t chunk = len < RUGGED_FSCK_INTERRUPT_BYTES ? len : RUGGED_FSCK_INTERRUPT_BYTES;
+
+		if (rugged_pool_interrupted(pool))
+			return RUGGED_POOL_RETRY;
+
+		sha1_update(&ctx, data, chunk);
+		data += chunk;
+		len -= chunk;
+	}
+
+	sha1_final(&ctx, digest);
+
+	*ok = !memcmp(digest, expected, GIT_OID_RAWSZ);
+	return 0;
+}
+
+/*
+ * A problem found with one object. Everything filled in by the worker
+ * threads is allocated with malloc, since they run without the GVL.
+ */
+typedef struct {
+	git_oid id;
+	char message[128];
+} fsck_problem;
+
+typedef struct {
+	fsck_problem *problems;
+	size_t count, alloc;
+} fsck_problem_list;
+
+typedef struct {
+	char *path;
+	uint32_t objects;
+	int checksum_ok, index_checksum_ok;
+	fsck_problem_list bad_crcs;
+	char error_message[256];
+} fsck_pack;
+
+typedef struct {
+	git_repository *repo;
+	git_odb *odb;
+	fsck_problem_list corrupt;
+} fsck_slot;
+
+enum {
+	FSCK_PHASE_PACKS,
+	FSCK_PHASE_HASHES
+};
+
+typedef struct {
+	VALUE rb_repo;
+	int progress;
+	int phase;
+
+	fsck_pack *packs;
+	size_t pack_count;
+
+	VALUE rb_ids;
+	size_t id_count;
+
+	fsck_slot *slots;
+	size_t slot_count;
+
+	size_t begin;
+} fsck_work;
+
+static void problem_push(fsck_problem_list *list, const unsigned char *id, const char *message)
+{
+	fsck_problem *problem;
+
+	if (list->count == list->alloc) {
+		size_t alloc = list->alloc ? list->alloc * 2 : 16;
+		fsck_problem *problems = realloc(list->problems, alloc * sizeof(fsck_problem));
+
+		/* nowhere to report it; the rest of the report is still accurate */
+		if (!problems)
+			return;
+
+		list->problems = problems;
+		list->alloc = alloc;
+	}
+
+	problem = &list->problems[list->count++];
+	memcpy(problem->id.id, id, GIT_OID_RAWSZ);
+	snprintf(problem->message, sizeof(problem->message), "%s", message);
+}
+
+typedef struct {
+	uint64_t offset;
+	uint32_t pos;
+} fsck_pack_entry;
+
+static int fsck_pack_entry_cmp(const void *a, const void *b)
+{
+	uint64_t left = ((const fsck_pack_entry *)a)->offset, right = ((const fsck_pack_entry *)b)->offset;
+	return left < right ? -1 : left > right;
+}
+
+/*
+ * Check the CRC32 recorded in a version 2 index for every entry of the
+ * packfile; an entry spans up to the next one, or to the trailer.
+ */
+static int fsck_pack_crcs(rugged_pool *pool, fsck_pack *result, const rugged_pack_index *idx,
+	const unsigned char *pack, size_t pack_size)
+{
+	fsck_pack_entry *entries = malloc(((size_t)idx->count + 1) * sizeof(fsck_pack_entry));
+	uint32_t i;
+
+	if (!entries) {
+		snprintf(result->error_message, sizeof(result->error_message), "Out of memory");
+		return 0;
+	}
+
+	for (i = 0; i < idx->count; ++i) {
+		entries[i].pos = i;
+		if (rugged_pack_index_offset(&entries[i].offset, idx, i) < 0) {
+			snprintf(result->error_message, sizeof(result->error_message), "Corrupted pack index");
+			free(entries);
+			return 0;
+		}
+	}
+
+	qsort(entries, idx->count, sizeof(fsck_pack_entry), fsck_pack_entry_cmp);
+
+	for (i = 0; i < idx->count; ++i) {
+		uint64_t start = entries[i].offset;
+		uint64_t end = i + 1 < idx->count ? entries[i + 1].offset : pack_size - GIT_OID_RAWSZ;
+		const unsigned char *name = rugged_pack_index_name(idx, entries[i].pos);
+		uLong crc = crc32(0L, Z_NULL, 0);
+		uint64_t pos;
+
+		if (i % RUGGED_FSCK_INTERRUPT_ENTRIES == 0 && rugged_pool_interrupted(pool)) {
+			free(entries);
+			return RUGGED_POOL_RETRY;
+		}
+
+		if (start < 12 || end > pack_size - GIT_OID_RAWSZ || start >= end) {
+			problem_push(&result->bad_crcs, name, "Entry out of the packfile bounds");
+			continue;
+		}
+
+		/* crc32() takes a uInt length */
+		for (pos = start; pos < end; pos += 1 << 30) {
+			uint64_t chunk = end - pos < (1 << 30) ? end - pos : (1 << 30);
+			crc = crc32(crc, pack + pos, (uInt)chunk);
+		}
+
+		if ((uint32_t)crc != rugged_be32(idx->crcs + (size_t)entries[i].pos * 4))
+			problem_push(&result->bad_crcs, name, "CRC mismatch");
+	}
+
+	free(entries);
+	return 0;
+}
+
+/*
+ * Returns RUGGED_POOL_RETRY, with `result` reset, when interrupted
+ * halfway, or 0 once every problem with the pack is recorded.
+ */
+static int fsck_verify_pack(rugged_pool *pool, fsck_pack *result)
+{
+	rugged_pack_index idx;
+	unsigned char *pack = NULL;
+	size_t pack_size = 0, len = strlen(result->path);
+	char *idx_path = malloc(len + 1);
+	int error = 0;
+
+	memset(&idx, 0x0, sizeof(idx));
+
+	if (!idx_path) {
+		snprintf(result->error_message, sizeof(result->error_message), "Out of memory");
+		return 0;
+	}
+
+	/* "pack-<sha>.pack" => "pack-<sha>.idx" */
+	memcpy(idx_path, result->path, len - 4);
+	memcpy(idx_path + len - 4, "idx", 4);
+
+	idx.data = rugged_map_file(idx_path, &idx.size);
+	free(idx_path);
+
+	if (!idx.data || rugged_pack_index_parse(&idx) < 0) {
+		snprintf(result->error_message, sizeof(result->error_message), "Corrupted pack index");
+		goto cleanup;
+	}
+
+	result->objects = idx.count;
+
+	if ((error = sha1_check(&result->index_checksum_ok, pool,
+		idx.data, idx.size - GIT_OID_RAWSZ, idx.data + idx.size - GIT_OID_RAWSZ)) != 0)
+		goto cleanup;
+
+	if (!(pack = rugged_map_file(result->path, &pack_size)) ||
+		pack_size < 12 + GIT_OID_RAWSZ || memcmp(pack, "PACK", 4)) {
+		snprintf(result->error_message, sizeof(result->error_message), "Invalid packfile");
+		goto cleanup;
+	}
+
+	if ((error = sha1_check(&result->checksum_ok, pool,
+		pack, pack_size - GIT_OID_RAWSZ, pack + pack_size - GIT_OID_RAWSZ)) != 0)
+		goto cleanup;
+
+	result->checksum_ok = result->checksum_ok &&
+		!memcmp(pack + pack_size - GIT_OID_RAWSZ, idx.data + idx.size - 2 * GIT_OID_RAWSZ, GIT_OID_RAWSZ);
+
+	if (rugged_be32(pack + 8) != idx.count)
+		snprintf(result->error_message, sizeof(result->error_message),
+			"The packfile has %u objects, its index %u", rugged_be32(pack + 8), idx.count);
+	else if (idx.version == 2)
+		error = fsck_pack_crcs(pool, result, &idx, pack, pack_size);
+
+cleanup:
+	if (pack)
+		munmap(pack, pack_size);
+
+	if (idx.data)
+		munmap((void *)idx.data, idx.size);
+
+	if (error == RUGGED_POOL_RETRY) {
+		result->objects = 0;
+		result->checksum_ok = result->index_checksum_ok = 0;
+		result->bad_crcs.count = 0;
+		result->error_message[0] = '\0';
+	}
+
+	return error;
+}
+
+/* Read an object and check that its content hashes back to its ID */
+static void fsck_verify_hash(fsck_work *work, fsck_slot *slot, size_t i)
+{
+	const unsigned char *raw = (const unsigned char *)RSTRING_PTR(work->rb_ids) + i * GIT_OID_RAWSZ;
+	git_odb_object *object;
+	git_oid oid, actual;
+	int error;
+
+	memcpy(oid.id, raw, GIT_OID_RAWSZ);
+
+	if ((error = git_odb_read(&object, slot->odb, &oid)) < 0) {
+		const git_error *err = giterr_last();
+		problem_push(&slot->corrupt, raw, err ? err->message : "Failed to read the object");
+		giterr_clear();
+		return;
+	}
+
+	error = git_odb_hash(&actual, git_odb_object_data(object),
+		git_odb_object_size(object), git_odb_object_type(object));
+
+	if (error < 0 || git_oid_cmp(&oid, &actual))
+		problem_push(&slot->corrupt, raw, "The content of the object doesn't match its ID");
+
+	git_odb_object_free(object);
+}
+
+static int fsck_run_item(rugged_pool *pool, size_t slot, size_t i, void *payload)
+{
+	fsck_work *work = payload;
+
+	if (work->phase == FSCK_PHASE_PACKS)
+		return fsck_verify_pack(pool, &work->packs[work->begin + i]);
+
+	fsck_verify_hash(work, &work->slots[slot], work->begin + i);
+	return 0;
+}
+
+/* Verify items [begin, end) of the current phase, one thread per slot */
+static void fsck_run(fsck_work *work, size_t begin, size_t end)
+{
+	size_t threads = work->slot_count;
+
+	/* objects are read through libgit2, which may not be thread-safe */
+	if (work->phase == FSCK_PHASE_HASHES && !rugged_threads_supported())
+		threads = 0;
+
+	work->begin = begin;
+	rugged_pool_run(threads, end - begin, fsck_run_item, NULL, work);
+}
+
+static void fsck_progress(fsck_work *work, const char *phase, size_t done, size_t total)
+{
+	if (work->progress)
+		rb_yield_values(3, CSTR2SYM(phase), SIZET2NUM(done), SIZET2NUM(total));
+}
+
+static VALUE fsck_problems_to_rb(const fsck_problem_list *list, VALUE rb_result)
+{
+	size_t i;
+
+	for (i = 0; i < list->count; ++i) {
+		VALUE rb_problem = rb_hash_new();
+		rb_hash_aset(rb_problem, CSTR2SYM("id"), rugged_create_oid(&list->problems[i].id));
+		rb_hash_aset(rb_problem, CSTR2SYM("error"), rb_str_new2(list->problems[i].message));
+		rb_ary_push(rb_result, rb_problem);
+	}
+
+	return rb_result;
+}
+
+static VALUE fsck_packs(fsck_work *work)
+{
+	VALUE rb_dirs = rugged_object_dirs(work->rb_repo), rb_packs = rb_ary_new();
+	size_t i, alloc = 0;
+	long d;
+
+	for (d = 0; d < RARRAY_LEN(rb_dirs); ++d) {
+		VALUE rb_pack_dir = rb_str_plus(rb_ary_entry(rb_dirs, d), rb_str_new2("pack/"));
+		struct dirent *entry;
+		DIR *dir;
+
+		if (!(dir = opendir(StringValueCStr(rb_pack_dir))))
+			continue;
+
+		while ((entry = readdir(dir)) != NULL) {
+			size_t len = strlen(entry->d_name);
+			VALUE rb_path;
+
+			if (len <= 5 || strcmp(entry->d_name + len - 5, ".pack"))
+				continue;
+
+			if (work->pack_count == alloc) {
+				alloc = alloc ? alloc * 2 : 16;
+				REALLOC_N(work->packs, fsck_pack, alloc);
+			}
+
+			rb_path = rb_str_plus(rb_pack_dir, rb_str_new2(entry->d_name));
+
+			memset(&work->packs[work->pack_count], 0x0, sizeof(fsck_pack));
+			work->packs[work->pack_count].path = xmalloc(RSTRING_LEN(rb_path) + 1);
+			memcpy(work->packs[work->pack_count++].path, StringValueCStr(rb_path), RSTRING_LEN(rb_path) + 1);
+		}
+
+		closedir(dir);
+	}
+
+	work->phase = FSCK_PHASE_PACKS;
+	fsck_progress(work, "packs", 0, work->pack_count);
+
+	for (i = 0; i < work->pack_count; i += work->slot_count) {
+		size_t end = i + work->slot_count < work->pack_count ? i + work->slot_count : work->pack_count;
+
+		fsck_run(work, i, end);
+		fsck_progress(work, "packs", end, work->pack_count);
+	}
+
+	for (i = 0; i < work->pack_count; ++i) {
+		fsck_pack *pack = &work->packs[i];
+		VALUE rb_pack = rb_hash_new();
+
+		rb_hash_aset(rb_pack, CSTR2SYM("path"), rb_str_new2(pack->path));
+		rb_hash_aset(rb_pack, CSTR2SYM("objects"), UINT2NUM(pack->objects));
+		rb_hash_aset(rb_pack, CSTR2SYM("checksum"), pack->checksum_ok ? Qtrue : Qfalse);
+		rb_hash_aset(rb_pack, CSTR2SYM("index_checksum"), pack->index_checksum_ok ? Qtrue : Qfalse);
+		rb_hash_aset(rb_pack, CSTR2SYM("bad_crcs"), fsck_problems_to_rb(&pack->bad_crcs, rb_ary_new()));
+		rb_hash_aset(rb_pack, CSTR2SYM("error"),
+			pack->error_message[0] ? rb_str_new2(pack->error_message) : Qnil);
+
+		rb_ary_push(rb_packs, rb_pack);
+	}
+
+	return rb_packs;
+}
+
+static VALUE fsck_hashes(fsck_work *work)
+{
+	VALUE rb_corrupt = rb_ary_new();
+	git_repository *repo;
+	char **alternates;
+	size_t i;
+	int error = 0;
+
+	Data_Get_Struct(work->rb_repo, git_repository, repo);
+
+	/* objects are read through libgit2, which may not be thread-safe */
+	if (!rugged_threads_supported())
+		work->slot_count = 1;
+
+	/* libgit2 objects can't be shared between threads: one handle each */
+	alternates = rugged_repo_alternates(work->rb_repo);
+
+	for (i = 0; !error && i < work->slot_count; ++i) {
+		fsck_slot *slot = &work->slots[i];
+
+		error = rugged_repo_open_worker(&slot->repo, git_repository_path(repo), alternates);
+		if (!error)
+			error = git_repository_odb(&slot->odb, slot->repo);
+	}
+
+	rugged_repo_alternates_free(alternates);
+	rugged_exception_check(error);
+
+	work->phase = FSCK_PHASE_HASHES;
+	fsck_progress(work, "hashes", 0, work->id_count);
+
+	for (i = 0; i < work->id_count; i += RUGGED_FSCK_HASH_BATCH) {
+		size_t end = i + RUGGED_FSCK_HASH_BATCH < work->id_count ? i + RUGGED_FSCK_HASH_BATCH : work->id_count;
+
+		fsck_run(work, i, end);
+		fsck_progress(work, "hashes", end, work->id_count);
+	}
+
+	for (i = 0; i < work->slot_count; ++i)
+		fsck_problems_to_rb(&work->slots[i].corrupt, rb_corrupt);
+
+	return rb_corrupt;
+}
+
+static long fsck_id_index(fsck_work *work, const git_oid *oid)
+{
+	const unsigned char *ids = (const unsigned char *)RSTRING_PTR(work->rb_ids);
+	size_t lo = 0, hi = work->id_count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = memcmp(oid->id, ids + mid * GIT_OID_RAWSZ, GIT_OID_RAWSZ);
+
+		if (!cmp)
+			return (long)mid;
+
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return -1;
+}
+
+typedef struct {
+	git_oid id, referrer;
+	git_otype type;
+} fsck_walk_entry;
+
+typedef struct {
+	fsck_walk_entry *entries;
+	size_t count, alloc;
+} fsck_walk_stack;
+
+static void walk_push(fsck_walk_stack *stack, const git_oid *id, git_otype type, const git_oid *referrer)
+{
+	fsck_walk_entry *entry;
+
+	if (stack->count == stack->alloc) {
+		stack->alloc = stack->alloc ? stack->alloc * 2 : 1024;
+		REALLOC_N(stack->entries, fsck_walk_entry, stack->alloc);
+	}
+
+	entry = &stack->entries[stack->count++];
+	git_oid_cpy(&entry->id, id);
+	entry->type = type;
+
+	if (referrer)
+		git_oid_cpy(&entry->referrer, referrer);
+	else
+		memset(&entry->referrer, 0x0, sizeof(git_oid));
+}
+
+static void walk_report(VALUE rb_list, const git_oid *id, const char *key, VALUE rb_value)
+{
+	VALUE rb_problem = rb_hash_new();
+	rb_hash_aset(rb_problem, CSTR2SYM("id"), rugged_create_oid(id));
+	rb_hash_aset(rb_problem, CSTR2SYM(key), rb_value);
+	rb_ary_push(rb_list, rb_problem);
+}
+
+/*
+ * Walk every object reachable from the references, marking them in a
+ * bitmap indexed like the sorted list of all the IDs in the repository.
+ * Blobs are never read: their presence in the list is enough.
+ */
+static size_t fsck_connectivity(fsck_work *work, fsck_walk_stack *stack, unsigned char *visited,
+	VALUE rb_missing, VALUE rb_corrupt)
+{
+	git_repository *repo;
+	git_odb *odb;
+	git_strarray refs;
+	size_t i, reachable = 0, walked = 0;
+	int error;
+
+	Data_Get_Struct(work->rb_repo, git_repository, repo);
+
+	error = git_reference_list(&refs, repo, GIT_REF_LISTALL);
+	rugged_exception_check(error);
+
+	for (i = 0; i < refs.count; ++i) {
+		git_oid oid;
+
+		/* e.g. HEAD on an unborn branch */
+		if (git_reference_name_to_id(&oid, repo, refs.strings[i]) < 0) {
+			giterr_clear();
+			continue;
+		}
+
+		walk_push(stack, &oid, GIT_OBJ_ANY, NULL);
+	}
+
+	git_strarray_free(&refs);
+
+	error = git_repository_odb(&odb, repo);
+	rugged_exception_check(error);
+
+	fsck_progress(work, "connectivity", 0, work->id_count);
+
+	while (stack->count > 0) {
+		fsck_walk_entry entry = stack->entries[--stack->count];
+		git_object *object;
+		long index = fsck_id_index(work, &entry.id);
+
+		if (index < 0) {
+			/* objects can live in backends that aren't scanned, such as alternates added later */
+			if (!git_odb_exists(odb, &entry.id))
+				walk_report(rb_missing, &entry.id, "referrer",
+					git_oid_iszero(&entry.referrer) ? Qnil : rugged_create_oid(&entry.referrer));
+			continue;
+		}
+
+		if (visited[index / 8] & (1 << (index % 8)))
+			continue;
+
+		visited[index / 8] |= (1 << (index % 8));
+		reachable++;
+
+		if (++walked % RUGGED_FSCK_WALK_BATCH == 0)
+			fsck_progress(work, "connectivity", reachable, work->id_count);
+
+		if (entry.type == GIT_OBJ_BLOB)
+			continue;
+
+		if (git_object_lookup(&object, repo, &entry.id, GIT_OBJ_ANY) < 0) {
+			const git_error *err = giterr_last();
+			walk_report(rb_corrupt, &entry.id, "error", rb_str_new2(err ? err->message : "Failed to read the object"));
+			giterr_clear();
+			continue;
+		}
+
+		if (entry.type != GIT_OBJ_ANY && git_object_type(object) != entry.type) {
+			walk_report(rb_corrupt, &entry.id, "error",
+				rb_sprintf("Expected a %s, found a %s",
+					git_object_type2string(entry.type), git_object_type2string(git_object_type(object))));
+			git_object_free(object);
+			continue;
+		}
+
+		switch (git_object_type(object)) {
+		case GIT_OBJ_COMMIT: {
+			git_commit *commit = (git_commit *)object;
+			unsigned int p;
+
+			walk_push(stack, git_commit_tree_id(commit), GIT_OBJ_TREE, &entry.id);
+
+			for (p = 0; p < git_commit_parentcount(commit); ++p)
+				walk_push(stack, git_commit_parent_id(commit, p), GIT_OBJ_COMMIT, &entry.id);
+			break;
+		}
+
+		case GIT_OBJ_TREE: {
+			git_tree *tree = (git_tree *)object;
+			size_t e;
+
+			for (e = 0; e < git_tree_entrycount(tree); ++e) {
+				const git_tree_entry *tree_entry = git_tree_entry_byindex(tree, e);
+				git_otype type = git_tree_entry_type(tree_entry);
+
+				/* submodules point to commits of other repositories */
+				if (type == GIT_OBJ_TREE || type == GIT_OBJ_BLOB)
+					walk_push(stack, git_tree_entry_id(tree_entry), type, &entry.id);
+			}
+			break;
+		}
+
+		case GIT_OBJ_TAG:
+			walk_push(stack, git_tag_target_id((git_tag *)object),
+				git_tag_target_type((git_tag *)object), &entry.id);
+			break;
+
+		default:
+			break;
+		}
+
+		git_object_free(object);
+	}
+
+	git_odb_free(odb);
+
+	fsck_progress(work, "connectivity", reachable, work->id_count);
+	return reachable;
+}
+
+typedef struct {
+	fsck_work *work;
+	VALUE rb_options;
+	VALUE rb_result;
+	fsck_walk_stack stack;
+	unsigned char *visited;
+} fsck_data;
+
+static VALUE fsck_body(VALUE payload)
+{
+	fsck_data *data = (fsck_data *)payload;
+	fsck_work *work = data->work;
+	VALUE rb_options = data->rb_options, rb_result = data->rb_result;
+	VALUE rb_missing = rb_ary_new(), rb_corrupt = rb_ary_new(), rb_packs = rb_ary_new();
+	int ok = 1;
+	long i;
+
+	work->rb_ids = rugged_object_ids(work->rb_repo, GIT_OBJ_ANY);
+	work->id_count = RSTRING_LEN(work->rb_ids) / GIT_OID_RAWSZ;
+	rb_hash_aset(rb_result, CSTR2SYM("objects"), SIZET2NUM(work->id_count));
+
+	if (RTEST(rb_hash_lookup2(rb_options, CSTR2SYM("packs"), Qtrue)))
+		rb_packs = fsck_packs(work);
+
+	for (i = 0; i < RARRAY_LEN(rb_packs); ++i) {
+		VALUE rb_pack = rb_ary_entry(rb_packs, i);
+
+		ok = ok && RTEST(rb_hash_aref(rb_pack, CSTR2SYM("checksum"))) &&
+			RTEST(rb_hash_aref(rb_pack, CSTR2SYM("index_checksum"))) &&
+			RARRAY_LEN(rb_hash_aref(rb_pack, CSTR2SYM("bad_crcs"))) == 0 &&
+			NIL_P(rb_hash_aref(rb_pack, CSTR2SYM("error")));
+	}
+
+	rb_hash_aset(rb_result, CSTR2SYM("packs"), rb_packs);
+
+	if (RTEST(rb_hash_aref(rb_options, CSTR2SYM("verify_hashes"))))
+		rb_ary_concat(rb_corrupt, fsck_hashes(work));
+
+	if (RTEST(rb_hash_lookup2(rb_options, CSTR2SYM("connectivity"), Qtrue))) {
+		size_t reachable;
+
+		data->visited = xcalloc(work->id_count / 8 + 1, 1);
+		reachable = fsck_connectivity(work, &data->stack, data->visited, rb_missing, rb_corrupt);
+
+		rb_hash_aset(rb_result, CSTR2SYM("reachable"), SIZET2NUM(reachable));
+		rb_hash_aset(rb_result, CSTR2SYM("unreachable"), SIZET2NUM(work->id_count - reachable));
+	}
+
+	rb_hash_aset(rb_result, CSTR2SYM("missing"), rb_missing);
+	rb_hash_aset(rb_result, CSTR2SYM("corrupt"), rb_corrupt);
+	rb_hash_aset(rb_result, CSTR2SYM("ok"),
+		ok && RARRAY_LEN(rb_missing) == 0 && RARRAY_LEN(rb_corrupt) == 0 ? Qtrue : Qfalse);
+
+	return rb_result;
+}
+
+static VALUE fsck_cleanup(VALUE payload)
+{
+	fsck_data *data = (fsck_data *)payload;
+	fsck_work *work = data->work;
+	size_t i;
+
+	for (i = 0; i < work->pack_count; ++i) {
+		xfree(work->packs[i].path);
+		free(work->packs[i].bad_crcs.problems);
+	}
+
+	for (i = 0; i < work->slot_count; ++i) {
+		git_odb_free(work->slots[i].odb);
+		git_repository_free(work->slots[i].repo);
+		free(work->slots[i].corrupt.problems);
+	}
+
+	xfree(work->packs);
+	xfree(work->slots);
+	xfree(data->stack.entries);
+	xfree(data->visited);
+
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		repo.fsck(options = {}) -> hash
+ *		repo.fsck(options = {}) { |phase, done, total| block } -> hash
+ *
+ *	Verify the integrity of the repository, and of its alternates, in
+ *	process. Each check can be turned on or off in the +options+ Hash:
+ *
+ *	:packs ::
+ *	  Check the SHA-1 checksums of every packfile and pack index, and
+ *	  the CRC32 the index records for each packed object. Defaults to
+ *	  +true+.
+ *
+ *	:verify_hashes ::
+ *	  Read every object and check that its content hashes back to its
+ *	  ID. This inflates the whole object database and defaults to
+ *	  +false+.
+ *
+ *	:connectivity ::
+ *	  Walk all the objects reachable from the references and report the
+ *	  missing or unreadable ones. Defaults to +true+.
+ *
+ *	:threads ::
+ *	  How many threads verify packs and object hashes in parallel, without
+ *	  holding the GVL. Defaults to the number of CPUs, up to 16. Object
+ *	  hashes are verified on one thread when libgit2 was built without
+ *	  thread support.
+ *
+ *	When a block is given, it is called with the current phase
+ *	(+:packs+, +:hashes+ or +:connectivity+) and the progress made in
+ *	that phase, as two integers.
+ *
+ *	Returns a Hash with the following keys:
+ *
+ *	:ok ::
+ *	  +true+ when no problem at all was found.
+ *
+ *	:objects ::
+ *	  The number of objects in the repository.
+ *
+ *	:packs ::
+ *	  One Hash per packfile, with its +:path+, number of +:objects+,
+ *	  whether its +:checksum+ and +:index_checksum+ match, the
+ *	  +:bad_crcs+ of the entries that don't (as <tt>{:id, :error}</tt>
+ *	  Hashes) and any other +:error+ found reading it.
+ *
+ *	:missing ::
+ *	  The objects that are referenced but can't be found, as
+ *	  <tt>{:id, :referrer}</tt> Hashes; the referrer is +nil+ for
+ *	  objects pointed to by references.
+ *
+ *	:corrupt ::
+ *	  The objects that can't be read, or whose content doesn't match,
+ *	  as <tt>{:id, :error}</tt> Hashes.
+ *
+ *	:reachable, :unreachable ::
+ *	  How many objects can, or can't, be reached from the references.
+ *
+ *		report = repo.fsck(:verify_hashes => true) do |phase, done, total|
+ *		  puts "#{phase}: #{done}/#{total}"
+ *		end
+ *		report[:ok] #=> true
+ */
+static VALUE rb_git_repo_fsck(int argc, VALUE *argv, VALUE self)
+{
+	fsck_work work;
+	fsck_data data;
+	VALUE rb_options, rb_threads;
+
+	rb_scan_args(argc, argv, "01", &rb_options);
+
+	if (NIL_P(rb_options))
+		rb_options = rb_hash_new();
+
+	Check_Type(rb_options, T_HASH);
+
+	memset(&work, 0x0, sizeof(work));
+	memset(&data, 0x0, sizeof(data));
+
+	work.rb_repo = self;
+	work.progress = rb_block_given_p();
+	work.slot_count = rugged_pool_threads(RUGGED_FSCK_MAX_THREADS);
+
+	rb_threads = rb_hash_aref(rb_options, CSTR2SYM("threads"));
+	if (!NIL_P(rb_threads)) {
+		int threads = NUM2INT(rb_threads);
+		if (threads < 1)
+			rb_raise(rb_eArgError, "The number of threads must be positive");
+		work.slot_count = (size_t)threads;
+	}
+
+#ifdef RUGGED_THREADS
+	if (work.slot_count > RUGGED_FSCK_MAX_THREADS)
+		work.slot_count = RUGGED_FSCK_MAX_THREADS;
+#else
+	work.slot_count = 1;
+#endif
+
+	work.slots = xcalloc(work.slot_count, sizeof(fsck_slot));
+
+	data.work = &work;
+	data.rb_options = rb_options;
+	data.rb_result = rb_hash_new();
+
+	return rb_ensure(fsck_body, (VALUE)&data, fsck_cleanup, (VALUE)&data);
+}
+
+void Init_rugged_fsck()
+{
+	rb_define_method(rb_cRuggedRepo, "fsck", rb_git_repo_fsck, -1);
+}
@@ -242,6 +242,9 @@ static VALUE rb_git_indexentry_fromC(const git_index_entry *entry)
 	stage = (entry->flags & GIT_IDXENTRY_STAGEMASK) >> GIT_IDXENTRY_STAGESHIFT;
 	rb_hash_aset(rb_entry, CSTR2SYM("stage"), INT2FIX(stage));
 
+	rb_hash_aset(rb_entry, CSTR2SYM("skip_worktree"),
+		(entry->flags_extended & GIT_IDXENTRY_SKIP_WORKTREE) ? Qtrue : Qfalse);
+
 	rb_mtime = rb_time_new(entry->mtime.seconds, entry->mtime.nanoseconds / 1000);
 	rb_ctime = rb_time_new(entry->ctime.seconds, entry->ctime.nanoseconds / 1000);
 
@@ -323,6 +326,12 @@ static void rb_git_indexentry_toC(git_index_entry *entry, VALUE rb_entry)
 	} else {
 		entry->flags |= GIT_IDXENTRY_VALID;
 	}
+
+	val = rb_hash_aref(rb_entry, CSTR2SYM("skip_worktree"));
+	if (!NIL_P(val) && rugged_parse_bool(val)) {
+		entry->flags |= GIT_IDXENTRY_EXTENDED;
+		entry->flags_extended |= GIT_IDXENTRY_SKIP_WORKTREE;
+	}
 }
 
 static VALUE rb_git_index_writetree(int argc, VALUE *argv, VALUE self)
@@ -390,7 +399,8 @@ static VALUE rb_git_index_readtree(VALUE self, VALUE rb_tree)
  *
  *  :paths ::
  *    An array of paths / fnmatch patterns to constrain the diff to a specific
- *    set of files. Also see +:disable_pathspec_match+.
+ *    set of files, or a precompiled Rugged::Pathspec. Also see
+ *    +:disable_pathspec_match+.
  *
  *  :max_size ::
  *    An integer specifying the maximum byte size of a file before a it will
@@ -0,0 +1,506 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "rugged.h"
+
+extern VALUE rb_mRugged;
+extern VALUE rb_cRuggedBlob;
+
+#define RUGGED_MERGE_MARKER_LEN 7
+#define RUGGED_MERGE_BINARY_CHECK 8000
+
+typedef enum {
+	RUGGED_MERGE_FAVOR_NONE = 0,
+	RUGGED_MERGE_FAVOR_OURS,
+	RUGGED_MERGE_FAVOR_THEIRS,
+	RUGGED_MERGE_FAVOR_UNION,
+} rugged_merge_favor;
+
+typedef struct {
+	int diff3;
+	rugged_merge_favor favor;
+	const char *ancestor_label;
+	const char *our_label;
+	const char *their_label;
+} rugged_merge_opts;
+
+typedef struct {
+	const char *ptr;
+	size_t len;
+} rugged_merge_line;
+
+typedef struct {
+	const char *data;
+	size_t size;
+	rugged_merge_line *lines;
+	size_t count;
+} rugged_merge_text;
+
+/*
+ * A change from the ancestor to one of the sides: the ancestor lines
+ * in [a_begin, a_end) were replaced by (a_end - a_begin + delta) lines.
+ */
+typedef struct {
+	size_t a_begin, a_end;
+	long delta;
+} rugged_merge_hunk;
+
+typedef struct {
+	rugged_merge_hunk *hunks;
+	size_t count, alloc;
+} rugged_merge_hunks;
+
+static void merge_text_init(rugged_merge_text *text, const git_blob *blob)
+{
+	size_t i, start = 0;
+
+	memset(text, 0x0, sizeof(rugged_merge_text));
+
+	if (blob == NULL)
+		return;
+
+	text->data = git_blob_rawcontent(blob);
+	text->size = (size_t)git_blob_rawsize(blob);
+
+	for (i = 0; i < text->size; ++i) {
+		if (text->data[i] == '\n')
+			text->count++;
+	}
+
+	text->lines = xmalloc((text->count + 1) * sizeof(rugged_merge_line));
+	text->count = 0;
+
+	for (i = 0; i < text->size; ++i) {
+		if (text->data[i] == '\n' || i + 1 == text->size) {
+			text->lines[text->count].ptr = text->data + start;
+			text->lines[text->count].len = i + 1 - start;
+			text->count++;
+			start = i + 1;
+		}
+	}
+}
+
+static int merge_text_is_binary(const rugged_merge_text *text)
+{
+	size_t len = text->size < RUGGED_MERGE_BINARY_CHECK ?
+		text->size : RUGGED_MERGE_BINARY_CHECK;
+
+	return memchr(text->data, 0x0, len) != NULL;
+}
+
+static int merge_text_equal(const rugged_merge_text *a, const rugged_merge_text *b)
+{
+	return a->size == b->size && !memcmp(a->data, b->data, a->size);
+}
+
+static void merge_range(
+	const rugged_merge_text *text, size_t begin, size_t end,
+	const char **ptr, size_t *len)
+{
+	if (begin >= end) {
+		*ptr = NULL;
+		*len = 0;
+		return;
+	}
+
+	*ptr = text->lines[begin].ptr;
+	*len = (text->lines[end - 1].ptr + text->lines[end - 1].len) - *ptr;
+}
+
+static void merge_write_range(
+	VALUE rb_out, const rugged_merge_text *text, size_t begin, size_t end, int terminate)
+{
+	const char *ptr;
+	size_t len;
+
+	merge_range(text, begin, end, &ptr, &len);
+
+	if (len == 0)
+		return;
+
+	rb_str_cat(rb_out, ptr, len);
+
+	if (terminate && ptr[len - 1] != '\n')
+		rb_str_cat(rb_out, "\n", 1);
+}
+
+static void merge_write_marker(VALUE rb_out, char c, const char *label)
+{
+	char marker[RUGGED_MERGE_MARKER_LEN];
+
+	memset(marker, c, sizeof(marker));
+	rb_str_cat(rb_out, marker, sizeof(marker));
+
+	if (label) {
+		rb_str_cat(rb_out, " ", 1);
+		rb_str_cat2(rb_out, label);
+	}
+
+	rb_str_cat(rb_out, "\n", 1);
+}
+
+static int merge_hunk_cb(
+	const git_diff_delta *delta,
+	const git_diff_range *range,
+	const char *header,
+	size_t header_len,
+	void *payload)
+{
+	rugged_merge_hunks *hunks = (rugged_merge_hunks *)payload;
+	rugged_merge_hunk *hunk;
+
+	if (hunks->count == hunks->alloc) {
+		hunks->alloc = hunks->alloc ? hunks->alloc * 2 : 8;
+		hunks->hunks = xrealloc(hunks->hunks, hunks->alloc * sizeof(rugged_merge_hunk));
+	}
+
+	hunk = &hunks->hunks[hunks->count++];
+
+	/* Pure insertions are reported as starting at the line before them */
+	hunk->a_begin = range->old_lines ? range->old_start - 1 : range->old_start;
+	hunk->a_end = hunk->a_begin + range->old_lines;
+	hunk->delta = (long)range->new_lines - (long)range->old_lines;
+
+	return 0;
+}
+
+static int merge_diff_blobs(rugged_merge_hunks *hunks, const git_blob *old_blob, const git_blob *new_blob)
+{
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+
+	opts.context_lines = 0;
+	opts.interhunk_lines = 0;
+
+	/*
+	 * libgit2 reports no hunks at all for content it guesses is binary,
+	 * which would silently drop the changes; binary content (with NUL
+	 * bytes) has been ruled out already.
+	 */
+	opts.flags |= GIT_DIFF_FORCE_TEXT;
+
+	return git_diff_blobs(old_blob, new_blob, &opts, NULL, merge_hunk_cb, NULL, hunks);
+}
+
+/*
+ * Walk the changes of both sides in ancestor order. Changes that overlap
+ * (or touch) each other are grouped together; a group with changes from
+ * only one side is resolved by taking that side, and a group with changes
+ * from both sides is a conflict unless both made the same change.
+ */
+static int merge_texts(
+	VALUE rb_out,
+	const rugged_merge_text *ancestor,
+	const rugged_merge_text *ours,
+	const rugged_merge_text *theirs,
+	const rugged_merge_hunks *our_hunks,
+	const rugged_merge_hunks *their_hunks,
+	const rugged_merge_opts *opts)
+{
+	size_t pos = 0, i = 0, j = 0;
+	long our_offset = 0, their_offset = 0;
+	int conflicts = 0;
+
+	while (i < our_hunks->count || j < their_hunks->count) {
+		long our_before = our_offset, their_before = their_offset;
+		size_t begin, end, our_begin, our_end, their_begin, their_end;
+		const char *our_ptr, *their_ptr;
+		size_t our_len, their_len;
+		int has_ours = 0, has_theirs = 0;
+		const rugged_merge_hunk *hunk;
+
+		if (j == their_hunks->count ||
+			(i < our_hunks->count && our_hunks->hunks[i].a_begin <= their_hunks->hunks[j].a_begin))
+			begin = our_hunks->hunks[i].a_begin;
+		else
+			begin = their_hunks->hunks[j].a_begin;
+
+		end = begin;
+
+		for (;;) {
+			if (i < our_hunks->count && our_hunks->hunks[i].a_begin <= end) {
+				hunk = &our_hunks->hunks[i++];
+				our_offset += hunk->delta;
+				has_ours = 1;
+			} else if (j < their_hunks->count && their_hunks->hunks[j].a_begin <= end) {
+				hunk = &their_hunks->hunks[j++];
+				their_offset += hunk->delta;
+				has_theirs = 1;
+			} else {
+				break;
+			}
+
+			if (hunk->a_end > end)
+				end = hunk->a_end;
+		}
+
+		merge_write_range(rb_out, ancestor, pos, begin, 0);
+		pos = end;
+
+		our_begin = begin + our_before;
+		our_end = end + our_offset;
+		their_begin = begin + their_before;
+		their_end = end + their_offset;
+
+		if (!has_theirs) {
+			merge_write_range(rb_out, ours, our_begin, our_end, 0);
+			continue;
+		}
+
+		if (!has_ours) {
+			merge_write_range(rb_out, theirs, their_begin, their_end, 0);
+			continue;
+		}
+
+		merge_range(ours, our_begin, our_end, &our_ptr, &our_len);
+		merge_range(theirs, their_begin, their_end, &their_ptr, &their_len);
+
+		if (our_len == their_len && !memcmp(our_ptr, their_ptr, our_len)) {
+			merge_write_range(rb_out, ours, our_begin, our_end, 0);
+			continue;
+		}
+
+		switch (opts->favor) {
+		case RUGGED_MERGE_FAVOR_OURS:
+			merge_write_range(rb_out, ours, our_begin, our_end, 0);
+			break;
+
+		case RUGGED_MERGE_FAVOR_THEIRS:
+			merge_write_range(rb_out, theirs, their_begin, their_end, 0);
+			break;
+
+		case RUGGED_MERGE_FAVOR_UNION:
+			merge_write_range(rb_out, ours, our_begin, our_end, 1);
+			merge_write_range(rb_out, theirs, their_begin, their_end, 0);
+			break;
+
+		default:
+			merge_write_marker(rb_out, '<', opts->our_label);
+			merge_write_range(rb_out, ours, our_begin, our_end, 1);
+
+			if (opts->diff3) {
+				merge_write_marker(rb_out, '|', opts->ancestor_label);
+				merge_write_range(rb_out, ancestor, begin, end, 1);
+			}
+
+			merge_write_marker(rb_out, '=', NULL);
+			merge_write_range(rb_out, theirs, their_begin, their_end, 1);
+			merge_write_marker(rb_out, '>', opts->their_label);
+
+			conflicts++;
+		}
+	}
+
+	merge_write_range(rb_out, ancestor, pos, ancestor->count, 0);
+	return conflicts;
+}
+
+/*
+ * Binary files can't be merged line by line: unless one of the sides
+ * is unchanged, the result is a conflict and keeps "our" version.
+ */
+static int merge_binary(
+	VALUE rb_out,
+	const rugged_merge_text *ancestor,
+	const rugged_merge_text *ours,
+	const rugged_merge_text *theirs,
+	const rugged_merge_opts *opts)
+{
+	const rugged_merge_text *result = ours;
+	int conflicts = 0;
+
+	if (merge_text_equal(ancestor, ours))
+		result = theirs;
+	else if (!merge_text_equal(ancestor, theirs) && !merge_text_equal(ours, theirs)) {
+		if (opts->favor == RUGGED_MERGE_FAVOR_THEIRS)
+			result = theirs;
+		else if (opts->favor != RUGGED_MERGE_FAVOR_OURS)
+			conflicts = 1;
+	}
+
+	rb_str_cat(rb_out, result->data, result->size);
+	return conflicts;
+}
+
+static git_blob *merge_blob_get(VALUE rb_blob)
+{
+	git_blob *blob;
+
+	if (NIL_P(rb_blob))
+		return NULL;
+
+	if (!rb_obj_is_kind_of(rb_blob, rb_cRuggedBlob))
+		rb_raise(rb_eTypeError, "Expecting a Rugged::Blob instance");
+
+	Data_Get_Struct(rb_blob, git_blob, blob);
+	return blob;
+}
+
+static const char *merge_label_get(VALUE rb_options, const char *key)
+{
+	VALUE rb_label = rb_hash_aref(rb_options, CSTR2SYM(key));
+
+	if (NIL_P(rb_label))
+		return NULL;
+
+	Check_Type(rb_label, T_STRING);
+	return StringValueCStr(rb_label);
+}
+
+static void rugged_parse_merge_file_options(rugged_merge_opts *opts, VALUE rb_options)
+{
+	VALUE rb_value;
+
+	memset(opts, 0x0, sizeof(rugged_merge_opts));
+
+	if (NIL_P(rb_options))
+		return;
+
+	Check_Type(rb_options, T_HASH);
+
+	rb_value = rb_hash_aref(rb_options, CSTR2SYM("style"));
+	if (!NIL_P(rb_value)) {
+		ID id_style;
+
+		Check_Type(rb_value, T_SYMBOL);
+		id_style = SYM2ID(rb_value);
+
+		if (id_style == rb_intern("diff3"))
+			opts->diff3 = 1;
+		else if (id_style != rb_intern("merge"))
+			rb_raise(rb_eArgError, "Invalid style mode. Expected `:merge` or `:diff3`");
+	}
+
+	rb_value = rb_hash_aref(rb_options, CSTR2SYM("favor"));
+	if (!NIL_P(rb_value)) {
+		ID id_favor;
+
+		Check_Type(rb_value, T_SYMBOL);
+		id_favor = SYM2ID(rb_value);
+
+		if (id_favor == rb_intern("normal"))
+			opts->favor = RUGGED_MERGE_FAVOR_NONE;
+		else if (id_favor == rb_intern("ours"))
+			opts->favor = RUGGED_MERGE_FAVOR_OURS;
+		else if (id_favor == rb_intern("theirs"))
+			opts->favor = RUGGED_MERGE_FAVOR_THEIRS;
+		else if (id_favor == rb_intern("union"))
+			opts->favor = RUGGED_MERGE_FAVOR_UNION;
+		else
+			rb_raise(rb_eArgError,
+				"Invalid favor mode. Expected `:normal`, `:ours`, `:theirs` or `:union`");
+	}
+
+	opts->ancestor_label = merge_label_get(rb_options, "ancestor_label");
+	opts->our_label = merge_label_get(rb_options, "our_label");
+	opts->their_label = merge_label_get(rb_options, "their_label");
+}
+
+/*
+ *	call-seq:
+ *		Rugged.merge_files(ancestor, ours, theirs, options = {}) -> result
+ *
+ *	Perform a three-way merge of the contents of the blobs +ours+ and
+ *	+theirs+, using +ancestor+ as their common base, entirely in memory.
+ *	Any of the blobs may be +nil+ to stand for an empty (or missing) file.
+ *
+ *	Returns a +Hash+ with the following keys:
+ *
+ *	:content ::
+ *	  A +String+ with the merged contents. Conflicting regions are
+ *	  delimited by the usual conflict markers.
+ *
+ *	:conflicted ::
+ *	  +true+ if the merge had any conflicts, +false+ otherwise.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:style ::
+ *	  Either +:merge+ (the default), or +:diff3+ to also include the
+ *	  ancestor's version of each conflicting region.
+ *
+ *	:favor ::
+ *	  How to resolve conflicting regions: +:normal+ (the default) writes
+ *	  conflict markers, +:ours+ and +:theirs+ take one of the sides,
+ *	  and +:union+ takes both of them, one after the other.
+ *
+ *	:ancestor_label, :our_label, :their_label ::
+ *	  The labels written after the conflict markers for each of the
+ *	  sides (e.g. "HEAD" or a file name).
+ *
+ *		result = Rugged.merge_files(base, ours, theirs, :our_label => "HEAD")
+ *		result[:conflicted] #=> true
+ *		result[:content] #=> "<<<<<<< HEAD\n..."
+ */
+static VALUE rb_git_merge_files(int argc, VALUE *argv, VALUE self)
+{
+	VALUE rb_ancestor, rb_ours, rb_theirs, rb_options, rb_result, rb_out;
+	rugged_merge_hunks our_hunks = {0}, their_hunks = {0};
+	rugged_merge_text ancestor, ours, theirs;
+	git_blob *ancestor_blob, *our_blob, *their_blob;
+	rugged_merge_opts opts;
+	int error = 0, conflicts = 0;
+
+	rb_scan_args(argc, argv, "31", &rb_ancestor, &rb_ours, &rb_theirs, &rb_options);
+	rugged_parse_merge_file_options(&opts, rb_options);
+
+	ancestor_blob = merge_blob_get(rb_ancestor);
+	our_blob = merge_blob_get(rb_ours);
+	their_blob = merge_blob_get(rb_theirs);
+
+	merge_text_init(&ancestor, ancestor_blob);
+	merge_text_init(&ours, our_blob);
+	merge_text_init(&theirs, their_blob);
+
+	rb_out = rb_str_buf_new(ours.size > theirs.size ? ours.size : theirs.size);
+
+	if (merge_text_is_binary(&ancestor) ||
+		merge_text_is_binary(&ours) ||
+		merge_text_is_binary(&theirs)) {
+		conflicts = merge_binary(rb_out, &ancestor, &ours, &theirs, &opts);
+	} else if (!(error = merge_diff_blobs(&our_hunks, ancestor_blob, our_blob)) &&
+		!(error = merge_diff_blobs(&their_hunks, ancestor_blob, their_blob))) {
+		conflicts = merge_texts(rb_out,
+			&ancestor, &ours, &theirs, &our_hunks, &their_hunks, &opts);
+	}
+
+	xfree(ancestor.lines);
+	xfree(ours.lines);
+	xfree(theirs.lines);
+	xfree(our_hunks.hunks);
+	xfree(their_hunks.hunks);
+
+	rugged_exception_check(error);
+
+	rb_result = rb_hash_new();
+	rb_hash_aset(rb_result, CSTR2SYM("content"), rb_out);
+	rb_hash_aset(rb_result, CSTR2SYM("conflicted"), conflicts ? Qtrue : Qfalse);
+
+	return rb_result;
+}
+
+void Init_rugged_merge()
+{
+	rb_define_module_function(rb_mRugged, "merge_files", rb_git_merge_files, -1);
+}
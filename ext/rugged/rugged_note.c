@@ -108,6 +108,17 @@ static VALUE rb_git_note_lookup(int argc, VALUE *argv, VALUE self)
 	return rb_note_hash;
 }
 
+/* notes_ref is NULL when the default notes reference was written */
+static void note_ref_fsync(VALUE owner, git_repository *repo, const char *notes_ref)
+{
+	if (!notes_ref && git_note_default_ref(&notes_ref, repo) < 0) {
+		giterr_clear();
+		return;
+	}
+
+	rugged_ref_fsync(owner, notes_ref);
+}
+
 /*
  *	call-seq:
  *		obj.create_note(data = {}) -> oid
@@ -192,6 +203,7 @@ static VALUE rb_git_note_create(VALUE self, VALUE rb_data)
 	git_signature_free(committer);
 
 	rugged_exception_check(error);
+	note_ref_fsync(owner, repo, notes_ref);
 
 	return rugged_create_oid(&note_oid);
 }
@@ -267,6 +279,7 @@ static VALUE rb_git_note_remove(VALUE self, VALUE rb_data)
 		return Qfalse;
 
 	rugged_exception_check(error);
+	note_ref_fsync(owner, repo, notes_ref);
 
 	return Qtrue;
 }
@@ -0,0 +1,853 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "rugged.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+extern VALUE rb_cRuggedRepo;
+
+#define RUGGED_OBJECT_IDS_MAX_THREADS 16
+
+/* same limit as libgit2 */
+#define RUGGED_OBJECT_IDS_MAX_ALTERNATES_DEPTH 5
+
+/* pack entry types */
+#define PACK_OBJ_OFS_DELTA 6
+#define PACK_OBJ_REF_DELTA 7
+
+/* a delta whose base is not in the same pack; libgit2 finds its type */
+#define PACK_TYPE_UNRESOLVED 8
+
+#define PACK_NO_BASE UINT32_MAX
+
+/* pack entries read between two checks for an interrupt */
+#define PACK_INTERRUPT_CHECK 4096
+
+/*
+ * Raw object IDs, back to back. Everything below runs without the GVL,
+ * so buffers are allocated with malloc rather than xmalloc.
+ */
+typedef struct {
+	unsigned char *ids;
+	size_t count, alloc;
+} object_id_list;
+
+typedef struct {
+	char *path;
+	int is_pack;
+	object_id_list found;
+	object_id_list unresolved;
+	int error;
+	char error_message[256];
+} object_ids_job;
+
+typedef struct {
+	object_ids_job *jobs;
+	size_t job_count, job_alloc;
+	git_otype type;
+	VALUE rb_repo;
+	git_repository *repo;
+	git_odb *odb;
+} object_ids_work;
+
+typedef struct {
+	uint64_t offset;
+	uint32_t pos;
+} pack_entry;
+
+static int id_list_push(object_id_list *list, const unsigned char *id)
+{
+	if (list->count == list->alloc) {
+		size_t alloc = list->alloc ? list->alloc * 2 : 64;
+		unsigned char *ids = realloc(list->ids, alloc * GIT_OID_RAWSZ);
+
+		if (!ids)
+			return -1;
+
+		list->ids = ids;
+		list->alloc = alloc;
+	}
+
+	memcpy(list->ids + list->count++ * GIT_OID_RAWSZ, id, GIT_OID_RAWSZ);
+	return 0;
+}
+
+static int job_fail(object_ids_job *job, const char *message)
+{
+	snprintf(job->error_message, sizeof(job->error_message), "%s: '%s'", message, job->path);
+	job->error = -1;
+	return -1;
+}
+
+static int pack_entry_cmp(const void *a, const void *b)
+{
+	uint64_t left = ((const pack_entry *)a)->offset, right = ((const pack_entry *)b)->offset;
+	return left < right ? -1 : left > right;
+}
+
+static int raw_oid_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, GIT_OID_RAWSZ);
+}
+
+/* Map a whole file read-only, or return NULL */
+void *rugged_map_file(const char *path, size_t *size)
+{
+	struct stat st;
+	void *data;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	*size = (size_t)st.st_size;
+	return data;
+}
+
+int rugged_pack_index_parse(rugged_pack_index *idx)
+{
+	const unsigned char *data = idx->data;
+	size_t min_size;
+
+	if (idx->size >= 8 && !memcmp(data, "\377tOc", 4)) {
+		if (rugged_be32(data + 4) != 2)
+			return -1;
+
+		idx->version = 2;
+		idx->fanout = data + 8;
+	} else {
+		idx->version = 1;
+		idx->fanout = data;
+	}
+
+	if (idx->size < (size_t)(idx->fanout - data) + 256 * 4)
+		return -1;
+
+	idx->count = rugged_be32(idx->fanout + 255 * 4);
+
+	if (idx->version == 2) {
+		min_size = 8 + 256 * 4 + (size_t)idx->count * (GIT_OID_RAWSZ + 4 + 4) + 2 * GIT_OID_RAWSZ;
+		idx->names = idx->fanout + 256 * 4;
+		idx->crcs = idx->names + (size_t)idx->count * GIT_OID_RAWSZ;
+		idx->offsets = idx->crcs + (size_t)idx->count * 4;
+		idx->large_offsets = idx->offsets + (size_t)idx->count * 4;
+	} else {
+		min_size = 256 * 4 + (size_t)idx->count * (GIT_OID_RAWSZ + 4) + 2 * GIT_OID_RAWSZ;
+		idx->names = idx->fanout + 256 * 4 + 4;
+	}
+
+	return idx->size < min_size ? -1 : 0;
+}
+
+const unsigned char *rugged_pack_index_name(const rugged_pack_index *idx, uint32_t pos)
+{
+	return idx->names + (size_t)pos * (idx->version == 2 ? GIT_OID_RAWSZ : GIT_OID_RAWSZ + 4);
+}
+
+int rugged_pack_index_offset(uint64_t *out, const rugged_pack_index *idx, uint32_t pos)
+{
+	uint32_t offset;
+
+	if (idx->version == 1) {
+		*out = rugged_be32(idx->fanout + 256 * 4 + (size_t)pos * (GIT_OID_RAWSZ + 4));
+		return 0;
+	}
+
+	offset = rugged_be32(idx->offsets + (size_t)pos * 4);
+
+	if (offset & 0x80000000) {
+		const unsigned char *large = idx->large_offsets + (size_t)(offset & 0x7fffffff) * 8;
+
+		if (large + 8 > idx->data + idx->size - 2 * GIT_OID_RAWSZ)
+			return -1;
+
+		*out = ((uint64_t)rugged_be32(large) << 32) | rugged_be32(large + 4);
+		return 0;
+	}
+
+	*out = offset;
+	return 0;
+}
+
+static uint32_t pack_index_find(const rugged_pack_index *idx, const unsigned char *id)
+{
+	uint32_t lo = id[0] ? rugged_be32(idx->fanout + (id[0] - 1) * 4) : 0;
+	uint32_t hi = rugged_be32(idx->fanout + id[0] * 4);
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int cmp = memcmp(id, rugged_pack_index_name(idx, mid), GIT_OID_RAWSZ);
+
+		if (!cmp)
+			return mid;
+
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return PACK_NO_BASE;
+}
+
+/*
+ * Read the type of every entry from its header in the packfile. Deltas
+ * only link to their base here; the types are resolved by following
+ * those links, so no object is ever inflated.
+ */
+static int pack_read_types(rugged_pool *pool, object_ids_job *job, const rugged_pack_index *idx,
+	const unsigned char *pack, size_t pack_size, unsigned char *types, uint32_t *bases)
+{
+	pack_entry *entries;
+	uint32_t i;
+
+	if (pack_size < 12 + GIT_OID_RAWSZ || memcmp(pack, "PACK", 4))
+		return job_fail(job, "Invalid packfile");
+
+	entries = malloc(((size_t)idx->count + 1) * sizeof(pack_entry));
+	if (!entries)
+		return job_fail(job, "Out of memory");
+
+	for (i = 0; i < idx->count; ++i) {
+		entries[i].pos = i;
+		if (rugged_pack_index_offset(&entries[i].offset, idx, i) < 0) {
+			free(entries);
+			return job_fail(job, "Corrupted pack index");
+		}
+	}
+
+	qsort(entries, idx->count, sizeof(pack_entry), pack_entry_cmp);
+
+	for (i = 0; i < idx->count; ++i) {
+		uint64_t offset = entries[i].offset, limit = pack_size - GIT_OID_RAWSZ;
+		uint32_t pos = entries[i].pos;
+		unsigned char c;
+		int type;
+
+		if (i % PACK_INTERRUPT_CHECK == 0 && rugged_pool_interrupted(pool)) {
+			free(entries);
+			return RUGGED_POOL_RETRY;
+		}
+
+		if (offset < 12 || offset >= limit)
+			goto corrupted;
+
+		c = pack[offset++];
+		type = (c >> 4) & 7;
+
+		while (c & 0x80) {
+			if (offset >= limit)
+				goto corrupted;
+			c = pack[offset++];
+		}
+
+		bases[pos] = PACK_NO_BASE;
+
+		if (type >= GIT_OBJ_COMMIT && type <= GIT_OBJ_TAG) {
+			types[pos] = (unsigned char)type;
+		} else if (type == PACK_OBJ_OFS_DELTA) {
+			uint64_t distance;
+			pack_entry key, *base;
+
+			if (offset >= limit)
+				goto corrupted;
+
+			c = pack[offset++];
+			distance = c & 0x7f;
+
+			while (c & 0x80) {
+				if (offset >= limit)
+					goto corrupted;
+				c = pack[offset++];
+				distance = ((distance + 1) << 7) | (c & 0x7f);
+			}
+
+			if (distance > entries[i].offset)
+				goto corrupted;
+
+			key.offset = entries[i].offset - distance;
+			base = bsearch(&key, entries, idx->count, sizeof(pack_entry), pack_entry_cmp);
+
+			if (base)
+				bases[pos] = base->pos;
+		} else if (type == PACK_OBJ_REF_DELTA) {
+			if (offset + GIT_OID_RAWSZ > limit)
+				goto corrupted;
+
+			bases[pos] = pack_index_find(idx, pack + offset);
+		} else {
+			goto corrupted;
+		}
+	}
+
+	free(entries);
+
+	for (i = 0; i < idx->count; ++i) {
+		uint32_t pos = i, steps = 0;
+		unsigned char type;
+
+		while (!types[pos] && bases[pos] != PACK_NO_BASE && steps++ < idx->count)
+			pos = bases[pos];
+
+		type = types[pos] ? types[pos] : PACK_TYPE_UNRESOLVED;
+
+		for (pos = i; !types[pos]; pos = bases[pos]) {
+			types[pos] = type;
+			if (bases[pos] == PACK_NO_BASE)
+				break;
+		}
+	}
+
+	return 0;
+
+corrupted:
+	free(entries);
+	return job_fail(job, "Corrupted packfile");
+}
+
+static int scan_pack(rugged_pool *pool, object_ids_job *job, git_otype type)
+{
+	rugged_pack_index idx;
+	unsigned char *pack = NULL, *types = NULL;
+	uint32_t *bases = NULL, i;
+	size_t pack_size = 0, len = strlen(job->path);
+	char *pack_path;
+	int error = 0;
+
+	memset(&idx, 0x0, sizeof(idx));
+
+	if (!(idx.data = rugged_map_file(job->path, &idx.size)))
+		return job_fail(job, "Failed to read pack index");
+
+	if (rugged_pack_index_parse(&idx) < 0) {
+		error = job_fail(job, "Corrupted pack index");
+		goto cleanup;
+	}
+
+	if (type == GIT_OBJ_ANY) {
+		for (i = 0; !error && i < idx.count; ++i)
+			error = id_list_push(&job->found, rugged_pack_index_name(&idx, i));
+
+		if (error)
+			job_fail(job, "Out of memory");
+
+		goto cleanup;
+	}
+
+	/* "pack-<sha>.idx" => "pack-<sha>.pack" */
+	if (!(pack_path = malloc(len + 2))) {
+		error = job_fail(job, "Out of memory");
+		goto cleanup;
+	}
+
+	memcpy(pack_path, job->path, len - 3);
+	memcpy(pack_path + len - 3, "pack", 5);
+	pack = rugged_map_file(pack_path, &pack_size);
+	free(pack_path);
+
+	if (!pack) {
+		error = job_fail(job, "Failed to read the packfile of");
+		goto cleanup;
+	}
+
+	types = calloc((size_t)idx.count + 1, 1);
+	bases = malloc(((size_t)idx.count + 1) * sizeof(uint32_t));
+
+	if (!types || !bases) {
+		error = job_fail(job, "Out of memory");
+		goto cleanup;
+	}
+
+	if ((error = pack_read_types(pool, job, &idx, pack, pack_size, types, bases)) != 0)
+		goto cleanup;
+
+	for (i = 0; !error && i < idx.count; ++i) {
+		if (types[i] == PACK_TYPE_UNRESOLVED)
+			error = id_list_push(&job->unresolved, rugged_pack_index_name(&idx, i));
+		else if (types[i] == (unsigned char)type)
+			error = id_list_push(&job->found, rugged_pack_index_name(&idx, i));
+	}
+
+	if (error)
+		job_fail(job, "Out of memory");
+
+cleanup:
+	free(types);
+	free(bases);
+
+	if (pack)
+		munmap(pack, pack_size);
+
+	munmap((void *)idx.data, idx.size);
+	return error;
+}
+
+/*
+ * Inflate just the header of a loose object ("<type> <size>\0") to
+ * find its type.
+ */
+static git_otype loose_object_type(const char *path)
+{
+	unsigned char in[256];
+	char header[64];
+	z_stream zs;
+	git_otype type = GIT_OBJ_BAD;
+	ssize_t read_len;
+	int fd = open(path, O_RDONLY), status = Z_OK;
+
+	if (fd < 0)
+		return GIT_OBJ_BAD;
+
+	memset(&zs, 0x0, sizeof(zs));
+	if (inflateInit(&zs) != Z_OK) {
+		close(fd);
+		return GIT_OBJ_BAD;
+	}
+
+	zs.next_out = (unsigned char *)header;
+	zs.avail_out = sizeof(header) - 1;
+
+	while (status == Z_OK && zs.avail_out > 0 &&
+		!memchr(header, ' ', sizeof(header) - 1 - zs.avail_out)) {
+		if ((read_len = read(fd, in, sizeof(in))) <= 0)
+			break;
+
+		zs.next_in = in;
+		zs.avail_in = (uInt)read_len;
+		status = inflate(&zs, Z_SYNC_FLUSH);
+	}
+
+	header[sizeof(header) - 1 - zs.avail_out] = '\0';
+	inflateEnd(&zs);
+	close(fd);
+
+	if (!strncmp(header, "commit ", 7))
+		type = GIT_OBJ_COMMIT;
+	else if (!strncmp(header, "tree ", 5))
+		type = GIT_OBJ_TREE;
+	else if (!strncmp(header, "blob ", 5))
+		type = GIT_OBJ_BLOB;
+	else if (!strncmp(header, "tag ", 4))
+		type = GIT_OBJ_TAG;
+
+	return type;
+}
+
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+static int scan_loose(rugged_pool *pool, object_ids_job *job, git_otype type)
+{
+	/* job->path is "<objects>/xx/" */
+	size_t len = strlen(job->path);
+	const char *fanout = job->path + len - 3;
+	struct dirent *entry;
+	char *path;
+	DIR *dir;
+
+	if (!(dir = opendir(job->path)))
+		return 0;
+
+	if (!(path = malloc(len + GIT_OID_HEXSZ))) {
+		closedir(dir);
+		return job_fail(job, "Out of memory");
+	}
+
+	memcpy(path, job->path, len);
+
+	while ((entry = readdir(dir)) != NULL) {
+		unsigned char id[GIT_OID_RAWSZ];
+		const char *name = entry->d_name;
+		int i, valid = strlen(name) == GIT_OID_HEXSZ - 2;
+
+		if (rugged_pool_interrupted(pool)) {
+			free(path);
+			closedir(dir);
+			return RUGGED_POOL_RETRY;
+		}
+
+		for (i = 0; valid && i < GIT_OID_RAWSZ; ++i) {
+			int hi = hex_value(i ? name[i * 2 - 2] : fanout[0]);
+			int lo = hex_value(i ? name[i * 2 - 1] : fanout[1]);
+
+			valid = hi >= 0 && lo >= 0;
+			id[i] = (unsigned char)(hi << 4 | lo);
+		}
+
+		if (!valid)
+			continue;
+
+		if (type != GIT_OBJ_ANY) {
+			memcpy(path + len, name, GIT_OID_HEXSZ - 1);
+			if (loose_object_type(path) != type)
+				continue;
+		}
+
+		if (id_list_push(&job->found, id) < 0) {
+			job_fail(job, "Out of memory");
+			break;
+		}
+	}
+
+	free(path);
+	closedir(dir);
+	return job->error;
+}
+
+/*
+ * Scan one pack or loose fan-out directory. This runs without the GVL;
+ * errors are recorded in the job, so the other ones still run.
+ */
+static int object_ids_run_job(rugged_pool *pool, size_t worker, size_t i, void *payload)
+{
+	object_ids_work *work = payload;
+	object_ids_job *job = &work->jobs[i];
+	int error;
+
+	if (job->is_pack)
+		error = scan_pack(pool, job, work->type);
+	else
+		error = scan_loose(pool, job, work->type);
+
+	if (error == RUGGED_POOL_RETRY) {
+		job->found.count = 0;
+		job->unresolved.count = 0;
+		return error;
+	}
+
+	return 0;
+}
+
+static void object_ids_add_job(object_ids_work *work, const char *dir, const char *name, int is_pack)
+{
+	object_ids_job *job;
+	size_t dir_len = strlen(dir), name_len = strlen(name);
+
+	if (work->job_count == work->job_alloc) {
+		work->job_alloc = work->job_alloc ? work->job_alloc * 2 : 512;
+		REALLOC_N(work->jobs, object_ids_job, work->job_alloc);
+	}
+
+	job = &work->jobs[work->job_count++];
+	memset(job, 0x0, sizeof(object_ids_job));
+	job->is_pack = is_pack;
+	job->path = xmalloc(dir_len + name_len + 1);
+	memcpy(job->path, dir, dir_len);
+	memcpy(job->path + dir_len, name, name_len + 1);
+}
+
+static void collect_objects_dirs(VALUE rb_dirs, VALUE rb_dir, int depth)
+{
+	VALUE rb_path;
+	FILE *alternates;
+
+	if (depth > RUGGED_OBJECT_IDS_MAX_ALTERNATES_DEPTH || RTEST(rb_ary_includes(rb_dirs, rb_dir)))
+		return;
+
+	rb_ary_push(rb_dirs, rb_dir);
+
+	rb_path = rb_str_plus(rb_dir, rb_str_new2("info/alternates"));
+
+	if ((alternates = fopen(StringValueCStr(rb_path), "r")) != NULL) {
+		char line[4096];
+
+		while (fgets(line, sizeof(line), alternates)) {
+			VALUE rb_alternate;
+			size_t len = strcspn(line, "\r\n");
+
+			line[len] = '\0';
+			if (!len || line[0] == '#')
+				continue;
+
+			rb_alternate = line[0] == '/' ?
+				rb_str_new2(line) :
+				rb_str_plus(rb_dir, rb_str_new2(line));
+
+			if (line[len - 1] != '/')
+				rb_str_cat2(rb_alternate, "/");
+
+			collect_objects_dirs(rb_dirs, rb_alternate, depth + 1);
+		}
+
+		fclose(alternates);
+	}
+}
+
+/*
+ * Return the objects directory of `rb_repo` and those of its
+ * alternates, listed in `objects/info/alternates` files or given to
+ * Repository.new, each with a trailing slash.
+ */
+VALUE rugged_object_dirs(VALUE rb_repo)
+{
+	git_repository *repo;
+	VALUE rb_dirs = rb_ary_new(), rb_alternates;
+	long i;
+
+	Data_Get_Struct(rb_repo, git_repository, repo);
+
+	collect_objects_dirs(rb_dirs,
+		rb_str_plus(rb_str_new2(git_repository_path(repo)), rb_str_new2("objects/")), 0);
+
+	rb_alternates = rb_attr_get(rb_repo, rb_intern("alternates"));
+
+	for (i = 0; !NIL_P(rb_alternates) && i < RARRAY_LEN(rb_alternates); ++i) {
+		VALUE rb_alternate = rb_str_dup(rb_ary_entry(rb_alternates, i));
+
+		if (RSTRING_LEN(rb_alternate) && RSTRING_PTR(rb_alternate)[RSTRING_LEN(rb_alternate) - 1] != '/')
+			rb_str_cat2(rb_alternate, "/");
+
+		collect_objects_dirs(rb_dirs, rb_alternate, 0);
+	}
+
+	return rb_dirs;
+}
+
+/* Queue one job per pack and per loose fan-out directory of `objects_dir` */
+static void object_ids_add_objects_dir(object_ids_work *work, const char *objects_dir)
+{
+	VALUE rb_dir = rb_str_plus(rb_str_new2(objects_dir), rb_str_new2("pack/"));
+	struct dirent *entry;
+	char name[8];
+	DIR *dir;
+	int i;
+
+	for (i = 0; i < 256; ++i) {
+		snprintf(name, sizeof(name), "%02x/", i);
+		object_ids_add_job(work, objects_dir, name, 0);
+	}
+
+	if ((dir = opendir(StringValueCStr(rb_dir))) != NULL) {
+		while ((entry = readdir(dir)) != NULL) {
+			size_t len = strlen(entry->d_name);
+
+			if (len > 4 && !strcmp(entry->d_name + len - 4, ".idx"))
+				object_ids_add_job(work, StringValueCStr(rb_dir), entry->d_name, 1);
+		}
+
+		closedir(dir);
+	}
+}
+
+static VALUE object_ids_cleanup(VALUE payload)
+{
+	object_ids_work *work = (object_ids_work *)payload;
+	size_t i;
+
+	git_odb_free(work->odb);
+
+	for (i = 0; i < work->job_count; ++i) {
+		xfree(work->jobs[i].path);
+		free(work->jobs[i].found.ids);
+		free(work->jobs[i].unresolved.ids);
+	}
+
+	xfree(work->jobs);
+
+	return Qnil;
+}
+
+static VALUE object_ids_body(VALUE payload)
+{
+	object_ids_work *work = (object_ids_work *)payload;
+	VALUE rb_dirs, rb_result;
+	size_t i, total = 0, count = 0;
+	unsigned char *ids;
+	int error = 0;
+
+	rb_dirs = rugged_object_dirs(work->rb_repo);
+
+	for (i = 0; i < (size_t)RARRAY_LEN(rb_dirs); ++i) {
+		VALUE rb_dir = rb_ary_entry(rb_dirs, i);
+		object_ids_add_objects_dir(work, StringValueCStr(rb_dir));
+	}
+
+	/* nothing in the jobs needs libgit2, so they never need the GVL, even on one thread */
+	rugged_pool_run(rugged_pool_threads(RUGGED_OBJECT_IDS_MAX_THREADS), work->job_count,
+		object_ids_run_job, NULL, work);
+
+	for (i = 0; i < work->job_count; ++i) {
+		if (work->jobs[i].error) {
+			giterr_set_str(GITERR_ODB, work->jobs[i].error_message);
+			rugged_exception_check(-1);
+		}
+
+		total += work->jobs[i].found.count + work->jobs[i].unresolved.count;
+	}
+
+	rb_result = rb_str_buf_new(total * GIT_OID_RAWSZ);
+	ids = (unsigned char *)RSTRING_PTR(rb_result);
+
+	for (i = 0; i < work->job_count; ++i) {
+		object_ids_job *job = &work->jobs[i];
+		size_t j;
+
+		memcpy(ids + count * GIT_OID_RAWSZ, job->found.ids, job->found.count * GIT_OID_RAWSZ);
+		count += job->found.count;
+
+		/* deltas against objects of other packs, which can't be resolved locally */
+		for (j = 0; j < job->unresolved.count; ++j) {
+			git_oid oid;
+			git_otype unresolved_type;
+			size_t len;
+
+			if (!work->odb && (error = git_repository_odb(&work->odb, work->repo)) < 0)
+				break;
+
+			git_oid_fromraw(&oid, job->unresolved.ids + j * GIT_OID_RAWSZ);
+
+			if ((error = git_odb_read_header(&len, &unresolved_type, work->odb, &oid)) < 0)
+				break;
+
+			if (unresolved_type == work->type)
+				memcpy(ids + count++ * GIT_OID_RAWSZ, oid.id, GIT_OID_RAWSZ);
+		}
+
+		if (error)
+			break;
+	}
+
+	rugged_exception_check(error);
+
+	qsort(ids, count, GIT_OID_RAWSZ, raw_oid_cmp);
+
+	for (i = 0, total = 0; i < count; ++i) {
+		if (total && !memcmp(ids + (total - 1) * GIT_OID_RAWSZ, ids + i * GIT_OID_RAWSZ, GIT_OID_RAWSZ))
+			continue;
+
+		memmove(ids + total++ * GIT_OID_RAWSZ, ids + i * GIT_OID_RAWSZ, GIT_OID_RAWSZ);
+	}
+
+	rb_str_set_len(rb_result, total * GIT_OID_RAWSZ);
+	return rb_result;
+}
+
+/*
+ * Return the raw IDs of all the objects of type `type` (or of any type,
+ * for GIT_OBJ_ANY) in the repository and its alternates, sorted and
+ * without duplicates, packed in a binary String.
+ */
+VALUE rugged_object_ids(VALUE rb_repo, git_otype type)
+{
+	object_ids_work work;
+
+	memset(&work, 0x0, sizeof(work));
+	work.type = type;
+	work.rb_repo = rb_repo;
+	Data_Get_Struct(rb_repo, git_repository, work.repo);
+
+	return rb_ensure(object_ids_body, (VALUE)&work, object_ids_cleanup, (VALUE)&work);
+}
+
+/*
+ *	call-seq:
+ *		repo.ids(options = {}) -> array or string
+ *
+ *	Return the IDs of all the objects in +repo+ and its alternates,
+ *	sorted and each listed once, as 40-character strings.
+ *
+ *	The packfiles and loose object directories are scanned directly, in
+ *	parallel on several threads when the platform supports it. Object
+ *	types are read from the pack entry headers, following delta chains
+ *	through the pack index, so packed objects are never inflated; only
+ *	the first bytes of loose objects are.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:type ::
+ *	  Only return the IDs of objects of this type (+:commit+, +:tree+,
+ *	  +:blob+ or +:tag+).
+ *
+ *	:packed ::
+ *	  When +true+, return a single binary String with the 20-byte raw
+ *	  IDs back to back instead, which is much cheaper for millions of
+ *	  objects.
+ *
+ *		repo.ids(:type => :commit)
+ *		#=> ["36060c58702ed4c2a40832c51758d5344201d89a", ...]
+ *
+ *		repo.ids(:type => :tag, :packed => true).bytesize / 20 #=> 4
+ */
+static VALUE rb_git_repo_ids(int argc, VALUE *argv, VALUE self)
+{
+	VALUE rb_options, rb_ids, rb_result;
+	git_otype type = GIT_OBJ_ANY;
+	int packed = 0;
+	long i, count;
+
+	rb_scan_args(argc, argv, "01", &rb_options);
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+		type = rugged_otype_get(rb_hash_aref(rb_options, CSTR2SYM("type")));
+		packed = RTEST(rb_hash_aref(rb_options, CSTR2SYM("packed")));
+	}
+
+	rb_ids = rugged_object_ids(self, type);
+
+	if (packed)
+		return rb_ids;
+
+	count = RSTRING_LEN(rb_ids) / GIT_OID_RAWSZ;
+	rb_result = rb_ary_new2(count);
+
+	for (i = 0; i < count; ++i) {
+		git_oid oid;
+		git_oid_fromraw(&oid, (const unsigned char *)RSTRING_PTR(rb_ids) + i * GIT_OID_RAWSZ);
+		rb_ary_push(rb_result, rugged_create_oid(&oid));
+	}
+
+	return rb_result;
+}
+
+void Init_rugged_object_ids()
+{
+	rb_define_method(rb_cRuggedRepo, "ids", rb_git_repo_ids, -1);
+}
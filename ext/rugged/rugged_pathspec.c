@@ -0,0 +1,648 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "rugged.h"
+#include <fnmatch.h>
+
+extern VALUE rb_mRugged;
+extern VALUE rb_cRuggedTree;
+VALUE rb_cRuggedPathspec;
+
+/* how a trie node terminates a pattern */
+#define PATHSPEC_LITERAL 1 /* the path itself, or anything below it */
+#define PATHSPEC_DIR     2 /* anything below it ("dir/") */
+#define PATHSPEC_PREFIX  4 /* any path starting with it ("foo*") */
+
+typedef struct pathspec_node {
+	unsigned char byte;
+	unsigned char flags;
+	struct pathspec_node *child;
+	struct pathspec_node *sibling;
+} pathspec_node;
+
+typedef struct {
+	git_strarray patterns;
+	pathspec_node root;
+	const char **globs;
+	size_t *glob_literal_len;
+	size_t glob_count;
+} rugged_pathspec;
+
+static int pathspec_is_glob_char(char c)
+{
+	return c == '*' || c == '?' || c == '[' || c == '\\';
+}
+
+static pathspec_node *pathspec_node_child(pathspec_node *node, unsigned char byte, int create)
+{
+	pathspec_node *child;
+
+	for (child = node->child; child; child = child->sibling) {
+		if (child->byte == byte)
+			return child;
+	}
+
+	if (!create)
+		return NULL;
+
+	child = xcalloc(1, sizeof(pathspec_node));
+	child->byte = byte;
+	child->sibling = node->child;
+	node->child = child;
+
+	return child;
+}
+
+static void pathspec_node_free(pathspec_node *node)
+{
+	pathspec_node *child = node->child, *next;
+
+	while (child) {
+		next = child->sibling;
+		pathspec_node_free(child);
+		xfree(child);
+		child = next;
+	}
+}
+
+static void rb_git_pathspec__free(rugged_pathspec *ps)
+{
+	size_t i;
+
+	for (i = 0; i < ps->patterns.count; ++i)
+		xfree(ps->patterns.strings[i]);
+
+	xfree(ps->patterns.strings);
+	xfree(ps->globs);
+	xfree(ps->glob_literal_len);
+	pathspec_node_free(&ps->root);
+	xfree(ps);
+}
+
+/*
+ * Classify a pattern and add it to the trie, or to the glob list when
+ * it needs fnmatch. A leading "./" is dropped, and an empty pattern or
+ * "." selects everything.
+ */
+static void pathspec_add(rugged_pathspec *ps, const char *pattern)
+{
+	size_t len, i, glob_at;
+	unsigned char flag = PATHSPEC_LITERAL;
+	pathspec_node *node = &ps->root;
+
+	while (pattern[0] == '.' && pattern[1] == '/')
+		pattern += 2;
+
+	if (pattern[0] == '.' && pattern[1] == '\0')
+		pattern++;
+
+	len = strlen(pattern);
+
+	for (glob_at = 0; glob_at < len; ++glob_at) {
+		if (pathspec_is_glob_char(pattern[glob_at]))
+			break;
+	}
+
+	if (glob_at < len) {
+		if (glob_at == len - 1 && pattern[glob_at] == '*') {
+			flag = PATHSPEC_PREFIX;
+			len--;
+		} else {
+			ps->globs[ps->glob_count] = pattern;
+			ps->glob_literal_len[ps->glob_count] = glob_at;
+			ps->glob_count++;
+			return;
+		}
+	} else if (len > 0 && pattern[len - 1] == '/') {
+		flag = PATHSPEC_DIR;
+		while (len > 0 && pattern[len - 1] == '/')
+			len--;
+	}
+
+	if (len == 0)
+		flag = PATHSPEC_PREFIX;
+
+	for (i = 0; i < len; ++i)
+		node = pathspec_node_child(node, (unsigned char)pattern[i], 1);
+
+	node->flags |= flag;
+}
+
+static int pathspec_node_matches(const pathspec_node *node, const char *rest)
+{
+	if (node->flags & PATHSPEC_PREFIX)
+		return 1;
+
+	if ((node->flags & PATHSPEC_LITERAL) && (*rest == '\0' || *rest == '/'))
+		return 1;
+
+	if ((node->flags & PATHSPEC_DIR) && *rest == '/')
+		return 1;
+
+	return 0;
+}
+
+/*
+ * Check a single path against the compiled patterns: one pass down the
+ * trie for literal and prefix patterns, then fnmatch for actual globs.
+ */
+static int pathspec_match(rugged_pathspec *ps, const char *path)
+{
+	pathspec_node *node = &ps->root;
+	const char *p = path;
+	size_t i;
+
+	if (ps->patterns.count == 0)
+		return 1;
+
+	for (;;) {
+		if (pathspec_node_matches(node, p))
+			return 1;
+
+		if (*p == '\0' || !(node = pathspec_node_child(node, (unsigned char)*p, 0)))
+			break;
+
+		p++;
+	}
+
+	for (i = 0; i < ps->glob_count; ++i) {
+		if (fnmatch(ps->globs[i], path, 0) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Decide whether a directory has to be looked into: PATHSPEC_DIR_ALL
+ * if everything below it matches, PATHSPEC_DIR_SOME if some of it may,
+ * and PATHSPEC_DIR_NONE if no pattern can match anything below it.
+ */
+static int pathspec_match_dir(rugged_pathspec *ps, const char *dir, size_t dir_len)
+{
+	pathspec_node *node = &ps->root;
+	size_t i, glob;
+
+	if (ps->patterns.count == 0)
+		return PATHSPEC_DIR_ALL;
+
+	/* walk "dir/" down the trie */
+	for (i = 0; node; ++i) {
+		char c = i < dir_len ? dir[i] : '/';
+
+		if ((node->flags & PATHSPEC_PREFIX) ||
+			((node->flags & (PATHSPEC_LITERAL | PATHSPEC_DIR)) && c == '/'))
+			return PATHSPEC_DIR_ALL;
+
+		if (i > dir_len)
+			return PATHSPEC_DIR_SOME;
+
+		node = pathspec_node_child(node, (unsigned char)c, 0);
+	}
+
+	for (glob = 0; glob < ps->glob_count; ++glob) {
+		size_t literal_len = ps->glob_literal_len[glob];
+		size_t cmp_len = literal_len < dir_len + 1 ? literal_len : dir_len + 1;
+		const char *pattern = ps->globs[glob];
+
+		for (i = 0; i < cmp_len; ++i) {
+			if (pattern[i] != (i < dir_len ? dir[i] : '/'))
+				break;
+		}
+
+		if (i == cmp_len)
+			return PATHSPEC_DIR_SOME;
+	}
+
+	return PATHSPEC_DIR_NONE;
+}
+
+static rugged_pathspec *rugged_pathspec_get(VALUE rb_pathspec)
+{
+	rugged_pathspec *ps;
+
+	if (!rb_obj_is_kind_of(rb_pathspec, rb_cRuggedPathspec))
+		rb_raise(rb_eTypeError, "Expecting a Rugged::Pathspec instance");
+
+	Data_Get_Struct(rb_pathspec, rugged_pathspec, ps);
+	return ps;
+}
+
+/*
+ * Fill a strarray with the patterns of a pathspec, for the libgit2
+ * APIs that take one. As with the :paths Array, only the array of
+ * pointers is allocated and must be released with xfree.
+ */
+void rugged_pathspec_strarray(git_strarray *out, VALUE rb_pathspec)
+{
+	rugged_pathspec *ps = rugged_pathspec_get(rb_pathspec);
+
+	out->count = ps->patterns.count;
+	out->strings = xmalloc((out->count + 1) * sizeof(char *));
+	memcpy(out->strings, ps->patterns.strings, out->count * sizeof(char *));
+}
+
+typedef struct {
+	rugged_pathspec *ps;
+	git_repository *repo;
+	char *path;
+	size_t path_len, path_alloc;
+} pathspec_walk;
+
+static void pathspec_walk_push(pathspec_walk *walk, const char *name)
+{
+	size_t name_len = strlen(name);
+	size_t needed = walk->path_len + name_len + 2;
+
+	if (needed > walk->path_alloc) {
+		walk->path_alloc = needed * 2;
+		walk->path = xrealloc(walk->path, walk->path_alloc);
+	}
+
+	if (walk->path_len)
+		walk->path[walk->path_len++] = '/';
+
+	memcpy(walk->path + walk->path_len, name, name_len + 1);
+	walk->path_len += name_len;
+}
+
+static void pathspec_walk_pop(pathspec_walk *walk, size_t path_len)
+{
+	walk->path_len = path_len;
+	walk->path[path_len] = '\0';
+}
+
+static int pathspec_match_tree(pathspec_walk *walk, git_tree *tree, int all, VALUE rb_result)
+{
+	size_t i, count = git_tree_entrycount(tree);
+	int error = 0;
+
+	for (i = 0; i < count && !error; ++i) {
+		const git_tree_entry *entry = git_tree_entry_byindex(tree, i);
+		size_t path_len = walk->path_len;
+
+		pathspec_walk_push(walk, git_tree_entry_name(entry));
+
+		if (git_tree_entry_type(entry) == GIT_OBJ_TREE) {
+			int dir_match = all ? PATHSPEC_DIR_ALL :
+				pathspec_match_dir(walk->ps, walk->path, walk->path_len);
+
+			if (dir_match != PATHSPEC_DIR_NONE) {
+				git_tree *subtree;
+
+				error = git_tree_lookup(&subtree, walk->repo, git_tree_entry_id(entry));
+				if (!error) {
+					error = pathspec_match_tree(walk, subtree,
+						dir_match == PATHSPEC_DIR_ALL, rb_result);
+					git_tree_free(subtree);
+				}
+			}
+		} else if (all || pathspec_match(walk->ps, walk->path)) {
+			rb_ary_push(rb_result, rugged_str_new(walk->path, walk->path_len, NULL));
+		}
+
+		pathspec_walk_pop(walk, path_len);
+	}
+
+	return error;
+}
+
+static int pathspec_tree_differs(pathspec_walk *walk,
+	const git_oid *old_id, const git_oid *new_id, int all, int *differs);
+
+static int pathspec_entry_differs(pathspec_walk *walk,
+	const git_tree_entry *old_entry, const git_tree_entry *new_entry, int all, int *differs)
+{
+	const git_tree_entry *entry = old_entry ? old_entry : new_entry;
+	size_t path_len = walk->path_len;
+	int error = 0;
+
+	pathspec_walk_push(walk, git_tree_entry_name(entry));
+
+	if (git_tree_entry_type(entry) == GIT_OBJ_TREE) {
+		int dir_match = all ? PATHSPEC_DIR_ALL :
+			pathspec_match_dir(walk->ps, walk->path, walk->path_len);
+
+		if (dir_match != PATHSPEC_DIR_NONE)
+			error = pathspec_tree_differs(walk,
+				old_entry ? git_tree_entry_id(old_entry) : NULL,
+				new_entry ? git_tree_entry_id(new_entry) : NULL,
+				dir_match == PATHSPEC_DIR_ALL, differs);
+	} else if (all || pathspec_match(walk->ps, walk->path)) {
+		*differs = 1;
+	}
+
+	pathspec_walk_pop(walk, path_len);
+	return error;
+}
+
+/*
+ * Merge-walk two trees (either may be NULL) and stop as soon as a path
+ * selected by the pathspec is found to differ between them.
+ */
+static int pathspec_tree_differs(pathspec_walk *walk,
+	const git_oid *old_id, const git_oid *new_id, int all, int *differs)
+{
+	git_tree *old_tree = NULL, *new_tree = NULL;
+	size_t old_count = 0, new_count = 0, i = 0, j = 0;
+	int error = 0;
+
+	if (old_id && new_id && git_oid_cmp(old_id, new_id) == 0)
+		return 0;
+
+	if (old_id) {
+		if ((error = git_tree_lookup(&old_tree, walk->repo, old_id)) < 0)
+			goto cleanup;
+		old_count = git_tree_entrycount(old_tree);
+	}
+
+	if (new_id) {
+		if ((error = git_tree_lookup(&new_tree, walk->repo, new_id)) < 0)
+			goto cleanup;
+		new_count = git_tree_entrycount(new_tree);
+	}
+
+	while (!error && !*differs && (i < old_count || j < new_count)) {
+		const git_tree_entry *old_entry = i < old_count ? git_tree_entry_byindex(old_tree, i) : NULL;
+		const git_tree_entry *new_entry = j < new_count ? git_tree_entry_byindex(new_tree, j) : NULL;
+		int cmp;
+
+		if (!old_entry)
+			cmp = 1;
+		else if (!new_entry)
+			cmp = -1;
+		else
+			cmp = rugged_tree_entry_cmp(old_entry, new_entry);
+
+		if (cmp < 0) {
+			error = pathspec_entry_differs(walk, old_entry, NULL, all, differs);
+			i++;
+		} else if (cmp > 0) {
+			error = pathspec_entry_differs(walk, NULL, new_entry, all, differs);
+			j++;
+		} else {
+			if (git_oid_cmp(git_tree_entry_id(old_entry), git_tree_entry_id(new_entry)) != 0 ||
+				git_tree_entry_filemode(old_entry) != git_tree_entry_filemode(new_entry))
+				error = pathspec_entry_differs(walk, old_entry, new_entry, all, differs);
+			i++;
+			j++;
+		}
+	}
+
+cleanup:
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+	return error;
+}
+
+/*
+ * Decide whether the walker should show +commit+ for this pathspec: that
+ * is, whether it changes a selected path with respect to every one of its
+ * parents (or, for a root commit, whether it contains any selected path).
+ * This is the same history simplification `git log -- <paths>` does.
+ */
+int rugged_pathspec_commit_touches(int *touches, VALUE rb_pathspec, git_commit *commit)
+{
+	pathspec_walk walk;
+	unsigned int i, parents = git_commit_parentcount(commit);
+	int error = 0;
+
+	memset(&walk, 0x0, sizeof(walk));
+	walk.ps = rugged_pathspec_get(rb_pathspec);
+	walk.repo = git_object_owner((git_object *)commit);
+	walk.path_alloc = 256;
+	walk.path = xmalloc(walk.path_alloc);
+	walk.path[0] = '\0';
+
+	if (parents == 0) {
+		int differs = 0;
+
+		error = pathspec_tree_differs(&walk,
+			NULL, git_commit_tree_id(commit), 0, &differs);
+		*touches = differs;
+	} else {
+		*touches = 1;
+	}
+
+	for (i = 0; i < parents && !error && *touches; ++i) {
+		git_commit *parent;
+		int differs = 0;
+
+		if ((error = git_commit_parent(&parent, commit, i)) < 0)
+			break;
+
+		error = pathspec_tree_differs(&walk,
+			git_commit_tree_id(parent), git_commit_tree_id(commit), 0, &differs);
+		git_commit_free(parent);
+
+		*touches = differs;
+	}
+
+	xfree(walk.path);
+	return error;
+}
+
+/*
+ *	call-seq:
+ *		Pathspec.new(patterns) -> pathspec
+ *
+ *	Compile +patterns+ (a +String+ or an +Array+ of them) into a pathspec
+ *	that can be matched against many paths, or passed as the +:paths+
+ *	option of Rugged::Tree#diff and Rugged::Index#diff, to
+ *	Rugged::Repository#status and to Rugged::Walker#pathspec=, without
+ *	being parsed again every time.
+ *
+ *	Patterns follow git's pathspec rules: a plain path selects that file
+ *	or everything below that directory, a trailing "/" only selects
+ *	directories, and patterns with glob characters are matched with
+ *	fnmatch, where "*" also matches "/". An empty list of patterns
+ *	matches every path.
+ *
+ *	Literal patterns and patterns whose only glob is a trailing "*" are
+ *	looked up in a prefix trie, so matching a path costs one pass over
+ *	it no matter how many of them there are.
+ *
+ *		pathspec = Rugged::Pathspec.new(["lib/", "*.gemspec"])
+ *		pathspec.match_path("lib/rugged.rb") #=> true
+ */
+static VALUE rb_git_pathspec_new(VALUE klass, VALUE rb_patterns)
+{
+	rugged_pathspec *ps;
+	VALUE rb_pathspec;
+	long i;
+
+	if (TYPE(rb_patterns) == T_STRING)
+		rb_patterns = rb_ary_new3(1, rb_patterns);
+
+	Check_Type(rb_patterns, T_ARRAY);
+
+	for (i = 0; i < RARRAY_LEN(rb_patterns); ++i)
+		Check_Type(rb_ary_entry(rb_patterns, i), T_STRING);
+
+	ps = xcalloc(1, sizeof(rugged_pathspec));
+	rb_pathspec = Data_Wrap_Struct(klass, NULL, rb_git_pathspec__free, ps);
+
+	ps->patterns.strings = xcalloc(RARRAY_LEN(rb_patterns) + 1, sizeof(char *));
+	ps->globs = xcalloc(RARRAY_LEN(rb_patterns) + 1, sizeof(char *));
+	ps->glob_literal_len = xcalloc(RARRAY_LEN(rb_patterns) + 1, sizeof(size_t));
+
+	for (i = 0; i < RARRAY_LEN(rb_patterns); ++i) {
+		VALUE rb_pattern = rb_ary_entry(rb_patterns, i);
+		const char *pattern = StringValueCStr(rb_pattern);
+		char *copy = xmalloc(RSTRING_LEN(rb_pattern) + 1);
+
+		memcpy(copy, pattern, RSTRING_LEN(rb_pattern) + 1);
+		ps->patterns.strings[ps->patterns.count++] = copy;
+
+		pathspec_add(ps, copy);
+	}
+
+	return rb_pathspec;
+}
+
+/*
+ * Coerce a :paths option (a Rugged::Pathspec, a String or an Array of
+ * Strings) into a Rugged::Pathspec.
+ */
+VALUE rugged_pathspec_coerce(VALUE rb_paths)
+{
+	if (rb_obj_is_kind_of(rb_paths, rb_cRuggedPathspec))
+		return rb_paths;
+
+	return rb_git_pathspec_new(rb_cRuggedPathspec, rb_paths);
+}
+
+int rugged_pathspec_match_path(VALUE rb_pathspec, const char *path)
+{
+	return pathspec_match(rugged_pathspec_get(rb_pathspec), path);
+}
+
+int rugged_pathspec_match_dir(VALUE rb_pathspec, const char *dir, size_t dir_len)
+{
+	return pathspec_match_dir(rugged_pathspec_get(rb_pathspec), dir, dir_len);
+}
+
+/*
+ *	call-seq:
+ *		pathspec.patterns -> array
+ *
+ *	Return the patterns the pathspec was compiled from.
+ */
+static VALUE rb_git_pathspec_patterns(VALUE self)
+{
+	rugged_pathspec *ps = rugged_pathspec_get(self);
+	VALUE rb_patterns = rb_ary_new2(ps->patterns.count);
+	size_t i;
+
+	for (i = 0; i < ps->patterns.count; ++i)
+		rb_ary_push(rb_patterns, rugged_str_new2(ps->patterns.strings[i], NULL));
+
+	return rb_patterns;
+}
+
+/*
+ *	call-seq:
+ *		pathspec.match_path(path) -> true or false
+ *
+ *	Return whether +path+ is selected by the pathspec.
+ */
+static VALUE rb_git_pathspec_match_path(VALUE self, VALUE rb_path)
+{
+	Check_Type(rb_path, T_STRING);
+	return pathspec_match(rugged_pathspec_get(self), StringValueCStr(rb_path)) ? Qtrue : Qfalse;
+}
+
+/*
+ *	call-seq:
+ *		pathspec.match_paths(paths) -> array
+ *
+ *	Return the paths in the +paths+ Array that are selected by the
+ *	pathspec, in the same order.
+ */
+static VALUE rb_git_pathspec_match_paths(VALUE self, VALUE rb_paths)
+{
+	rugged_pathspec *ps = rugged_pathspec_get(self);
+	VALUE rb_result = rb_ary_new();
+	long i;
+
+	Check_Type(rb_paths, T_ARRAY);
+
+	for (i = 0; i < RARRAY_LEN(rb_paths); ++i) {
+		VALUE rb_path = rb_ary_entry(rb_paths, i);
+
+		Check_Type(rb_path, T_STRING);
+
+		if (pathspec_match(ps, StringValueCStr(rb_path)))
+			rb_ary_push(rb_result, rb_path);
+	}
+
+	return rb_result;
+}
+
+/*
+ *	call-seq:
+ *		pathspec.match_tree(tree) -> array
+ *
+ *	Return the paths of all the blobs in +tree+ (recursively) that are
+ *	selected by the pathspec. Subtrees that no pattern can reach are
+ *	never loaded.
+ */
+static VALUE rb_git_pathspec_match_tree(VALUE self, VALUE rb_tree)
+{
+	pathspec_walk walk;
+	git_tree *tree;
+	VALUE rb_result = rb_ary_new();
+	int error;
+
+	if (!rb_obj_is_kind_of(rb_tree, rb_cRuggedTree))
+		rb_raise(rb_eTypeError, "Expecting a Rugged::Tree instance");
+
+	Data_Get_Struct(rb_tree, git_tree, tree);
+
+	memset(&walk, 0x0, sizeof(walk));
+	walk.ps = rugged_pathspec_get(self);
+	walk.repo = git_object_owner((git_object *)tree);
+	walk.path_alloc = 256;
+	walk.path = xmalloc(walk.path_alloc);
+	walk.path[0] = '\0';
+
+	error = pathspec_match_tree(&walk, tree, walk.ps->patterns.count == 0, rb_result);
+	xfree(walk.path);
+
+	rugged_exception_check(error);
+
+	return rb_result;
+}
+
+void Init_rugged_pathspec()
+{
+	rb_cRuggedPathspec = rb_define_class_under(rb_mRugged, "Pathspec", rb_cObject);
+	rb_undef_alloc_func(rb_cRuggedPathspec);
+
+	rb_define_singleton_method(rb_cRuggedPathspec, "new", rb_git_pathspec_new, 1);
+	rb_define_method(rb_cRuggedPathspec, "patterns", rb_git_pathspec_patterns, 0);
+	rb_define_method(rb_cRuggedPathspec, "match_path", rb_git_pathspec_match_path, 1);
+	rb_define_method(rb_cRuggedPathspec, "match_paths", rb_git_pathspec_match_paths, 1);
+	rb_define_method(rb_cRuggedPathspec, "match_tree", rb_git_pathspec_match_tree, 1);
+}
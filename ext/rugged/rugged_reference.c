@@ -193,6 +193,8 @@ static VALUE rb_git_ref_create(int argc, VALUE *argv, VALUE klass)
 	}
 
 	rugged_exception_check(error);
+	rugged_ref_fsync(rb_repo, git_reference_name(ref));
+
 	return rugged_ref_new(klass, rb_repo, ref);
 }
 
@@ -262,6 +264,8 @@ static VALUE rb_git_ref_set_target(VALUE self, VALUE rb_target)
 	}
 
 	rugged_exception_check(error);
+	rugged_ref_fsync(rugged_owner(self), git_reference_name(out));
+
 	return rugged_ref_new(rb_cRuggedReference, rugged_owner(self), out);
 }
 
@@ -356,6 +360,8 @@ static VALUE rb_git_ref_rename(int argc, VALUE *argv, VALUE self)
 
 	error = git_reference_rename(&out, ref, StringValueCStr(rb_name), force);
 	rugged_exception_check(error);
+	rugged_ref_fsync(rugged_owner(self), git_reference_name(ref));
+	rugged_ref_fsync(rugged_owner(self), git_reference_name(out));
 
 	return rugged_ref_new(rb_cRuggedReference, rugged_owner(self), out);
 }
@@ -379,31 +385,36 @@ static VALUE rb_git_ref_delete(VALUE self)
 
 	error = git_reference_delete(ref);
 	rugged_exception_check(error);
+	rugged_ref_fsync(rugged_owner(self), git_reference_name(ref));
 
 	return Qnil;
 }
 
-static VALUE reflog_entry_new(const git_reflog_entry *entry)
+static VALUE reflog_entry_build(
+	const git_oid *id_old,
+	const git_oid *id_new,
+	const git_signature *committer,
+	const char *message,
+	VALUE rb_repo)
 {
 	VALUE rb_entry = rb_hash_new();
-	const char *message;
 
 	rb_hash_aset(rb_entry,
 		CSTR2SYM("id_old"),
-		rugged_create_oid(git_reflog_entry_id_old(entry))
+		rugged_create_oid(id_old)
 	);
 
 	rb_hash_aset(rb_entry,
 		CSTR2SYM("id_new"),
-		rugged_create_oid(git_reflog_entry_id_new(entry))
+		rugged_create_oid(id_new)
 	);
 
 	rb_hash_aset(rb_entry,
 		CSTR2SYM("committer"),
-		rugged_signature_new(git_reflog_entry_committer(entry), NULL)
+		rugged_signature_new(committer, NULL, rb_repo)
 	);
 
-	if ((message = git_reflog_entry_message(entry)) != NULL) {
+	if (message != NULL) {
 		rb_hash_aset(rb_entry,
 			CSTR2SYM("message"),
 			rugged_str_new2(message, NULL)
@@ -413,9 +424,320 @@ static VALUE reflog_entry_new(const git_reflog_entry *entry)
 	return rb_entry;
 }
 
+static VALUE reflog_entry_new(const git_reflog_entry *entry, VALUE rb_repo)
+{
+	return reflog_entry_build(
+		git_reflog_entry_id_old(entry),
+		git_reflog_entry_id_new(entry),
+		git_reflog_entry_committer(entry),
+		git_reflog_entry_message(entry),
+		rb_repo);
+}
+
+/*
+ * Reflogs are append-only, so the most recent entries are always at the
+ * end of the file. The reader below walks the file backwards in fixed
+ * size chunks, and only keeps in memory the chunk being scanned plus the
+ * line that is being assembled; the rest of the log is never read.
+ */
+#define RUGGED_REFLOG_CHUNK 8192
+
+typedef struct {
+	FILE *fp;
+	long pos;
+
+	char *buf;
+	size_t len, alloc;
+
+	char *line;
+	size_t line_alloc;
+} rugged_reflog_reader;
+
+static int reflog_reader_open(rugged_reflog_reader *reader, git_reference *ref)
+{
+	const char *repo_path = git_repository_path(git_reference_owner(ref));
+	const char *ref_name = git_reference_name(ref);
+	char *path;
+
+	memset(reader, 0x0, sizeof(rugged_reflog_reader));
+
+	path = xmalloc(strlen(repo_path) + strlen("logs/") + strlen(ref_name) + 1);
+	sprintf(path, "%slogs/%s", repo_path, ref_name);
+
+	reader->fp = fopen(path, "rb");
+	xfree(path);
+
+	/* A missing reflog is just an empty one */
+	if (reader->fp == NULL)
+		return 0;
+
+	if (fseek(reader->fp, 0, SEEK_END) < 0 || (reader->pos = ftell(reader->fp)) < 0) {
+		giterr_set_str(GITERR_OS, "Failed to read reflog");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void reflog_reader_free(rugged_reflog_reader *reader)
+{
+	if (reader->fp)
+		fclose(reader->fp);
+
+	xfree(reader->buf);
+	xfree(reader->line);
+}
+
+/*
+ * Read the chunk of the file right before the data we already have in
+ * the buffer, and prepend it. Returns the size of the new chunk.
+ */
+static long reflog_reader_fill(rugged_reflog_reader *reader)
+{
+	size_t chunk = reader->pos < RUGGED_REFLOG_CHUNK ?
+		(size_t)reader->pos : RUGGED_REFLOG_CHUNK;
+
+	if (reader->len + chunk > reader->alloc) {
+		reader->alloc = reader->len + chunk;
+		reader->buf = xrealloc(reader->buf, reader->alloc);
+	}
+
+	memmove(reader->buf + chunk, reader->buf, reader->len);
+	reader->pos -= chunk;
+
+	if (fseek(reader->fp, reader->pos, SEEK_SET) < 0 ||
+		fread(reader->buf, 1, chunk, reader->fp) != chunk) {
+		giterr_set_str(GITERR_OS, "Failed to read reflog");
+		return -1;
+	}
+
+	reader->len += chunk;
+	return (long)chunk;
+}
+
+static void reflog_reader_take(rugged_reflog_reader *reader, size_t start)
+{
+	size_t line_len = reader->len - start;
+
+	if (line_len + 1 > reader->line_alloc) {
+		reader->line_alloc = line_len + 1;
+		reader->line = xrealloc(reader->line, reader->line_alloc);
+	}
+
+	memcpy(reader->line, reader->buf + start, line_len);
+	reader->line[line_len] = '\0';
+}
+
+/*
+ * Fetch the line right before the last one returned. On success, the
+ * NUL-terminated line is left in `reader->line` and 1 is returned;
+ * 0 means the start of the file has been reached.
+ */
+static int reflog_reader_prev(rugged_reflog_reader *reader)
+{
+	size_t scan = reader->len;
+	long chunk;
+
+	for (;;) {
+		while (scan > 0) {
+			if (reader->buf[scan - 1] != '\n') {
+				scan--;
+				continue;
+			}
+
+			if (scan == reader->len) {
+				/* skip empty lines */
+				reader->len = --scan;
+				continue;
+			}
+
+			reflog_reader_take(reader, scan);
+			reader->len = scan - 1;
+			return 1;
+		}
+
+		if (reader->fp == NULL || reader->pos == 0) {
+			if (reader->len == 0)
+				return 0;
+
+			reflog_reader_take(reader, 0);
+			reader->len = 0;
+			return 1;
+		}
+
+		if ((chunk = reflog_reader_fill(reader)) < 0)
+			return -1;
+
+		scan = (size_t)chunk;
+	}
+}
+
+static int reflog_parse_line(
+	char *line,
+	git_oid *id_old,
+	git_oid *id_new,
+	git_signature *committer,
+	char **message)
+{
+	char *name_end, *email, *email_end, *p;
+	int sign, tz;
+
+	if (strlen(line) < 2 * GIT_OID_HEXSZ + 2 ||
+		line[GIT_OID_HEXSZ] != ' ' || line[2 * GIT_OID_HEXSZ + 1] != ' ')
+		goto fail;
+
+	if (git_oid_fromstr(id_old, line) < 0 ||
+		git_oid_fromstr(id_new, line + GIT_OID_HEXSZ + 1) < 0)
+		goto fail;
+
+	line += 2 * GIT_OID_HEXSZ + 2;
+
+	*message = NULL;
+	if ((p = strchr(line, '\t')) != NULL) {
+		*p = '\0';
+		*message = p + 1;
+	}
+
+	if ((email = strchr(line, '<')) == NULL ||
+		(email_end = strchr(email, '>')) == NULL)
+		goto fail;
+
+	for (name_end = email; name_end > line && name_end[-1] == ' '; --name_end)
+		/* nothing */;
+
+	*name_end = '\0';
+	*email_end = '\0';
+
+	committer->name = line;
+	committer->email = email + 1;
+	committer->when.time = 0;
+	committer->when.offset = 0;
+
+	p = email_end + 1;
+	while (*p == ' ')
+		p++;
+
+	while (*p >= '0' && *p <= '9')
+		committer->when.time = committer->when.time * 10 + (*p++ - '0');
+
+	while (*p == ' ')
+		p++;
+
+	if (*p == '+' || *p == '-') {
+		sign = (*p++ == '-') ? -1 : 1;
+
+		if (strlen(p) < 4)
+			goto fail;
+
+		tz = (p[0] - '0') * 1000 + (p[1] - '0') * 100 + (p[2] - '0') * 10 + (p[3] - '0');
+		committer->when.offset = sign * ((tz / 100) * 60 + (tz % 100));
+	}
+
+	return 0;
+
+fail:
+	giterr_set_str(GITERR_REFERENCE, "Failed to parse reflog. Could not parse entry");
+	return -1;
+}
+
+struct rugged_reflog_each {
+	rugged_reflog_reader reader;
+	VALUE rb_repo;
+	VALUE rb_result;
+	long offset;
+	long limit;
+};
+
+static VALUE rugged_reflog_each_entry(VALUE _payload)
+{
+	struct rugged_reflog_each *payload = (struct rugged_reflog_each *)_payload;
+	long index = 0, taken = 0;
+	int error;
+
+	while (payload->limit < 0 || taken < payload->limit) {
+		git_oid id_old, id_new;
+		git_signature committer;
+		char *message;
+		VALUE rb_entry;
+
+		error = reflog_reader_prev(&payload->reader);
+		rugged_exception_check(error);
+
+		if (error == 0)
+			break;
+
+		if (index++ < payload->offset)
+			continue;
+
+		rugged_exception_check(reflog_parse_line(
+			payload->reader.line, &id_old, &id_new, &committer, &message));
+
+		rb_entry = reflog_entry_build(&id_old, &id_new, &committer, message, payload->rb_repo);
+		taken++;
+
+		if (NIL_P(payload->rb_result))
+			rb_yield(rb_entry);
+		else
+			rb_ary_push(payload->rb_result, rb_entry);
+	}
+
+	return Qnil;
+}
+
+static VALUE rugged_reflog_each_cleanup(VALUE _payload)
+{
+	struct rugged_reflog_each *payload = (struct rugged_reflog_each *)_payload;
+	reflog_reader_free(&payload->reader);
+	return Qnil;
+}
+
+static void rugged_reflog_each(VALUE self, VALUE rb_options, VALUE rb_result)
+{
+	struct rugged_reflog_each payload;
+	git_reference *ref;
+	VALUE rb_val;
+
+	Data_Get_Struct(self, git_reference, ref);
+
+	payload.rb_repo = rugged_owner(self);
+	payload.rb_result = rb_result;
+	payload.offset = 0;
+	payload.limit = -1;
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+
+		rb_val = rb_hash_aref(rb_options, CSTR2SYM("offset"));
+		if (!NIL_P(rb_val)) {
+			Check_Type(rb_val, T_FIXNUM);
+			payload.offset = FIX2LONG(rb_val);
+
+			if (payload.offset < 0)
+				rb_raise(rb_eArgError, "offset must not be negative");
+		}
+
+		rb_val = rb_hash_aref(rb_options, CSTR2SYM("limit"));
+		if (!NIL_P(rb_val)) {
+			Check_Type(rb_val, T_FIXNUM);
+			payload.limit = FIX2LONG(rb_val);
+
+			if (payload.limit < 0)
+				rb_raise(rb_eArgError, "limit must not be negative");
+		}
+	}
+
+	if (reflog_reader_open(&payload.reader, ref) < 0) {
+		reflog_reader_free(&payload.reader);
+		rugged_exception_check(-1);
+	}
+
+	rb_ensure(rugged_reflog_each_entry, (VALUE)&payload,
+		rugged_reflog_each_cleanup, (VALUE)&payload);
+}
+
 /*
  *	call-seq:
- *		reference.log -> [reflog_entry, ...]
+ *		reference.log(options = {}) -> [reflog_entry, ...]
  *
  *	Return an array with the log of all modifications to this reference
  *
@@ -426,6 +748,17 @@ static VALUE reflog_entry_new(const git_reflog_entry *entry)
  *	- +:committer+: author of the change
  *	- +:message+: message for the change
  *
+ *	The following options can be passed in the +options+ Hash to read
+ *	only a window of the log, counting back from its most recent entry:
+ *
+ *	- +:limit+: return at most this many entries
+ *	- +:offset+: skip this many of the most recent entries
+ *
+ *	When a window is requested, the log is read backwards from its end and
+ *	the older entries are never loaded. The entries are still returned in
+ *	chronological order, so <tt>reference.log(:limit => 20)</tt> is
+ *	equivalent to <tt>reference.log.last(20)</tt>.
+ *
  *		reference.log #=> [
  *		# {
  *		#	:id_old => nil,
@@ -434,14 +767,22 @@ static VALUE reflog_entry_new(const git_reflog_entry *entry)
  *		#	:message => 'created reference'
  *		# }, ... ]
  */
-static VALUE rb_git_reflog(VALUE self)
+static VALUE rb_git_reflog(int argc, VALUE *argv, VALUE self)
 {
 	git_reflog *reflog;
 	git_reference *ref;
 	int error;
-	VALUE rb_log;
+	VALUE rb_log, rb_options;
 	size_t i, ref_count;
 
+	rb_scan_args(argc, argv, "01", &rb_options);
+
+	if (!NIL_P(rb_options)) {
+		rb_log = rb_ary_new();
+		rugged_reflog_each(self, rb_options, rb_log);
+		return rb_ary_reverse(rb_log);
+	}
+
 	Data_Get_Struct(self, git_reference, ref);
 
 	error = git_reflog_read(&reflog, ref);
@@ -454,13 +795,43 @@ static VALUE rb_git_reflog(VALUE self)
 		const git_reflog_entry *entry =
 			git_reflog_entry_byindex(reflog, ref_count - i - 1);
 
-		rb_ary_push(rb_log, reflog_entry_new(entry));
+		rb_ary_push(rb_log, reflog_entry_new(entry, rugged_owner(self)));
 	}
 
 	git_reflog_free(reflog);
 	return rb_log;
 }
 
+/*
+ *	call-seq:
+ *		reference.each_log_entry(options = {}) { |reflog_entry| block }
+ *		reference.each_log_entry(options = {}) -> Enumerator
+ *
+ *	Iterate through the log of this reference, starting from the most
+ *	recent entry and going back in time. Entries have the same format as
+ *	the ones returned by +Reference#log+, and the same +:limit+ and
+ *	+:offset+ options are accepted.
+ *
+ *	The log file is read backwards in small chunks as the iteration goes,
+ *	so breaking out of the block early avoids reading the rest of it.
+ *
+ *	If no block is given, an +Enumerator+ will be returned.
+ *
+ *		reference.each_log_entry(:limit => 2) { |entry| puts entry[:message] }
+ */
+static VALUE rb_git_reflog_each(int argc, VALUE *argv, VALUE self)
+{
+	VALUE rb_options;
+
+	rb_scan_args(argc, argv, "01", &rb_options);
+
+	if (!rb_block_given_p())
+		return rb_funcall(self, rb_intern("to_enum"), 2, CSTR2SYM("each_log_entry"), rb_options);
+
+	rugged_reflog_each(self, rb_options, Qnil);
+	return Qnil;
+}
+
 /*
  *	call-seq:
  *		reference.log? -> Boolean
@@ -569,7 +940,8 @@ void Init_rugged_reference()
 	rb_define_method(rb_cRuggedReference, "branch?", rb_git_ref_is_branch, 0);
 	rb_define_method(rb_cRuggedReference, "remote?", rb_git_ref_is_remote, 0);
 
-	rb_define_method(rb_cRuggedReference, "log", rb_git_reflog, 0);
+	rb_define_method(rb_cRuggedReference, "log", rb_git_reflog, -1);
+	rb_define_method(rb_cRuggedReference, "each_log_entry", rb_git_reflog_each, -1);
 	rb_define_method(rb_cRuggedReference, "log?", rb_git_has_reflog, 0);
 	rb_define_method(rb_cRuggedReference, "log!", rb_git_reflog_write, -1);
 }
@@ -573,6 +573,9 @@ static VALUE rb_git_remote_update_tips(VALUE self)
 		);
 	}
 
+	/* the updated references are not known here */
+	rugged_ref_fsync(rugged_owner(self), NULL);
+
 	return Qnil;
 }
 
@@ -31,6 +31,7 @@ extern VALUE rb_cRuggedIndex;
 extern VALUE rb_cRuggedConfig;
 extern VALUE rb_cRuggedBackend;
 extern VALUE rb_cRuggedRemote;
+extern VALUE rb_cRuggedPathspec;
 
 VALUE rb_cRuggedRepo;
 VALUE rb_cRuggedOdbObject;
@@ -172,6 +173,74 @@ static void load_alternates(git_repository *repo, VALUE rb_alternates)
 	rugged_exception_check(error);
 }
 
+/* Repository#ids scans the object directories of alternates as well */
+static VALUE remember_alternates(VALUE rb_repo, VALUE rb_alternates)
+{
+	rb_ivar_set(rb_repo, rb_intern("alternates"), NIL_P(rb_alternates) ? Qnil : rb_ary_dup(rb_alternates));
+	return rb_repo;
+}
+
+/*
+ * A NULL-terminated copy of the alternates given to Repository.new,
+ * for worker threads to open their own handles on the repository with.
+ * Free it with rugged_repo_alternates_free.
+ */
+char **rugged_repo_alternates(VALUE rb_repo)
+{
+	VALUE rb_alternates = rb_attr_get(rb_repo, rb_intern("alternates"));
+	long i, count = NIL_P(rb_alternates) ? 0 : RARRAY_LEN(rb_alternates);
+	char **alternates = xcalloc(count + 1, sizeof(char *));
+
+	for (i = 0; i < count; ++i) {
+		VALUE rb_alternate = rb_ary_entry(rb_alternates, i);
+
+		alternates[i] = xmalloc(RSTRING_LEN(rb_alternate) + 1);
+		memcpy(alternates[i], StringValueCStr(rb_alternate), RSTRING_LEN(rb_alternate) + 1);
+	}
+
+	return alternates;
+}
+
+void rugged_repo_alternates_free(char **alternates)
+{
+	char **alternate;
+
+	for (alternate = alternates; alternate && *alternate; ++alternate)
+		xfree(*alternate);
+
+	xfree(alternates);
+}
+
+/*
+ * Open a new handle on the repository at `path`, with `alternates`
+ * added to its object database. This doesn't touch the Ruby API, so
+ * worker threads can call it without the GVL.
+ */
+int rugged_repo_open_worker(git_repository **out, const char *path, char **alternates)
+{
+	git_odb *odb = NULL;
+	int error;
+
+	*out = NULL;
+
+	if ((error = git_repository_open(out, path)) < 0)
+		return error;
+
+	if (alternates && *alternates && (error = git_repository_odb(&odb, *out)) == 0) {
+		for (; !error && *alternates; ++alternates)
+			error = git_odb_add_disk_alternate(odb, *alternates);
+
+		git_odb_free(odb);
+	}
+
+	if (error < 0) {
+		git_repository_free(*out);
+		*out = NULL;
+	}
+
+	return error;
+}
+
 static void set_repository_options(git_repository *repo, VALUE rb_options)
 {
 	if (NIL_P(rb_options))
@@ -197,7 +266,7 @@ static VALUE rb_git_repo_open_bare(int argc, VALUE *argv, VALUE klass)
 
 	load_alternates(repo, rb_alternates);
 
-	return rugged_repo_new(klass, repo);
+	return remember_alternates(rugged_repo_new(klass, repo), rb_alternates);
 }
 
 /*
@@ -234,7 +303,8 @@ static VALUE rb_git_repo_new(int argc, VALUE *argv, VALUE klass)
 	rugged_exception_check(error);
 	set_repository_options(repo, rb_options);
 
-	return rugged_repo_new(klass, repo);
+	return remember_alternates(rugged_repo_new(klass, repo),
+		NIL_P(rb_options) ? Qnil : rb_hash_aref(rb_options, CSTR2SYM("alternates")));
 }
 
 /*
@@ -391,6 +461,408 @@ static VALUE rb_git_repo_merge_base(VALUE self, VALUE rb_args)
 	return rugged_create_oid(&base);
 }
 
+static void rugged_parse_merge_tree_options(git_merge_tree_opts *opts, VALUE rb_options)
+{
+	VALUE rb_value;
+
+	if (NIL_P(rb_options))
+		return;
+
+	Check_Type(rb_options, T_HASH);
+
+	if (RTEST(rb_hash_aref(rb_options, CSTR2SYM("renames"))))
+		opts->flags |= GIT_MERGE_TREE_FIND_RENAMES;
+
+	rb_value = rb_hash_aref(rb_options, CSTR2SYM("rename_threshold"));
+	if (!NIL_P(rb_value)) {
+		Check_Type(rb_value, T_FIXNUM);
+		opts->rename_threshold = FIX2UINT(rb_value);
+	}
+
+	rb_value = rb_hash_aref(rb_options, CSTR2SYM("target_limit"));
+	if (!NIL_P(rb_value)) {
+		Check_Type(rb_value, T_FIXNUM);
+		opts->target_limit = FIX2UINT(rb_value);
+	}
+}
+
+/*
+ * Turn the index produced by a tree merge into the value returned to
+ * Ruby: the index itself if it has conflicts, or the OID of the tree
+ * it describes otherwise.
+ */
+static VALUE rugged_merge_result(VALUE self, git_repository *repo, git_index *index)
+{
+	git_oid tree_oid;
+	int error;
+
+	if (git_index_has_conflicts(index))
+		return rugged_index_new(rb_cRuggedIndex, self, index);
+
+	error = git_index_write_tree_to(&tree_oid, index, repo);
+	git_index_free(index);
+	rugged_exception_check(error);
+
+	return rugged_create_oid(&tree_oid);
+}
+
+typedef struct {
+	git_repository *repo;
+	VALUE rb_value;
+	git_otype type;
+	git_object *object;
+} merge_object_args;
+
+static VALUE merge_object_get_protected(VALUE payload)
+{
+	merge_object_args *args = (merge_object_args *)payload;
+	args->object = rugged_object_get(args->repo, args->rb_value, args->type);
+	return Qnil;
+}
+
+/*
+ * Like rugged_object_get, but frees the objects already looked up
+ * (`held`, `held2`; either can be NULL) before raising.
+ */
+static git_object *merge_object_get(git_repository *repo, VALUE rb_value, git_otype type,
+	git_object *held, git_object *held2)
+{
+	merge_object_args args;
+	int state = 0;
+
+	args.repo = repo;
+	args.rb_value = rb_value;
+	args.type = type;
+	args.object = NULL;
+
+	rb_protect(merge_object_get_protected, (VALUE)&args, &state);
+
+	if (state) {
+		git_object_free(held);
+		git_object_free(held2);
+		rb_jump_tag(state);
+	}
+
+	return args.object;
+}
+
+/*
+ *	call-seq:
+ *		repo.merge_trees(ancestor, ours, theirs, options = {}) -> oid or index
+ *
+ *	Merge the trees +ours+ and +theirs+, using +ancestor+ as their common
+ *	base, entirely in memory: neither the working directory nor the
+ *	repository's index are touched.
+ *
+ *	Each of +ancestor+, +ours+ and +theirs+ can be a <tt>Rugged::Tree</tt>,
+ *	a <tt>Rugged::Commit</tt>, or a String with an OID or a revision. If
+ *	+ancestor+ is +nil+ and both sides are commits, their merge base is
+ *	used as the ancestor.
+ *
+ *	Subtrees with the same OID on both sides are never descended into, so
+ *	the cost of the merge depends on the size of the changes, not on the
+ *	size of the trees.
+ *
+ *	If the merge is clean, the resulting tree is written to the object
+ *	database and its OID is returned. Otherwise, an in-memory
+ *	<tt>Rugged::Index</tt> is returned, with the conflicting entries in
+ *	stages 1 (ancestor), 2 (ours) and 3 (theirs).
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:renames ::
+ *	  If true, renames between the ancestor and each side will be
+ *	  detected and merged as such.
+ *
+ *	:rename_threshold ::
+ *	  The similarity (0-100) needed for two files to be considered a
+ *	  rename. Defaults to 50.
+ *
+ *	:target_limit ::
+ *	  The maximum number of files to inspect when looking for renames.
+ *	  Defaults to 200.
+ *
+ *		result = repo.merge_trees(nil, "master", "topic")
+ *		result.conflicts? if result.is_a?(Rugged::Index)
+ */
+static VALUE rb_git_repo_merge_trees(int argc, VALUE *argv, VALUE self)
+{
+	VALUE rb_ancestor, rb_ours, rb_theirs, rb_options;
+	git_merge_tree_opts opts = GIT_MERGE_TREE_OPTS_INIT;
+	git_object *ancestor = NULL, *ours, *theirs;
+	git_tree *ancestor_tree = NULL, *our_tree = NULL, *their_tree = NULL;
+	git_repository *repo;
+	git_index *index;
+	git_oid base;
+	int error;
+
+	rb_scan_args(argc, argv, "31", &rb_ancestor, &rb_ours, &rb_theirs, &rb_options);
+	rugged_parse_merge_tree_options(&opts, rb_options);
+
+	Data_Get_Struct(self, git_repository, repo);
+
+	ours = rugged_object_get(repo, rb_ours, GIT_OBJ_ANY);
+	theirs = merge_object_get(repo, rb_theirs, GIT_OBJ_ANY, ours, NULL);
+
+	if (!NIL_P(rb_ancestor)) {
+		ancestor = merge_object_get(repo, rb_ancestor, GIT_OBJ_ANY, ours, theirs);
+	} else if (git_object_type(ours) == GIT_OBJ_COMMIT &&
+		git_object_type(theirs) == GIT_OBJ_COMMIT) {
+		error = git_merge_base(&base, repo, git_object_id(ours), git_object_id(theirs));
+
+		if (error == GIT_ENOTFOUND) {
+			giterr_clear();
+		} else if (error < 0 ||
+			(error = git_object_lookup(&ancestor, repo, &base, GIT_OBJ_COMMIT)) < 0) {
+			goto cleanup;
+		}
+	}
+
+	if ((error = git_object_peel((git_object **)&our_tree, ours, GIT_OBJ_TREE)) < 0 ||
+		(error = git_object_peel((git_object **)&their_tree, theirs, GIT_OBJ_TREE)) < 0)
+		goto cleanup;
+
+	if (ancestor &&
+		(error = git_object_peel((git_object **)&ancestor_tree, ancestor, GIT_OBJ_TREE)) < 0)
+		goto cleanup;
+
+	error = git_merge_trees(&index, repo, ancestor_tree, our_tree, their_tree, &opts);
+
+cleanup:
+	git_tree_free(ancestor_tree);
+	git_tree_free(our_tree);
+	git_tree_free(their_tree);
+	git_object_free(ancestor);
+	git_object_free(ours);
+	git_object_free(theirs);
+
+	rugged_exception_check(error);
+
+	return rugged_merge_result(self, repo, index);
+}
+
+/* 4b825dc642cb6eb9a060e54bf8d69288fbee4904, the tree with no entries */
+static const git_oid rugged_empty_tree_id = {{
+	0x4b, 0x82, 0x5d, 0xc6, 0x42, 0xcb, 0x6e, 0xb9, 0xa0, 0x60,
+	0xe5, 0x4b, 0xf8, 0xd6, 0x92, 0x88, 0xfb, 0xee, 0x49, 0x04
+}};
+
+static int empty_tree_backend_read_header(size_t *len_p, git_otype *type_p,
+	git_odb_backend *backend, const git_oid *oid)
+{
+	if (git_oid_cmp(oid, &rugged_empty_tree_id))
+		return GIT_ENOTFOUND;
+
+	*len_p = 0;
+	*type_p = GIT_OBJ_TREE;
+	return 0;
+}
+
+static int empty_tree_backend_read(void **buffer_p, size_t *len_p, git_otype *type_p,
+	git_odb_backend *backend, const git_oid *oid)
+{
+	if (git_oid_cmp(oid, &rugged_empty_tree_id))
+		return GIT_ENOTFOUND;
+
+	if ((*buffer_p = git_odb_backend_malloc(backend, 1)) == NULL)
+		return -1;
+
+	*len_p = 0;
+	*type_p = GIT_OBJ_TREE;
+	return 0;
+}
+
+static int empty_tree_backend_exists(git_odb_backend *backend, const git_oid *oid)
+{
+	return !git_oid_cmp(oid, &rugged_empty_tree_id);
+}
+
+static int empty_tree_backend_foreach(git_odb_backend *backend, git_odb_foreach_cb cb, void *payload)
+{
+	return 0;
+}
+
+static void empty_tree_backend_free(git_odb_backend *backend)
+{
+	xfree(backend);
+}
+
+/*
+ * Look up the empty tree. Repositories don't necessarily contain it, and
+ * it must not be written to them, so when it's missing it is looked up
+ * in a private repository whose object database serves just that object.
+ * `owner` is then set to that repository, to be freed (after the tree)
+ * once the operation is done; otherwise it is NULL.
+ */
+static int rugged_empty_tree(git_tree **out, git_repository **owner, git_repository *repo)
+{
+	git_odb_backend *backend;
+	git_odb *odb;
+	int error = git_tree_lookup(out, repo, &rugged_empty_tree_id);
+
+	*owner = NULL;
+
+	if (error != GIT_ENOTFOUND)
+		return error;
+
+	giterr_clear();
+
+	if ((error = git_odb_new(&odb)) < 0)
+		return error;
+
+	backend = xcalloc(1, sizeof(git_odb_backend));
+	backend->version = GIT_ODB_BACKEND_VERSION;
+	backend->read = empty_tree_backend_read;
+	backend->read_header = empty_tree_backend_read_header;
+	backend->exists = empty_tree_backend_exists;
+	backend->foreach = empty_tree_backend_foreach;
+	backend->free = empty_tree_backend_free;
+
+	if ((error = git_odb_add_backend(odb, backend, 1)) < 0)
+		xfree(backend);
+	else
+		error = git_repository_wrap_odb(owner, odb);
+
+	git_odb_free(odb);
+
+	if (error < 0)
+		return error;
+
+	if ((error = git_tree_lookup(out, *owner, &rugged_empty_tree_id)) < 0) {
+		git_repository_free(*owner);
+		*owner = NULL;
+	}
+
+	return error;
+}
+
+/*
+ * Cherry-picking a commit merges the changes between its parent and
+ * itself into +onto+; reverting it does the same with the ancestor and
+ * the other side swapped.
+ */
+static VALUE rugged_merge_commit_changes(int argc, VALUE *argv, VALUE self, int revert)
+{
+	VALUE rb_commit, rb_onto, rb_options, rb_mainline;
+	git_merge_tree_opts opts = GIT_MERGE_TREE_OPTS_INIT;
+	git_tree *commit_tree = NULL, *parent_tree = NULL, *onto_tree = NULL;
+	git_commit *commit, *parent = NULL;
+	git_repository *repo, *empty_owner = NULL;
+	git_object *onto;
+	git_index *index;
+	unsigned int mainline = 0, parent_count;
+	int error;
+
+	rb_scan_args(argc, argv, "21", &rb_commit, &rb_onto, &rb_options);
+	rugged_parse_merge_tree_options(&opts, rb_options);
+
+	if (!NIL_P(rb_options)) {
+		rb_mainline = rb_hash_aref(rb_options, CSTR2SYM("mainline"));
+
+		if (!NIL_P(rb_mainline)) {
+			Check_Type(rb_mainline, T_FIXNUM);
+			mainline = FIX2UINT(rb_mainline);
+		}
+	}
+
+	Data_Get_Struct(self, git_repository, repo);
+
+	commit = (git_commit *)rugged_object_get(repo, rb_commit, GIT_OBJ_COMMIT);
+	parent_count = git_commit_parentcount(commit);
+
+	if (parent_count > 1 && mainline == 0) {
+		git_commit_free(commit);
+		rb_raise(rb_eArgError, "Commit is a merge but no :mainline option was given");
+	}
+
+	if (parent_count <= 1 && mainline != 0) {
+		git_commit_free(commit);
+		rb_raise(rb_eArgError, ":mainline was given but commit is not a merge");
+	}
+
+	if (mainline > parent_count) {
+		git_commit_free(commit);
+		rb_raise(rb_eArgError, "Commit does not have parent number %u", mainline);
+	}
+
+	onto = merge_object_get(repo, rb_onto, GIT_OBJ_ANY, (git_object *)commit, NULL);
+
+	if ((error = git_commit_tree(&commit_tree, commit)) < 0 ||
+		(error = git_object_peel((git_object **)&onto_tree, onto, GIT_OBJ_TREE)) < 0)
+		goto cleanup;
+
+	/*
+	 * A root commit is merged without an ancestor. Reverting one still
+	 * needs the empty tree, as the side the changes are undone towards.
+	 */
+	if (parent_count > 0) {
+		if ((error = git_commit_parent(&parent, commit, mainline ? mainline - 1 : 0)) < 0 ||
+			(error = git_commit_tree(&parent_tree, parent)) < 0)
+			goto cleanup;
+	} else if (revert && (error = rugged_empty_tree(&parent_tree, &empty_owner, repo)) < 0) {
+		goto cleanup;
+	}
+
+	if (revert)
+		error = git_merge_trees(&index, repo, commit_tree, onto_tree, parent_tree, &opts);
+	else
+		error = git_merge_trees(&index, repo, parent_tree, onto_tree, commit_tree, &opts);
+
+cleanup:
+	git_tree_free(commit_tree);
+	git_tree_free(parent_tree);
+	git_repository_free(empty_owner);
+	git_tree_free(onto_tree);
+	git_commit_free(parent);
+	git_commit_free(commit);
+	git_object_free(onto);
+
+	rugged_exception_check(error);
+
+	return rugged_merge_result(self, repo, index);
+}
+
+/*
+ *	call-seq:
+ *		repo.cherry_pick_tree(commit, onto, options = {}) -> oid or index
+ *
+ *	Apply the changes introduced by +commit+ on top of +onto+, entirely in
+ *	memory, and return the result just like +Repository#merge_trees+: the
+ *	OID of the resulting tree if the cherry-pick is clean, or an in-memory
+ *	<tt>Rugged::Index</tt> with the conflicts otherwise.
+ *
+ *	+commit+ is a <tt>Rugged::Commit</tt> or a revision string, and +onto+
+ *	can be a commit, a tree or a revision string.
+ *
+ *	Besides the options accepted by +Repository#merge_trees+, the
+ *	+options+ Hash can contain:
+ *
+ *	:mainline ::
+ *	  When +commit+ is a merge, the number (starting from 1) of the parent
+ *	  its changes are taken relative to. Required for merges.
+ *
+ *		repo.cherry_pick_tree("topic~2", "master")
+ */
+static VALUE rb_git_repo_cherry_pick_tree(int argc, VALUE *argv, VALUE self)
+{
+	return rugged_merge_commit_changes(argc, argv, self, 0);
+}
+
+/*
+ *	call-seq:
+ *		repo.revert_tree(commit, onto, options = {}) -> oid or index
+ *
+ *	Undo the changes introduced by +commit+ on top of +onto+, entirely in
+ *	memory. Takes the same arguments and options, and returns the same
+ *	values, as +Repository#cherry_pick_tree+.
+ *
+ *		repo.revert_tree("HEAD~3", "HEAD")
+ */
+static VALUE rb_git_repo_revert_tree(int argc, VALUE *argv, VALUE self)
+{
+	return rugged_merge_commit_changes(argc, argv, self, 1);
+}
+
 /*
  *	call-seq:
  *		repo.include?(oid) -> true or false
@@ -799,6 +1271,11 @@ static int rugged__status_cb(const char *path, unsigned int flags, void *payload
  *	+path+ must be relative to the repository's working directory.
  *
  *		repo.status('src/diff.c') #=> [:index_new, :worktree_new]
+ *
+ *	If a Rugged::Pathspec is given together with a +block+, only the files
+ *	selected by it are reported.
+ *
+ *		repo.status(Rugged::Pathspec.new("src/")) { |file, status_data| ... }
  */
 static VALUE rb_git_repo_status(int argc, VALUE *argv, VALUE self)
 {
@@ -808,7 +1285,36 @@ static VALUE rb_git_repo_status(int argc, VALUE *argv, VALUE self)
 
 	Data_Get_Struct(self, git_repository, repo);
 
-	if (rb_scan_args(argc, argv, "01", &rb_path) == 1) {
+	if (rb_scan_args(argc, argv, "01", &rb_path) == 1 &&
+		rb_obj_is_kind_of(rb_path, rb_cRuggedPathspec)) {
+		git_status_options opts = GIT_STATUS_OPTIONS_INIT;
+
+		if (!rb_block_given_p())
+			rb_raise(rb_eRuntimeError,
+				"A block was expected for iterating through "
+				"the repository contents.");
+
+		/* the same flags git_status_foreach uses */
+		opts.show = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
+		opts.flags = GIT_STATUS_OPT_INCLUDE_IGNORED |
+			GIT_STATUS_OPT_INCLUDE_UNTRACKED |
+			GIT_STATUS_OPT_RECURSE_UNTRACKED_DIRS;
+
+		rugged_pathspec_strarray(&opts.pathspec, rb_path);
+
+		error = git_status_foreach_ext(
+			repo,
+			&opts,
+			&rugged__status_cb,
+			(void *)rb_block_proc()
+		);
+
+		xfree(opts.pathspec.strings);
+		rugged_exception_check(error);
+		return Qnil;
+	}
+
+	if (!NIL_P(rb_path)) {
 		unsigned int flags;
 		Check_Type(rb_path, T_STRING);
 		error = git_status_file(&flags, repo, StringValueCStr(rb_path));
@@ -832,6 +1338,205 @@ static VALUE rb_git_repo_status(int argc, VALUE *argv, VALUE self)
 	return Qnil;
 }
 
+static VALUE rugged_attr_value_new(const char *value)
+{
+	switch (git_attr_value(value)) {
+		case GIT_ATTR_TRUE_T:
+			return Qtrue;
+
+		case GIT_ATTR_FALSE_T:
+			return Qfalse;
+
+		case GIT_ATTR_UNSPECIFIED_T:
+			return Qnil;
+
+		default:
+			return rugged_str_new2(value, NULL);
+	}
+}
+
+static uint32_t rugged_parse_attr_options(VALUE rb_options)
+{
+	uint32_t flags = GIT_ATTR_CHECK_FILE_THEN_INDEX;
+	VALUE rb_value;
+
+	if (NIL_P(rb_options))
+		return flags;
+
+	Check_Type(rb_options, T_HASH);
+
+	rb_value = rb_hash_aref(rb_options, CSTR2SYM("check"));
+	if (!NIL_P(rb_value)) {
+		ID id_check;
+
+		Check_Type(rb_value, T_SYMBOL);
+		id_check = SYM2ID(rb_value);
+
+		if (id_check == rb_intern("index_then_file"))
+			flags = GIT_ATTR_CHECK_INDEX_THEN_FILE;
+		else if (id_check == rb_intern("index_only"))
+			flags = GIT_ATTR_CHECK_INDEX_ONLY;
+		else if (id_check != rb_intern("file_then_index"))
+			rb_raise(rb_eArgError,
+				"Invalid check mode. Expected `:file_then_index`, `:index_then_file` or `:index_only`");
+	}
+
+	if (RTEST(rb_hash_aref(rb_options, CSTR2SYM("skip_system"))))
+		flags |= GIT_ATTR_CHECK_NO_SYSTEM;
+
+	return flags;
+}
+
+/*
+ * Wrap a single String in an Array. Every String is checked for NUL
+ * bytes up front, so StringValueCStr can't raise on them later, once
+ * buffers have been allocated.
+ */
+static VALUE rugged_string_list(VALUE rb_value)
+{
+	long i;
+
+	if (TYPE(rb_value) != T_STRING)
+		Check_Type(rb_value, T_ARRAY);
+	else
+		rb_value = rb_ary_new3(1, rb_value);
+
+	for (i = 0; i < RARRAY_LEN(rb_value); ++i) {
+		VALUE rb_string = rb_ary_entry(rb_value, i);
+
+		Check_Type(rb_string, T_STRING);
+		StringValueCStr(rb_string);
+	}
+
+	return rb_value;
+}
+
+/*
+ *	call-seq:
+ *		repo.attributes_for(path, names, options = {}) -> hash
+ *		repo.attributes_for(paths, names, options = {}) -> hash
+ *
+ *	Look up the gitattributes +names+ (a +String+ or an +Array+ of them)
+ *	for +path+, or for each of the +paths+ in an +Array+.
+ *
+ *	For a single path, returns a +Hash+ from each attribute name to its
+ *	value: +true+ if the attribute is set, +false+ if it is unset, +nil+
+ *	if it is unspecified, or a +String+ for attributes with a value. For
+ *	an +Array+ of paths, returns a +Hash+ from each path to such a +Hash+.
+ *
+ *	All the lookups share the repository's attribute cache, so every
+ *	.gitattributes file involved is parsed only once, no matter how many
+ *	paths are checked.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:check ::
+ *	  Where to read the .gitattributes files from: +:file_then_index+
+ *	  (the default), +:index_then_file+ or +:index_only+.
+ *
+ *	:skip_system ::
+ *	  If true, the system-wide gitattributes file is ignored.
+ *
+ *		repo.attributes_for(["README", "lib/foo.rb"], ["diff", "linguist-vendored"])
+ *		#=> {"README" => {"diff" => nil, ...}, "lib/foo.rb" => {...}}
+ */
+static VALUE rb_git_repo_attributes_for(int argc, VALUE *argv, VALUE self)
+{
+	git_repository *repo;
+	VALUE rb_paths, rb_names, rb_options, rb_path_list, rb_name_list, rb_result;
+	const char **names, **values;
+	size_t name_count;
+	uint32_t flags;
+	long i;
+	int error = 0;
+
+	rb_scan_args(argc, argv, "21", &rb_paths, &rb_names, &rb_options);
+	Data_Get_Struct(self, git_repository, repo);
+
+	rb_path_list = rugged_string_list(rb_paths);
+	rb_name_list = rugged_string_list(rb_names);
+	flags = rugged_parse_attr_options(rb_options);
+
+	name_count = RARRAY_LEN(rb_name_list);
+	names = xmalloc((name_count + 1) * sizeof(char *));
+	values = xmalloc((name_count + 1) * sizeof(char *));
+
+	for (i = 0; i < (long)name_count; ++i) {
+		VALUE rb_name = rb_ary_entry(rb_name_list, i);
+		names[i] = StringValueCStr(rb_name);
+	}
+
+	rb_result = rb_hash_new();
+
+	for (i = 0; i < RARRAY_LEN(rb_path_list) && !error; ++i) {
+		VALUE rb_path = rb_ary_entry(rb_path_list, i), rb_attrs;
+		size_t j;
+
+		error = git_attr_get_many(values, repo, flags,
+			StringValueCStr(rb_path), name_count, names);
+		if (error < 0)
+			break;
+
+		rb_attrs = rb_hash_new();
+		for (j = 0; j < name_count; ++j)
+			rb_hash_aset(rb_attrs, rb_ary_entry(rb_name_list, j), rugged_attr_value_new(values[j]));
+
+		if (TYPE(rb_paths) == T_STRING)
+			rb_result = rb_attrs;
+		else
+			rb_hash_aset(rb_result, rb_path, rb_attrs);
+	}
+
+	xfree(names);
+	xfree(values);
+
+	rugged_exception_check(error);
+
+	return rb_result;
+}
+
+/*
+ *	call-seq:
+ *		repo.ignored?(path) -> true or false
+ *		repo.ignored?(paths) -> array
+ *
+ *	Check whether +path+ would be ignored by the .gitignore rules (and
+ *	the repository's exclude files) when adding it to the index. When an
+ *	+Array+ of paths is given, an +Array+ with one boolean per path is
+ *	returned. The ignore files are parsed once and cached, so checking
+ *	many paths at once is cheap.
+ *
+ *	Paths are relative to the working directory; whether they exist on
+ *	disk doesn't matter.
+ *
+ *		repo.ignored?(["tmp/cache", "lib/rugged.rb"]) #=> [true, false]
+ */
+static VALUE rb_git_repo_is_ignored(VALUE self, VALUE rb_paths)
+{
+	git_repository *repo;
+	VALUE rb_path_list, rb_result;
+	long i;
+
+	Data_Get_Struct(self, git_repository, repo);
+	rb_path_list = rugged_string_list(rb_paths);
+	rb_result = rb_ary_new2(RARRAY_LEN(rb_path_list));
+
+	for (i = 0; i < RARRAY_LEN(rb_path_list); ++i) {
+		VALUE rb_path = rb_ary_entry(rb_path_list, i);
+		int ignored, error;
+
+		error = git_ignore_path_is_ignored(&ignored, repo, StringValueCStr(rb_path));
+		rugged_exception_check(error);
+
+		rb_ary_push(rb_result, ignored ? Qtrue : Qfalse);
+	}
+
+	if (TYPE(rb_paths) == T_STRING)
+		return rb_ary_entry(rb_result, 0);
+
+	return rb_result;
+}
+
 static int rugged__each_id_cb(const git_oid *id, void *payload)
 {
 	rb_yield(rugged_create_oid(id));
@@ -840,21 +1545,50 @@ static int rugged__each_id_cb(const git_oid *id, void *payload)
 
 /*
  *	call-seq:
- *		repo.each_id { |id| block }
- *		repo.each_id -> Iterator
+ *		repo.each_id(options = {}) { |id| block }
+ *		repo.each_id(options = {}) -> Iterator
  *
  *	Call the given +block+ once with every object ID found in +repo+
  *	and all its alternates. Object IDs are passed as 40-character
  *	strings.
+ *
+ *	With a +:type+ option (+:commit+, +:tree+, +:blob+ or +:tag+), only
+ *	the IDs of objects of that type are passed, sorted and each once;
+ *	see Repository#ids for how they are found.
+ *
+ *		repo.each_id(:type => :commit) { |id| ... }
  */
-static VALUE rb_git_repo_each_id(VALUE self)
+static VALUE rb_git_repo_each_id(int argc, VALUE *argv, VALUE self)
 {
 	git_repository *repo;
 	git_odb *odb;
+	VALUE rb_options, rb_type = Qnil;
 	int error;
 
+	rb_scan_args(argc, argv, "01", &rb_options);
+
 	if (!rb_block_given_p())
-		return rb_funcall(self, rb_intern("to_enum"), 1, CSTR2SYM("each_id"));
+		return NIL_P(rb_options) ?
+			rb_funcall(self, rb_intern("to_enum"), 1, CSTR2SYM("each_id")) :
+			rb_funcall(self, rb_intern("to_enum"), 2, CSTR2SYM("each_id"), rb_options);
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+		rb_type = rb_hash_aref(rb_options, CSTR2SYM("type"));
+	}
+
+	if (!NIL_P(rb_type)) {
+		VALUE rb_ids = rugged_object_ids(self, rugged_otype_get(rb_type));
+		long i;
+
+		for (i = 0; i < RSTRING_LEN(rb_ids) / GIT_OID_RAWSZ; ++i) {
+			git_oid oid;
+			git_oid_fromraw(&oid, (const unsigned char *)RSTRING_PTR(rb_ids) + i * GIT_OID_RAWSZ);
+			rb_yield(rugged_create_oid(&oid));
+		}
+
+		return Qnil;
+	}
 
 	Data_Get_Struct(self, git_repository, repo);
 
@@ -921,6 +1655,7 @@ static VALUE rb_git_repo_reset(VALUE self, VALUE rb_target, VALUE rb_reset_type)
 
 	git_object_free(target);
 	rugged_exception_check(error);
+	rugged_ref_fsync(self, "HEAD");
 
 	return Qnil;
 }
@@ -1069,6 +1804,7 @@ cleanup:
 		rb_exc_raise(rb_exception);
 
 	rugged_exception_check(error);
+	rugged_ref_fsync(self, NULL);
 
 	return rb_result;
 }
@@ -1154,12 +1890,14 @@ void Init_rugged_repo()
 	rb_define_method(rb_cRuggedRepo, "read",   rb_git_repo_read,   1);
 	rb_define_method(rb_cRuggedRepo, "read_header",   rb_git_repo_read_header,   1);
 	rb_define_method(rb_cRuggedRepo, "write",  rb_git_repo_write,  2);
-	rb_define_method(rb_cRuggedRepo, "each_id",  rb_git_repo_each_id,  0);
+	rb_define_method(rb_cRuggedRepo, "each_id",  rb_git_repo_each_id,  -1);
 
 	rb_define_method(rb_cRuggedRepo, "path",  rb_git_repo_path, 0);
 	rb_define_method(rb_cRuggedRepo, "workdir",  rb_git_repo_workdir, 0);
 	rb_define_method(rb_cRuggedRepo, "workdir=",  rb_git_repo_set_workdir, 1);
 	rb_define_method(rb_cRuggedRepo, "status",  rb_git_repo_status,  -1);
+	rb_define_method(rb_cRuggedRepo, "attributes_for", rb_git_repo_attributes_for, -1);
+	rb_define_method(rb_cRuggedRepo, "ignored?", rb_git_repo_is_ignored, 1);
 
 	rb_define_method(rb_cRuggedRepo, "push", rb_git_repo_push, 2);
 
@@ -1175,6 +1913,9 @@ void Init_rugged_repo()
 	rb_define_method(rb_cRuggedRepo, "head_orphan?",  rb_git_repo_head_orphan,  0);
 
 	rb_define_method(rb_cRuggedRepo, "merge_base", rb_git_repo_merge_base, -2);
+	rb_define_method(rb_cRuggedRepo, "merge_trees", rb_git_repo_merge_trees, -1);
+	rb_define_method(rb_cRuggedRepo, "cherry_pick_tree", rb_git_repo_cherry_pick_tree, -1);
+	rb_define_method(rb_cRuggedRepo, "revert_tree", rb_git_repo_revert_tree, -1);
 	rb_define_method(rb_cRuggedRepo, "reset", rb_git_repo_reset, 2);
 	rb_define_method(rb_cRuggedRepo, "reset_path", rb_git_repo_reset_path, -1);
 
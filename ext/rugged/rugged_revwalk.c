@@ -25,6 +25,7 @@
 #include "rugged.h"
 
 extern VALUE rb_mRugged;
+extern VALUE rb_cRuggedPathspec;
 VALUE rb_cRuggedWalker;
 
 static void rb_git_walk__free(git_revwalk *walk)
@@ -91,6 +92,7 @@ static VALUE rb_git_walker_each(VALUE self)
 	git_commit *commit;
 	git_repository *repo;
 	git_oid commit_oid;
+	VALUE rb_pathspec;
 	int error;
 
 	Data_Get_Struct(self, git_revwalk, walk);
@@ -99,10 +101,24 @@ static VALUE rb_git_walker_each(VALUE self)
 	if (!rb_block_given_p())
 		return rb_funcall(self, rb_intern("to_enum"), 0);
 
+	rb_pathspec = rb_iv_get(self, "@pathspec");
+
 	while ((error = git_revwalk_next(&commit_oid, walk)) == 0) {
 		error = git_commit_lookup(&commit, repo, &commit_oid);
 		rugged_exception_check(error);
 
+		if (!NIL_P(rb_pathspec)) {
+			int touches;
+
+			error = rugged_pathspec_commit_touches(&touches, rb_pathspec, commit);
+
+			if (error < 0 || !touches) {
+				git_commit_free(commit);
+				rugged_exception_check(error);
+				continue;
+			}
+		}
+
 		rb_yield(rugged_object_new(rugged_owner(self), (git_object *)commit));
 	}
 
@@ -165,6 +181,29 @@ static VALUE rb_git_walker_hide(VALUE self, VALUE rb_commit)
 	return Qnil;
 }
 
+/*
+ *	call-seq:
+ *		walker.pathspec = pathspec
+ *
+ *	Limit the walk to the commits that change the paths selected by
+ *	+pathspec+, a Rugged::Pathspec, like <tt>git log -- <paths></tt>
+ *	does: commits that leave those paths untouched with respect to any
+ *	of their parents are skipped. Only the subtrees that the pathspec can
+ *	reach are compared. Set it to +nil+ to walk all commits again.
+ *
+ *		walker.pathspec = Rugged::Pathspec.new("lib/")
+ *		walker.push(repo.head.target)
+ *		walker.each { |commit| puts commit.oid }
+ */
+static VALUE rb_git_walker_set_pathspec(VALUE self, VALUE rb_pathspec)
+{
+	if (!NIL_P(rb_pathspec) && !rb_obj_is_kind_of(rb_pathspec, rb_cRuggedPathspec))
+		rb_raise(rb_eTypeError, "Expecting a Rugged::Pathspec instance");
+
+	rb_iv_set(self, "@pathspec", rb_pathspec);
+	return rb_pathspec;
+}
+
 static VALUE rb_git_walker_sorting(VALUE self, VALUE ruby_sort_mode)
 {
 	git_revwalk *walk;
@@ -192,4 +231,5 @@ void Init_rugged_revwalk()
 	rb_define_method(rb_cRuggedWalker, "hide", rb_git_walker_hide, 1);
 	rb_define_method(rb_cRuggedWalker, "reset", rb_git_walker_reset, 0);
 	rb_define_method(rb_cRuggedWalker, "sorting", rb_git_walker_sorting, 1);
+	rb_define_method(rb_cRuggedWalker, "pathspec=", rb_git_walker_set_pathspec, 1);
 }
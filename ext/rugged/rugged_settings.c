@@ -36,12 +36,36 @@
 
 extern VALUE rb_mRugged;
 
+static int rb_git_cache_limit_check_cb(VALUE rb_type, VALUE rb_limit, VALUE payload)
+{
+	rugged_otype_get(rb_type);
+	Check_Type(rb_limit, T_FIXNUM);
+	NUM2SIZET(rb_limit);
+	return ST_CONTINUE;
+}
+
+static int rb_git_cache_limit_cb(VALUE rb_type, VALUE rb_limit, VALUE payload)
+{
+	git_libgit2_opts(GIT_OPT_SET_CACHE_OBJECT_LIMIT, rugged_otype_get(rb_type), NUM2SIZET(rb_limit));
+	return ST_CONTINUE;
+}
+
 /*
  *	call-seq:
  *		Rugged.Settings[option] = value
  *
  *	Sets a libgit2 library option
  *
+ *	- +mwindow_size+: the size of the windows mapped over packfiles
+ *	- +mwindow_mapped_limit+: the total size of the packfile windows
+ *	  mapped at once
+ *	- +cache_max_size+: the memory the object cache of each repository
+ *	  may use, in bytes. Objects that are already parsed are never
+ *	  inflated or rebuilt from their deltas again
+ *	- +cache_object_limits+: a Hash mapping object types to the size of
+ *	  the biggest object of that type that will be cached, e.g.
+ *	  <tt>{:blob => 0, :tree => 4096}</tt>
+ *	- +enable_caching+: +true+ or +false+ to turn the object cache on or off
  */
 static VALUE rb_git_set_option(VALUE self, VALUE option, VALUE value)
 {
@@ -64,6 +88,27 @@ static VALUE rb_git_set_option(VALUE self, VALUE option, VALUE value)
 		git_libgit2_opts(GIT_OPT_SET_MWINDOW_MAPPED_LIMIT, val);
 	}
 
+	else if (strcmp(opt, "cache_max_size") == 0) {
+		Check_Type(value, T_FIXNUM);
+		git_libgit2_opts(GIT_OPT_SET_CACHE_MAX_SIZE, (ssize_t)NUM2LONG(value));
+	}
+
+	else if (strcmp(opt, "cache_object_limits") == 0) {
+		Check_Type(value, T_HASH);
+
+		/* a bad entry must not leave the limits half set */
+		rb_hash_foreach(value, rb_git_cache_limit_check_cb, Qnil);
+		rb_hash_foreach(value, rb_git_cache_limit_cb, Qnil);
+	}
+
+	else if (strcmp(opt, "enable_caching") == 0) {
+		git_libgit2_opts(GIT_OPT_ENABLE_CACHING, rugged_parse_bool(value));
+	}
+
+	else if (strcmp(opt, "cached_memory") == 0) {
+		rb_raise(rb_eArgError, "The cached_memory option is read-only");
+	}
+
 	else {
 		rb_raise(rb_eArgError, "Unknown option specified");
 	}
@@ -77,6 +122,9 @@ static VALUE rb_git_set_option(VALUE self, VALUE option, VALUE value)
  *
  *	Gets the value of a libgit2 library option
  *
+ *	Besides +mwindow_size+, +mwindow_mapped_limit+ and +cache_max_size+,
+ *	the read-only +cached_memory+ option returns the number of bytes
+ *	currently used by the object caches.
  */
 static VALUE rb_git_get_option(VALUE self, VALUE option)
 {
@@ -96,7 +144,19 @@ static VALUE rb_git_get_option(VALUE self, VALUE option)
 		git_libgit2_opts(GIT_OPT_GET_MWINDOW_MAPPED_LIMIT, &val);
 		return SIZET2NUM(val);
 	}
-	
+
+	else if (strcmp(opt, "cache_max_size") == 0) {
+		ssize_t used, max;
+		git_libgit2_opts(GIT_OPT_GET_CACHED_MEMORY, &used, &max);
+		return LL2NUM(max);
+	}
+
+	else if (strcmp(opt, "cached_memory") == 0) {
+		ssize_t used, max;
+		git_libgit2_opts(GIT_OPT_GET_CACHED_MEMORY, &used, &max);
+		return LL2NUM(used);
+	}
+
 	else {
 		rb_raise(rb_eArgError, "Unknown option specified");
 	}
@@ -0,0 +1,640 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "rugged.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern VALUE rb_mRugged;
+extern VALUE rb_cRuggedRepo;
+
+VALUE rb_cRuggedSharedObjectCache;
+
+/*
+ * Layout of the shared segment:
+ *
+ *	[header][slots][data ring]
+ *
+ * Objects are appended to the data ring by atomically bumping `head`,
+ * which only ever grows; a record written at position `pos` lives at
+ * `pos % data_size` and is valid for as long as `head <= pos + data_size`,
+ * i.e. until the ring wraps around it. That gives FIFO eviction without
+ * any bookkeeping.
+ *
+ * Slots are grouped in sets of SHARED_CACHE_WAYS, picked by hashing the
+ * OID. Each slot holds `pos + 1` of a record (0 when empty), and readers
+ * validate every record they find against its OID and position, before
+ * and after copying it out, so no locks are needed: a race can only make
+ * a lookup miss, never return the wrong data.
+ */
+#define SHARED_CACHE_MAGIC "RGDSHM01"
+#define SHARED_CACHE_WAYS 4
+#define SHARED_CACHE_DEFAULT_SIZE (64 * 1024 * 1024)
+#define SHARED_CACHE_MIN_SIZE (64 * 1024)
+#define SHARED_CACHE_PRIORITY 3 /* ahead of loose (2) and packed (1) objects */
+
+typedef struct {
+	char magic[8];
+	uint64_t size;
+	uint64_t slot_count;
+	uint64_t data_size;
+	volatile uint64_t head;
+	volatile uint64_t hits;
+	volatile uint64_t misses;
+	volatile uint64_t inserts;
+} shared_cache_header;
+
+typedef struct {
+	unsigned char oid[GIT_OID_RAWSZ];
+	uint32_t type;
+	uint64_t len;
+	volatile uint64_t pos;
+} shared_cache_record;
+
+typedef struct {
+	char *path;
+	void *map;
+	size_t map_size;
+	shared_cache_header *header;
+	volatile uint64_t *slots;
+	unsigned char *data;
+	size_t max_object_size;
+	int refcount;
+} rugged_shared_cache;
+
+typedef struct {
+	git_odb_backend parent;
+	rugged_shared_cache *cache;
+	int reading;
+} shared_cache_backend;
+
+#define SHARED_CACHE_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+static void shared_cache_unref(rugged_shared_cache *cache)
+{
+	if (__sync_sub_and_fetch(&cache->refcount, 1) > 0)
+		return;
+
+	munmap(cache->map, cache->map_size);
+	free(cache->path);
+	free(cache);
+}
+
+static volatile uint64_t *shared_cache_set(rugged_shared_cache *cache, const git_oid *oid)
+{
+	uint64_t hash;
+
+	memcpy(&hash, oid->id, sizeof(hash));
+	return cache->slots + (hash % (cache->header->slot_count / SHARED_CACHE_WAYS)) * SHARED_CACHE_WAYS;
+}
+
+static int shared_cache_live(rugged_shared_cache *cache, uint64_t pos)
+{
+	return cache->header->head <= pos + cache->header->data_size;
+}
+
+/*
+ * Find the record for `oid`, and optionally copy its contents out with
+ * the backend allocator. Returns 0 on a hit.
+ */
+static int shared_cache_lookup(void **out, size_t *len_out, git_otype *type_out,
+	rugged_shared_cache *cache, git_odb_backend *backend, const git_oid *oid)
+{
+	volatile uint64_t *set = shared_cache_set(cache, oid);
+	int i;
+
+	for (i = 0; i < SHARED_CACHE_WAYS; ++i) {
+		uint64_t slot = set[i], pos;
+		shared_cache_record *record;
+		size_t len;
+		git_otype type;
+		void *copy = NULL;
+
+		if (!slot)
+			continue;
+
+		pos = slot - 1;
+		if (!shared_cache_live(cache, pos))
+			continue;
+
+		record = (shared_cache_record *)(cache->data + pos % cache->header->data_size);
+
+		if (record->pos != pos || memcmp(record->oid, oid->id, GIT_OID_RAWSZ) != 0)
+			continue;
+
+		len = (size_t)record->len;
+		type = (git_otype)record->type;
+
+		if (pos % cache->header->data_size + sizeof(shared_cache_record) + len > cache->header->data_size)
+			continue;
+
+		if (out) {
+			if ((copy = git_odb_backend_malloc(backend, len + 1)) == NULL)
+				return -1;
+
+			memcpy(copy, record + 1, len);
+			((char *)copy)[len] = '\0';
+		}
+
+		__sync_synchronize();
+
+		/* the ring may have wrapped around the record while copying it */
+		if (record->pos != pos || !shared_cache_live(cache, pos)) {
+			free(copy);
+			continue;
+		}
+
+		if (out)
+			*out = copy;
+		*len_out = len;
+		*type_out = type;
+
+		return 0;
+	}
+
+	return GIT_ENOTFOUND;
+}
+
+static void shared_cache_insert(rugged_shared_cache *cache,
+	const git_oid *oid, git_otype type, const void *data, size_t len)
+{
+	shared_cache_header *header = cache->header;
+	uint64_t record_len = SHARED_CACHE_ALIGN(sizeof(shared_cache_record) + len);
+	volatile uint64_t *set, *victim;
+	shared_cache_record *record;
+	uint64_t pos;
+	int attempt, i;
+
+	if (len > cache->max_object_size)
+		return;
+
+	/* a record can't wrap around the end of the ring: skip the tail */
+	for (attempt = 0; attempt < 2; ++attempt) {
+		pos = __sync_fetch_and_add(&header->head, record_len);
+		if (pos % header->data_size + record_len <= header->data_size)
+			break;
+	}
+
+	if (attempt == 2)
+		return;
+
+	record = (shared_cache_record *)(cache->data + pos % header->data_size);
+
+	record->pos = UINT64_MAX;
+	__sync_synchronize();
+
+	memcpy(record->oid, oid->id, GIT_OID_RAWSZ);
+	record->type = (uint32_t)type;
+	record->len = len;
+	memcpy(record + 1, data, len);
+
+	__sync_synchronize();
+	record->pos = pos;
+	__sync_synchronize();
+
+	/* replace an empty slot, or the oldest record of the set */
+	set = shared_cache_set(cache, oid);
+	victim = &set[0];
+
+	for (i = 0; i < SHARED_CACHE_WAYS; ++i) {
+		if (set[i] == 0 || set[i] < *victim)
+			victim = &set[i];
+	}
+
+	*victim = pos + 1;
+
+	__sync_fetch_and_add(&header->inserts, 1);
+}
+
+/*
+ * On a miss, the object is read through the rest of the ODB (which
+ * recurses into this backend, hence the `reading` guard) and published
+ * to the segment for the other processes.
+ */
+static int shared_cache_backend_read(void **out, size_t *len_out, git_otype *type_out,
+	git_odb_backend *_backend, const git_oid *oid)
+{
+	shared_cache_backend *backend = (shared_cache_backend *)_backend;
+	rugged_shared_cache *cache = backend->cache;
+	git_odb_object *object;
+	size_t len;
+	int error;
+
+	if (backend->reading)
+		return GIT_ENOTFOUND;
+
+	if (shared_cache_lookup(out, len_out, type_out, cache, _backend, oid) == 0) {
+		__sync_fetch_and_add(&cache->header->hits, 1);
+		return 0;
+	}
+
+	__sync_fetch_and_add(&cache->header->misses, 1);
+
+	backend->reading = 1;
+	error = git_odb_read(&object, _backend->odb, oid);
+	backend->reading = 0;
+
+	if (error < 0)
+		return error;
+
+	len = git_odb_object_size(object);
+
+	shared_cache_insert(cache, oid, git_odb_object_type(object),
+		git_odb_object_data(object), len);
+
+	if ((*out = git_odb_backend_malloc(_backend, len + 1)) == NULL) {
+		git_odb_object_free(object);
+		return -1;
+	}
+
+	memcpy(*out, git_odb_object_data(object), len);
+	((char *)*out)[len] = '\0';
+
+	*len_out = len;
+	*type_out = git_odb_object_type(object);
+
+	git_odb_object_free(object);
+
+	return 0;
+}
+
+static int shared_cache_backend_read_header(size_t *len_out, git_otype *type_out,
+	git_odb_backend *_backend, const git_oid *oid)
+{
+	shared_cache_backend *backend = (shared_cache_backend *)_backend;
+
+	if (backend->reading)
+		return GIT_ENOTFOUND;
+
+	return shared_cache_lookup(NULL, len_out, type_out, backend->cache, _backend, oid);
+}
+
+static int shared_cache_backend_exists(git_odb_backend *_backend, const git_oid *oid)
+{
+	shared_cache_backend *backend = (shared_cache_backend *)_backend;
+	size_t len;
+	git_otype type;
+
+	if (backend->reading)
+		return 0;
+
+	return shared_cache_lookup(NULL, &len, &type, backend->cache, _backend, oid) == 0;
+}
+
+/* the cache only holds copies; the other backends list the objects */
+static int shared_cache_backend_foreach(git_odb_backend *_backend, git_odb_foreach_cb cb, void *payload)
+{
+	return 0;
+}
+
+static void shared_cache_backend_free(git_odb_backend *_backend)
+{
+	shared_cache_backend *backend = (shared_cache_backend *)_backend;
+
+	shared_cache_unref(backend->cache);
+	free(backend);
+}
+
+static int shared_cache_add_backend(git_odb *odb, rugged_shared_cache *cache)
+{
+	shared_cache_backend *backend = calloc(1, sizeof(shared_cache_backend));
+	int error;
+
+	if (!backend) {
+		giterr_set_oom();
+		return -1;
+	}
+
+	backend->parent.version = GIT_ODB_BACKEND_VERSION;
+	backend->parent.read = shared_cache_backend_read;
+	backend->parent.read_header = shared_cache_backend_read_header;
+	backend->parent.exists = shared_cache_backend_exists;
+	backend->parent.foreach = shared_cache_backend_foreach;
+	backend->parent.free = shared_cache_backend_free;
+	backend->cache = cache;
+
+	__sync_fetch_and_add(&cache->refcount, 1);
+
+	if ((error = git_odb_add_backend(odb, &backend->parent, SHARED_CACHE_PRIORITY)) < 0)
+		shared_cache_backend_free(&backend->parent);
+
+	return error;
+}
+
+static void rb_git_shared_cache__free(rugged_shared_cache *cache)
+{
+	shared_cache_unref(cache);
+}
+
+static rugged_shared_cache *rugged_shared_cache_get(VALUE rb_cache)
+{
+	rugged_shared_cache *cache;
+
+	if (!rb_obj_is_kind_of(rb_cache, rb_cRuggedSharedObjectCache))
+		rb_raise(rb_eTypeError, "Expecting a Rugged::SharedObjectCache instance");
+
+	Data_Get_Struct(rb_cache, rugged_shared_cache, cache);
+	return cache;
+}
+
+/*
+ * Check that the header of an existing segment describes a layout that
+ * fits in its `size` bytes, so neither the slots nor the ring can point
+ * past the end of the mapping.
+ */
+static int shared_cache_valid(const shared_cache_header *header, uint64_t size)
+{
+	uint64_t max_slots = (size - sizeof(shared_cache_header)) / sizeof(uint64_t);
+
+	return memcmp(header->magic, SHARED_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+		header->size == size &&
+		header->slot_count >= SHARED_CACHE_WAYS &&
+		header->slot_count % SHARED_CACHE_WAYS == 0 &&
+		header->slot_count <= max_slots &&
+		header->data_size > sizeof(shared_cache_record) &&
+		header->data_size <= (max_slots - header->slot_count) * sizeof(uint64_t);
+}
+
+/* An all-zero magic: a segment whose creator died before laying it out */
+static int shared_cache_blank(const shared_cache_header *header)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(header->magic); ++i) {
+		if (header->magic[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Create and lay out the segment, unless another process already did.
+ * The file lock only serializes initialization; lookups and inserts
+ * never take it.
+ *
+ * Returns -1 with errno set on a system error, and -2 if the file exists
+ * but isn't a shared object cache. Other files are never overwritten.
+ */
+static int shared_cache_open(rugged_shared_cache *cache, uint64_t size)
+{
+	shared_cache_header *header;
+	uint64_t slot_count;
+	struct stat st;
+	int fd;
+
+	if ((fd = open(cache->path, O_RDWR | O_CREAT, 0600)) < 0)
+		return -1;
+
+	if (flock(fd, LOCK_EX) < 0 || fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	/* an existing segment is reused as the first process laid it out */
+	if (st.st_size != 0) {
+		if ((uint64_t)st.st_size < SHARED_CACHE_MIN_SIZE) {
+			close(fd);
+			return -2;
+		}
+
+		size = st.st_size;
+	} else if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	cache->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (cache->map == MAP_FAILED) {
+		cache->map = NULL;
+		close(fd);
+		return -1;
+	}
+
+	cache->map_size = size;
+	header = cache->header = cache->map;
+
+	if (!shared_cache_valid(header, size)) {
+		/* a new file is all zeroes; anything else belongs to someone */
+		if (!shared_cache_blank(header)) {
+			munmap(cache->map, size);
+			cache->map = NULL;
+			close(fd);
+			return -2;
+		}
+
+		slot_count = (size / 4096) / SHARED_CACHE_WAYS * SHARED_CACHE_WAYS;
+		if (slot_count < SHARED_CACHE_WAYS)
+			slot_count = SHARED_CACHE_WAYS;
+
+		memset(cache->map, 0x0, sizeof(shared_cache_header) + slot_count * sizeof(uint64_t));
+
+		header->size = size;
+		header->slot_count = slot_count;
+		header->data_size = (size - sizeof(shared_cache_header) - slot_count * sizeof(uint64_t)) & ~(uint64_t)7;
+
+		__sync_synchronize();
+		memcpy(header->magic, SHARED_CACHE_MAGIC, sizeof(header->magic));
+	}
+
+	cache->slots = (volatile uint64_t *)(header + 1);
+	cache->data = (unsigned char *)(cache->slots + header->slot_count);
+
+	flock(fd, LOCK_UN);
+	close(fd);
+
+	return 0;
+}
+
+/*
+ *	call-seq:
+ *		SharedObjectCache.new(path, options = {}) -> cache
+ *
+ *	Open (or create) a cache of inflated objects in the file at +path+,
+ *	which should live on a memory filesystem such as <tt>/dev/shm</tt>,
+ *	and which is mapped into memory and shared by every process that
+ *	opens it.
+ *
+ *	The cache is a fixed-size ring: new objects overwrite the oldest
+ *	ones. Lookups and inserts are lock-free, so any number of processes
+ *	can use it concurrently. Attach it to repositories with
+ *	Rugged::Repository#add_shared_object_cache.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:size ::
+ *	  The size of the segment in bytes, when creating it. Defaults to
+ *	  64MB. An existing segment is always used with its own size.
+ *
+ *	Raises +ArgumentError+ if +path+ is an existing file other than a
+ *	shared object cache; it is left untouched.
+ *
+ *	:max_object_size ::
+ *	  Objects bigger than this many bytes are never cached. Defaults to
+ *	  1/16th of the segment size.
+ */
+static VALUE rb_git_shared_cache_new(int argc, VALUE *argv, VALUE klass)
+{
+	rugged_shared_cache *cache;
+	VALUE rb_path, rb_options, rb_size = Qnil, rb_max_object_size = Qnil, rb_cache;
+	uint64_t size = SHARED_CACHE_DEFAULT_SIZE;
+	int error;
+
+	rb_scan_args(argc, argv, "11", &rb_path, &rb_options);
+	Check_Type(rb_path, T_STRING);
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+		rb_size = rb_hash_aref(rb_options, CSTR2SYM("size"));
+		rb_max_object_size = rb_hash_aref(rb_options, CSTR2SYM("max_object_size"));
+	}
+
+	if (!NIL_P(rb_size)) {
+		size = NUM2ULL(rb_size);
+		if (size < SHARED_CACHE_MIN_SIZE)
+			rb_raise(rb_eArgError, "The shared object cache must be at least 64KB");
+	}
+
+	cache = calloc(1, sizeof(rugged_shared_cache));
+	if (!cache || !(cache->path = strdup(StringValueCStr(rb_path)))) {
+		free(cache);
+		rb_raise(rb_eNoMemError, "Out of memory");
+	}
+
+	if ((error = shared_cache_open(cache, size)) < 0) {
+		int err = errno;
+
+		free(cache->path);
+		free(cache);
+
+		if (error == -2)
+			rb_raise(rb_eArgError, "'%s' is not a shared object cache", StringValueCStr(rb_path));
+
+		errno = err;
+		rb_sys_fail(StringValueCStr(rb_path));
+	}
+
+	cache->refcount = 1;
+	cache->max_object_size = NIL_P(rb_max_object_size) ?
+		(size_t)(cache->header->data_size / 16) : NUM2SIZET(rb_max_object_size);
+
+	rb_cache = Data_Wrap_Struct(klass, NULL, rb_git_shared_cache__free, cache);
+	rb_iv_set(rb_cache, "@path", rb_path);
+
+	return rb_cache;
+}
+
+/*
+ *	call-seq:
+ *		cache.stats -> hash
+ *
+ *	Return a Hash with the +:hits+, +:misses+ and +:inserts+ counted by
+ *	all the processes using the segment, and its +:size+ in bytes.
+ */
+static VALUE rb_git_shared_cache_stats(VALUE self)
+{
+	rugged_shared_cache *cache = rugged_shared_cache_get(self);
+	VALUE rb_stats = rb_hash_new();
+
+	rb_hash_aset(rb_stats, CSTR2SYM("hits"), ULL2NUM(cache->header->hits));
+	rb_hash_aset(rb_stats, CSTR2SYM("misses"), ULL2NUM(cache->header->misses));
+	rb_hash_aset(rb_stats, CSTR2SYM("inserts"), ULL2NUM(cache->header->inserts));
+	rb_hash_aset(rb_stats, CSTR2SYM("size"), ULL2NUM(cache->header->size));
+
+	return rb_stats;
+}
+
+/*
+ * Add every shared cache attached to `rb_repo` to `odb`; used when a
+ * repository gets a new object database, e.g. after forking.
+ */
+int rugged_shared_cache_attach(VALUE rb_repo, git_odb *odb)
+{
+	VALUE rb_caches = rb_attr_get(rb_repo, rb_intern("shared_object_caches"));
+	long i;
+	int error = 0;
+
+	if (NIL_P(rb_caches))
+		return 0;
+
+	for (i = 0; i < RARRAY_LEN(rb_caches) && !error; ++i)
+		error = shared_cache_add_backend(odb, rugged_shared_cache_get(rb_ary_entry(rb_caches, i)));
+
+	return error;
+}
+
+/*
+ *	call-seq:
+ *		repo.add_shared_object_cache(cache) -> nil
+ *
+ *	Put the Rugged::SharedObjectCache +cache+ in front of the packed and
+ *	loose objects of the repository: objects read by any process using
+ *	the same cache are served from it, without being inflated or
+ *	rebuilt from their deltas again.
+ */
+static VALUE rb_git_repo_add_shared_object_cache(VALUE self, VALUE rb_cache)
+{
+	rugged_shared_cache *cache = rugged_shared_cache_get(rb_cache);
+	git_repository *repo;
+	git_odb *odb;
+	VALUE rb_caches;
+	int error;
+
+	Data_Get_Struct(self, git_repository, repo);
+
+	error = git_repository_odb(&odb, repo);
+	rugged_exception_check(error);
+
+	error = shared_cache_add_backend(odb, cache);
+	git_odb_free(odb);
+	rugged_exception_check(error);
+
+	rb_caches = rb_attr_get(self, rb_intern("shared_object_caches"));
+	if (NIL_P(rb_caches)) {
+		rb_caches = rb_ary_new();
+		rb_ivar_set(self, rb_intern("shared_object_caches"), rb_caches);
+	}
+	rb_ary_push(rb_caches, rb_cache);
+
+	return Qnil;
+}
+
+void Init_rugged_shared_cache()
+{
+	rb_cRuggedSharedObjectCache = rb_define_class_under(rb_mRugged, "SharedObjectCache", rb_cObject);
+	rb_undef_alloc_func(rb_cRuggedSharedObjectCache);
+
+	rb_define_singleton_method(rb_cRuggedSharedObjectCache, "new", rb_git_shared_cache_new, -1);
+	rb_define_method(rb_cRuggedSharedObjectCache, "stats", rb_git_shared_cache_stats, 0);
+	rb_define_attr(rb_cRuggedSharedObjectCache, "path", 1, 0);
+
+	rb_define_method(rb_cRuggedRepo, "add_shared_object_cache", rb_git_repo_add_shared_object_cache, 1);
+}
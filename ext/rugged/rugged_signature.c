@@ -24,15 +24,160 @@
 
 #include "rugged.h"
 
-VALUE rugged_signature_new(const git_signature *sig, const char *encoding_name)
+extern VALUE rb_mRugged;
+VALUE rb_cRuggedSignature;
+
+/*
+ * Upper bound on the number of distinct strings interned per repository,
+ * so that a pathological history can't grow the table without limit.
+ * Strings past this point are simply allocated as usual.
+ */
+#define RUGGED_INTERN_MAX 16384
+
+typedef struct {
+	const char *ptr;
+	size_t len;
+	const void *enc;
+} rugged_intern_key;
+
+typedef struct {
+	st_table *strings;
+} rugged_intern_table;
+
+static int intern_key_cmp(st_data_t a, st_data_t b)
+{
+	const rugged_intern_key *ka = (const rugged_intern_key *)a;
+	const rugged_intern_key *kb = (const rugged_intern_key *)b;
+
+	if (ka->len != kb->len || ka->enc != kb->enc)
+		return 1;
+
+	return memcmp(ka->ptr, kb->ptr, ka->len);
+}
+
+static st_index_t intern_key_hash(st_data_t a)
+{
+	const rugged_intern_key *key = (const rugged_intern_key *)a;
+	st_index_t h = 5381;
+	size_t i;
+
+	for (i = 0; i < key->len; ++i)
+		h = (h << 5) + h + (unsigned char)key->ptr[i];
+
+	return h ^ (st_index_t)key->enc;
+}
+
+static const struct st_hash_type intern_hash_type = {
+	intern_key_cmp,
+	intern_key_hash,
+};
+
+static int intern_mark_cb(st_data_t key, st_data_t value, st_data_t unused)
+{
+	rb_gc_mark((VALUE)value);
+	return ST_CONTINUE;
+}
+
+static void rb_git_intern__mark(rugged_intern_table *table)
+{
+	st_foreach(table->strings, intern_mark_cb, 0);
+}
+
+static int intern_free_cb(st_data_t key, st_data_t value, st_data_t unused)
+{
+	xfree((void *)key);
+	return ST_CONTINUE;
+}
+
+static void rb_git_intern__free(rugged_intern_table *table)
+{
+	st_foreach(table->strings, intern_free_cb, 0);
+	st_free_table(table->strings);
+	xfree(table);
+}
+
+/*
+ * The intern table lives in a hidden instance variable of the
+ * repository, so it is released together with it.
+ */
+static rugged_intern_table *rugged_intern_table_get(VALUE rb_repo)
 {
-	VALUE rb_sig, rb_time;
+	static ID id_intern = 0;
+	rugged_intern_table *table;
+	VALUE rb_table;
+
+	if (!id_intern)
+		id_intern = rb_intern("signature_strings");
+
+	rb_table = rb_attr_get(rb_repo, id_intern);
+
+	if (NIL_P(rb_table)) {
+		table = xmalloc(sizeof(rugged_intern_table));
+		table->strings = st_init_table(&intern_hash_type);
+
+		rb_table = Data_Wrap_Struct(rb_cObject,
+			rb_git_intern__mark, rb_git_intern__free, table);
+		rb_ivar_set(rb_repo, id_intern, rb_table);
+	} else {
+		Data_Get_Struct(rb_table, rugged_intern_table, table);
+	}
+
+	return table;
+}
+
+#ifdef HAVE_RUBY_ENCODING_H
+static VALUE rugged_intern_str(rugged_intern_table *table, const char *str, rb_encoding *encoding)
+#else
+static VALUE rugged_intern_str(rugged_intern_table *table, const char *str, void *encoding)
+#endif
+{
+	rugged_intern_key lookup, *key;
+	st_data_t value;
+	VALUE rb_str;
+
+	lookup.ptr = str;
+	lookup.len = strlen(str);
+	lookup.enc = encoding;
+
+	if (st_lookup(table->strings, (st_data_t)&lookup, &value))
+		return (VALUE)value;
+
+	rb_str = rugged_str_new(str, lookup.len, encoding);
+
+	if (table->strings->num_entries >= RUGGED_INTERN_MAX)
+		return rb_str;
+
+	OBJ_FREEZE(rb_str);
+
+	key = xmalloc(sizeof(rugged_intern_key) + lookup.len);
+	memcpy(key + 1, str, lookup.len);
+	key->ptr = (const char *)(key + 1);
+	key->len = lookup.len;
+	key->enc = encoding;
+
+	st_insert(table->strings, (st_data_t)key, (st_data_t)rb_str);
+	return rb_str;
+}
+
+/*
+ * Build the Ruby +Hash+ for a signature.
+ *
+ * When +rb_repo+ is not nil, the name and email strings are interned in
+ * the repository: walking a long history will share the same frozen
+ * +String+ for every appearance of an author, instead of allocating two
+ * new ones for each commit.
+ */
+VALUE rugged_signature_new(const git_signature *sig, const char *encoding_name, VALUE rb_repo)
+{
+	VALUE rb_sig, rb_time, rb_name, rb_email;
 
 #ifdef HAVE_RUBY_ENCODING_H
 	rb_encoding *encoding = NULL;
 
 	if (encoding_name != NULL)
 		encoding = rb_enc_find(encoding_name);
+#else
+	void *encoding = NULL;
 #endif
 
 	rb_sig = rb_hash_new();
@@ -49,19 +194,51 @@ VALUE rugged_signature_new(const git_signature *sig, const char *encoding_name)
 	rb_hash_aset(rb_sig, CSTR2SYM("time_offset"), INT2FIX(sig->when.offset * 60));
 #endif
 
-	rb_hash_aset(rb_sig, CSTR2SYM("name"), rugged_str_new2(sig->name, encoding));
-	rb_hash_aset(rb_sig, CSTR2SYM("email"), rugged_str_new2(sig->email, encoding));
+	if (NIL_P(rb_repo)) {
+		rb_name = rugged_str_new2(sig->name, encoding);
+		rb_email = rugged_str_new2(sig->email, encoding);
+	} else {
+		rugged_intern_table *table = rugged_intern_table_get(rb_repo);
+		rb_name = rugged_intern_str(table, sig->name, encoding);
+		rb_email = rugged_intern_str(table, sig->email, encoding);
+	}
+
+	rb_hash_aset(rb_sig, CSTR2SYM("name"), rb_name);
+	rb_hash_aset(rb_sig, CSTR2SYM("email"), rb_email);
 	rb_hash_aset(rb_sig, CSTR2SYM("time"), rb_time);
 
 	return rb_sig;
 }
 
+/*
+ * Return the signature held by a Rugged::Signature, raising if it was
+ * never initialized (e.g. created with +allocate+).
+ */
+const git_signature *rugged_signature_unwrap(VALUE rb_sig)
+{
+	git_signature *sig;
+	Data_Get_Struct(rb_sig, git_signature, sig);
+
+	if (!sig)
+		rb_raise(rb_eRuntimeError, "uninitialized Rugged::Signature");
+
+	return sig;
+}
+
 git_signature *rugged_signature_get(VALUE rb_sig)
 {
 	int error;
 	VALUE rb_time, rb_unix_t, rb_offset, rb_name, rb_email, rb_time_offset;
 	git_signature *sig;
 
+	if (rb_obj_is_kind_of(rb_sig, rb_cRuggedSignature)) {
+		sig = git_signature_dup(rugged_signature_unwrap(rb_sig));
+		if (sig == NULL)
+			rb_raise(rb_eNoMemError, "Failed to duplicate signature");
+
+		return sig;
+	}
+
 	Check_Type(rb_sig, T_HASH);
 
 	rb_name = rb_hash_aref(rb_sig, CSTR2SYM("name"));
@@ -94,3 +271,111 @@ git_signature *rugged_signature_get(VALUE rb_sig)
 	return sig;
 }
 
+static void rb_git_signature__free(git_signature *sig)
+{
+	git_signature_free(sig);
+}
+
+static VALUE rb_git_signature_allocate(VALUE klass)
+{
+	return Data_Wrap_Struct(klass, NULL, &rb_git_signature__free, NULL);
+}
+
+/*
+ *	call-seq:
+ *		Signature.new(name, email, time = Time.now) -> signature
+ *
+ *	Create a new signature for +name+ and +email+ at the given +time+.
+ *
+ *	Unlike the +Hash+ signatures returned by +Commit#author+ and friends,
+ *	a +Signature+ is parsed only once, and can be passed many times to
+ *	methods that write objects (e.g. +Commit.create_raw+) without being
+ *	rebuilt each time.
+ *
+ *		sig = Rugged::Signature.new("Vicent Mart\303\255", "tanoku@gmail.com")
+ */
+static VALUE rb_git_signature_init(int argc, VALUE *argv, VALUE self)
+{
+	VALUE rb_name, rb_email, rb_time;
+	git_signature *sig;
+	int error;
+
+	rb_scan_args(argc, argv, "21", &rb_name, &rb_email, &rb_time);
+
+	Check_Type(rb_name, T_STRING);
+	Check_Type(rb_email, T_STRING);
+
+	if (NIL_P(rb_time)) {
+		error = git_signature_now(&sig,
+			StringValueCStr(rb_name), StringValueCStr(rb_email));
+	} else {
+		if (!rb_obj_is_kind_of(rb_time, rb_cTime))
+			rb_raise(rb_eTypeError, "expected Time object");
+
+		error = git_signature_new(&sig,
+			StringValueCStr(rb_name),
+			StringValueCStr(rb_email),
+			NUM2LONG(rb_funcall(rb_time, rb_intern("tv_sec"), 0)),
+			FIX2INT(rb_funcall(rb_time, rb_intern("utc_offset"), 0)) / 60);
+	}
+
+	rugged_exception_check(error);
+
+	/* initialize can be called again on the same object */
+	git_signature_free(DATA_PTR(self));
+
+	DATA_PTR(self) = sig;
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		signature.name -> name
+ *
+ *	Return the name of the person in this +signature+.
+ */
+static VALUE rb_git_signature_name(VALUE self)
+{
+	const git_signature *sig = rugged_signature_unwrap(self);
+	return rugged_str_new2(sig->name, rb_utf8_encoding());
+}
+
+/*
+ *	call-seq:
+ *		signature.email -> email
+ *
+ *	Return the email of the person in this +signature+.
+ */
+static VALUE rb_git_signature_email(VALUE self)
+{
+	const git_signature *sig = rugged_signature_unwrap(self);
+	return rugged_str_new2(sig->email, rb_utf8_encoding());
+}
+
+/*
+ *	call-seq:
+ *		signature.time -> time
+ *
+ *	Return the time of this +signature+, in the timezone it was
+ *	recorded with.
+ */
+static VALUE rb_git_signature_time(VALUE self)
+{
+	const git_signature *sig = rugged_signature_unwrap(self);
+
+	return rb_funcall(
+		rb_time_new(sig->when.time, 0),
+		rb_intern("getlocal"), 1,
+		INT2FIX(sig->when.offset * 60)
+	);
+}
+
+void Init_rugged_signature()
+{
+	rb_cRuggedSignature = rb_define_class_under(rb_mRugged, "Signature", rb_cObject);
+	rb_define_alloc_func(rb_cRuggedSignature, rb_git_signature_allocate);
+	rb_define_method(rb_cRuggedSignature, "initialize", rb_git_signature_init, -1);
+	rb_define_method(rb_cRuggedSignature, "name", rb_git_signature_name, 0);
+	rb_define_method(rb_cRuggedSignature, "email", rb_git_signature_email, 0);
+	rb_define_method(rb_cRuggedSignature, "time", rb_git_signature_time, 0);
+}
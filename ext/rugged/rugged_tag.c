@@ -133,7 +133,7 @@ static VALUE rb_git_tag_tagger_GET(VALUE self)
 	if (!tagger)
 		return Qnil;
 
-	return rugged_signature_new(tagger, NULL);
+	return rugged_signature_new(tagger, NULL, rugged_owner(self));
 }
 
 /*
@@ -159,13 +159,20 @@ static VALUE rb_git_tag_message_GET(VALUE self)
 	return rugged_str_new2(message, NULL);
 }
 
+static void tag_ref_fsync(VALUE rb_repo, const char *name)
+{
+	VALUE rb_refname = rb_str_new2("refs/tags/");
+	rb_str_cat2(rb_refname, name);
+	rugged_ref_fsync(rb_repo, StringValueCStr(rb_refname));
+}
+
 static VALUE rb_git_tag_create(VALUE self, VALUE rb_repo, VALUE rb_data)
 {
 	git_oid tag_oid;
 	git_repository *repo = NULL;
 	int error, force = 0;
 
-	VALUE rb_name, rb_target, rb_tagger, rb_message, rb_force;
+	VALUE rb_name = Qnil, rb_target, rb_tagger, rb_message, rb_force;
 
 	if (!rb_obj_is_kind_of(rb_repo, rb_cRuggedRepo))
 		rb_raise(rb_eTypeError, "Expecting a Rugged::Repository instance");
@@ -231,6 +238,19 @@ static VALUE rb_git_tag_create(VALUE self, VALUE rb_repo, VALUE rb_data)
 	}
 
 	rugged_exception_check(error);
+
+	if (NIL_P(rb_name)) {
+		git_tag *tag;
+
+		error = git_tag_lookup(&tag, repo, &tag_oid);
+		rugged_exception_check(error);
+
+		rb_name = rugged_str_new2(git_tag_name(tag), NULL);
+		git_tag_free(tag);
+	}
+
+	tag_ref_fsync(rb_repo, StringValueCStr(rb_name));
+
 	return rugged_create_oid(&tag_oid);
 }
 
@@ -281,6 +301,7 @@ static VALUE rb_git_tag_delete(VALUE self, VALUE rb_repo, VALUE rb_name)
 
 	error = git_tag_delete(repo, StringValueCStr(rb_name));
 	rugged_exception_check(error);
+	tag_ref_fsync(rb_repo, StringValueCStr(rb_name));
 	return Qnil;
 }
 
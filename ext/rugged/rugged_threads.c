@@ -0,0 +1,401 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "rugged.h"
+
+#include <unistd.h>
+
+#ifdef RUGGED_THREADS
+#	include <pthread.h>
+#	ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+#		include <ruby/thread.h>
+#	endif
+#endif
+
+typedef struct {
+	rugged_pool *pool;
+	size_t worker;
+} rugged_pool_thread;
+
+struct rugged_pool {
+	rugged_pool_job_cb job_cb;
+	rugged_pool_report_cb report_cb;
+	void *payload;
+
+	size_t job_count, next_job, done, reported;
+
+	/* jobs given up halfway because of an interrupt, handed out first */
+	size_t retry[RUGGED_POOL_MAX_THREADS];
+	size_t retry_count;
+
+	int error;
+	int error_class;
+	char error_message[256];
+
+	/* also read by the jobs, without the lock */
+	volatile int interrupted, cancelled;
+
+#ifdef RUGGED_THREADS
+	rugged_pool_thread threads[RUGGED_POOL_MAX_THREADS];
+	pthread_t thread_ids[RUGGED_POOL_MAX_THREADS];
+	size_t started, running;
+	pthread_mutex_t lock;
+	pthread_cond_t progress, resume;
+#endif
+};
+
+/*
+ * How many threads to use by default: one per CPU, up to `max`, or
+ * none at all when the GVL can't be released.
+ */
+size_t rugged_pool_threads(size_t max)
+{
+#ifdef RUGGED_THREADS
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads = cpus > 0 ? (size_t)cpus : 1;
+
+	if (max > RUGGED_POOL_MAX_THREADS)
+		max = RUGGED_POOL_MAX_THREADS;
+
+	return threads < max ? threads : max;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Whether the calling thread is waiting for the jobs to stop. Long jobs
+ * should check it from time to time, and return RUGGED_POOL_RETRY to be
+ * run again from the start if the pool resumes.
+ */
+int rugged_pool_interrupted(const rugged_pool *pool)
+{
+	return pool->interrupted || pool->cancelled;
+}
+
+static void pool_fail(rugged_pool *pool, int error)
+{
+	const git_error *last = giterr_last();
+
+	if (pool->error < 0)
+		return;
+
+	pool->error = error;
+	pool->error_class = last ? last->klass : GITERR_INVALID;
+	snprintf(pool->error_message, sizeof(pool->error_message), "%s",
+		last ? last->message : "A worker thread failed");
+}
+
+static int pool_next(rugged_pool *pool, size_t *job)
+{
+	if (pool->cancelled || pool->error < 0)
+		return 0;
+
+	if (pool->retry_count > 0) {
+		*job = pool->retry[--pool->retry_count];
+		return 1;
+	}
+
+	if (pool->next_job == pool->job_count)
+		return 0;
+
+	*job = pool->next_job++;
+	return 1;
+}
+
+static void pool_finish(rugged_pool *pool, size_t job, int error)
+{
+	if (error == RUGGED_POOL_RETRY)
+		pool->retry[pool->retry_count++] = job;
+	else if (error < 0)
+		pool_fail(pool, error);
+	else
+		pool->done++;
+}
+
+static void pool_run_serial(rugged_pool *pool)
+{
+	size_t job;
+
+	while (pool_next(pool, &job)) {
+		rb_thread_check_ints();
+
+		pool_finish(pool, job, pool->job_cb(pool, 0, job, pool->payload));
+
+		if (pool->report_cb && pool->done != pool->reported) {
+			pool->reported = pool->done;
+			pool->report_cb(pool->reported, pool->payload);
+		}
+	}
+}
+
+#ifdef RUGGED_THREADS
+/*
+ * Run jobs until there are none left. While the calling thread handles
+ * an interrupt, the other workers wait to be resumed or cancelled, and
+ * the calling thread itself returns.
+ */
+static void pool_work(rugged_pool *pool, size_t worker, int caller)
+{
+	pthread_mutex_lock(&pool->lock);
+
+	for (;;) {
+		size_t job;
+		int error;
+
+		while (!caller && pool->interrupted && !pool->cancelled)
+			pthread_cond_wait(&pool->resume, &pool->lock);
+
+		if ((caller && pool->interrupted) || !pool_next(pool, &job))
+			break;
+
+		pthread_mutex_unlock(&pool->lock);
+		error = pool->job_cb(pool, worker, job, pool->payload);
+		pthread_mutex_lock(&pool->lock);
+
+		pool_finish(pool, job, error);
+		pthread_cond_signal(&pool->progress);
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void *pool_thread(void *payload)
+{
+	rugged_pool_thread *thread = payload;
+	rugged_pool *pool = thread->pool;
+
+	pool_work(pool, thread->worker, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->running--;
+	pthread_cond_signal(&pool->progress);
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/*
+ * Runs without the GVL. The calling thread is a worker as well, unless
+ * it reports progress: then it sleeps until there is some to report.
+ */
+static void *pool_wait(void *payload)
+{
+	rugged_pool *pool = payload;
+
+	if (!pool->report_cb)
+		pool_work(pool, 0, 1);
+
+	pthread_mutex_lock(&pool->lock);
+
+	while (pool->running > 0 && !pool->interrupted &&
+		(!pool->report_cb || pool->done == pool->reported))
+		pthread_cond_wait(&pool->progress, &pool->lock);
+
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/*
+ * Only pauses the jobs and wakes up the calling thread: whether to
+ * resume or raise is decided once it holds the GVL again.
+ */
+static void pool_unblock(void *payload)
+{
+	rugged_pool *pool = payload;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->interrupted = 1;
+	pthread_cond_broadcast(&pool->progress);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Pending interrupts are also checked when the GVL is acquired again,
+ * so this may raise with the workers still running.
+ */
+static VALUE pool_wait_blocking(VALUE payload)
+{
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+	rb_thread_call_without_gvl(pool_wait, (void *)payload, pool_unblock, (void *)payload);
+#else
+	rb_thread_blocking_region((rb_blocking_function_t *)pool_wait,
+		(void *)payload, pool_unblock, (void *)payload);
+#endif
+	return Qnil;
+}
+
+static VALUE pool_check_ints(VALUE payload)
+{
+	rb_thread_check_ints();
+	return Qnil;
+}
+
+static VALUE pool_report(VALUE payload)
+{
+	rugged_pool *pool = (rugged_pool *)payload;
+
+	pool->report_cb(pool->reported, pool->payload);
+	return Qnil;
+}
+
+static void pool_join(rugged_pool *pool)
+{
+	size_t i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->cancelled = 1;
+	pthread_cond_broadcast(&pool->resume);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->started; ++i)
+		pthread_join(pool->thread_ids[i], NULL);
+
+	pthread_cond_destroy(&pool->resume);
+	pthread_cond_destroy(&pool->progress);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+/*
+ * Returns -1 without running any job when the pool reports progress but
+ * no thread could be started. Exceptions raised by the progress callback
+ * or by a pending interrupt are re-raised once every thread is joined.
+ */
+static int pool_run_threads(rugged_pool *pool, size_t threads)
+{
+	size_t i, completed;
+	int state = 0, done, interrupted;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->progress, NULL);
+	pthread_cond_init(&pool->resume, NULL);
+
+	pthread_mutex_lock(&pool->lock);
+
+	for (i = pool->report_cb ? 0 : 1; i < threads; ++i) {
+		rugged_pool_thread *thread = &pool->threads[pool->started];
+
+		thread->pool = pool;
+		thread->worker = i;
+
+		if (pthread_create(&pool->thread_ids[pool->started], NULL, pool_thread, thread) != 0)
+			break;
+
+		pool->started++;
+		pool->running++;
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+
+	if (pool->report_cb && !pool->started) {
+		pthread_cond_destroy(&pool->resume);
+		pthread_cond_destroy(&pool->progress);
+		pthread_mutex_destroy(&pool->lock);
+		return -1;
+	}
+
+	do {
+		rb_protect(pool_wait_blocking, (VALUE)pool, &state);
+
+		pthread_mutex_lock(&pool->lock);
+		interrupted = pool->interrupted;
+		done = pool->running == 0 && !interrupted;
+		completed = pool->done;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (!state && pool->report_cb && completed != pool->reported) {
+			pool->reported = completed;
+			rb_protect(pool_report, (VALUE)pool, &state);
+		}
+
+		/*
+		 * A pending exception (e.g. Interrupt) is raised once the workers
+		 * are stopped. After a trap handler or Thread#wakeup, the jobs
+		 * just resume.
+		 */
+		if (!state && interrupted) {
+			rb_protect(pool_check_ints, Qnil, &state);
+
+			pthread_mutex_lock(&pool->lock);
+			pool->interrupted = 0;
+			pthread_cond_broadcast(&pool->resume);
+			pthread_mutex_unlock(&pool->lock);
+		}
+	} while (!state && !done);
+
+	pool_join(pool);
+
+	if (state)
+		rb_jump_tag(state);
+
+	return 0;
+}
+#endif
+
+/*
+ * Run jobs 0 to `job_count - 1` through `job_cb` on up to `threads`
+ * threads, without the GVL. With no `report_cb`, the calling thread is
+ * one of the workers; otherwise it calls `report_cb` with the number of
+ * jobs done, holding the GVL, as they complete. With 0 `threads`, or
+ * when the GVL can't be released, the jobs run one after the other on
+ * the calling thread, which keeps the GVL.
+ *
+ * Jobs return 0, or an error to stop handing out the remaining ones.
+ * Returns the first error, which is then also the last libgit2 error of
+ * the calling thread.
+ */
+int rugged_pool_run(size_t threads, size_t job_count,
+	rugged_pool_job_cb job_cb, rugged_pool_report_cb report_cb, void *payload)
+{
+	rugged_pool pool;
+
+	memset(&pool, 0x0, sizeof(pool));
+	pool.job_cb = job_cb;
+	pool.report_cb = report_cb;
+	pool.payload = payload;
+	pool.job_count = job_count;
+
+	if (threads > job_count)
+		threads = job_count;
+
+	if (threads > RUGGED_POOL_MAX_THREADS)
+		threads = RUGGED_POOL_MAX_THREADS;
+
+#ifdef RUGGED_THREADS
+	if (!threads || pool_run_threads(&pool, threads) < 0)
+#endif
+		pool_run_serial(&pool);
+
+	if (pool.error < 0) {
+		giterr_set_str(pool.error_class, pool.error_message);
+		return pool.error;
+	}
+
+	/* jobs completed after the last report */
+	if (report_cb && pool.done != pool.reported)
+		report_cb(pool.done, payload);
+
+	return 0;
+}
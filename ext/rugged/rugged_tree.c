@@ -24,6 +24,9 @@
 
 #include "rugged.h"
 
+#include <ctype.h>
+#include <fnmatch.h>
+
 extern VALUE rb_mRugged;
 extern VALUE rb_cRuggedObject;
 extern VALUE rb_cRuggedRepo;
@@ -282,7 +285,8 @@ static VALUE rb_git_tree_path(VALUE self, VALUE rb_path)
  *
  *  :paths ::
  *    An array of paths / fnmatch patterns to constrain the diff to a specific
- *    set of files. Also see +:disable_pathspec_match+.
+ *    set of files, or a precompiled Rugged::Pathspec. Also see
+ *    +:disable_pathspec_match+.
  *
  *  :max_size ::
  *    An integer specifying the maximum byte size of a file before a it will
@@ -429,6 +433,841 @@ static VALUE rb_git_tree_diff(int argc, VALUE *argv, VALUE self)
 	return rugged_diff_new(rb_cRuggedDiff, self, diff);
 }
 
+typedef struct {
+	git_repository *repo;
+	VALUE rb_changes;
+	char *path;
+	size_t path_len, path_alloc;
+	const char **prefixes;
+	size_t *prefix_lens;
+	long prefix_count;
+} rugged_changed_paths;
+
+static void changed_path_push(rugged_changed_paths *walk, const char *name)
+{
+	size_t name_len = strlen(name);
+	size_t needed = walk->path_len + name_len + 2;
+
+	if (needed > walk->path_alloc) {
+		walk->path_alloc = needed * 2;
+		walk->path = xrealloc(walk->path, walk->path_alloc);
+	}
+
+	if (walk->path_len)
+		walk->path[walk->path_len++] = '/';
+
+	memcpy(walk->path + walk->path_len, name, name_len + 1);
+	walk->path_len += name_len;
+}
+
+/*
+ * Check the current path against the :paths filter. Returns 1 if the path
+ * is selected, and 2 if it is a directory that leads to a selected path
+ * (so it has to be walked into, but is not selected itself).
+ */
+static int changed_path_selected(rugged_changed_paths *walk, int is_tree)
+{
+	long i;
+	int result = 0;
+
+	if (!walk->prefix_count)
+		return 1;
+
+	for (i = 0; i < walk->prefix_count; ++i) {
+		const char *prefix = walk->prefixes[i];
+		size_t prefix_len = walk->prefix_lens[i];
+
+		/* "", "/" and the like select the whole tree */
+		if (!prefix_len)
+			return 1;
+
+		if (prefix_len <= walk->path_len) {
+			if (!memcmp(walk->path, prefix, prefix_len) &&
+				(prefix_len == walk->path_len || walk->path[prefix_len] == '/'))
+				return 1;
+		} else if (is_tree && !memcmp(walk->path, prefix, walk->path_len) &&
+			prefix[walk->path_len] == '/') {
+			result = 2;
+		}
+	}
+
+	return result;
+}
+
+/* Order tree entries the way git sorts them, with trees suffixed by '/' */
+int rugged_tree_entry_cmp(const git_tree_entry *a, const git_tree_entry *b)
+{
+	const unsigned char *name_a = (const unsigned char *)git_tree_entry_name(a);
+	const unsigned char *name_b = (const unsigned char *)git_tree_entry_name(b);
+	unsigned char c_a, c_b;
+
+	while (*name_a && *name_a == *name_b)
+		name_a++, name_b++;
+
+	c_a = *name_a;
+	c_b = *name_b;
+
+	if (!c_a && git_tree_entry_type(a) == GIT_OBJ_TREE)
+		c_a = '/';
+	if (!c_b && git_tree_entry_type(b) == GIT_OBJ_TREE)
+		c_b = '/';
+
+	return (int)c_a - (int)c_b;
+}
+
+static void changed_path_add(rugged_changed_paths *walk, const char *status,
+	const git_tree_entry *old_entry, const git_tree_entry *new_entry)
+{
+	VALUE rb_change = rb_ary_new2(5);
+	VALUE rb_path = rugged_str_new(walk->path, walk->path_len, NULL);
+
+	rb_ary_push(rb_change, CSTR2SYM(status));
+	rb_ary_push(rb_change, rb_path);
+	rb_ary_push(rb_change, old_entry ? rugged_create_oid(git_tree_entry_id(old_entry)) : Qnil);
+	rb_ary_push(rb_change, new_entry ? rugged_create_oid(git_tree_entry_id(new_entry)) : Qnil);
+	rb_ary_push(rb_change, old_entry ? rb_str_dup(rb_path) : Qnil);
+
+	rb_ary_push(walk->rb_changes, rb_change);
+}
+
+static int changed_paths_walk(rugged_changed_paths *walk, const git_oid *old_id, const git_oid *new_id);
+
+static int changed_entries(rugged_changed_paths *walk,
+	const git_tree_entry *old_entry, const git_tree_entry *new_entry)
+{
+	const git_tree_entry *entry = old_entry ? old_entry : new_entry;
+	size_t path_len = walk->path_len;
+	int is_tree = git_tree_entry_type(entry) == GIT_OBJ_TREE;
+	int selected, error = 0;
+
+	changed_path_push(walk, git_tree_entry_name(entry));
+	selected = changed_path_selected(walk, is_tree);
+
+	if (!selected) {
+		/* outside of :paths */
+	} else if (is_tree) {
+		error = changed_paths_walk(walk,
+			old_entry ? git_tree_entry_id(old_entry) : NULL,
+			new_entry ? git_tree_entry_id(new_entry) : NULL);
+	} else if (selected == 1) {
+		if (!new_entry) {
+			changed_path_add(walk, "deleted", old_entry, NULL);
+		} else if (!old_entry) {
+			changed_path_add(walk, "added", NULL, new_entry);
+		} else if ((git_tree_entry_filemode(old_entry) & 0170000) !=
+			(git_tree_entry_filemode(new_entry) & 0170000)) {
+			changed_path_add(walk, "typechange", old_entry, new_entry);
+		} else {
+			changed_path_add(walk, "modified", old_entry, new_entry);
+		}
+	}
+
+	walk->path_len = path_len;
+	walk->path[path_len] = '\0';
+
+	return error;
+}
+
+/*
+ * Merge-walk two trees by name. Subtrees with the same OID on both sides
+ * are skipped without being loaded; blobs are only ever compared by OID.
+ */
+static int changed_paths_walk(rugged_changed_paths *walk, const git_oid *old_id, const git_oid *new_id)
+{
+	git_tree *old_tree = NULL, *new_tree = NULL;
+	size_t old_count = 0, new_count = 0, i = 0, j = 0;
+	int error = 0;
+
+	if (old_id && new_id && git_oid_cmp(old_id, new_id) == 0)
+		return 0;
+
+	if (old_id) {
+		if ((error = git_tree_lookup(&old_tree, walk->repo, old_id)) < 0)
+			goto cleanup;
+		old_count = git_tree_entrycount(old_tree);
+	}
+
+	if (new_id) {
+		if ((error = git_tree_lookup(&new_tree, walk->repo, new_id)) < 0)
+			goto cleanup;
+		new_count = git_tree_entrycount(new_tree);
+	}
+
+	while (!error && (i < old_count || j < new_count)) {
+		const git_tree_entry *old_entry = i < old_count ? git_tree_entry_byindex(old_tree, i) : NULL;
+		const git_tree_entry *new_entry = j < new_count ? git_tree_entry_byindex(new_tree, j) : NULL;
+		int cmp;
+
+		if (!old_entry)
+			cmp = 1;
+		else if (!new_entry)
+			cmp = -1;
+		else
+			cmp = rugged_tree_entry_cmp(old_entry, new_entry);
+
+		if (cmp < 0) {
+			error = changed_entries(walk, old_entry, NULL);
+			i++;
+		} else if (cmp > 0) {
+			error = changed_entries(walk, NULL, new_entry);
+			j++;
+		} else {
+			if (git_oid_cmp(git_tree_entry_id(old_entry), git_tree_entry_id(new_entry)) != 0 ||
+				git_tree_entry_filemode(old_entry) != git_tree_entry_filemode(new_entry))
+				error = changed_entries(walk, old_entry, new_entry);
+			i++;
+			j++;
+		}
+	}
+
+cleanup:
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+	return error;
+}
+
+/*
+ * Pair up deletions and additions of the very same blob into renames.
+ * Nothing is read from the blobs: only exact renames are found.
+ */
+static VALUE changed_paths_find_renames(VALUE rb_changes)
+{
+	VALUE rb_deleted = rb_hash_new(), rb_result;
+	long i;
+
+	for (i = 0; i < RARRAY_LEN(rb_changes); ++i) {
+		VALUE rb_change = rb_ary_entry(rb_changes, i);
+
+		if (rb_ary_entry(rb_change, 0) == CSTR2SYM("deleted")) {
+			VALUE rb_oid = rb_ary_entry(rb_change, 2);
+			VALUE rb_list = rb_hash_aref(rb_deleted, rb_oid);
+
+			if (NIL_P(rb_list)) {
+				rb_list = rb_ary_new();
+				rb_hash_aset(rb_deleted, rb_oid, rb_list);
+			}
+
+			rb_ary_push(rb_list, rb_change);
+		}
+	}
+
+	if (RHASH_SIZE(rb_deleted) == 0)
+		return rb_changes;
+
+	for (i = 0; i < RARRAY_LEN(rb_changes); ++i) {
+		VALUE rb_change = rb_ary_entry(rb_changes, i), rb_list, rb_source;
+
+		/* consumed deletions have a nil status, so compare the VALUEs */
+		if (rb_ary_entry(rb_change, 0) != CSTR2SYM("added"))
+			continue;
+
+		rb_list = rb_hash_aref(rb_deleted, rb_ary_entry(rb_change, 3));
+		if (NIL_P(rb_list) || RARRAY_LEN(rb_list) == 0)
+			continue;
+
+		rb_source = rb_ary_shift(rb_list);
+
+		/* a consumed deletion is dropped from the final list below */
+		rb_ary_store(rb_source, 0, Qnil);
+
+		rb_ary_store(rb_change, 0, CSTR2SYM("renamed"));
+		rb_ary_store(rb_change, 2, rb_ary_entry(rb_source, 2));
+		rb_ary_store(rb_change, 4, rb_ary_entry(rb_source, 1));
+	}
+
+	rb_result = rb_ary_new2(RARRAY_LEN(rb_changes));
+
+	for (i = 0; i < RARRAY_LEN(rb_changes); ++i) {
+		VALUE rb_change = rb_ary_entry(rb_changes, i);
+
+		if (!NIL_P(rb_ary_entry(rb_change, 0)))
+			rb_ary_push(rb_result, rb_change);
+	}
+
+	return rb_result;
+}
+
+/*
+ *  call-seq:
+ *    tree.changed_paths(other[, options]) -> array
+ *
+ *  Return the paths that differ between the tree and +other+ (a
+ *  Rugged::Tree, a Rugged::Commit, or +nil+ for the empty tree), as an
+ *  Array of <tt>[status, path, old_oid, new_oid, old_path]</tt> tuples.
+ *
+ *  Unlike #diff, this is a pure tree-to-tree comparison of OIDs: only
+ *  subtrees whose OIDs differ are walked into, and blob contents are
+ *  never loaded. +status+ is one of +:added+, +:deleted+, +:modified+,
+ *  +:typechange+ or +:renamed+; +old_oid+ and +old_path+ are +nil+ for
+ *  added paths and +new_oid+ is +nil+ for deleted ones. +old_path+ only
+ *  differs from +path+ for renames.
+ *
+ *  The following options can be passed in the +options+ Hash:
+ *
+ *  :paths ::
+ *    An array of paths to constrain the comparison to. Each path selects
+ *    the file or the whole directory with that name (a trailing slash is
+ *    ignored); subtrees outside of them are not walked at all.
+ *
+ *  :renames ::
+ *    If true, a deleted and an added path with the same blob OID are
+ *    reported as a single +:renamed+ tuple, with the path it was renamed
+ *    from as +old_path+.
+ *
+ *  Example:
+ *
+ *    tree.changed_paths(other_tree)
+ *    #=> [[:modified, "README", "1385f2...", "ce0136...", "README"],
+ *    #    [:added, "lib/foo.rb", nil, "2b40c5...", nil]]
+ */
+static VALUE rb_git_tree_changed_paths(int argc, VALUE *argv, VALUE self)
+{
+	git_tree *tree;
+	git_object *other = NULL;
+	git_tree *other_tree = NULL;
+	rugged_changed_paths walk;
+	VALUE rb_other, rb_options, rb_paths = Qnil, owner;
+	int error, renames = 0;
+	long i;
+
+	rb_scan_args(argc, argv, "11", &rb_other, &rb_options);
+
+	Data_Get_Struct(self, git_tree, tree);
+	owner = rugged_owner(self);
+
+	memset(&walk, 0x0, sizeof(walk));
+	Data_Get_Struct(owner, git_repository, walk.repo);
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+
+		renames = RTEST(rb_hash_aref(rb_options, CSTR2SYM("renames")));
+
+		rb_paths = rb_hash_aref(rb_options, CSTR2SYM("paths"));
+		if (!NIL_P(rb_paths)) {
+			Check_Type(rb_paths, T_ARRAY);
+
+			for (i = 0; i < RARRAY_LEN(rb_paths); ++i)
+				Check_Type(rb_ary_entry(rb_paths, i), T_STRING);
+		}
+	}
+
+	if (!NIL_P(rb_other)) {
+		other = rugged_object_get(walk.repo, rb_other, GIT_OBJ_ANY);
+		error = git_object_peel((git_object **)&other_tree, other, GIT_OBJ_TREE);
+		git_object_free(other);
+		rugged_exception_check(error);
+	}
+
+	if (!NIL_P(rb_paths) && RARRAY_LEN(rb_paths) > 0) {
+		walk.prefix_count = RARRAY_LEN(rb_paths);
+		walk.prefixes = xmalloc(walk.prefix_count * sizeof(char *));
+		walk.prefix_lens = xmalloc(walk.prefix_count * sizeof(size_t));
+
+		for (i = 0; i < walk.prefix_count; ++i) {
+			const char *prefix = StringValueCStr(RARRAY_PTR(rb_paths)[i]);
+			size_t prefix_len = strlen(prefix);
+
+			while (prefix_len && prefix[prefix_len - 1] == '/')
+				prefix_len--;
+
+			walk.prefixes[i] = prefix;
+			walk.prefix_lens[i] = prefix_len;
+		}
+	}
+
+	walk.rb_changes = rb_ary_new();
+	walk.path_alloc = 256;
+	walk.path = xmalloc(walk.path_alloc);
+	walk.path[0] = '\0';
+
+	error = changed_paths_walk(&walk, git_tree_id(tree),
+		other_tree ? git_tree_id(other_tree) : NULL);
+
+	git_tree_free(other_tree);
+	xfree(walk.path);
+	xfree(walk.prefixes);
+	xfree(walk.prefix_lens);
+
+	rugged_exception_check(error);
+
+	if (renames)
+		return changed_paths_find_renames(walk.rb_changes);
+
+	return walk.rb_changes;
+}
+
+/*
+ * Past this many cached subtrees the byte stats cache is simply dropped
+ * and rebuilt, to keep its memory bounded.
+ */
+#define RUGGED_BYTE_STATS_CACHE_MAX 65536
+
+/*
+ * A line of a .gitattributes file of the measured tree that mentions
+ * the :attribute being grouped by.
+ */
+typedef struct {
+	char *pattern;
+	size_t base_len; /* of the directory holding the file, with its slash */
+	int has_slash;
+	char *value; /* NULL when the attribute is set, unset or unspecified */
+} byte_stats_rule;
+
+typedef struct {
+	git_repository *repo;
+	git_odb *odb;
+	VALUE rb_cache;
+	const char *attribute;
+	int count_files;
+	char *path;
+	size_t path_len, path_alloc;
+
+	/* the rules in effect, outermost .gitattributes first */
+	byte_stats_rule *rules;
+	size_t rule_count, rule_alloc;
+
+	/* the .gitattributes blobs the rules come from */
+	git_oid *attr_files;
+	size_t attr_file_count, attr_file_alloc;
+
+	/* the trees being walked, freed by byte_stats_cleanup if Ruby raises */
+	git_tree **trees;
+	size_t tree_count, tree_alloc;
+} rugged_byte_stats;
+
+static char *byte_stats_strndup(const char *str, size_t len)
+{
+	char *copy = xmalloc(len + 1);
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+	return copy;
+}
+
+static void byte_stats_add_rule(rugged_byte_stats *stats,
+	const char *pattern, size_t pattern_len, const char *value, size_t value_len)
+{
+	byte_stats_rule *rule;
+
+	if (stats->rule_count == stats->rule_alloc) {
+		stats->rule_alloc = stats->rule_alloc ? stats->rule_alloc * 2 : 16;
+		stats->rules = xrealloc(stats->rules, stats->rule_alloc * sizeof(byte_stats_rule));
+	}
+
+	rule = &stats->rules[stats->rule_count++];
+	rule->base_len = stats->path_len ? stats->path_len + 1 : 0;
+	rule->has_slash = (pattern[0] == '/' || memchr(pattern, '/', pattern_len) != NULL);
+
+	if (pattern[0] == '/')
+		pattern++, pattern_len--;
+
+	rule->pattern = byte_stats_strndup(pattern, pattern_len);
+	rule->value = value ? byte_stats_strndup(value, value_len) : NULL;
+}
+
+/*
+ * Parse the .gitattributes file of the tree at the current path, keeping
+ * the lines that mention the attribute. Quoted patterns and macros are
+ * not supported.
+ */
+static void byte_stats_parse_rules(rugged_byte_stats *stats, const char *data, size_t len)
+{
+	const char *end = data + len;
+	size_t attribute_len = strlen(stats->attribute);
+
+	while (data < end) {
+		const char *eol = memchr(data, '\n', end - data);
+		const char *line_end = eol ? eol : end;
+		const char *p = data, *pattern, *value = NULL;
+		size_t pattern_len, value_len = 0;
+		int found = 0;
+
+		data = eol ? eol + 1 : end;
+
+		while (p < line_end && isspace((unsigned char)*p))
+			p++;
+
+		if (p == line_end || *p == '#' || *p == '!' || *p == '"' ||
+			(line_end - p >= 6 && !memcmp(p, "[attr]", 6)))
+			continue;
+
+		pattern = p;
+		while (p < line_end && !isspace((unsigned char)*p))
+			p++;
+		pattern_len = p - pattern;
+
+		/* patterns for directories never match the files inside them */
+		if (pattern[pattern_len - 1] == '/')
+			continue;
+
+		while (p < line_end) {
+			const char *name, *name_end, *eq;
+			int has_value = 0;
+
+			while (p < line_end && isspace((unsigned char)*p))
+				p++;
+			if (p == line_end)
+				break;
+
+			name = p;
+			while (p < line_end && !isspace((unsigned char)*p))
+				p++;
+			name_end = p;
+
+			if (*name == '-' || *name == '!') {
+				name++;
+			} else if ((eq = memchr(name, '=', name_end - name)) != NULL) {
+				has_value = 1;
+				value = eq + 1;
+				value_len = name_end - value;
+				name_end = eq;
+			}
+
+			if ((size_t)(name_end - name) == attribute_len &&
+				!memcmp(name, stats->attribute, attribute_len)) {
+				found = 1;
+				if (!has_value)
+					value = NULL;
+			}
+		}
+
+		if (found)
+			byte_stats_add_rule(stats, pattern, pattern_len, value, value_len);
+	}
+}
+
+/*
+ * Load the rules of the .gitattributes file in `tree`, if it has one.
+ * Deeper files are added last, so they take precedence when matching.
+ */
+static int byte_stats_load_rules(rugged_byte_stats *stats, git_tree *tree)
+{
+	const git_tree_entry *entry = git_tree_entry_byname(tree, ".gitattributes");
+	git_blob *blob;
+	int error;
+
+	if (!entry || git_tree_entry_type(entry) != GIT_OBJ_BLOB)
+		return 0;
+
+	if ((error = git_blob_lookup(&blob, stats->repo, git_tree_entry_id(entry))) < 0)
+		return error;
+
+	if (stats->attr_file_count == stats->attr_file_alloc) {
+		stats->attr_file_alloc = stats->attr_file_alloc ? stats->attr_file_alloc * 2 : 8;
+		stats->attr_files = xrealloc(stats->attr_files, stats->attr_file_alloc * sizeof(git_oid));
+	}
+
+	git_oid_cpy(&stats->attr_files[stats->attr_file_count++], git_tree_entry_id(entry));
+
+	byte_stats_parse_rules(stats,
+		git_blob_rawcontent(blob), (size_t)git_blob_rawsize(blob));
+
+	git_blob_free(blob);
+	return 0;
+}
+
+static void byte_stats_pop_rules(rugged_byte_stats *stats, size_t rule_count, size_t attr_file_count)
+{
+	while (stats->rule_count > rule_count) {
+		byte_stats_rule *rule = &stats->rules[--stats->rule_count];
+		xfree(rule->pattern);
+		xfree(rule->value);
+	}
+
+	stats->attr_file_count = attr_file_count;
+}
+
+/* The value of the attribute for the file at the current path, if any */
+static const char *byte_stats_attribute(rugged_byte_stats *stats, const char *name)
+{
+	size_t i;
+
+	for (i = stats->rule_count; i > 0; --i) {
+		const byte_stats_rule *rule = &stats->rules[i - 1];
+		int matched;
+
+		if (rule->has_slash)
+			matched = !fnmatch(rule->pattern, stats->path + rule->base_len, FNM_PATHNAME);
+		else
+			matched = !fnmatch(rule->pattern, name, 0);
+
+		if (matched)
+			return rule->value;
+	}
+
+	return NULL;
+}
+
+static VALUE byte_stats_key(rugged_byte_stats *stats, const char *name)
+{
+	const char *ext = strrchr(name, '.');
+
+	if (stats->attribute) {
+		const char *value = byte_stats_attribute(stats, name);
+
+		if (value)
+			return rugged_str_new2(value, NULL);
+	}
+
+	/* same as File.extname: dotfiles and trailing dots have none */
+	if (!ext || ext == name || ext[1] == '\0')
+		return rugged_str_new2("", NULL);
+
+	return rugged_str_new2(ext, NULL);
+}
+
+static void byte_stats_add(VALUE rb_totals, VALUE rb_key, VALUE rb_bytes)
+{
+	VALUE rb_total = rb_hash_aref(rb_totals, rb_key);
+
+	if (NIL_P(rb_total))
+		rb_hash_aset(rb_totals, rb_key, rb_bytes);
+	else
+		rb_hash_aset(rb_totals, rb_key, rb_funcall(rb_total, rb_intern("+"), 1, rb_bytes));
+}
+
+static int byte_stats_merge_cb(VALUE rb_key, VALUE rb_bytes, VALUE rb_totals)
+{
+	byte_stats_add(rb_totals, rb_key, rb_bytes);
+	return ST_CONTINUE;
+}
+
+static void byte_stats_push(rugged_byte_stats *stats, const char *name)
+{
+	size_t name_len = strlen(name);
+	size_t needed = stats->path_len + name_len + 2;
+
+	if (needed > stats->path_alloc) {
+		stats->path_alloc = needed * 2;
+		stats->path = xrealloc(stats->path, stats->path_alloc);
+	}
+
+	if (stats->path_len)
+		stats->path[stats->path_len++] = '/';
+
+	memcpy(stats->path + stats->path_len, name, name_len + 1);
+	stats->path_len += name_len;
+}
+
+/*
+ * Totals for one tree, reused from the cache when the same subtree was
+ * already measured. When grouping by attribute, the totals also depend
+ * on where the subtree lives and on the .gitattributes files above it,
+ * so its path and their OIDs are part of the key.
+ */
+static int byte_stats_tree(VALUE *out, rugged_byte_stats *stats, const git_oid *tree_id)
+{
+	git_tree *tree;
+	VALUE rb_key, rb_totals;
+	size_t i, count, rule_count = stats->rule_count, attr_file_count = stats->attr_file_count;
+	int error;
+
+	rb_key = rugged_str_new((const char *)tree_id->id, GIT_OID_RAWSZ, NULL);
+	if (stats->count_files)
+		rb_str_cat(rb_key, "#", 1);
+	if (stats->attribute) {
+		rb_str_cat2(rb_key, stats->attribute);
+		rb_str_cat(rb_key, "", 1);
+		rb_str_cat(rb_key, stats->path, stats->path_len);
+		rb_str_cat(rb_key, "", 1);
+		rb_str_cat(rb_key, (const char *)stats->attr_files,
+			stats->attr_file_count * sizeof(git_oid));
+	}
+
+	rb_totals = rb_hash_aref(stats->rb_cache, rb_key);
+	if (!NIL_P(rb_totals)) {
+		*out = rb_totals;
+		return 0;
+	}
+
+	if (stats->tree_count == stats->tree_alloc) {
+		stats->tree_alloc = stats->tree_alloc ? stats->tree_alloc * 2 : 16;
+		stats->trees = xrealloc(stats->trees, stats->tree_alloc * sizeof(git_tree *));
+	}
+
+	if ((error = git_tree_lookup(&tree, stats->repo, tree_id)) < 0)
+		return error;
+
+	stats->trees[stats->tree_count++] = tree;
+
+	if (stats->attribute && (error = byte_stats_load_rules(stats, tree)) < 0) {
+		git_tree_free(stats->trees[--stats->tree_count]);
+		return error;
+	}
+
+	rb_totals = rb_hash_new();
+	count = git_tree_entrycount(tree);
+
+	for (i = 0; i < count; ++i) {
+		const git_tree_entry *entry = git_tree_entry_byindex(tree, i);
+		size_t path_len = stats->path_len;
+
+		byte_stats_push(stats, git_tree_entry_name(entry));
+
+		if (git_tree_entry_type(entry) == GIT_OBJ_TREE) {
+			VALUE rb_subtree;
+
+			error = byte_stats_tree(&rb_subtree, stats, git_tree_entry_id(entry));
+			if (!error)
+				rb_hash_foreach(rb_subtree, byte_stats_merge_cb, rb_totals);
+		} else if (git_tree_entry_type(entry) == GIT_OBJ_BLOB && stats->count_files) {
+			byte_stats_add(rb_totals,
+				byte_stats_key(stats, git_tree_entry_name(entry)), INT2FIX(1));
+		} else if (git_tree_entry_type(entry) == GIT_OBJ_BLOB &&
+			git_tree_entry_filemode(entry) != GIT_FILEMODE_LINK) {
+			size_t len;
+			git_otype type;
+
+			error = git_odb_read_header(&len, &type, stats->odb, git_tree_entry_id(entry));
+			if (!error)
+				byte_stats_add(rb_totals,
+					byte_stats_key(stats, git_tree_entry_name(entry)), SIZET2NUM(len));
+		}
+
+		stats->path_len = path_len;
+		stats->path[path_len] = '\0';
+
+		if (error < 0)
+			break;
+	}
+
+	git_tree_free(stats->trees[--stats->tree_count]);
+	byte_stats_pop_rules(stats, rule_count, attr_file_count);
+
+	if (error < 0)
+		return error;
+
+	if (RHASH_SIZE(stats->rb_cache) >= RUGGED_BYTE_STATS_CACHE_MAX)
+		rb_funcall(stats->rb_cache, rb_intern("clear"), 0);
+
+	OBJ_FREEZE(rb_totals);
+	rb_hash_aset(stats->rb_cache, rb_key, rb_totals);
+
+	*out = rb_totals;
+	return 0;
+}
+
+typedef struct {
+	rugged_byte_stats *stats;
+	const git_oid *tree_id;
+	VALUE rb_totals;
+} byte_stats_args;
+
+static VALUE byte_stats_body(VALUE _args)
+{
+	byte_stats_args *args = (byte_stats_args *)_args;
+	int error;
+
+	error = git_repository_odb(&args->stats->odb, args->stats->repo);
+	rugged_exception_check(error);
+
+	error = byte_stats_tree(&args->rb_totals, args->stats, args->tree_id);
+	rugged_exception_check(error);
+
+	return args->rb_totals;
+}
+
+static VALUE byte_stats_cleanup(VALUE _stats)
+{
+	rugged_byte_stats *stats = (rugged_byte_stats *)_stats;
+
+	while (stats->tree_count > 0)
+		git_tree_free(stats->trees[--stats->tree_count]);
+
+	byte_stats_pop_rules(stats, 0, 0);
+
+	xfree(stats->trees);
+	xfree(stats->path);
+	xfree(stats->rules);
+	xfree(stats->attr_files);
+	git_odb_free(stats->odb);
+
+	return Qnil;
+}
+
+/*
+ * Sizes (or, with +count_files+, the number) of the blobs under +tree_id+,
+ * grouped by extension or by the value of +attribute+. Subtree totals
+ * are cached on +rb_repo+; the returned Hash is frozen.
+ */
+VALUE rugged_tree_byte_stats(VALUE rb_repo, const git_oid *tree_id,
+	const char *attribute, int count_files)
+{
+	static ID id_cache = 0;
+	rugged_byte_stats stats;
+	byte_stats_args args;
+
+	memset(&stats, 0x0, sizeof(stats));
+	Data_Get_Struct(rb_repo, git_repository, stats.repo);
+
+	if (!id_cache)
+		id_cache = rb_intern("byte_stats_cache");
+
+	stats.rb_cache = rb_attr_get(rb_repo, id_cache);
+	if (NIL_P(stats.rb_cache)) {
+		stats.rb_cache = rb_hash_new();
+		rb_ivar_set(rb_repo, id_cache, stats.rb_cache);
+	}
+
+	stats.attribute = attribute;
+	stats.count_files = count_files;
+
+	args.stats = &stats;
+	args.tree_id = tree_id;
+	args.rb_totals = Qnil;
+
+	stats.path_alloc = 256;
+	stats.path = xmalloc(stats.path_alloc);
+	stats.path[0] = '\0';
+
+	return rb_ensure(byte_stats_body, (VALUE)&args, byte_stats_cleanup, (VALUE)&stats);
+}
+
+/*
+ *	call-seq:
+ *		tree.byte_stats(options = {}) -> hash
+ *
+ *	Return the total size in bytes of all the blobs in the tree (and its
+ *	subtrees), grouped by file extension, e.g.
+ *	<tt>{".rb" => 10240, ".c" => 52311, "" => 1058}</tt>. Files without
+ *	an extension are counted under "". Symlinks and submodules are
+ *	skipped.
+ *
+ *	Sizes come from the object headers, so blob contents are never
+ *	inflated. The totals of every subtree are cached on the repository
+ *	by OID, so measuring the tree of the next commit only walks the
+ *	directories that changed.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:attribute ::
+ *	  The name of a gitattribute (e.g. "linguist-language"). Files for
+ *	  which it is set to a value are grouped under that value instead of
+ *	  their extension. The attribute is resolved from the .gitattributes
+ *	  files of the measured tree itself, not from the working directory
+ *	  or the index, so the stats of an old commit use the attributes it
+ *	  had. Quoted patterns and attribute macros are not supported.
+ */
+static VALUE rb_git_tree_byte_stats(int argc, VALUE *argv, VALUE self)
+{
+	git_tree *tree;
+	VALUE rb_options, rb_attribute = Qnil;
+
+	rb_scan_args(argc, argv, "01", &rb_options);
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+		rb_attribute = rb_hash_aref(rb_options, CSTR2SYM("attribute"));
+		if (!NIL_P(rb_attribute))
+			Check_Type(rb_attribute, T_STRING);
+	}
+
+	Data_Get_Struct(self, git_tree, tree);
+
+	return rb_funcall(rugged_tree_byte_stats(rugged_owner(self), git_tree_id(tree),
+		NIL_P(rb_attribute) ? NULL : StringValueCStr(rb_attribute), 0), rb_intern("dup"), 0);
+}
+
 static void rb_git_treebuilder_free(git_treebuilder *bld)
 {
 	git_treebuilder_free(bld);
@@ -573,6 +1412,8 @@ void Init_rugged_tree()
 	rb_define_method(rb_cRuggedTree, "get_entry_by_oid", rb_git_tree_get_entry_by_oid, 1);
 	rb_define_method(rb_cRuggedTree, "path", rb_git_tree_path, 1);
 	rb_define_method(rb_cRuggedTree, "diff", rb_git_tree_diff, -1);
+	rb_define_method(rb_cRuggedTree, "changed_paths", rb_git_tree_changed_paths, -1);
+	rb_define_method(rb_cRuggedTree, "byte_stats", rb_git_tree_byte_stats, -1);
 	rb_define_method(rb_cRuggedTree, "[]", rb_git_tree_get_entry, 1);
 	rb_define_method(rb_cRuggedTree, "each", rb_git_tree_each, 0);
 	rb_define_method(rb_cRuggedTree, "walk", rb_git_tree_walk, 1);
@@ -0,0 +1,415 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "rugged.h"
+
+extern VALUE rb_mRugged;
+extern VALUE rb_cRuggedRepo;
+
+VALUE rb_cRuggedTreeAggregator;
+
+#define RUGGED_TREE_AGGREGATOR_MAX_ENTRIES 100000
+
+enum {
+	AGGREGATE_RUBY = 0,
+	AGGREGATE_BYTES,
+	AGGREGATE_FILES,
+};
+
+typedef struct {
+	VALUE rb_repo;
+	VALUE rb_reducer;
+	VALUE rb_name;
+	VALUE rb_cache;
+	int builtin;
+	long max_entries;
+	size_t hits, misses;
+} rugged_tree_aggregator;
+
+static void rb_git_tree_aggregator__mark(rugged_tree_aggregator *agg)
+{
+	rb_gc_mark(agg->rb_repo);
+	rb_gc_mark(agg->rb_reducer);
+	rb_gc_mark(agg->rb_name);
+	rb_gc_mark(agg->rb_cache);
+}
+
+static void rb_git_tree_aggregator__free(rugged_tree_aggregator *agg)
+{
+	xfree(agg);
+}
+
+static rugged_tree_aggregator *rugged_tree_aggregator_get(VALUE self)
+{
+	rugged_tree_aggregator *agg;
+	Data_Get_Struct(self, rugged_tree_aggregator, agg);
+	return agg;
+}
+
+static VALUE tree_aggregator_key(const git_oid *oid)
+{
+	return rugged_str_new((const char *)oid->id, GIT_OID_RAWSZ, NULL);
+}
+
+/*
+ * Look a subtree up in the cache, moving it to the back of the Hash so
+ * the front always holds the least recently used entries.
+ */
+static int tree_aggregator_lookup(VALUE *out, rugged_tree_aggregator *agg, VALUE rb_key)
+{
+	VALUE rb_value = rb_hash_lookup2(agg->rb_cache, rb_key, Qundef);
+
+	if (rb_value == Qundef)
+		return 0;
+
+	rb_hash_delete(agg->rb_cache, rb_key);
+	rb_hash_aset(agg->rb_cache, rb_key, rb_value);
+
+	agg->hits++;
+	*out = rb_value;
+	return 1;
+}
+
+static void tree_aggregator_store(rugged_tree_aggregator *agg, VALUE rb_key, VALUE rb_value)
+{
+	rb_hash_aset(agg->rb_cache, rb_key, rb_value);
+
+	while (RHASH_SIZE(agg->rb_cache) > (st_index_t)agg->max_entries)
+		rb_funcall(agg->rb_cache, rb_intern("shift"), 0);
+}
+
+static int tree_aggregator_sum_cb(VALUE rb_key, VALUE rb_value, VALUE rb_total)
+{
+	VALUE *total = (VALUE *)rb_total;
+	*total = rb_funcall(*total, rb_intern("+"), 1, rb_value);
+	return ST_CONTINUE;
+}
+
+/*
+ * The built-in reducers are Tree#byte_stats summed up, so the subtrees
+ * are walked and cached by the same code; only the trees asked for are
+ * kept here.
+ */
+static VALUE tree_aggregator_builtin(rugged_tree_aggregator *agg, const git_oid *tree_id)
+{
+	VALUE rb_key = tree_aggregator_key(tree_id);
+	VALUE rb_stats, rb_value;
+
+	if (tree_aggregator_lookup(&rb_value, agg, rb_key))
+		return rb_value;
+
+	agg->misses++;
+
+	rb_stats = rugged_tree_byte_stats(agg->rb_repo, tree_id,
+		NULL, agg->builtin == AGGREGATE_FILES);
+
+	rb_value = INT2FIX(0);
+	rb_hash_foreach(rb_stats, tree_aggregator_sum_cb, (VALUE)&rb_value);
+
+	tree_aggregator_store(agg, rb_key, rb_value);
+	return rb_value;
+}
+
+/*
+ * Ruby reducers get the Rugged::Tree itself, so the git_tree is owned by
+ * that object from the start and a raising block can't leak it.
+ */
+static VALUE tree_aggregator_ruby(rugged_tree_aggregator *agg, git_repository *repo, const git_oid *tree_id)
+{
+	VALUE rb_key = tree_aggregator_key(tree_id);
+	VALUE rb_tree, rb_results, rb_value;
+	git_tree *tree;
+	size_t i, count;
+
+	if (tree_aggregator_lookup(&rb_value, agg, rb_key))
+		return rb_value;
+
+	agg->misses++;
+
+	rugged_exception_check(git_tree_lookup(&tree, repo, tree_id));
+	rb_tree = rugged_object_new(agg->rb_repo, (git_object *)tree);
+
+	rb_results = rb_hash_new();
+	count = git_tree_entrycount(tree);
+
+	for (i = 0; i < count; ++i) {
+		const git_tree_entry *entry = git_tree_entry_byindex(tree, i);
+
+		if (git_tree_entry_type(entry) != GIT_OBJ_TREE)
+			continue;
+
+		rb_hash_aset(rb_results,
+			rugged_str_new2(git_tree_entry_name(entry), NULL),
+			tree_aggregator_ruby(agg, repo, git_tree_entry_id(entry)));
+	}
+
+	rb_value = rb_funcall(agg->rb_reducer, rb_intern("call"), 2, rb_tree, rb_results);
+	tree_aggregator_store(agg, rb_key, rb_value);
+
+	return rb_value;
+}
+
+/*
+ *	call-seq:
+ *		TreeAggregator.new(repo, reducer, options = {}) -> aggregator
+ *		TreeAggregator.new(repo, options = {}) { |tree, results| block } -> aggregator
+ *
+ *	Create an aggregator that computes a value for every tree of +repo+
+ *	as a pure function of its contents, and memoizes it by tree OID. When
+ *	a tree is aggregated, only the subtrees that have never been seen
+ *	before are read, so computing a metric over every commit in the
+ *	history costs as much as the subtrees that actually changed.
+ *
+ *	+reducer+ can be one of the built-in native reducers:
+ *
+ *	:bytes ::
+ *	  The total size of the blobs in the tree and all its subtrees, read
+ *	  from the object headers. Symlinks are not counted. This is the sum
+ *	  of Tree#byte_stats, and shares its subtree cache on the repository.
+ *
+ *	:files ::
+ *	  The number of blobs in the tree and all its subtrees.
+ *
+ *	The cache of a built-in reducer only holds the trees that were
+ *	aggregated; their subtrees are memoized by Tree#byte_stats.
+ *
+ *	Otherwise a block (or any object responding to +call+) is given the
+ *	Rugged::Tree being reduced and a Hash with the already reduced value
+ *	of each of its subtrees, keyed by entry name, and must return the
+ *	value for the tree:
+ *
+ *		agg = Rugged::TreeAggregator.new(repo) do |tree, results|
+ *		  tree.count { |e| e[:name].end_with?(".rb") } + results.values.inject(0, :+)
+ *		end
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:max_entries ::
+ *	  The number of trees to keep in the cache. When it is full, the
+ *	  least recently used trees are evicted. Defaults to 100000.
+ *
+ *	:name ::
+ *	  A name identifying a Ruby reducer, stored along with the cache by
+ *	  #save so that #load can refuse results computed by another
+ *	  reducer. Built-in reducers are identified by their Symbol.
+ */
+static VALUE rb_git_tree_aggregator_new(int argc, VALUE *argv, VALUE klass)
+{
+	rugged_tree_aggregator *agg;
+	VALUE rb_repo, rb_reducer, rb_options, rb_block, rb_aggregator;
+	VALUE rb_max = Qnil, rb_name = Qnil;
+
+	rb_scan_args(argc, argv, "12&", &rb_repo, &rb_reducer, &rb_options, &rb_block);
+
+	if (!rb_obj_is_kind_of(rb_repo, rb_cRuggedRepo))
+		rb_raise(rb_eTypeError, "Expecting a Rugged::Repository instance");
+
+	if (TYPE(rb_reducer) == T_HASH && NIL_P(rb_options)) {
+		rb_options = rb_reducer;
+		rb_reducer = Qnil;
+	}
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+		rb_max = rb_hash_aref(rb_options, CSTR2SYM("max_entries"));
+		rb_name = rb_hash_aref(rb_options, CSTR2SYM("name"));
+	}
+
+	agg = xcalloc(1, sizeof(rugged_tree_aggregator));
+	agg->rb_repo = rb_repo;
+	agg->rb_reducer = Qnil;
+	agg->rb_name = Qnil;
+	agg->rb_cache = Qnil;
+	agg->max_entries = RUGGED_TREE_AGGREGATOR_MAX_ENTRIES;
+
+	rb_aggregator = Data_Wrap_Struct(klass,
+		rb_git_tree_aggregator__mark, rb_git_tree_aggregator__free, agg);
+
+	agg->rb_cache = rb_hash_new();
+
+	if (!NIL_P(rb_max)) {
+		agg->max_entries = NUM2LONG(rb_max);
+		if (agg->max_entries <= 0)
+			rb_raise(rb_eArgError, "max_entries must be positive");
+	}
+
+	if (TYPE(rb_reducer) == T_SYMBOL) {
+		ID id_reducer = SYM2ID(rb_reducer);
+
+		if (id_reducer == rb_intern("bytes"))
+			agg->builtin = AGGREGATE_BYTES;
+		else if (id_reducer == rb_intern("files"))
+			agg->builtin = AGGREGATE_FILES;
+		else
+			rb_raise(rb_eArgError, "Invalid reducer. Expected `:bytes`, `:files` or a block");
+
+		agg->rb_name = rb_reducer;
+	} else {
+		if (NIL_P(rb_reducer))
+			rb_reducer = rb_block;
+
+		if (!rb_respond_to(rb_reducer, rb_intern("call")))
+			rb_raise(rb_eArgError, "Expected a reducer Symbol, a callable object or a block");
+
+		agg->rb_reducer = rb_reducer;
+		agg->rb_name = rb_name;
+	}
+
+	return rb_aggregator;
+}
+
+/*
+ *	call-seq:
+ *		aggregator.aggregate(tree) -> value
+ *
+ *	Return the reduced value for +tree+, which can be a Rugged::Tree,
+ *	a Rugged::Commit (whose tree is used), or a revision String.
+ */
+static VALUE rb_git_tree_aggregator_aggregate(VALUE self, VALUE rb_tree)
+{
+	rugged_tree_aggregator *agg = rugged_tree_aggregator_get(self);
+	git_repository *repo;
+	git_object *object, *tree;
+	git_oid oid;
+	int error;
+
+	Data_Get_Struct(agg->rb_repo, git_repository, repo);
+
+	error = rugged_oid_get(&oid, repo, rb_tree);
+	rugged_exception_check(error);
+
+	error = git_object_lookup(&object, repo, &oid, GIT_OBJ_ANY);
+	rugged_exception_check(error);
+
+	error = git_object_peel(&tree, object, GIT_OBJ_TREE);
+	git_object_free(object);
+	rugged_exception_check(error);
+
+	git_oid_cpy(&oid, git_object_id(tree));
+	git_object_free(tree);
+
+	if (agg->builtin == AGGREGATE_RUBY)
+		return tree_aggregator_ruby(agg, repo, &oid);
+
+	return tree_aggregator_builtin(agg, &oid);
+}
+
+/*
+ *	call-seq:
+ *		aggregator.reducer_name -> symbol, string or nil
+ *
+ *	Return the Symbol of the built-in reducer, or the +:name+ given for a
+ *	Ruby reducer.
+ */
+static VALUE rb_git_tree_aggregator_reducer_name(VALUE self)
+{
+	return rugged_tree_aggregator_get(self)->rb_name;
+}
+
+/*
+ *	call-seq:
+ *		aggregator.stats -> hash
+ *
+ *	Return a Hash with the number of cache +:hits+ and +:misses+ (trees
+ *	that had to be read and reduced) so far, and the current number of
+ *	cached +:entries+.
+ */
+static VALUE rb_git_tree_aggregator_stats(VALUE self)
+{
+	rugged_tree_aggregator *agg = rugged_tree_aggregator_get(self);
+	VALUE rb_stats = rb_hash_new();
+
+	rb_hash_aset(rb_stats, CSTR2SYM("hits"), SIZET2NUM(agg->hits));
+	rb_hash_aset(rb_stats, CSTR2SYM("misses"), SIZET2NUM(agg->misses));
+	rb_hash_aset(rb_stats, CSTR2SYM("entries"), LONG2NUM(RHASH_SIZE(agg->rb_cache)));
+
+	return rb_stats;
+}
+
+/*
+ *	call-seq:
+ *		aggregator.clear -> nil
+ *
+ *	Drop all the memoized results.
+ */
+static VALUE rb_git_tree_aggregator_clear(VALUE self)
+{
+	rb_funcall(rugged_tree_aggregator_get(self)->rb_cache, rb_intern("clear"), 0);
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		aggregator.cache_entries -> hash
+ *
+ *	Return a copy of the memoized results, keyed by raw 20-byte tree OID,
+ *	from the least to the most recently used.
+ */
+static VALUE rb_git_tree_aggregator_cache_entries(VALUE self)
+{
+	return rb_funcall(rugged_tree_aggregator_get(self)->rb_cache, rb_intern("dup"), 0);
+}
+
+static int tree_aggregator_import_cb(VALUE rb_key, VALUE rb_value, VALUE rb_aggregator)
+{
+	rugged_tree_aggregator *agg = rugged_tree_aggregator_get(rb_aggregator);
+
+	if (TYPE(rb_key) != T_STRING || RSTRING_LEN(rb_key) != GIT_OID_RAWSZ)
+		rb_raise(rb_eArgError, "Expected raw 20-byte OIDs as cache keys");
+
+	if (agg->builtin != AGGREGATE_RUBY && !rb_obj_is_kind_of(rb_value, rb_cInteger))
+		rb_raise(rb_eArgError, "Expected Integer cache values for a built-in reducer");
+
+	tree_aggregator_store(agg, rb_str_dup(rb_key), rb_value);
+	return ST_CONTINUE;
+}
+
+/*
+ *	call-seq:
+ *		aggregator.import_cache_entries(hash) -> aggregator
+ *
+ *	Add previously memoized results (as returned by #cache_entries) to
+ *	the cache. Entries already cached are overwritten.
+ */
+static VALUE rb_git_tree_aggregator_import_cache_entries(VALUE self, VALUE rb_entries)
+{
+	Check_Type(rb_entries, T_HASH);
+	rb_hash_foreach(rb_entries, tree_aggregator_import_cb, self);
+	return self;
+}
+
+void Init_rugged_tree_aggregator()
+{
+	rb_cRuggedTreeAggregator = rb_define_class_under(rb_mRugged, "TreeAggregator", rb_cObject);
+	rb_undef_alloc_func(rb_cRuggedTreeAggregator);
+
+	rb_define_singleton_method(rb_cRuggedTreeAggregator, "new", rb_git_tree_aggregator_new, -1);
+	rb_define_method(rb_cRuggedTreeAggregator, "aggregate", rb_git_tree_aggregator_aggregate, 1);
+	rb_define_method(rb_cRuggedTreeAggregator, "reducer_name", rb_git_tree_aggregator_reducer_name, 0);
+	rb_define_method(rb_cRuggedTreeAggregator, "stats", rb_git_tree_aggregator_stats, 0);
+	rb_define_method(rb_cRuggedTreeAggregator, "clear", rb_git_tree_aggregator_clear, 0);
+	rb_define_method(rb_cRuggedTreeAggregator, "cache_entries", rb_git_tree_aggregator_cache_entries, 0);
+	rb_define_method(rb_cRuggedTreeAggregator, "import_cache_entries", rb_git_tree_aggregator_import_cache_entries, 1);
+}
@@ -0,0 +1,360 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "rugged.h"
+
+extern VALUE rb_mRugged;
+
+/*
+ * Past this many edits the two sides are considered unrelated and the
+ * remaining middle section is reported as changed in full.
+ */
+#define RUGGED_WORD_DIFF_MAX_COST 1024
+
+enum {
+	WORD_CLASS_SINGLE = 0,
+	WORD_CLASS_WORD,
+	WORD_CLASS_SPACE,
+};
+
+typedef struct {
+	long offset;
+	long len;
+	unsigned int hash;
+} word_token;
+
+typedef struct {
+	const char *data;
+	word_token *tokens;
+	long count;
+	char *changed;
+} word_text;
+
+static int is_space(unsigned char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static void word_classes_init(unsigned char *classes, VALUE rb_tokenizer)
+{
+	int i;
+
+	if (NIL_P(rb_tokenizer))
+		rb_tokenizer = CSTR2SYM("word");
+
+	if (TYPE(rb_tokenizer) == T_STRING) {
+		const unsigned char *bounds = (const unsigned char *)RSTRING_PTR(rb_tokenizer);
+		long len = RSTRING_LEN(rb_tokenizer);
+
+		memset(classes, WORD_CLASS_WORD, 256);
+		for (i = 0; i < len; ++i)
+			classes[bounds[i]] = WORD_CLASS_SINGLE;
+		return;
+	}
+
+	if (TYPE(rb_tokenizer) == T_SYMBOL) {
+		ID id_tokenizer = SYM2ID(rb_tokenizer);
+
+		if (id_tokenizer == rb_intern("word")) {
+			for (i = 0; i < 256; ++i) {
+				if (is_space(i))
+					classes[i] = WORD_CLASS_SPACE;
+				else if ((i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') ||
+					(i >= '0' && i <= '9') || i == '_' || i >= 0x80)
+					classes[i] = WORD_CLASS_WORD;
+				else
+					classes[i] = WORD_CLASS_SINGLE;
+			}
+			return;
+		}
+
+		if (id_tokenizer == rb_intern("whitespace")) {
+			for (i = 0; i < 256; ++i)
+				classes[i] = is_space(i) ? WORD_CLASS_SPACE : WORD_CLASS_WORD;
+			return;
+		}
+
+		if (id_tokenizer == rb_intern("char")) {
+			memset(classes, WORD_CLASS_SINGLE, 256);
+			return;
+		}
+	}
+
+	rb_raise(rb_eArgError,
+		"Invalid tokenizer. Expected `:word`, `:whitespace`, `:char` or a String of boundary characters");
+}
+
+/*
+ * Split `data` into tokens: maximal runs of word or whitespace bytes, and
+ * single boundary characters. UTF-8 continuation bytes always stay with
+ * the character they belong to.
+ */
+static void word_tokenize(word_text *text, const char *data, long len, const unsigned char *classes)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	long pos = 0, alloc = 16;
+
+	text->data = data;
+	text->count = 0;
+	text->tokens = xmalloc(alloc * sizeof(word_token));
+	text->changed = NULL;
+
+	while (pos < len) {
+		word_token *token;
+		unsigned int hash = 2166136261u;
+		long start = pos;
+		unsigned char klass = classes[bytes[pos]];
+
+		pos++;
+		if (klass == WORD_CLASS_SINGLE) {
+			while (pos < len && (bytes[pos] & 0xC0) == 0x80)
+				pos++;
+		} else {
+			while (pos < len && classes[bytes[pos]] == klass)
+				pos++;
+		}
+
+		if (text->count == alloc) {
+			alloc *= 2;
+			text->tokens = xrealloc(text->tokens, alloc * sizeof(word_token));
+		}
+
+		token = &text->tokens[text->count++];
+		token->offset = start;
+		token->len = pos - start;
+
+		while (start < pos) {
+			hash ^= bytes[start++];
+			hash *= 16777619u;
+		}
+		token->hash = hash;
+	}
+
+	text->changed = xcalloc(text->count + 1, 1);
+}
+
+static int word_token_eq(const word_text *a, long i, const word_text *b, long j)
+{
+	const word_token *ta = &a->tokens[i], *tb = &b->tokens[j];
+
+	return ta->hash == tb->hash && ta->len == tb->len &&
+		memcmp(a->data + ta->offset, b->data + tb->offset, ta->len) == 0;
+}
+
+/*
+ * Myers' O(ND) diff over the token ranges [a_lo, a_hi) and [b_lo, b_hi),
+ * flagging every token that is not part of the longest common
+ * subsequence. One snapshot of the furthest-reaching paths is kept per
+ * edit distance so the script can be recovered by walking back.
+ */
+static void word_diff_middle(word_text *a, long a_lo, long a_hi, word_text *b, long b_lo, long b_hi)
+{
+	long n = a_hi - a_lo, m = b_hi - b_lo;
+	long max = n + m, d, k, x, y;
+	long *v, **trace;
+
+	if (max > RUGGED_WORD_DIFF_MAX_COST)
+		max = RUGGED_WORD_DIFF_MAX_COST;
+
+	v = xcalloc(2 * max + 3, sizeof(long));
+	trace = xcalloc(max + 1, sizeof(long *));
+
+	/* v[k + max + 1] holds the furthest x reached on diagonal k */
+	for (d = 0; d <= max; ++d) {
+		for (k = -d; k <= d; k += 2) {
+			long *vk = &v[k + max + 1];
+
+			if (k == -d || (k != d && vk[-1] < vk[1]))
+				x = vk[1];
+			else
+				x = vk[-1] + 1;
+
+			y = x - k;
+			while (x < n && y < m && word_token_eq(a, a_lo + x, b, b_lo + y))
+				x++, y++;
+
+			*vk = x;
+
+			if (x >= n && y >= m) {
+				trace[d] = xmalloc((2 * d + 1) * sizeof(long));
+				memcpy(trace[d], &v[max + 1 - d], (2 * d + 1) * sizeof(long));
+				goto found;
+			}
+		}
+
+		trace[d] = xmalloc((2 * d + 1) * sizeof(long));
+		memcpy(trace[d], &v[max + 1 - d], (2 * d + 1) * sizeof(long));
+	}
+
+	/* too expensive: everything in between changed */
+	memset(a->changed + a_lo, 1, n);
+	memset(b->changed + b_lo, 1, m);
+	d = max;
+	goto cleanup;
+
+found:
+	x = n;
+	y = m;
+
+	for (; d > 0; --d) {
+		long *prev = trace[d - 1] + (d - 1);
+		long prev_k, prev_x;
+
+		k = x - y;
+		if (k == -d || (k != d && prev[k - 1] < prev[k + 1]))
+			prev_k = k + 1;
+		else
+			prev_k = k - 1;
+
+		prev_x = prev[prev_k];
+
+		if (prev_k == k + 1)
+			b->changed[b_lo + prev_x - prev_k] = 1;
+		else
+			a->changed[a_lo + prev_x] = 1;
+
+		x = prev_x;
+		y = prev_x - prev_k;
+	}
+
+cleanup:
+	for (k = 0; k <= max; ++k)
+		xfree(trace[k]);
+
+	xfree(trace);
+	xfree(v);
+}
+
+static void word_diff(word_text *a, word_text *b)
+{
+	long a_lo = 0, b_lo = 0, a_hi = a->count, b_hi = b->count;
+
+	while (a_lo < a_hi && b_lo < b_hi && word_token_eq(a, a_lo, b, b_lo))
+		a_lo++, b_lo++;
+
+	while (a_hi > a_lo && b_hi > b_lo && word_token_eq(a, a_hi - 1, b, b_hi - 1))
+		a_hi--, b_hi--;
+
+	if (a_lo == a_hi)
+		memset(b->changed + b_lo, 1, b_hi - b_lo);
+	else if (b_lo == b_hi)
+		memset(a->changed + a_lo, 1, a_hi - a_lo);
+	else
+		word_diff_middle(a, a_lo, a_hi, b, b_lo, b_hi);
+}
+
+/*
+ * Coalesce runs of changed tokens into a flat [offset, length, ...]
+ * Array of byte ranges.
+ */
+static VALUE word_changed_ranges(const word_text *text)
+{
+	VALUE rb_ranges = rb_ary_new();
+	long i = 0;
+
+	while (i < text->count) {
+		long start;
+
+		if (!text->changed[i]) {
+			i++;
+			continue;
+		}
+
+		start = text->tokens[i].offset;
+		while (i < text->count && text->changed[i])
+			i++;
+
+		rb_ary_push(rb_ranges, LONG2NUM(start));
+		rb_ary_push(rb_ranges, LONG2NUM(
+			text->tokens[i - 1].offset + text->tokens[i - 1].len - start));
+	}
+
+	return rb_ranges;
+}
+
+/*
+ *	call-seq:
+ *		Rugged.word_diff(old, new, options = {}) -> [old_ranges, new_ranges]
+ *
+ *	Compute which parts of the +old+ and +new+ strings (typically a
+ *	removed line and the line that replaced it) changed, at the
+ *	granularity of words instead of whole lines.
+ *
+ *	Returns a pair of flat Arrays of byte ranges, <tt>[offset, length,
+ *	offset, length, ...]</tt>, one for each side. Adjacent changed
+ *	tokens are merged into a single range. Offsets count bytes, so they
+ *	can be used directly with <tt>String#byteslice</tt>.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:tokenizer ::
+ *	  How the strings are split into tokens: +:word+ (the default) uses
+ *	  runs of alphanumeric characters and runs of whitespace, with every
+ *	  other character a token on its own; +:whitespace+ only splits on
+ *	  whitespace; +:char+ compares character by character. A +String+
+ *	  may also be given, in which case each of its characters is a word
+ *	  boundary and every run of other characters is a token.
+ *
+ *		Rugged.word_diff("int foo = 1;", "int bar = 1;")
+ *		#=> [[4, 3], [4, 3]]
+ */
+static VALUE rb_git_word_diff(int argc, VALUE *argv, VALUE self)
+{
+	VALUE rb_old, rb_new, rb_options, rb_tokenizer = Qnil, rb_result;
+	unsigned char classes[256];
+	word_text old_text, new_text;
+
+	rb_scan_args(argc, argv, "21", &rb_old, &rb_new, &rb_options);
+
+	Check_Type(rb_old, T_STRING);
+	Check_Type(rb_new, T_STRING);
+
+	if (!NIL_P(rb_options)) {
+		Check_Type(rb_options, T_HASH);
+		rb_tokenizer = rb_hash_aref(rb_options, CSTR2SYM("tokenizer"));
+	}
+
+	word_classes_init(classes, rb_tokenizer);
+
+	word_tokenize(&old_text, RSTRING_PTR(rb_old), RSTRING_LEN(rb_old), classes);
+	word_tokenize(&new_text, RSTRING_PTR(rb_new), RSTRING_LEN(rb_new), classes);
+
+	word_diff(&old_text, &new_text);
+
+	rb_result = rb_ary_new3(2,
+		word_changed_ranges(&old_text),
+		word_changed_ranges(&new_text));
+
+	xfree(old_text.tokens);
+	xfree(old_text.changed);
+	xfree(new_text.tokens);
+	xfree(new_text.changed);
+
+	return rb_result;
+}
+
+void Init_rugged_word_diff()
+{
+	rb_define_module_function(rb_mRugged, "word_diff", rb_git_word_diff, -1);
+}
@@ -0,0 +1,429 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2013 GitHub, Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "rugged.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+extern VALUE rb_cRuggedRepo;
+
+#define WRITE_POLICY_PRIORITY 4 /* ahead of every other backend */
+
+/*
+ * The write settings of a repository, shared by the Ruby object that
+ * holds them and the ODB backend that applies them, which may outlive
+ * each other.
+ */
+typedef struct {
+	int refcount;
+	int compression;
+	int fsync_objects;
+	int fsync_refs;
+	int batch_depth;
+	char *repo_path;
+	git_odb_backend *loose;
+	git_odb_backend *loose_fsync;
+} rugged_write_policy;
+
+typedef struct {
+	git_odb_backend parent;
+	rugged_write_policy *policy;
+} write_policy_backend;
+
+static void write_policy_free_backends(rugged_write_policy *policy)
+{
+	if (policy->loose)
+		policy->loose->free(policy->loose);
+
+	if (policy->loose_fsync)
+		policy->loose_fsync->free(policy->loose_fsync);
+
+	policy->loose = policy->loose_fsync = NULL;
+}
+
+static void write_policy_unref(rugged_write_policy *policy)
+{
+	if (--policy->refcount > 0)
+		return;
+
+	write_policy_free_backends(policy);
+	xfree(policy->repo_path);
+	xfree(policy);
+}
+
+static int write_policy_load_backends(rugged_write_policy *policy)
+{
+	size_t len = strlen(policy->repo_path);
+	char *objects_path = xmalloc(len + sizeof("objects"));
+	int error;
+
+	memcpy(objects_path, policy->repo_path, len);
+	memcpy(objects_path + len, "objects", sizeof("objects"));
+
+	write_policy_free_backends(policy);
+
+	if ((error = git_odb_backend_loose(&policy->loose, objects_path, policy->compression, 0)) == 0)
+		error = git_odb_backend_loose(&policy->loose_fsync, objects_path, policy->compression, 1);
+
+	xfree(objects_path);
+
+	return error;
+}
+
+/* objects are only fsynced one by one outside of Repository#batch_fsync */
+static git_odb_backend *write_policy_loose(rugged_write_policy *policy)
+{
+	return policy->fsync_objects && !policy->batch_depth ? policy->loose_fsync : policy->loose;
+}
+
+static int write_policy_backend_write(git_oid *oid, git_odb_backend *_backend,
+	const void *data, size_t len, git_otype type)
+{
+	git_odb_backend *loose = write_policy_loose(((write_policy_backend *)_backend)->policy);
+	return loose->write(oid, loose, data, len, type);
+}
+
+static int write_policy_backend_writestream(git_odb_stream **stream, git_odb_backend *_backend,
+	size_t len, git_otype type)
+{
+	git_odb_backend *loose = write_policy_loose(((write_policy_backend *)_backend)->policy);
+	return loose->writestream(stream, loose, len, type);
+}
+
+/* objects are read and listed by the regular loose backend */
+static int write_policy_backend_foreach(git_odb_backend *_backend, git_odb_foreach_cb cb, void *payload)
+{
+	return 0;
+}
+
+static void write_policy_backend_free(git_odb_backend *_backend)
+{
+	write_policy_unref(((write_policy_backend *)_backend)->policy);
+	xfree(_backend);
+}
+
+static int write_policy_add_backend(git_odb *odb, rugged_write_policy *policy)
+{
+	write_policy_backend *backend = xcalloc(1, sizeof(write_policy_backend));
+	int error;
+
+	backend->parent.version = GIT_ODB_BACKEND_VERSION;
+	backend->parent.write = write_policy_backend_write;
+	backend->parent.writestream = write_policy_backend_writestream;
+	backend->parent.foreach = write_policy_backend_foreach;
+	backend->parent.free = write_policy_backend_free;
+	backend->policy = policy;
+
+	policy->refcount++;
+
+	if ((error = git_odb_add_backend(odb, &backend->parent, WRITE_POLICY_PRIORITY)) < 0)
+		write_policy_backend_free(&backend->parent);
+
+	return error;
+}
+
+static void rb_git_write_policy__free(rugged_write_policy *policy)
+{
+	write_policy_unref(policy);
+}
+
+static rugged_write_policy *write_policy_get(VALUE rb_repo)
+{
+	VALUE rb_policy = rb_attr_get(rb_repo, rb_intern("write_policy"));
+	rugged_write_policy *policy;
+
+	if (NIL_P(rb_policy))
+		return NULL;
+
+	Data_Get_Struct(rb_policy, rugged_write_policy, policy);
+	return policy;
+}
+
+/*
+ * Flush everything written to the filesystem holding the repository,
+ * in one go.
+ */
+static void write_policy_sync(rugged_write_policy *policy)
+{
+#ifdef HAVE_SYNCFS
+	int fd = open(policy->repo_path, O_RDONLY);
+
+	if (fd >= 0) {
+		syncfs(fd);
+		close(fd);
+		return;
+	}
+#endif
+	sync();
+}
+
+static void write_policy_fsync_path(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+}
+
+static char *write_policy_ref_path(rugged_write_policy *policy, const char *refname)
+{
+	size_t len = strlen(policy->repo_path);
+	char *path = xmalloc(len + strlen(refname) + sizeof("packed-refs"));
+
+	memcpy(path, policy->repo_path, len);
+	strcpy(path + len, refname);
+
+	return path;
+}
+
+/*
+ * Called after references have been written or deleted through Rugged,
+ * when the repository asks for durable reference updates: fsync the
+ * file of `refname` (or packed-refs, if it is packed or was deleted)
+ * and the directory holding it. A NULL `refname` means that an unknown
+ * set of references changed, and flushes the whole filesystem.
+ */
+void rugged_ref_fsync(VALUE rb_repo, const char *refname)
+{
+	rugged_write_policy *policy = write_policy_get(rb_repo);
+	git_repository *repo;
+	git_reference *ref, *resolved;
+	char *path = NULL, *slash;
+	size_t len;
+
+	if (!policy || !policy->fsync_refs || policy->batch_depth)
+		return;
+
+	if (!refname) {
+		write_policy_sync(policy);
+		return;
+	}
+
+	Data_Get_Struct(rb_repo, git_repository, repo);
+
+	/* for symbolic references, such as HEAD, the target was updated */
+	if (git_reference_lookup(&ref, repo, refname) == 0) {
+		if (git_reference_resolve(&resolved, ref) == 0) {
+			path = write_policy_ref_path(policy, git_reference_name(resolved));
+			git_reference_free(resolved);
+		}
+
+		git_reference_free(ref);
+	}
+
+	giterr_clear();
+
+	/* deleted references only have their directory left to sync */
+	if (!path)
+		path = write_policy_ref_path(policy, refname);
+
+	if (access(path, F_OK) == 0) {
+		write_policy_fsync_path(path);
+	} else {
+		len = strlen(policy->repo_path);
+		strcpy(path + len, "packed-refs");
+		write_policy_fsync_path(path);
+		strcpy(path + len, refname);
+	}
+
+	if ((slash = strrchr(path, '/')) != NULL) {
+		*slash = '\0';
+		write_policy_fsync_path(path);
+	}
+
+	xfree(path);
+}
+
+/*
+ * Install the write backend of `rb_repo`, if it has write options, in
+ * `odb`; used when a repository gets a new object database.
+ */
+int rugged_write_policy_attach(VALUE rb_repo, git_odb *odb)
+{
+	rugged_write_policy *policy = write_policy_get(rb_repo);
+	return policy ? write_policy_add_backend(odb, policy) : 0;
+}
+
+/*
+ *	call-seq:
+ *		repo.write_options = options
+ *
+ *	Set how new loose objects and reference updates are written to
+ *	disk. Trading durability for speed makes a big difference for
+ *	throwaway repositories, e.g. for CI merges.
+ *
+ *	The following options can be passed in the +options+ Hash:
+ *
+ *	:compression ::
+ *	  The zlib compression level of new loose objects, from 0 (none,
+ *	  the fastest) to 9. Defaults to libgit2's default.
+ *
+ *	:fsync_objects ::
+ *	  Whether every loose object is fsynced as soon as it is written.
+ *	  Defaults to +false+.
+ *
+ *	:fsync_refs ::
+ *	  Whether references created, updated or deleted through Rugged
+ *	  (including branches, tags, notes, Repository#reset and
+ *	  Remote#update_tips!) are fsynced, along with their directory.
+ *	  Defaults to +false+.
+ *
+ *	Inside a Repository#batch_fsync block, nothing is fsynced as it is
+ *	written; everything is flushed once at the end of the block instead.
+ */
+static VALUE rb_git_repo_set_write_options(VALUE self, VALUE rb_options)
+{
+	rugged_write_policy *policy;
+	VALUE rb_compression, rb_fsync_objects, rb_fsync_refs;
+	int compression = -1, error;
+
+	Check_Type(rb_options, T_HASH);
+
+	rb_compression = rb_hash_aref(rb_options, CSTR2SYM("compression"));
+	rb_fsync_objects = rb_hash_aref(rb_options, CSTR2SYM("fsync_objects"));
+	rb_fsync_refs = rb_hash_aref(rb_options, CSTR2SYM("fsync_refs"));
+
+	if (!NIL_P(rb_compression)) {
+		compression = NUM2INT(rb_compression);
+		if (compression < 0 || compression > 9)
+			rb_raise(rb_eArgError, "The compression level must be between 0 and 9");
+	}
+
+	policy = write_policy_get(self);
+
+	if (!policy) {
+		git_repository *repo;
+		git_odb *odb;
+		VALUE rb_policy;
+
+		Data_Get_Struct(self, git_repository, repo);
+
+		policy = xcalloc(1, sizeof(rugged_write_policy));
+		policy->refcount = 1;
+		policy->compression = -1;
+		policy->repo_path = xmalloc(strlen(git_repository_path(repo)) + 1);
+		strcpy(policy->repo_path, git_repository_path(repo));
+
+		rb_policy = Data_Wrap_Struct(rb_cObject, NULL, rb_git_write_policy__free, policy);
+
+		error = write_policy_load_backends(policy);
+		rugged_exception_check(error);
+
+		error = git_repository_odb(&odb, repo);
+		rugged_exception_check(error);
+
+		error = write_policy_add_backend(odb, policy);
+		git_odb_free(odb);
+		rugged_exception_check(error);
+
+		rb_ivar_set(self, rb_intern("write_policy"), rb_policy);
+	}
+
+	policy->fsync_objects = NIL_P(rb_fsync_objects) ? 0 : rugged_parse_bool(rb_fsync_objects);
+	policy->fsync_refs = NIL_P(rb_fsync_refs) ? 0 : rugged_parse_bool(rb_fsync_refs);
+
+	if (policy->compression != compression) {
+		policy->compression = compression;
+		error = write_policy_load_backends(policy);
+		rugged_exception_check(error);
+	}
+
+	return rb_options;
+}
+
+/*
+ *	call-seq:
+ *		repo.write_options -> hash
+ *
+ *	Return the options set with Repository#write_options=.
+ */
+static VALUE rb_git_repo_get_write_options(VALUE self)
+{
+	rugged_write_policy *policy = write_policy_get(self);
+	VALUE rb_options = rb_hash_new();
+
+	rb_hash_aset(rb_options, CSTR2SYM("compression"),
+		policy && policy->compression >= 0 ? INT2FIX(policy->compression) : Qnil);
+	rb_hash_aset(rb_options, CSTR2SYM("fsync_objects"),
+		policy && policy->fsync_objects ? Qtrue : Qfalse);
+	rb_hash_aset(rb_options, CSTR2SYM("fsync_refs"),
+		policy && policy->fsync_refs ? Qtrue : Qfalse);
+
+	return rb_options;
+}
+
+static VALUE batch_fsync_end(VALUE rb_policy)
+{
+	rugged_write_policy *policy;
+	Data_Get_Struct(rb_policy, rugged_write_policy, policy);
+
+	if (--policy->batch_depth == 0)
+		write_policy_sync(policy);
+
+	return Qnil;
+}
+
+/*
+ *	call-seq:
+ *		repo.batch_fsync { block } -> result of block
+ *
+ *	Write objects and references without fsyncing each of them, and
+ *	flush them all to disk once when the block returns, which is much
+ *	cheaper than fsyncing every write. Blocks can be nested; only the
+ *	outermost one flushes.
+ *
+ *		repo.write_options = { :fsync_objects => true, :fsync_refs => true }
+ *		repo.batch_fsync do
+ *		  commits.each { |c| Rugged::Commit.create(repo, c) }
+ *		end
+ */
+static VALUE rb_git_repo_batch_fsync(VALUE self)
+{
+	rugged_write_policy *policy;
+	VALUE rb_policy;
+
+	rb_need_block();
+
+	if (!write_policy_get(self))
+		rb_git_repo_set_write_options(self, rb_hash_new());
+
+	rb_policy = rb_attr_get(self, rb_intern("write_policy"));
+	Data_Get_Struct(rb_policy, rugged_write_policy, policy);
+
+	policy->batch_depth++;
+
+	return rb_ensure(rb_yield, self, batch_fsync_end, rb_policy);
+}
+
+void Init_rugged_write_policy()
+{
+	rb_define_method(rb_cRuggedRepo, "write_options=", rb_git_repo_set_write_options, 1);
+	rb_define_method(rb_cRuggedRepo, "write_options", rb_git_repo_get_write_options, 0);
+	rb_define_method(rb_cRuggedRepo, "batch_fsync", rb_git_repo_batch_fsync, 0);
+}
@@ -10,4 +10,5 @@ require 'rugged/tree'
 require 'rugged/tag'
 require 'rugged/branch'
 require 'rugged/diff'
+require 'rugged/tree_aggregator'
 require 'rugged/remote'
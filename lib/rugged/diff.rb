@@ -2,6 +2,7 @@ require 'rugged/diff/patch'
 require 'rugged/diff/hunk'
 require 'rugged/diff/line'
 require 'rugged/diff/delta'
+require 'rugged/diff/parsed'
 
 module Rugged
   class Diff
@@ -0,0 +1,16 @@
+module Rugged
+  class Diff
+    class Parsed
+      include Enumerable
+      alias each each_file
+
+      def paths
+        each_file.map { |file| file[:new_path] || file[:old_path] }
+      end
+
+      def inspect
+        "#<#{self.class.name}:#{object_id} {files: #{size}}>"
+      end
+    end
+  end
+end
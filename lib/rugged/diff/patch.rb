@@ -23,6 +23,44 @@ module Rugged
       def hunks
         each_hunk.to_a
       end
+
+      # Yields each removed line together with the added line that replaced
+      # it, and the byte ranges that changed within both of them, as
+      # returned by Rugged.word_diff. Runs of deletions followed by runs of
+      # additions are paired up line by line; unpaired lines are skipped.
+      def each_line_pair_with_changes(options = {}, &block)
+        return to_enum(:each_line_pair_with_changes, options) unless block_given?
+
+        each_hunk do |hunk|
+          deletions, additions = [], []
+
+          hunk.each_line do |line|
+            if line.deletion?
+              yield_line_pairs(deletions, additions, options, &block) unless additions.empty?
+              deletions << line
+            elsif line.addition?
+              additions << line
+            else
+              yield_line_pairs(deletions, additions, options, &block)
+            end
+          end
+
+          yield_line_pairs(deletions, additions, options, &block)
+        end
+      end
+
+      private
+
+      def yield_line_pairs(deletions, additions, options)
+        deletions.zip(additions).each do |old_line, new_line|
+          break unless new_line
+          old_ranges, new_ranges = Rugged.word_diff(old_line.content, new_line.content, options)
+          yield old_line, new_line, old_ranges, new_ranges
+        end
+
+        deletions.clear
+        additions.clear
+      end
     end
   end
 end
@@ -0,0 +1,36 @@
+module Rugged
+  class TreeAggregator
+    # Version of the format written by #save.
+    CACHE_FORMAT = 1
+
+    # Aggregate the tree of every commit in +commits+ (e.g. a
+    # Rugged::Walker), sharing the memoized subtrees between them.
+    #
+    # Returns an Array of [commit, value] pairs.
+    def aggregate_commits(commits)
+      commits.map { |commit| [commit, aggregate(commit)] }
+    end
+
+    # Write the memoized results to +path+, so a later process can #load
+    # them instead of reducing the same trees again.
+    def save(path)
+      File.open(path, "wb") do |file|
+        Marshal.dump([CACHE_FORMAT, reducer_name, cache_entries], file)
+      end
+      self
+    end
+
+    # Load results written by #save into the cache.
+    #
+    # Raises ArgumentError if the file was written by a different version
+    # or for a different reducer.
+    def load(path)
+      format, name, entries = File.open(path, "rb") { |file| Marshal.load(file) }
+
+      raise ArgumentError, "unsupported cache format #{format.inspect}" unless format == CACHE_FORMAT
+      raise ArgumentError, "cache was saved for reducer #{name.inspect}, not #{reducer_name.inspect}" unless name == reducer_name
+
+      import_cache_entries(entries)
+    end
+  end
+end
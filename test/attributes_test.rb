@@ -0,0 +1,42 @@
+require "test_helper"
+
+class AttributesTest < Rugged::SandboxedTestCase
+  def setup
+    super
+    @repo = sandbox_init("attr")
+  end
+
+  def test_attributes_for_path
+    attrs = @repo.attributes_for("root_test3", ["rootattr", "multiattr", "missingattr"])
+    assert_equal({ "rootattr" => nil, "multiattr" => "3", "missingattr" => nil }, attrs)
+  end
+
+  def test_attributes_for_many_paths
+    attrs = @repo.attributes_for(["root_test1", "root_test2", "sub/abc", "sub/subdir_test1"],
+      ["rootattr", "subattr", "foo"])
+
+    assert_equal true, attrs["root_test1"]["rootattr"]
+    assert_equal false, attrs["root_test2"]["rootattr"]
+    assert_equal "yes", attrs["sub/subdir_test1"]["subattr"]
+    assert_equal false, attrs["sub/abc"]["foo"]
+    assert_nil attrs["root_test1"]["subattr"]
+  end
+
+  def test_attributes_for_invalid_check
+    assert_raises ArgumentError do
+      @repo.attributes_for("root_test1", "rootattr", :check => :somewhere)
+    end
+  end
+
+  def test_attributes_for_names_with_nul
+    assert_raises ArgumentError do
+      @repo.attributes_for(["root_test1", "sub/abc"], ["rootattr", "sub\0attr"])
+    end
+  end
+
+  def test_ignored
+    assert @repo.ignored?("ign")
+    refute @repo.ignored?("file")
+    assert_equal [true, true, false], @repo.ignored?(["ign", "sub/ign", "root_test1"])
+  end
+end
@@ -0,0 +1,93 @@
+require "test_helper"
+
+class RepositoryCheckoutTreeTest < Rugged::TestCase
+  include Rugged::TempRepositoryAccess
+
+  def test_checkout_tree_restores_files
+    File.open(File.join(@path, "subdir", "README"), "w") { |f| f.puts "changed" }
+    File.unlink(File.join(@path, "new.txt"))
+    FileUtils.rm_rf(File.join(@path, "subdir", "subdir2"))
+
+    @repo.checkout_tree("36060c58702ed4c2a40832c51758d5344201d89a")
+
+    assert_equal "hey\n", File.read(File.join(@path, "subdir", "README"))
+    assert_equal "new file\n", File.read(File.join(@path, "new.txt"))
+    assert_equal "new file\n", File.read(File.join(@path, "subdir", "subdir2", "new.txt"))
+
+    ["subdir/README", "new.txt", "subdir/subdir2/new.txt"].each do |path|
+      assert_empty @repo.status(path)
+    end
+  end
+
+  def test_checkout_tree_replaces_index
+    @repo.checkout_tree(@repo.lookup("8496071c1b46c854b31185ea97743be6a8774479"), :threads => 1)
+
+    assert_equal 1, @repo.index.count
+    assert_equal [:index_deleted, :worktree_new], @repo.status("new.txt")
+  end
+
+  def test_checkout_tree_reports_progress
+    progress = []
+    @repo.checkout_tree("36060c58702ed4c2a40832c51758d5344201d89a", :threads => 4) do |completed, total|
+      progress << [completed, total]
+    end
+
+    assert_equal [6, 6], progress.last
+    assert_equal progress.sort, progress
+  end
+
+  def test_checkout_tree_rejects_git_directory
+    subdir = @repo.lookup("36060c58702ed4c2a40832c51758d5344201d89a").path("subdir")[:oid]
+    builder = Rugged::Tree::Builder.new
+    builder << { :type => :tree, :name => ".GIT", :oid => subdir, :filemode => 0040000 }
+    tree = builder.write(@repo)
+
+    assert_raises Rugged::InvalidError do
+      @repo.checkout_tree(tree)
+    end
+
+    refute File.exist?(File.join(@path, ".GIT", "README"))
+  end
+
+  def test_checkout_tree_in_bare_repository
+    bare = Rugged::Repository.new(File.join(Rugged::TestCase::TEST_DIR, "fixtures", "testrepo.git"))
+
+    assert_raises Rugged::RepositoryError do
+      bare.checkout_tree("36060c58702ed4c2a40832c51758d5344201d89a")
+    end
+  end
+end
+
+class RepositorySparseCheckoutTest < Rugged::TestCase
+  include Rugged::TempRepositoryAccess
+
+  def setup
+    super
+    ["README", "new.txt", "subdir"].each { |path| FileUtils.rm_rf(File.join(@path, path)) }
+  end
+
+  def test_checkout_tree_with_paths
+    @repo.checkout_tree("36060c58702ed4c2a40832c51758d5344201d89a", :paths => ["subdir/subdir2"])
+
+    assert_equal ["README", "new.txt"], Dir.entries(File.join(@path, "subdir", "subdir2")).sort - [".", ".."]
+    assert_equal ["subdir2"], Dir.entries(File.join(@path, "subdir")) - [".", ".."]
+    refute File.exist?(File.join(@path, "README"))
+
+    assert_equal ["subdir/subdir2/README", "subdir/subdir2/new.txt"], @repo.index.map { |e| e[:path] }
+  end
+
+  def test_checkout_tree_with_sparse_patterns
+    total = nil
+    @repo.checkout_tree("36060c58702ed4c2a40832c51758d5344201d89a",
+      :sparse_patterns => Rugged::Pathspec.new(["*.txt"])) { |_, t| total = t }
+
+    assert_equal 3, total
+    assert File.exist?(File.join(@path, "subdir", "subdir2", "new.txt"))
+    refute File.exist?(File.join(@path, "subdir", "README"))
+
+    index = @repo.index
+    assert_equal 6, index.count
+    assert index["README"][:skip_worktree]
+    refute index["new.txt"][:skip_worktree]
+  end
+end
@@ -43,6 +43,16 @@ class TestCommit < Rugged::TestCase
     assert parents.include?("c47800c7266a2be04c571c04d5a6614691ea99bd")
   end
 
+  def test_signature_strings_are_interned
+    first = @repo.lookup("8496071c1b46c854b31185ea97743be6a8774479")
+    second = @repo.lookup("5b5b025afb0b4c913b4c338a42934a3863bf3644")
+
+    assert_equal first.author[:email], second.author[:email]
+    assert_same first.author[:email], second.author[:email]
+    assert_same first.author[:name], first.committer[:name]
+    assert first.author[:name].frozen?
+  end
+
   def test_get_tree_oid
     oid = "8496071c1b46c854b31185ea97743be6a8774479"
     obj = @repo.lookup(oid)
@@ -104,4 +114,82 @@ class CommitWriteTest < Rugged::TestCase
         :tree => "c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
     end
   end
+
+  def test_write_raw_commit
+    person = Rugged::Signature.new("Scott", "schacon@gmail.com", Time.at(1370000000))
+
+    oid = Rugged::Commit.create_raw(@repo,
+      :message => "This is the commit message\n\nThis commit is created from Rugged",
+      :committer => person,
+      :author => person,
+      :parent_oids => [@repo.head.target],
+      :tree_oid => "c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+
+    commit = @repo.lookup(oid)
+    assert_equal [@repo.head.target], commit.parent_oids
+    assert_equal "c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b", commit.tree_oid
+    assert_equal "Scott", commit.author[:name]
+    assert_equal Time.at(1370000000), commit.committer[:time]
+  end
+
+  def test_write_raw_commit_with_signature_hash
+    person = {:name => 'Jake', :email => 'jake@github.com', :time => Time.now, :time_offset => 3600}
+
+    oid = Rugged::Commit.create_raw(@repo,
+      :message => "This is the commit message\n\nThis commit is created from Rugged",
+      :committer => person,
+      :author => person,
+      :parent_oids => [],
+      :tree_oid => "c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+
+    assert_equal 3600, @repo.lookup(oid).committer[:time_offset]
+  end
+
+  def test_write_raw_commit_invalid_oid
+    person = Rugged::Signature.new("Jake", "jake@github.com")
+
+    assert_raises Rugged::InvalidError do
+      Rugged::Commit.create_raw(@repo,
+        :message => "This is the commit message\n\nThis commit is created from Rugged",
+        :committer => person,
+        :author => person,
+        :parent_oids => ["notanoid"],
+        :tree_oid => "c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+    end
+  end
+
+  def test_write_raw_commit_with_nul_in_message
+    person = {:name => 'Jake', :email => 'jake@github.com', :time => Time.now}
+
+    assert_raises ArgumentError do
+      Rugged::Commit.create_raw(@repo,
+        :message => "This is the commit message\0with a NUL byte",
+        :committer => person,
+        :author => person,
+        :parent_oids => [],
+        :tree_oid => "c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+    end
+  end
+
+  def test_uninitialized_signature
+    person = Rugged::Signature.allocate
+
+    assert_raises(RuntimeError) { person.name }
+    assert_raises(RuntimeError) { person.time }
+    assert_raises RuntimeError do
+      Rugged::Commit.create_raw(@repo,
+        :message => "This is the commit message",
+        :committer => person,
+        :author => person,
+        :parent_oids => [],
+        :tree_oid => "c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+    end
+  end
+
+  def test_reinitialize_signature
+    person = Rugged::Signature.new("Jake", "jake@github.com")
+    person.send(:initialize, "Scott", "schacon@gmail.com")
+
+    assert_equal "Scott", person.name
+  end
 end
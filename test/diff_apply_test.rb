@@ -0,0 +1,105 @@
+require "test_helper"
+
+class DiffApplyTest < Rugged::TestCase
+  include Rugged::TempRepositoryAccess
+
+  PATCH = <<-PATCH
+diff --git a/README b/README
+index 1385f26..ce01362 100644
+--- a/README
++++ b/README
+@@ -1 +1 @@
+-hey
++hello
+diff --git a/subdir/added.txt b/subdir/added.txt
+new file mode 100644
+index 0000000..3b18e51
+--- /dev/null
++++ b/subdir/added.txt
+@@ -0,0 +1 @@
++hello world
+PATCH
+
+  def test_parse
+    diff = Rugged::Diff.parse(PATCH)
+    assert_equal 2, diff.size
+
+    files = diff.to_a
+    assert_equal "README", files[0][:old_path]
+    assert_equal :modified, files[0][:status]
+    assert_equal 1, files[0][:hunks]
+
+    assert_nil files[1][:old_path]
+    assert_equal :added, files[1][:status]
+    assert_equal 0100644, files[1][:new_mode]
+    assert_equal ["README", "subdir/added.txt"], diff.paths
+  end
+
+  def test_apply_to_tree
+    tree = @repo.lookup(@repo.head.target).tree
+    result = tree.apply(PATCH)
+
+    new_tree = @repo.lookup(result[:tree])
+    assert_equal "hello\n", @repo.lookup(new_tree["README"][:oid]).content
+    assert_equal "hello world\n", @repo.lookup(new_tree.path("subdir/added.txt")[:oid]).content
+
+    # untouched subtrees are reused as-is
+    assert_equal tree.path("subdir/subdir2")[:oid], new_tree.path("subdir/subdir2")[:oid]
+
+    assert_equal 2, result[:hunks].size
+    assert_equal({ :path => "README", :hunk => 0, :offset => 0, :fuzz => 0 }, result[:hunks][0])
+  end
+
+  def test_apply_rejects_mismatched_hunk
+    patch = PATCH.sub("-hey", "-bye")
+
+    assert_raises Rugged::InvalidError do
+      @repo.lookup(@repo.head.target).tree.apply(Rugged::Diff.parse(patch))
+    end
+  end
+
+  def test_apply_rejects_existing_file
+    patch = PATCH.gsub("subdir/added.txt", "new.txt")
+
+    assert_raises Rugged::InvalidError do
+      @repo.lookup(@repo.head.target).tree.apply(patch)
+    end
+  end
+
+  def test_apply_binary_patch_without_trailing_blank_line
+    patch = <<-PATCH
+diff --git a/data.bin b/data.bin
+new file mode 100644
+index 0000000..7989678
+GIT binary patch
+literal 8
+PcmYew%wtF_s^kIy3}FJ0
+PATCH
+
+    result = @repo.lookup(@repo.head.target).tree.apply(patch)
+    new_tree = @repo.lookup(result[:tree])
+    assert_equal "bin\0ary\n", @repo.lookup(new_tree["data.bin"][:oid]).content
+  end
+
+  def test_apply_rejects_negative_fuzz
+    assert_raises ArgumentError do
+      @repo.lookup(@repo.head.target).tree.apply(PATCH, :fuzz => -1)
+    end
+  end
+
+  def test_apply_patches_to_the_same_file_in_order
+    patch = PATCH + <<-PATCH
+diff --git a/README b/README
+index ce01362..b1fc3e5 100644
+--- a/README
++++ b/README
+@@ -1 +1 @@
+-hello
++hello again
+PATCH
+
+    result = @repo.lookup(@repo.head.target).tree.apply(patch)
+    new_tree = @repo.lookup(result[:tree])
+    assert_equal "hello again\n", @repo.lookup(new_tree["README"][:oid]).content
+  end
+end
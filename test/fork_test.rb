@@ -0,0 +1,43 @@
+require "test_helper"
+
+class ForkTest < Rugged::TestCase
+  include Rugged::RepositoryAccess
+
+  def test_repository_is_usable_after_fork
+    skip "fork is not available" unless Process.respond_to?(:fork)
+
+    commit = @repo.lookup("36060c58702ed4c2a40832c51758d5344201d89a")
+    Rugged.prepare_for_fork(@repo)
+
+    pid = fork do
+      Rugged.after_fork
+      exit!(@repo.exists?("41bc8c69075bbdb46c5c6f0566cc8cc5b46e8bd9") && commit.tree.count == 3 ? 0 : 1)
+    end
+
+    Process.wait(pid)
+    assert $?.success?
+    assert @repo.exists?("41bc8c69075bbdb46c5c6f0566cc8cc5b46e8bd9")
+  end
+
+  def test_alternates_survive_after_fork
+    skip "fork is not available" unless Process.respond_to?(:fork)
+
+    alt_path = File.dirname(__FILE__) + '/fixtures/alternate/objects'
+    repo = Rugged::Repository.new(@path, :alternates => [alt_path])
+    Rugged.prepare_for_fork(repo)
+
+    pid = fork do
+      Rugged.after_fork
+      exit!(repo.exists?("146ae76773c91e3b1d00cf7a338ec55ae58297e2") ? 0 : 1)
+    end
+
+    Process.wait(pid)
+    assert $?.success?
+  ensure
+    Rugged.prepare_for_fork
+  end
+
+  def test_prepare_for_fork_expects_repositories
+    assert_raises(TypeError) { Rugged.prepare_for_fork("not a repo") }
+  end
+end
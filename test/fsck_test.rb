@@ -0,0 +1,54 @@
+require "test_helper"
+require "zlib"
+
+class FsckTest < Rugged::TestCase
+  include Rugged::TempRepositoryAccess
+
+  def object_path(oid)
+    File.join(@repo.path, "objects", oid[0, 2], oid[2..-1])
+  end
+
+  def test_healthy_repository
+    report = @repo.fsck(:verify_hashes => true)
+
+    assert report[:ok]
+    assert_equal @repo.ids.length, report[:objects]
+    assert_equal 1, report[:packs].length
+    assert report[:packs][0][:checksum]
+    assert report[:packs][0][:index_checksum]
+    assert_empty report[:packs][0][:bad_crcs]
+    assert_empty report[:missing]
+    assert_empty report[:corrupt]
+    assert_equal report[:objects], report[:reachable] + report[:unreachable]
+  end
+
+  def test_progress
+    phases = []
+    @repo.fsck(:verify_hashes => true, :threads => 2) do |phase, done, total|
+      assert done <= total
+      phases << phase
+    end
+
+    assert_equal [:packs, :hashes, :connectivity], phases.uniq
+  end
+
+  def test_missing_object
+    oid = @repo.write("soon gone\n", :blob)
+    Rugged::Reference.create(@repo, "refs/tags/gone", oid)
+    File.unlink(object_path(oid))
+
+    report = @repo.fsck(:packs => false)
+    refute report[:ok]
+    assert_equal [{ :id => oid, :referrer => nil }], report[:missing]
+  end
+
+  def test_corrupt_object
+    oid = @repo.write("original\n", :blob)
+    File.chmod(0644, object_path(oid))
+    File.open(object_path(oid), "wb") { |f| f.write(Zlib::Deflate.deflate("blob 9\0tampered\n")) }
+
+    report = @repo.fsck(:verify_hashes => true, :connectivity => false)
+    refute report[:ok]
+    assert_equal [oid], report[:corrupt].map { |problem| problem[:id] }
+  end
+end
@@ -28,6 +28,29 @@ class RuggedTest < Rugged::TestCase
     assert_raises(TypeError) { Rugged::Settings['mwindow_size'] = nil }
   end
 
+  def test_cache_settings
+    max_size = Rugged::Settings['cache_max_size']
+
+    begin
+      Rugged::Settings['cache_max_size'] = 64 * 1024 * 1024
+      assert_equal 64 * 1024 * 1024, Rugged::Settings['cache_max_size']
+
+      Rugged::Settings['cache_object_limits'] = { :tree => 8192, :blob => 0 }
+      Rugged::Settings['enable_caching'] = true
+
+      assert Rugged::Settings['cached_memory'] >= 0
+      assert_raises(ArgumentError) { Rugged::Settings['cached_memory'] = 0 }
+      assert_raises(TypeError) { Rugged::Settings['cache_object_limits'] = 4096 }
+      assert_raises(TypeError) { Rugged::Settings['cache_object_limits'] = { :tree => 0, :blob => "big" } }
+      assert_raises(TypeError) { Rugged::Settings['cache_object_limits'] = { :tree => 0, :bogus => 4096 } }
+    ensure
+      Rugged::Settings['cache_max_size'] = max_size
+
+      # the limits can't be read back, so put libgit2's defaults back
+      Rugged::Settings['cache_object_limits'] = { :commit => 4096, :tree => 4096, :tag => 4096, :blob => 0 }
+    end
+  end
+
   def test_capabilities
     capabilities = Rugged.capabilities
     assert capabilities.is_a? Array
@@ -0,0 +1,68 @@
+require "test_helper"
+
+class MergeFilesTest < Rugged::SandboxedTestCase
+  def setup
+    super
+
+    @repo = sandbox_init("mergedrepo")
+  end
+
+  def blobs(path)
+    ["9a05ccb", "master", "branch"].map { |rev| @repo.rev_parse("#{rev}:#{path}") }
+  end
+
+  def test_clean_merge
+    result = Rugged.merge_files(*blobs("one.txt"))
+
+    assert_equal false, result[:conflicted]
+    assert_equal "75938de1e367098b3e9a7b1ec3c4ac4548afffe4",
+      Rugged::Repository.hash(result[:content], :blob)
+  end
+
+  def test_conflicted_merge
+    ancestor, ours, theirs = blobs("conflicts-one.txt")
+    result = Rugged.merge_files(ancestor, ours, theirs, :our_label => "ours", :their_label => "theirs")
+
+    assert_equal true, result[:conflicted]
+    assert_equal "<<<<<<< ours\nThis is most certainly a conflict!\n" +
+      "=======\nThis is a conflict!!!\n>>>>>>> theirs\n", result[:content]
+  end
+
+  def test_conflicted_merge_diff3_style
+    ancestor, ours, theirs = blobs("conflicts-one.txt")
+    result = Rugged.merge_files(ancestor, ours, theirs, :style => :diff3)
+
+    assert_equal "<<<<<<<\nThis is most certainly a conflict!\n" +
+      "|||||||\nThis is a conflict!\n" +
+      "=======\nThis is a conflict!!!\n>>>>>>>\n", result[:content]
+  end
+
+  def test_favor_theirs
+    ancestor, ours, theirs = blobs("conflicts-one.txt")
+    result = Rugged.merge_files(ancestor, ours, theirs, :favor => :theirs)
+
+    assert_equal false, result[:conflicted]
+    assert_equal "This is a conflict!!!\n", result[:content]
+  end
+
+  def test_merge_text_with_control_characters
+    ancestor, ours, theirs = [
+      "\x01\x02\x03one\n\x01\x02\x03two\n\x01\x02\x03three\n",
+      "\x01\x02\x03ONE\n\x01\x02\x03two\n\x01\x02\x03three\n",
+      "\x01\x02\x03one\n\x01\x02\x03two\n\x01\x02\x03THREE\n"
+    ].map { |content| @repo.lookup(Rugged::Blob.from_buffer(@repo, content)) }
+
+    result = Rugged.merge_files(ancestor, ours, theirs)
+
+    assert_equal false, result[:conflicted]
+    assert_equal "\x01\x02\x03ONE\n\x01\x02\x03two\n\x01\x02\x03THREE\n", result[:content]
+  end
+
+  def test_missing_ancestor
+    ours = blobs("conflicts-one.txt")[1]
+    result = Rugged.merge_files(nil, ours, ours)
+
+    assert_equal false, result[:conflicted]
+    assert_equal ours.content, result[:content]
+  end
+end
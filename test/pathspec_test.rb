@@ -0,0 +1,62 @@
+require "test_helper"
+
+class PathspecTest < Rugged::TestCase
+  include Rugged::RepositoryAccess
+
+  def test_match_paths
+    pathspec = Rugged::Pathspec.new(["lib/", "README", "*.gemspec", "ext/rugged/rugged_*"])
+
+    assert pathspec.match_path("lib/rugged.rb")
+    assert pathspec.match_path("README")
+    assert pathspec.match_path("vendor/foo.gemspec")
+    assert pathspec.match_path("ext/rugged/rugged_tree.c")
+    refute pathspec.match_path("lib")
+    refute pathspec.match_path("README.md")
+    refute pathspec.match_path("ext/rugged/extconf.rb")
+
+    assert_equal ["lib/a.rb", "README"], pathspec.match_paths(["lib/a.rb", "libx/a.rb", "README"])
+    assert_equal ["lib/", "README", "*.gemspec", "ext/rugged/rugged_*"], pathspec.patterns
+  end
+
+  def test_empty_pathspec_matches_everything
+    assert Rugged::Pathspec.new([]).match_path("any/path")
+    assert Rugged::Pathspec.new(".").match_path("any/path")
+  end
+
+  def test_match_tree
+    tree = @repo.lookup("c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+
+    assert_equal ["subdir/subdir2/README", "subdir/subdir2/new.txt"],
+      Rugged::Pathspec.new("subdir/subdir2").match_tree(tree)
+    assert_equal ["README", "subdir/README", "subdir/subdir2/README"],
+      Rugged::Pathspec.new("*README").match_tree(tree)
+    assert_equal 6, Rugged::Pathspec.new([]).match_tree(tree).size
+  end
+
+  def test_tree_diff_with_pathspec
+    old_tree = @repo.lookup("181037049a54a1eb5fab404658a3a250b44335d7")
+    tree = @repo.lookup("c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+
+    diff = old_tree.diff(tree, :paths => Rugged::Pathspec.new("subdir/subdir2"))
+    assert_equal ["subdir/subdir2/README", "subdir/subdir2/new.txt"],
+      diff.deltas.map { |d| d.new_file[:path] }
+  end
+
+  def test_walker_with_pathspec
+    walker = Rugged::Walker.new(@repo)
+    walker.push("36060c58702ed4c2a40832c51758d5344201d89a")
+    walker.pathspec = Rugged::Pathspec.new("new.txt")
+    assert_equal ["5b5b025afb0b4c913b4c338a42934a3863bf3644"], walker.map(&:oid)
+
+    walker.reset
+    walker.push("36060c58702ed4c2a40832c51758d5344201d89a")
+    walker.pathspec = Rugged::Pathspec.new(["README", "subdir/"])
+    assert_equal ["36060c58702ed4c2a40832c51758d5344201d89a",
+      "8496071c1b46c854b31185ea97743be6a8774479"], walker.map(&:oid)
+
+    walker.reset
+    walker.push("36060c58702ed4c2a40832c51758d5344201d89a")
+    walker.pathspec = nil
+    assert_equal 3, walker.count
+  end
+end
@@ -43,6 +43,32 @@ class ReferenceTest < Rugged::TestCase
     assert_equal e[:committer][:email], "schacon@gmail.com"
   end
 
+  def test_load_reflog_window
+    ref = Rugged::Reference.lookup(@repo, "refs/heads/master")
+
+    log = ref.log(:limit => 1)
+    assert_equal 1, log.size
+    assert_equal "push", log[0][:message]
+
+    log = ref.log(:limit => 1, :offset => 1)
+    assert_equal "commit: another commit", log[0][:message]
+    assert_equal "schacon@gmail.com", log[0][:committer][:email]
+
+    assert_equal ref.log, ref.log(:offset => 0)
+    assert_equal [], ref.log(:offset => 3)
+  end
+
+  def test_each_log_entry_starts_from_the_end
+    ref = Rugged::Reference.lookup(@repo, "refs/heads/master")
+
+    messages = ref.each_log_entry.map { |e| e[:message] }
+    assert_equal ["push", "commit: another commit", "commit (initial): testing"], messages
+
+    entries = ref.each_log_entry(:limit => 2).to_a
+    assert_equal 2, entries.size
+    assert_equal "36060c58702ed4c2a40832c51758d5344201d89a", entries[0][:id_new]
+  end
+
   def test_reference_exists
     exists = Rugged::Reference.exist?(@repo, "refs/heads/master")
     assert exists
@@ -168,5 +194,12 @@ class ReflogTest < Rugged::TestCase
     assert_equal reflog[1][:committer][:email], "foo@bar"
     assert_kind_of Time, reflog[1][:committer][:time]
   end
-end
 
+  def test_each_log_entry_matches_log
+    @ref.log!({ :name => "foo", :email => "foo@bar", :time => Time.now })
+    @ref.log!({ :name => "foo", :email => "foo@bar", :time => Time.now }, "commit: bla bla")
+
+    assert_equal @ref.log.reverse, @ref.each_log_entry.to_a
+    assert_equal nil, @ref.each_log_entry.to_a.last[:message]
+  end
+end
@@ -0,0 +1,53 @@
+require "test_helper"
+require 'stringio'
+
+class RepositoryFastExportTest < Rugged::TestCase
+  include Rugged::RepositoryAccess
+
+  def test_export_branch
+    io = StringIO.new
+    marks = @repo.fast_export(io, "refs/heads/master")
+    stream = io.string
+
+    assert_equal 3, stream.scan(/^commit refs\/heads\/master$/).size
+    assert_equal 2, stream.scan(/^blob$/).size
+    assert_match "M 100644 :1 README\n", stream
+    assert_match "reset refs/heads/master\nfrom :5\n", stream
+
+    assert_equal 5, marks.size
+    assert_equal 5, marks["36060c58702ed4c2a40832c51758d5344201d89a"]
+  end
+
+  def test_export_is_incremental_with_marks
+    marks = { "8496071c1b46c854b31185ea97743be6a8774479" => 2, "1385f264afb75a56a5bec74243be9b367ba4ca08" => 1 }
+
+    io = StringIO.new
+    @repo.fast_export(io, ["refs/heads/master"], :marks => marks)
+    stream = io.string
+
+    assert_equal 2, stream.scan(/^commit /).size
+    assert_match "from :2\n", stream
+    assert_equal 4, marks["5b5b025afb0b4c913b4c338a42934a3863bf3644"]
+
+    io = StringIO.new
+    @repo.fast_export(io, ["refs/heads/master"], :marks => marks)
+    assert_equal 0, io.string.scan(/^commit /).size
+    assert_match "reset refs/heads/master\nfrom :", io.string
+  end
+
+  def test_export_never_reuses_marks_of_missing_objects
+    marks = { "deadbeefdeadbeefdeadbeefdeadbeefdeadbeef" => 10 }
+
+    @repo.fast_export(StringIO.new, ["refs/heads/master"], :marks => marks)
+
+    new_marks = marks.values - [10]
+    assert_equal 5, new_marks.size
+    assert new_marks.all? { |mark| mark > 10 }
+  end
+
+  def test_export_requires_io
+    assert_raises ArgumentError do
+      @repo.fast_export(nil, "refs/heads/master")
+    end
+  end
+end
@@ -138,6 +138,29 @@ class RepositoryTest < Rugged::TestCase
     assert repo.read('146ae76773c91e3b1d00cf7a338ec55ae58297e2')
   end
 
+  def test_enumerate_objects_by_type
+    commits = @repo.each_id(:type => :commit).to_a
+    assert_equal 13, commits.length
+    assert commits.include?("36060c58702ed4c2a40832c51758d5344201d89a")
+    commits.each { |id| assert_equal :commit, @repo.read_header(id)[:type] }
+
+    assert_equal commits, @repo.ids(:type => :commit)
+    assert_equal 1, @repo.ids(:type => :tag).length
+    assert_equal @repo.each_id.to_a.uniq.sort, @repo.ids
+  end
+
+  def test_packed_ids
+    raw = @repo.ids(:type => :tree, :packed => true)
+    assert_equal @repo.ids(:type => :tree), raw.unpack("H40" * (raw.bytesize / 20))
+  end
+
+  def test_ids_include_alternates
+    alt_path = File.dirname(__FILE__) + '/fixtures/alternate/objects'
+    repo = Rugged::Repository.new(@path, :alternates => [alt_path])
+    assert_equal repo.each_id.to_a.uniq.sort, repo.ids
+    assert repo.ids(:type => :tree).include?('146ae76773c91e3b1d00cf7a338ec55ae58297e2')
+  end
+
   def test_alternates_with_invalid_path_type
     assert_raises TypeError do
       Rugged::Repository.new(@path, :alternates => [:invalid_input])
@@ -366,3 +389,154 @@ class RepositoryAddTest < Rugged::SandboxedTestCase
     assert_equal expected, repo.index.map {|entry| entry[:path]}
   end
 end
+
+class RepositoryMergeTreesTest < Rugged::SandboxedTestCase
+  def setup
+    super
+
+    @repo = sandbox_init("mergedrepo")
+  end
+
+  def test_clean_merge_returns_tree_oid
+    base = @repo.rev_parse("master~1")
+
+    assert_equal "03db1d37504ca0c4f7c26d7776b0e28bdea08712",
+      @repo.merge_trees(base.tree, "master", base.tree)
+  end
+
+  def test_conflicted_merge_returns_index
+    index = @repo.merge_trees(nil, "master", "branch")
+
+    assert_kind_of Rugged::Index, index
+    assert index.conflicts?
+
+    assert_equal "1f85ca51b8e0aac893a621b61a9c2661d6aa6d81", index.get("conflicts-one.txt", 1)[:oid]
+    assert_equal "6aea5f295304c36144ad6e9247a291b7f8112399", index.get("conflicts-one.txt", 2)[:oid]
+    assert_equal "516bd85f78061e09ccc714561d7b504672cb52da", index.get("conflicts-one.txt", 3)[:oid]
+    assert_equal 0, index.get("one.txt")[:stage]
+  end
+end
+
+class RepositoryCherryPickTreeTest < Rugged::SandboxedTestCase
+  def setup
+    super
+
+    @repo = sandbox_init("mergedrepo")
+  end
+
+  def test_clean_cherry_pick
+    assert_equal "03db1d37504ca0c4f7c26d7776b0e28bdea08712",
+      @repo.cherry_pick_tree("master", "master~1")
+  end
+
+  def test_conflicted_cherry_pick
+    index = @repo.cherry_pick_tree("branch", "master")
+
+    assert index.conflicts?
+    assert_equal "516bd85f78061e09ccc714561d7b504672cb52da", index.get("conflicts-one.txt", 3)[:oid]
+  end
+
+  def test_revert
+    assert_equal "f72784290c151092abf04ce6b875068547f70406",
+      @repo.revert_tree("master", @repo.rev_parse("master"))
+  end
+
+  def test_revert_root_commit_leaves_the_object_database_alone
+    empty_tree = "4b825dc642cb6eb9a060e54bf8d69288fbee4904"
+    refute @repo.exists?(empty_tree)
+
+    index = @repo.revert_tree("9a05ccb4e0f948de03128e095f39dae6976751c5", "master")
+
+    assert index.conflicts?
+    refute @repo.exists?(empty_tree)
+  end
+
+  def test_mainline_requires_a_merge
+    assert_raises ArgumentError do
+      @repo.cherry_pick_tree("master", "branch", :mainline => 1)
+    end
+  end
+end
+
+class RepositoryDiffCacheTest < Rugged::TestCase
+  include Rugged::RepositoryAccess
+
+  OLD = "8496071c1b46c854b31185ea97743be6a8774479"
+  NEW = "5b5b025afb0b4c913b4c338a42934a3863bf3644"
+
+  def test_diff_patch_without_cache
+    patch = @repo.diff_patch(OLD, NEW)
+
+    assert_match "+++ b/new.txt", patch
+    assert_equal 0, @repo.diff_cache_size
+    assert_equal 0, @repo.diff_cache_stats[:misses]
+    refute_same patch, @repo.diff_patch(OLD, NEW)
+  end
+
+  def test_cached_diff_patch
+    @repo.diff_cache_size = 1024 * 1024
+
+    patch = @repo.diff_patch(OLD, NEW)
+    assert patch.frozen?
+    assert_same patch, @repo.diff_patch(@repo.lookup(OLD), @repo.lookup(NEW).tree)
+
+    compact = @repo.diff_patch(OLD, NEW, :compact => true)
+    refute_equal patch, compact
+
+    stats = @repo.diff_cache_stats
+    assert_equal 1, stats[:hits]
+    assert_equal 2, stats[:misses]
+    assert_equal 2, stats[:entries]
+
+    @repo.clear_diff_cache
+    assert_equal 0, @repo.diff_cache_stats[:entries]
+    assert_equal 0, @repo.diff_cache_stats[:bytes]
+  end
+
+  def test_cache_key_ignores_path_order
+    @repo.diff_cache_size = 1024 * 1024
+
+    patch = @repo.diff_patch(OLD, NEW, :paths => ["new.txt", "README"])
+    assert_same patch, @repo.diff_patch(OLD, NEW, :paths => ["README", "new.txt", "README"])
+  end
+
+  def test_diff_patch_with_bad_tree_raises
+    @repo.diff_cache_size = 1024 * 1024
+
+    assert_raises(Rugged::Error) do
+      @repo.diff_patch(OLD, "refs/heads/does-not-exist")
+    end
+  end
+
+  def test_cache_evicts_least_recently_used
+    @repo.diff_cache_size = 1024 * 1024
+    first = @repo.diff_patch(OLD, NEW)
+    @repo.diff_patch(nil, NEW)
+    @repo.diff_patch(OLD, NEW)
+
+    @repo.diff_cache_size = @repo.diff_cache_stats[:bytes] - 1
+    assert_equal 1, @repo.diff_cache_stats[:evictions]
+    assert_same first, @repo.diff_patch(OLD, NEW)
+  end
+end
+
+class RepositoryDiffStatsTest < Rugged::TestCase
+  include Rugged::RepositoryAccess
+
+  def test_diff_stats_for
+    stats = @repo.diff_stats_for([
+      "36060c58702ed4c2a40832c51758d5344201d89a",
+      "5b5b025afb0b4c913b4c338a42934a3863bf3644",
+      @repo.lookup("8496071c1b46c854b31185ea97743be6a8774479")
+    ])
+
+    assert_equal [[4, 4, 0], [1, 1, 0], [1, 1, 0]], stats
+    assert_equal [], @repo.diff_stats_for([])
+  end
+
+  def test_diff_stats_for_missing_commit
+    assert_raises Rugged::OdbError do
+      @repo.diff_stats_for(["36060c58702ed4c2a40832c51758d5344201d89a", "a" * 40])
+    end
+  end
+end
@@ -0,0 +1,53 @@
+require "test_helper"
+
+class SharedObjectCacheTest < Rugged::TestCase
+  def setup
+    @dir = Dir.mktmpdir("rugged_shm")
+    @repo_path = File.join(TEST_DIR, "fixtures", "testrepo.git")
+    @cache = Rugged::SharedObjectCache.new(File.join(@dir, "objects"), :size => 1024 * 1024)
+  end
+
+  def teardown
+    FileUtils.remove_entry_secure(@dir)
+  end
+
+  def test_objects_are_shared_between_repositories
+    first = Rugged::Repository.new(@repo_path)
+    first.add_shared_object_cache(@cache)
+    commit = first.lookup("36060c58702ed4c2a40832c51758d5344201d89a")
+
+    stats = @cache.stats
+    assert_equal 1, stats[:misses]
+    assert_equal 1, stats[:inserts]
+
+    second = Rugged::Repository.new(@repo_path)
+    second.add_shared_object_cache(Rugged::SharedObjectCache.new(@cache.path))
+
+    assert_equal commit.message, second.lookup("36060c58702ed4c2a40832c51758d5344201d89a").message
+    assert_equal 1, @cache.stats[:hits]
+    assert_equal 1024 * 1024, @cache.stats[:size]
+  end
+
+  def test_missing_objects
+    repo = Rugged::Repository.new(@repo_path)
+    repo.add_shared_object_cache(@cache)
+
+    refute repo.exists?("ce08fe4884650f067bd5703b6a59a8b3b3c99a09")
+    assert repo.exists?("8496071c1b46c854b31185ea97743be6a8774479")
+    assert_raises(Rugged::OdbError) { repo.read("ce08fe4884650f067bd5703b6a59a8b3b3c99a09") }
+  end
+
+  def test_other_files_are_left_alone
+    small = File.join(@dir, "small")
+    File.open(small, "wb") { |f| f.write("not a cache") }
+
+    big = File.join(@dir, "big")
+    File.open(big, "wb") { |f| f.write("x" * 1024 * 1024) }
+
+    assert_raises(ArgumentError) { Rugged::SharedObjectCache.new(small) }
+    assert_raises(ArgumentError) { Rugged::SharedObjectCache.new(big) }
+
+    assert_equal "not a cache", File.binread(small)
+    assert_equal "x" * 1024 * 1024, File.binread(big)
+  end
+end
@@ -0,0 +1,58 @@
+require "test_helper"
+
+class TreeAggregatorTest < Rugged::TestCase
+  include Rugged::RepositoryAccess
+
+  def test_builtin_reducers_memoize_subtrees
+    agg = Rugged::TreeAggregator.new(@repo, :bytes)
+
+    assert_equal 13, agg.aggregate("f60079018b664e4e79329a7ef9559c8d9e0378d1")
+    assert_equal({ :hits => 0, :misses => 1, :entries => 1 }, agg.stats)
+
+    # the subtrees are shared with Tree#byte_stats, only roots are kept here
+    tree = @repo.lookup("36060c58702ed4c2a40832c51758d5344201d89a")
+    assert_equal 39, agg.aggregate(tree)
+    assert_equal tree.byte_stats.values.inject(0, :+), agg.aggregate(tree)
+    assert_equal({ :hits => 1, :misses => 2, :entries => 2 }, agg.stats)
+
+    assert_equal 6, Rugged::TreeAggregator.new(@repo, :files).aggregate("36060c58702ed4c2a40832c51758d5344201d89a")
+  end
+
+  def test_ruby_reducer
+    agg = Rugged::TreeAggregator.new(@repo) do |tree, results|
+      tree.count { |e| e[:name].end_with?(".txt") } + results.values.inject(0, :+)
+    end
+
+    assert_equal 3, agg.aggregate("c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+    assert_equal 1, agg.aggregate("f60079018b664e4e79329a7ef9559c8d9e0378d1")
+    assert_equal 1, agg.stats[:hits]
+  end
+
+  def test_bounded_cache
+    agg = Rugged::TreeAggregator.new(@repo, :files, :max_entries => 2)
+    agg.aggregate("c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+    assert_equal 2, agg.stats[:entries]
+
+    agg.clear
+    assert_equal 0, agg.stats[:entries]
+  end
+
+  def test_save_and_load
+    path = File.join(Dir.mktmpdir, "aggregates")
+
+    agg = Rugged::TreeAggregator.new(@repo, :bytes)
+    agg.aggregate("c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+    agg.save(path)
+
+    loaded = Rugged::TreeAggregator.new(@repo, :bytes).load(path)
+    assert_equal 39, loaded.aggregate("c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b")
+    assert_equal 0, loaded.stats[:misses]
+
+    assert_raises(ArgumentError) { Rugged::TreeAggregator.new(@repo, :files).load(path) }
+    assert_raises(ArgumentError) do
+      Rugged::TreeAggregator.new(@repo, :bytes).import_cache_entries("\0" * 20 => "39")
+    end
+  ensure
+    FileUtils.remove_entry_secure(File.dirname(path)) if path
+  end
+end
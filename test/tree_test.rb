@@ -71,6 +71,45 @@ class TreeTest < Rugged::TestCase
   def test_iterate_subtree_blobs
     @tree.each_blob {|tree| assert_equal :blob, tree[:type]}
   end
+
+  def test_changed_paths
+    old_tree = @repo.lookup("181037049a54a1eb5fab404658a3a250b44335d7")
+    readme, new_txt = "1385f264afb75a56a5bec74243be9b367ba4ca08", "fa49b077972391ad58037050f2a75f74e3671e92"
+
+    assert_equal [
+      [:added, "new.txt", nil, new_txt, nil],
+      [:added, "subdir/README", nil, readme, nil],
+      [:added, "subdir/new.txt", nil, new_txt, nil],
+      [:added, "subdir/subdir2/README", nil, readme, nil],
+      [:added, "subdir/subdir2/new.txt", nil, new_txt, nil]
+    ], old_tree.changed_paths(@tree)
+
+    assert_equal [:deleted, "new.txt", new_txt, nil, "new.txt"], @tree.changed_paths(old_tree).first
+    assert_equal 5, @tree.changed_paths(nil).size
+    assert_equal [], @tree.changed_paths(@repo.lookup("36060c58702ed4c2a40832c51758d5344201d89a"))
+  end
+
+  def test_changed_paths_with_paths
+    old_tree = @repo.lookup("181037049a54a1eb5fab404658a3a250b44335d7")
+
+    changes = old_tree.changed_paths(@tree, :paths => ["subdir/subdir2", "new.txt"])
+    assert_equal ["new.txt", "subdir/subdir2/README", "subdir/subdir2/new.txt"], changes.map { |c| c[1] }
+
+    changes = old_tree.changed_paths(@tree, :paths => ["subdir/subdir2/"])
+    assert_equal ["subdir/subdir2/README", "subdir/subdir2/new.txt"], changes.map { |c| c[1] }
+  end
+
+  def test_byte_stats
+    assert_equal({ "" => 12, ".txt" => 27 }, @tree.byte_stats)
+
+    # the second run is served from the subtree cache
+    stats = @tree.byte_stats
+    assert_equal({ "" => 12, ".txt" => 27 }, stats)
+    stats.clear
+    assert_equal({ "" => 12, ".txt" => 27 }, @tree.byte_stats)
+
+    assert_equal({ "" => 4, ".txt" => 9 }, @repo.lookup("f60079018b664e4e79329a7ef9559c8d9e0378d1").byte_stats)
+  end
 end
 
 class TreeWriteTest < Rugged::TestCase
@@ -88,4 +127,47 @@ class TreeWriteTest < Rugged::TestCase
     obj = @repo.lookup(sha)
     assert_equal 38, obj.read_raw.len
   end
+
+  def test_changed_paths_with_exact_renames
+    builder = Rugged::Tree::Builder.new
+    builder << { :type => :blob, :name => "README.txt", :filemode => 33188,
+                 :oid => "1385f264afb75a56a5bec74243be9b367ba4ca08" }
+    tree = @repo.lookup(builder.write(@repo))
+    old_tree = @repo.lookup("181037049a54a1eb5fab404658a3a250b44335d7")
+
+    assert_equal [5, 5], old_tree.changed_paths(tree).map(&:size)
+    assert_equal [[:renamed, "README.txt",
+      "1385f264afb75a56a5bec74243be9b367ba4ca08",
+      "1385f264afb75a56a5bec74243be9b367ba4ca08", "README"]],
+      old_tree.changed_paths(tree, :renames => true)
+  end
+
+  def test_changed_paths_with_renames_sorting_before_the_source
+    builder = Rugged::Tree::Builder.new
+    builder << { :type => :blob, :name => "0README", :filemode => 33188,
+                 :oid => "1385f264afb75a56a5bec74243be9b367ba4ca08" }
+    tree = @repo.lookup(builder.write(@repo))
+    old_tree = @repo.lookup("181037049a54a1eb5fab404658a3a250b44335d7")
+
+    assert_equal [[:renamed, "0README",
+      "1385f264afb75a56a5bec74243be9b367ba4ca08",
+      "1385f264afb75a56a5bec74243be9b367ba4ca08", "README"]],
+      old_tree.changed_paths(tree, :renames => true)
+  end
+  def test_byte_stats_uses_the_attributes_of_the_tree
+    script = @repo.write("puts 1\n", :blob)
+
+    attributes = Rugged::Tree::Builder.new
+    attributes << { :type => :blob, :name => "a.rb", :filemode => 33188, :oid => script }
+    attributes << { :type => :blob, :name => ".gitattributes", :filemode => 33188,
+                    :oid => @repo.write("*.rb linguist-language=Crystal\n", :blob) }
+    with_attributes = @repo.lookup(attributes.write(@repo))
+
+    plain = Rugged::Tree::Builder.new
+    plain << { :type => :blob, :name => "a.rb", :filemode => 33188, :oid => script }
+    without_attributes = @repo.lookup(plain.write(@repo))
+
+    assert_equal 7, with_attributes.byte_stats(:attribute => "linguist-language")["Crystal"]
+    assert_equal({ ".rb" => 7 }, without_attributes.byte_stats(:attribute => "linguist-language"))
+  end
 end
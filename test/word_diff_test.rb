@@ -0,0 +1,49 @@
+require "test_helper"
+
+class WordDiffTest < Rugged::TestCase
+  def test_changed_word
+    assert_equal [[4, 3], [4, 3]], Rugged.word_diff("int foo = 1;", "int bar = 1;")
+  end
+
+  def test_insertion_and_deletion
+    assert_equal [[], [4, 4]], Rugged.word_diff("foo bar", "foo baz bar")
+    assert_equal [[0, 3], []], Rugged.word_diff("abc", "")
+  end
+
+  def test_char_tokenizer
+    assert_equal [[2, 1], [2, 1, 5, 2]], Rugged.word_diff("a b c", "a x c d", :tokenizer => :char)
+  end
+
+  def test_custom_boundaries
+    old_ranges, new_ranges = Rugged.word_diff("foo.bar(baz)", "foo.qux(baz)", :tokenizer => ".()")
+    assert_equal [4, 3], old_ranges
+    assert_equal [4, 3], new_ranges
+
+    assert_equal [[0, 12], [0, 12]], Rugged.word_diff("foo.bar(baz)", "foo.qux(baz)", :tokenizer => :whitespace)
+  end
+
+  def test_invalid_tokenizer
+    assert_raises ArgumentError do
+      Rugged.word_diff("a", "b", :tokenizer => :sentence)
+    end
+  end
+end
+
+class PatchLinePairsTest < Rugged::SandboxedTestCase
+  def test_each_line_pair_with_changes
+    repo = sandbox_init("attr")
+    a = Rugged::Tree.lookup(repo, "605812a").tree
+    b = Rugged::Tree.lookup(repo, "370fe9ec22").tree
+
+    patch = a.diff(b).patches.find { |p| p.delta.new_file[:path] == "root_test3" }
+    pairs = patch.each_line_pair_with_changes.to_a
+
+    assert_equal 1, pairs.size
+
+    old_line, new_line, old_ranges, new_ranges = pairs.first
+    assert_equal "Hello from the root\n", old_line.content
+    assert_equal "Some additional lines\n", new_line.content
+    assert_equal [0, 5], old_ranges.first(2)
+    assert_equal [0, 4], new_ranges.first(2)
+  end
+end
@@ -0,0 +1,82 @@
+require "test_helper"
+
+class WriteOptionsTest < Rugged::TestCase
+  include Rugged::TempRepositoryAccess
+
+  def object_path(oid)
+    File.join(@repo.path, "objects", oid[0, 2], oid[2..-1])
+  end
+
+  def test_default_write_options
+    assert_equal({ :compression => nil, :fsync_objects => false, :fsync_refs => false }, @repo.write_options)
+  end
+
+  def test_compression_level
+    content = "a" * 4096
+
+    @repo.write_options = { :compression => 0 }
+    assert_equal 0, @repo.write_options[:compression]
+
+    oid = @repo.write(content, :blob)
+    assert File.size(object_path(oid)) > content.size
+    assert_equal content, @repo.read(oid).data
+
+    @repo.write_options = { :compression => 9 }
+    oid = @repo.write(content + "b", :blob)
+    assert File.size(object_path(oid)) < content.size
+  end
+
+  def test_invalid_compression_level
+    assert_raises(ArgumentError) { @repo.write_options = { :compression => 10 } }
+  end
+
+  def test_fsynced_writes
+    @repo.write_options = { :fsync_objects => true, :fsync_refs => true }
+
+    blob = Rugged::Blob.from_buffer(@repo, "durable\n")
+    assert_equal "durable\n", @repo.lookup(blob).content
+
+    person = { :name => "Scott", :email => "schacon@gmail.com", :time => Time.now }
+    commit = Rugged::Commit.create(@repo,
+      :message => "durable commit\n",
+      :committer => person,
+      :author => person,
+      :parents => [@repo.head.target],
+      :tree => "c4dc1555e4d4fa0e0c9c3fc46734c7c35b3ce90b",
+      :update_ref => "HEAD")
+    assert_equal commit, @repo.head.target
+
+    ref = Rugged::Reference.create(@repo, "refs/heads/durable", commit)
+    assert_equal commit, ref.target
+
+    branch = Rugged::Branch.create(@repo, "durable-branch", commit)
+    branch = branch.move("durable-moved")
+    assert_equal commit, Rugged::Branch.lookup(@repo, "durable-moved").target
+    branch.delete!
+    assert_nil Rugged::Branch.lookup(@repo, "durable-moved")
+
+    Rugged::Tag.create(@repo, :name => "durable-tag", :target => commit)
+    assert_equal commit, Rugged::Reference.lookup(@repo, "refs/tags/durable-tag").target
+    Rugged::Tag.delete(@repo, "durable-tag")
+    assert_nil Rugged::Reference.lookup(@repo, "refs/tags/durable-tag")
+  end
+
+  def test_write_policy_is_not_public
+    @repo.write_options = { :fsync_refs => true }
+    assert !Rugged::Repository.const_defined?(:WritePolicy)
+  end
+
+  def test_batch_fsync
+    @repo.write_options = { :fsync_objects => true }
+
+    oids = @repo.batch_fsync do
+      @repo.batch_fsync { (1..10).map { |i| @repo.write("batched #{i}\n", :blob) } }
+    end
+
+    assert_equal 10, oids.size
+    oids.each { |oid| assert @repo.exists?(oid) }
+
+    assert_raises(RuntimeError) { @repo.batch_fsync { raise "interrupted" } }
+    assert @repo.write("after batch\n", :blob)
+  end
+end